@@ -0,0 +1,156 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+/**
+ * @file
+ *
+ * @brief Compares the V, W, F, and K cycles on a variable coefficient Poisson problem
+ *
+ * usage: cycle_types [num_patches_per_side] [num_cells_per_side] [coefficient_jump]
+ *
+ * Each cycle is used as a stationary iteration until the residual is reduced by 1e-8. The number
+ * of cycles and the time (max over ranks) are printed for each cycle type.
+ */
+#include "utils/UniformDomainGenerator.h"
+#include <ThunderEgg/BiLinearGhostFiller.h>
+#include <ThunderEgg/DomainTools.h>
+#include <ThunderEgg/GMG/CycleBuilder.h>
+#include <ThunderEgg/GMG/DirectInterpolator.h>
+#include <ThunderEgg/GMG/LinearRestrictor.h>
+#include <ThunderEgg/Iterative/BiCGStab.h>
+#include <ThunderEgg/Iterative/PatchSolver.h>
+#include <ThunderEgg/VarPoisson/StarPatchOperator.h>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using namespace ThunderEgg;
+
+namespace {
+std::shared_ptr<GMG::Cycle<2>>
+BuildCycle(const vector<Domain<2>>& domains,
+           const vector<Vector<2>>& coeffs,
+           const GMG::CycleOpts& opts)
+{
+  GMG::CycleBuilder<2> builder(opts);
+  Iterative::BiCGStab<2> bcgs;
+  bcgs.setTolerance(1e-12);
+  for (size_t i = 0; i < domains.size(); i++) {
+    BiLinearGhostFiller ghost_filler(domains[i], GhostFillingType::Faces);
+    VarPoisson::StarPatchOperator<2> op(coeffs[i], domains[i], ghost_filler);
+    if (i == 0) {
+      Iterative::PatchSolver<2> smoother(bcgs, op);
+      GMG::LinearRestrictor<2> restrictor(domains[0], domains[1]);
+      builder.addFinestLevel(op, smoother, restrictor);
+    } else if (i + 1 < domains.size()) {
+      Iterative::PatchSolver<2> smoother(bcgs, op);
+      GMG::LinearRestrictor<2> restrictor(domains[i], domains[i + 1]);
+      GMG::DirectInterpolator<2> interpolator(domains[i], domains[i - 1]);
+      builder.addIntermediateLevel(op, smoother, restrictor, interpolator);
+    } else {
+      GMG::DirectInterpolator<2> interpolator(domains[i], domains[i - 1]);
+      builder.addCoarsestLevel(op, domains[i], interpolator);
+    }
+  }
+  return builder.getCycle();
+}
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  MPI_Init(&argc, &argv);
+  {
+    int num_patches_per_side = argc > 1 ? atoi(argv[1]) : 8;
+    int n = argc > 2 ? atoi(argv[2]) : 8;
+    double jump = argc > 3 ? atof(argv[3]) : 1000;
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    UniformDomainGenerator generator(num_patches_per_side, { n, n }, 1);
+    vector<Domain<2>> domains;
+    domains.push_back(generator.getFinestDomain());
+    while (generator.hasCoarserDomain()) {
+      domains.push_back(generator.getCoarserDomain());
+    }
+
+    // checkerboard of jumps, aligned with the coarsest patches below the root
+    auto coeff_func = [=](const std::array<double, 2>& coord) {
+      return ((coord[0] > 0.5) != (coord[1] > 0.5)) ? jump : 1.0;
+    };
+    vector<Vector<2>> coeffs;
+    for (const Domain<2>& domain : domains) {
+      coeffs.emplace_back(domain, 1);
+      DomainTools::SetValuesWithGhost<2>(domain, coeffs.back(), coeff_func);
+    }
+
+    BiLinearGhostFiller ghost_filler(domains[0], GhostFillingType::Faces);
+    VarPoisson::StarPatchOperator<2> op(coeffs[0], domains[0], ghost_filler);
+
+    Vector<2> f(domains[0], 1);
+    DomainTools::SetValues<2>(domains[0], f, [](const std::array<double, 2>& coord) {
+      return sin(M_PI * coord[0]) * sin(2 * M_PI * coord[1]) + 1;
+    });
+    double f_norm = f.twoNorm();
+
+    if (rank == 0) {
+      printf("%d x %d patches of %d x %d cells, coefficient jump %g\n",
+             num_patches_per_side,
+             num_patches_per_side,
+             n,
+             n,
+             jump);
+      printf("%-6s %8s %12s %14s\n", "cycle", "cycles", "time (s)", "time/cycle (s)");
+    }
+
+    for (const char* type : { "V", "W", "F", "K" }) {
+      GMG::CycleOpts opts;
+      opts.cycle_type = type;
+      auto cycle = BuildCycle(domains, coeffs, opts);
+
+      Vector<2> u = f.getZeroClone();
+      Vector<2> r = f;
+      Vector<2> e = f.getZeroClone();
+
+      MPI_Barrier(MPI_COMM_WORLD);
+      double start = MPI_Wtime();
+      int cycles = 0;
+      while (cycles < 100) {
+        cycles++;
+        cycle->apply(r, e);
+        u.add(e);
+        op.apply(u, r);
+        r.scaleThenAdd(-1, f);
+        if (r.twoNorm() < 1e-8 * f_norm) {
+          break;
+        }
+      }
+      double time = MPI_Wtime() - start;
+      double max_time;
+      MPI_Reduce(&time, &max_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+      if (rank == 0) {
+        printf("%-6s %8d %12.4f %14.6f\n", type, cycles, max_time, max_time / cycles);
+      }
+    }
+  }
+  MPI_Finalize();
+  return 0;
+}
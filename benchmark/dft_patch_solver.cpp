@@ -0,0 +1,223 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+/**
+ * @file
+ *
+ * @brief Compares the DFT transforms of DFTPatchSolver done line by line with dgemv and slab by
+ * slab with dgemm, and compares DFTPatchSolver, TridiagPatchSolver, and FFTWPatchSolver
+ *
+ * usage: dft_patch_solver [num_patches_per_side] [repetitions]
+ *
+ * For each n = 8, 16, 32, 64 the time of one forward transform of an n^D patch is printed for both
+ * transform formulations, followed by the time of a patch solver apply on a 2d domain with n x n
+ * cells per patch. Times are per repetition and are the max over ranks.
+ */
+#include "utils/UniformDomainGenerator.h"
+#include <ThunderEgg/BiLinearGhostFiller.h>
+#include <ThunderEgg/Config.h>
+#include <ThunderEgg/DomainTools.h>
+#include <ThunderEgg/Poisson/DFTPatchSolver.h>
+#include <ThunderEgg/Poisson/StarPatchOperator.h>
+#include <ThunderEgg/Poisson/TridiagPatchSolver.h>
+#ifdef THUNDEREGG_FFTW_ENABLED
+#include <ThunderEgg/Poisson/FFTWPatchSolver.h>
+#endif
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+extern "C" void
+dgemv_(char&, int&, int&, double&, double*, int&, double*, int&, double&, double*, int&);
+
+using namespace std;
+using namespace ThunderEgg;
+
+namespace {
+/**
+ * @brief Time a function, returns the max over ranks of the time per repetition
+ */
+double
+Time(int repetitions, const function<void()>& f)
+{
+  f();
+  MPI_Barrier(MPI_COMM_WORLD);
+  double start = MPI_Wtime();
+  for (int i = 0; i < repetitions; i++) {
+    f();
+  }
+  double time = (MPI_Wtime() - start) / repetitions;
+  double max_time;
+  MPI_Allreduce(&time, &max_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  return max_time;
+}
+/**
+ * @brief The transform along each axis as a dgemv for every line, this is how DFTPatchSolver used
+ * to transform patches
+ */
+void
+LineTransform(int D, int n, vector<double>& matrix, vector<double>& in, vector<double>& out)
+{
+  char T = 'T';
+  double one = 1;
+  double zero = 0;
+  int patch_size = in.size();
+  vector<double>* prev = &in;
+  vector<double>* next = &out;
+  int stride = 1;
+  for (int axis = 0; axis < D; axis++) {
+    int slab_size = stride * n;
+    for (int slab = 0; slab < patch_size; slab += slab_size) {
+      for (int line = 0; line < stride; line++) {
+        dgemv_(T,
+               n,
+               n,
+               one,
+               matrix.data(),
+               n,
+               prev->data() + slab + line,
+               stride,
+               zero,
+               next->data() + slab + line,
+               stride);
+      }
+    }
+    swap(prev, next);
+    stride = slab_size;
+  }
+}
+/**
+ * @brief The transform along each axis as a dgemm for every slab, this is how DFTPatchSolver
+ * transforms patches
+ */
+void
+SlabTransform(int D, int n, vector<double>& matrix, vector<double>& in, vector<double>& out)
+{
+  char N = 'N';
+  char T = 'T';
+  double one = 1;
+  double zero = 0;
+  int patch_size = in.size();
+  vector<double>* prev = &in;
+  vector<double>* next = &out;
+  int lower_size = 1;
+  for (int axis = 0; axis < D; axis++) {
+    int slab_size = lower_size * n;
+    int num_slabs = patch_size / slab_size;
+    if (axis == 0) {
+      dgemm_(T, N, n, num_slabs, n, one, matrix.data(), n, prev->data(), n, zero, next->data(), n);
+    } else {
+      for (int slab = 0; slab < num_slabs; slab++) {
+        dgemm_(N,
+               N,
+               lower_size,
+               n,
+               n,
+               one,
+               prev->data() + slab * slab_size,
+               lower_size,
+               matrix.data(),
+               n,
+               zero,
+               next->data() + slab * slab_size,
+               lower_size);
+      }
+    }
+    swap(prev, next);
+    lower_size = slab_size;
+  }
+}
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  MPI_Init(&argc, &argv);
+  {
+    int num_patches_per_side = argc > 1 ? atoi(argv[1]) : 4;
+    int repetitions = argc > 2 ? atoi(argv[2]) : 10;
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    if (rank == 0) {
+      printf("single patch forward transform\n");
+      printf("%-4s %4s %14s %14s %8s\n", "D", "n", "dgemv (s)", "dgemm (s)", "speedup");
+    }
+    for (int D : { 2, 3 }) {
+      for (int n : { 8, 16, 32, 64 }) {
+        int patch_size = D == 2 ? n * n : n * n * n;
+        vector<double> matrix(n * n);
+        vector<double> in(patch_size);
+        vector<double> out(patch_size);
+        for (int i = 0; i < n * n; i++) {
+          matrix[i] = cos(i);
+        }
+        for (int i = 0; i < patch_size; i++) {
+          in[i] = sin(i);
+        }
+        double line_time = Time(repetitions, [&]() { LineTransform(D, n, matrix, in, out); });
+        double slab_time = Time(repetitions, [&]() { SlabTransform(D, n, matrix, in, out); });
+        if (rank == 0) {
+          printf("%-4d %4d %14.3e %14.3e %8.2f\n", D, n, line_time, slab_time, line_time / slab_time);
+        }
+      }
+    }
+
+    if (rank == 0) {
+      printf("\npatch solver apply, %d x %d patches\n", num_patches_per_side, num_patches_per_side);
+      printf("%4s %14s %14s %14s\n", "n", "DFT (s)", "Tridiag (s)", "FFTW (s)");
+    }
+    for (int n : { 8, 16, 32, 64 }) {
+      UniformDomainGenerator generator(num_patches_per_side, { n, n }, 1);
+      Domain<2> domain = generator.getFinestDomain();
+
+      Vector<2> f(domain, 1);
+      DomainTools::SetValues<2>(domain, f, [](const std::array<double, 2>& coord) {
+        return sin(M_PI * coord[0]) * sin(2 * M_PI * coord[1]);
+      });
+      Vector<2> u = f.getZeroClone();
+
+      BiLinearGhostFiller ghost_filler(domain, GhostFillingType::Faces);
+      Poisson::StarPatchOperator<2> op(domain, ghost_filler);
+
+      Poisson::DFTPatchSolver<2> dft_solver(op, bitset<4>());
+      double dft_time = Time(repetitions, [&]() { dft_solver.apply(f, u); });
+
+      Poisson::TridiagPatchSolver<2> tridiag_solver(op, bitset<4>());
+      double tridiag_time = Time(repetitions, [&]() { tridiag_solver.apply(f, u); });
+
+      double fftw_time = 0;
+#ifdef THUNDEREGG_FFTW_ENABLED
+      Poisson::FFTWPatchSolver<2> fftw_solver(op, bitset<4>());
+      fftw_time = Time(repetitions, [&]() { fftw_solver.apply(f, u); });
+#endif
+      if (rank == 0) {
+        if (FFTW_ENABLED) {
+          printf("%4d %14.3e %14.3e %14.3e\n", n, dft_time, tridiag_time, fftw_time);
+        } else {
+          printf("%4d %14.3e %14.3e %14s\n", n, dft_time, tridiag_time, "-");
+        }
+      }
+    }
+  }
+  MPI_Finalize();
+  return 0;
+}
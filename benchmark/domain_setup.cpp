@@ -0,0 +1,109 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+/**
+ * @file
+ *
+ * @brief Measures the setup time of Domain, MPIGhostFiller, and GMG::InterLevelComm
+ *
+ * usage: domain_setup [max_patches] [repetitions]
+ *
+ * For uniform 2d domains of 128x128 patches, doubling the number of patches along each side until
+ * there are more than max_patches patches (default 10^6), the time to construct a Domain from its
+ * PatchInfo objects, a BiLinearGhostFiller, and an InterLevelComm to the next coarser domain is
+ * printed. Times are per construction and are the max over ranks. A PatchInfo takes about a
+ * kilobyte, so run with max_patches 1e7 on enough ranks to cover 10^4 to 10^7 patches.
+ */
+#include "utils/UniformDomainGenerator.h"
+#include <ThunderEgg/BiLinearGhostFiller.h>
+#include <ThunderEgg/GMG/InterLevelComm.h>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+using namespace std;
+using namespace ThunderEgg;
+
+namespace {
+/**
+ * @brief Time a function, returns the max over ranks of the time per repetition
+ */
+double
+Time(int repetitions, const function<void()>& f)
+{
+  MPI_Barrier(MPI_COMM_WORLD);
+  double start = MPI_Wtime();
+  for (int i = 0; i < repetitions; i++) {
+    f();
+  }
+  double time = (MPI_Wtime() - start) / repetitions;
+  double max_time;
+  MPI_Allreduce(&time, &max_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  return max_time;
+}
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  MPI_Init(&argc, &argv);
+  {
+    double max_patches = argc > 1 ? atof(argv[1]) : 1e6;
+    int repetitions = argc > 2 ? atoi(argv[2]) : 1;
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    if (rank == 0) {
+      printf("Domain setup, %d ranks\n", size);
+      printf("%10s %14s %14s %14s\n", "patches", "domain (s)", "filler (s)", "ilc (s)");
+    }
+    for (int k = 128; (double)k * k <= max_patches; k *= 2) {
+      UniformDomainGenerator generator(k, { 4, 4 }, 1);
+      Domain<2> finer_domain = generator.getFinestDomain();
+      Domain<2> coarser_domain = generator.getCoarserDomain();
+      const vector<PatchInfo<2>>& pinfos = finer_domain.getPatchInfoVector();
+
+      double domain_time = Time(repetitions, [&]() {
+        Domain<2> domain(finer_domain.getCommunicator(),
+                         finer_domain.getId(),
+                         finer_domain.getNs(),
+                         finer_domain.getNumGhostCells(),
+                         pinfos.begin(),
+                         pinfos.end());
+      });
+      double filler_time = Time(repetitions, [&]() {
+        BiLinearGhostFiller filler(finer_domain, GhostFillingType::Faces);
+      });
+      double ilc_time = Time(repetitions, [&]() {
+        GMG::InterLevelComm<2> ilc(coarser_domain, finer_domain);
+      });
+      if (rank == 0) {
+        printf("%10d %14.3e %14.3e %14.3e\n",
+               finer_domain.getNumGlobalPatches(),
+               domain_time,
+               filler_time,
+               ilc_time);
+      }
+    }
+  }
+  MPI_Finalize();
+}
@@ -0,0 +1,75 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+/**
+ * @file
+ *
+ * @brief Measures the setup time of Schur::InterfaceDomain
+ *
+ * usage: interface_domain_setup [repetitions]
+ *
+ * For uniform 2d domains of increasing size the time to construct a Schur::InterfaceDomain is
+ * printed, along with the number of patches and interfaces. Times are per construction and are
+ * the max over ranks. Run with an increasing number of ranks to see how the setup scales.
+ */
+#include "utils/UniformDomainGenerator.h"
+#include <ThunderEgg/Schur/InterfaceDomain.h>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using namespace ThunderEgg;
+
+int
+main(int argc, char* argv[])
+{
+  MPI_Init(&argc, &argv);
+  {
+    int repetitions = argc > 1 ? atoi(argv[1]) : 5;
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    if (rank == 0) {
+      printf("Schur::InterfaceDomain setup, %d ranks\n", size);
+      printf("%8s %12s %14s\n", "patches", "interfaces", "setup (s)");
+    }
+    for (int num_patches_per_side : { 8, 16, 32, 64 }) {
+      UniformDomainGenerator generator(num_patches_per_side, { 8, 8 }, 1);
+      Domain<2> domain = generator.getFinestDomain();
+
+      int num_global_ifaces = Schur::InterfaceDomain<2>(domain).getNumGlobalInterfaces();
+
+      MPI_Barrier(MPI_COMM_WORLD);
+      double start = MPI_Wtime();
+      for (int i = 0; i < repetitions; i++) {
+        Schur::InterfaceDomain<2> iface_domain(domain);
+      }
+      double time = (MPI_Wtime() - start) / repetitions;
+      double max_time;
+      MPI_Allreduce(&time, &max_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      if (rank == 0) {
+        printf("%8d %12d %14.3e\n", domain.getNumGlobalPatches(), num_global_ifaces, max_time);
+      }
+    }
+  }
+  MPI_Finalize();
+}
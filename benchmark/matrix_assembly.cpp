@@ -0,0 +1,156 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+/**
+ * @file
+ *
+ * @brief Measures the assembly time of the Poisson matrices
+ *
+ * usage: matrix_assembly [max_unknowns] [repetitions]
+ *
+ * For uniform 2d domains of 32x32 patches and uniform 3d domains of 16x16x16 patches, doubling the
+ * number of patches along each side until there are more than max_unknowns unknowns (default
+ * 10^7), the time to form the matrix with MatrixHelper2d and MatrixHelper is printed. The PETSc
+ * Mat is also formed when PETSc is enabled. Times are per assembly and are the max over ranks.
+ * Run with max_unknowns 1e8 on enough ranks to cover 10^6 to 10^8 unknowns.
+ */
+#include "utils/UniformDomainGenerator.h"
+#include <ThunderEgg/Poisson/MatrixHelper.h>
+#include <ThunderEgg/Poisson/MatrixHelper2d.h>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+using namespace std;
+using namespace ThunderEgg;
+
+namespace {
+/**
+ * @brief Time a function, returns the max over ranks of the time per repetition
+ */
+double
+Time(int repetitions, const function<void()>& f)
+{
+  MPI_Barrier(MPI_COMM_WORLD);
+  double start = MPI_Wtime();
+  for (int i = 0; i < repetitions; i++) {
+    f();
+  }
+  double time = (MPI_Wtime() - start) / repetitions;
+  double max_time;
+  MPI_Allreduce(&time, &max_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  return max_time;
+}
+/**
+ * @brief Get a uniform 3d domain on the unit cube, the patches are numbered with x varying fastest
+ * and are split into contiguous ranges over the ranks
+ */
+Domain<3>
+GetUniformDomain3D(int num_patches_per_side, int n)
+{
+  Communicator comm(MPI_COMM_WORLD);
+  int k = num_patches_per_side;
+  int num_patches = k * k * k;
+  auto owner = [&](int index) { return (int)((long long)index * comm.getSize() / num_patches); };
+  vector<PatchInfo<3>> pinfos;
+  for (int index = 0; index < num_patches; index++) {
+    if (owner(index) != comm.getRank()) {
+      continue;
+    }
+    array<int, 3> coord = { index % k, (index / k) % k, index / (k * k) };
+    PatchInfo<3>& pinfo = pinfos.emplace_back();
+    pinfo.id = index;
+    pinfo.rank = comm.getRank();
+    pinfo.ns = { n, n, n };
+    pinfo.num_ghost_cells = 1;
+    for (int axis = 0; axis < 3; axis++) {
+      pinfo.starts[axis] = (double)coord[axis] / k;
+      pinfo.spacings[axis] = 1.0 / k / n;
+    }
+    int stride = 1;
+    for (int axis = 0; axis < 3; axis++) {
+      for (Side<3> s : { LowerSideOnAxis<3>(axis), HigherSideOnAxis<3>(axis) }) {
+        int nbr_coord = coord[axis] + (s.isLowerOnAxis() ? -1 : 1);
+        if (nbr_coord >= 0 && nbr_coord < k) {
+          int nbr_id = index + (s.isLowerOnAxis() ? -stride : stride);
+          auto info = new NormalNbrInfo<2>(nbr_id);
+          info->rank = owner(nbr_id);
+          pinfo.setNbrInfo(s, info);
+        }
+      }
+      stride *= k;
+    }
+  }
+  return Domain<3>(comm, 0, { n, n, n }, 1, pinfos.begin(), pinfos.end());
+}
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  MPI_Init(&argc, &argv);
+  {
+    double max_unknowns = argc > 1 ? atof(argv[1]) : 1e7;
+    int repetitions = argc > 2 ? atoi(argv[2]) : 1;
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    if (rank == 0) {
+      printf("Poisson matrix assembly, %d ranks\n", size);
+      printf("%3s %12s %14s %14s\n", "dim", "unknowns", "sparse (s)", "petsc (s)");
+    }
+    for (int k = 32; (double)k * k * 32 * 32 <= max_unknowns; k *= 2) {
+      UniformDomainGenerator generator(k, { 32, 32 }, 1);
+      Domain<2> domain = generator.getFinestDomain();
+      Poisson::MatrixHelper2d mh(domain, 0);
+
+      double sparse_time = Time(repetitions, [&]() { mh.formSparseMatrix(); });
+      double petsc_time = 0;
+#ifdef THUNDEREGG_PETSC_ENABLED
+      petsc_time = Time(repetitions, [&]() {
+        Mat A = mh.formCRSMatrix();
+        MatDestroy(&A);
+      });
+#endif
+      if (rank == 0) {
+        printf("%3d %12d %14.3e %14.3e\n", 2, domain.getNumGlobalCells(), sparse_time, petsc_time);
+      }
+    }
+    for (int k = 4; (double)k * k * k * 16 * 16 * 16 <= max_unknowns; k *= 2) {
+      Domain<3> domain = GetUniformDomain3D(k, 16);
+      Poisson::MatrixHelper mh(domain, 0);
+
+      double sparse_time = Time(repetitions, [&]() { mh.formSparseMatrix(); });
+      double petsc_time = 0;
+#ifdef THUNDEREGG_PETSC_ENABLED
+      petsc_time = Time(repetitions, [&]() {
+        Mat A = mh.formCRSMatrix();
+        MatDestroy(&A);
+      });
+#endif
+      if (rank == 0) {
+        printf("%3d %12d %14.3e %14.3e\n", 3, domain.getNumGlobalCells(), sparse_time, petsc_time);
+      }
+    }
+  }
+  MPI_Finalize();
+}
@@ -0,0 +1,137 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+/**
+ * @file
+ *
+ * @brief Measures the effect of the local patch ordering on ghost filling, operator application,
+ * and restriction
+ *
+ * usage: patch_ordering [num_patches_per_side] [repetitions]
+ *
+ * A uniform 2d domain of num_patches_per_side x num_patches_per_side patches (default 256) with
+ * 8x8 cells, and its coarser domain, are constructed with the patches in row-major order, in a
+ * random order, and in Morton and Hilbert order. For each the time to fill the ghost cells, apply
+ * the Poisson operator, and restrict to the coarser domain is printed. The random order shows the
+ * cost of cache misses on neighboring patches, the curves show how much of it they recover. Times
+ * are per application and are the max over ranks.
+ */
+#include "utils/UniformDomainGenerator.h"
+#include <ThunderEgg/BiLinearGhostFiller.h>
+#include <ThunderEgg/GMG/LinearRestrictor.h>
+#include <ThunderEgg/Poisson/StarPatchOperator.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+
+using namespace std;
+using namespace ThunderEgg;
+
+namespace {
+/**
+ * @brief Time a function, returns the max over ranks of the time per repetition
+ */
+double
+Time(int repetitions, const function<void()>& f)
+{
+  MPI_Barrier(MPI_COMM_WORLD);
+  double start = MPI_Wtime();
+  for (int i = 0; i < repetitions; i++) {
+    f();
+  }
+  double time = (MPI_Wtime() - start) / repetitions;
+  double max_time;
+  MPI_Allreduce(&time, &max_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  return max_time;
+}
+/**
+ * @brief Construct a copy of a domain with its patches shuffled and then ordered
+ */
+Domain<2>
+GetOrderedDomain(const Domain<2>& domain, bool shuffle, PatchOrdering ordering)
+{
+  vector<PatchInfo<2>> pinfos = domain.getPatchInfoVector();
+  if (shuffle) {
+    mt19937 generator(domain.getCommunicator().getRank());
+    std::shuffle(pinfos.begin(), pinfos.end(), generator);
+  }
+  return Domain<2>(domain.getCommunicator(),
+                   domain.getId(),
+                   domain.getNs(),
+                   domain.getNumGhostCells(),
+                   pinfos.begin(),
+                   pinfos.end(),
+                   ordering);
+}
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  MPI_Init(&argc, &argv);
+  {
+    int num_patches_per_side = argc > 1 ? atoi(argv[1]) : 256;
+    int repetitions = argc > 2 ? atoi(argv[2]) : 10;
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    UniformDomainGenerator generator(num_patches_per_side, { 8, 8 }, 1);
+    Domain<2> finer_domain = generator.getFinestDomain();
+    Domain<2> coarser_domain = generator.getCoarserDomain();
+
+    if (rank == 0) {
+      printf("Patch ordering, %d patches, %d ranks\n", finer_domain.getNumGlobalPatches(), size);
+      printf("%10s %14s %14s %14s\n", "order", "ghost (s)", "apply (s)", "restrict (s)");
+    }
+    struct Case
+    {
+      const char* name;
+      bool shuffle;
+      PatchOrdering ordering;
+    };
+    for (Case c : { Case{ "row-major", false, PatchOrdering::Given },
+                    Case{ "random", true, PatchOrdering::Given },
+                    Case{ "morton", true, PatchOrdering::Morton },
+                    Case{ "hilbert", true, PatchOrdering::Hilbert } }) {
+      Domain<2> finer = GetOrderedDomain(finer_domain, c.shuffle, c.ordering);
+      Domain<2> coarser = GetOrderedDomain(coarser_domain, c.shuffle, c.ordering);
+
+      BiLinearGhostFiller ghost_filler(finer, GhostFillingType::Faces);
+      Poisson::StarPatchOperator<2> op(finer, ghost_filler);
+      GMG::LinearRestrictor<2> restrictor(finer, coarser);
+
+      Vector<2> u(finer, 1);
+      Vector<2> f(finer, 1);
+      u.set(1.0);
+
+      double ghost_time = Time(repetitions, [&]() { ghost_filler.fillGhost(u); });
+      double apply_time = Time(repetitions, [&]() { op.apply(u, f); });
+      double restrict_time = Time(repetitions, [&]() { restrictor.restrict(u); });
+      if (rank == 0) {
+        printf("%10s %14.3e %14.3e %14.3e\n", c.name, ghost_time, apply_time, restrict_time);
+      }
+    }
+  }
+  MPI_Finalize();
+}
@@ -0,0 +1,111 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+/**
+ * @file
+ *
+ * @brief Measures the latency of the Schur complement matrix-vector product
+ *
+ * usage: schur_matvec [num_patches_per_side] [repetitions]
+ *
+ * For each n = 4, 8, 16, 32 the time of a PatchIfaceScatter scatterStart/scatterFinish pair and the
+ * time of a PatchSolverWrapper apply are printed for a 2d domain with n x n cells per patch. The
+ * patches are solved with a patch-local CG. Times are per repetition and are the max over ranks.
+ */
+#include "utils/UniformDomainGenerator.h"
+#include <ThunderEgg/BiLinearGhostFiller.h>
+#include <ThunderEgg/Iterative/CG.h>
+#include <ThunderEgg/Iterative/PatchSolver.h>
+#include <ThunderEgg/Poisson/StarPatchOperator.h>
+#include <ThunderEgg/Schur/PatchSolverWrapper.h>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+using namespace std;
+using namespace ThunderEgg;
+
+namespace {
+/**
+ * @brief Time a function, returns the max over ranks of the time per repetition
+ */
+double
+Time(int repetitions, const function<void()>& f)
+{
+  f();
+  MPI_Barrier(MPI_COMM_WORLD);
+  double start = MPI_Wtime();
+  for (int i = 0; i < repetitions; i++) {
+    f();
+  }
+  double time = (MPI_Wtime() - start) / repetitions;
+  double max_time;
+  MPI_Allreduce(&time, &max_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  return max_time;
+}
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  MPI_Init(&argc, &argv);
+  {
+    int num_patches_per_side = argc > 1 ? atoi(argv[1]) : 8;
+    int repetitions = argc > 2 ? atoi(argv[2]) : 100;
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    if (rank == 0) {
+      printf("Schur complement matvec, %d x %d patches\n",
+             num_patches_per_side,
+             num_patches_per_side);
+      printf("%4s %14s %14s\n", "n", "scatter (s)", "apply (s)");
+    }
+    for (int n : { 4, 8, 16, 32 }) {
+      UniformDomainGenerator generator(num_patches_per_side, { n, n }, 1);
+      Domain<2> domain = generator.getFinestDomain();
+      Schur::InterfaceDomain<2> iface_domain(domain);
+
+      BiLinearGhostFiller ghost_filler(domain, GhostFillingType::Faces);
+      Poisson::StarPatchOperator<2> op(domain, ghost_filler);
+      Iterative::CG<2> cg;
+      cg.setTolerance(1e-8);
+      Iterative::PatchSolver<2> patch_solver(cg, op);
+      Schur::PatchSolverWrapper<2> wrapper(iface_domain, patch_solver);
+
+      Vector<1> x = iface_domain.getNewVector();
+      x.set(1);
+      Vector<1> b = iface_domain.getNewVector();
+
+      Schur::PatchIfaceScatter<2> scatter(iface_domain);
+      auto local_x = scatter.getNewLocalPatchIfaceVector();
+
+      double scatter_time = Time(repetitions, [&]() {
+        auto state = scatter.scatterStart(x, *local_x);
+        scatter.scatterFinish(state, x, *local_x);
+      });
+      double apply_time = Time(repetitions, [&]() { wrapper.apply(x, b); });
+      if (rank == 0) {
+        printf("%4d %14.3e %14.3e\n", n, scatter_time, apply_time);
+      }
+    }
+  }
+  MPI_Finalize();
+}
@@ -26,6 +26,7 @@ if(CMAKE_VERSION VERSION_LESS 3.21)
 endif()
 
 option(ThunderEgg_BUILD_TESTING "build tests" ${ThunderEgg_IS_TOP_LEVEL})
+option(ThunderEgg_BUILD_BENCHMARKS "build benchmarks" off)
 
 # users can specify like "cmake -B build -DCMAKE_INSTALL_PREFIX=~/mydir"
 if(ThunderEgg_IS_TOP_LEVEL AND CMAKE_INSTALL_PREFIX_INITIALIZED_TO_DEFAULT)
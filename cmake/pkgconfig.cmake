@@ -14,6 +14,9 @@ endif()
 if(TARGET LAPACK::LAPACK)
   string(APPEND pc_libs_public " -llapack")
 endif()
+if(CMAKE_THREAD_LIBS_INIT)
+  string(APPEND pc_libs_public " ${CMAKE_THREAD_LIBS_INIT}")
+endif()
 
 configure_file(cmake/ThunderEgg.pc.in ThunderEgg.pc @ONLY) 
 
@@ -0,0 +1,462 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef THUNDEREGG_AGGLOMERATINGDOMAINGENERATOR_H
+#define THUNDEREGG_AGGLOMERATINGDOMAINGENERATOR_H
+/**
+ * @file
+ *
+ * @brief AgglomeratingDomainGenerator class
+ */
+#include <ThunderEgg/BufferReader.h>
+#include <ThunderEgg/BufferWriter.h>
+#include <ThunderEgg/DomainGenerator.h>
+#include <ThunderEgg/RuntimeError.h>
+#include <algorithm>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+
+namespace ThunderEgg {
+/**
+ * @brief Wraps a DomainGenerator and moves coarse levels onto fewer ranks.
+ *
+ * Coarse levels generated by an octree/quadtree library keep their patches on the ranks that own
+ * the finer patches, so on deep hierarchies most ranks end up owning zero or one patch while
+ * still taking part in every level's communication. This generator limits the number of ranks a
+ * level is spread over to (number of global patches) / min_patches_per_rank. When a level falls
+ * below that threshold its patches are split, in order, into contiguous ranges over ranks
+ * 0, 1, ..., n-1 of the communicator. The set of active ranks only ever shrinks going coarser.
+ *
+ * A redistributed domain uses a sub-communicator of the active ranks. Since the active ranks are
+ * always the first n ranks, the ranks in the sub-communicator are the same as the ranks in the
+ * original communicator, and rank information in the PatchInfo objects (neighbor, parent, and
+ * child ranks) is valid in both. Ranks that are left without patches get a domain with no
+ * patches on MPI_COMM_SELF, and the GMG cycles skip those levels entirely.
+ *
+ * Neighbor, parent, and child ranks are updated on both sides of every redistributed level, so
+ * GMG::InterLevelComm handles moving values between levels with its usual point-to-point
+ * exchanges.
+ *
+ * @tparam D the number of Cartesian dimensions
+ */
+template<int D>
+class AgglomeratingDomainGenerator : public DomainGenerator<D>
+{
+private:
+  /**
+   * @brief A level that has been generated but not yet returned
+   *
+   * The parent ranks of a level can only be set after the next coarser level is redistributed,
+   * so levels are held here until then.
+   */
+  struct PendingDomain
+  {
+    /**
+     * @brief the communicator for the domain
+     */
+    Communicator comm;
+    /**
+     * @brief the id of the domain
+     */
+    int id;
+    /**
+     * @brief the number of cells in each direction
+     */
+    std::array<int, D> ns;
+    /**
+     * @brief the number of ghost cells on each side of a patch
+     */
+    int num_ghost_cells;
+    /**
+     * @brief the patches now on this rank
+     */
+    std::vector<PatchInfo<D>> pinfos;
+    /**
+     * @brief the patches this rank owned before redistribution
+     *
+     * Stored as {id, new rank, parent id, parent rank before redistribution}
+     */
+    std::vector<std::array<int, 4>> original_patches;
+  };
+  /**
+   * @brief the wrapped generator
+   */
+  std::shared_ptr<DomainGenerator<D>> generator;
+  /**
+   * @brief the minimum average number of patches a rank should have on a level
+   */
+  int min_patches_per_rank;
+  /**
+   * @brief communicator used for moving patches between ranks
+   */
+  Communicator comm;
+  /**
+   * @brief the number of ranks that the last generated level is spread over
+   */
+  int num_active_ranks = 0;
+  /**
+   * @brief levels that have been generated, but not returned. Finer level is in the front
+   */
+  std::list<PendingDomain> pending;
+
+  /**
+   * @brief Exchange (id, rank) pairs with other ranks
+   *
+   * @param outgoing map from destination rank to the (id, rank) pairs to send to that rank
+   * @param sources the ranks that will send to this rank
+   * @param tag the tag to use
+   * @return std::map<int, int> the received (id, rank) pairs
+   */
+  std::map<int, int> exchange(const std::map<int, std::set<std::pair<int, int>>>& outgoing,
+                              const std::set<int>& sources,
+                              int tag) const
+  {
+    int rank = comm.getRank();
+    std::map<int, int> incoming;
+
+    std::vector<std::vector<int>> send_buffers;
+    std::vector<MPI_Request> send_requests;
+    send_buffers.reserve(outgoing.size());
+    send_requests.reserve(outgoing.size());
+    for (const auto& pair : outgoing) {
+      if (pair.first == rank) {
+        incoming.insert(pair.second.begin(), pair.second.end());
+        continue;
+      }
+      std::vector<int>& buffer = send_buffers.emplace_back();
+      buffer.reserve(2 * pair.second.size());
+      for (const auto& id_rank : pair.second) {
+        buffer.push_back(id_rank.first);
+        buffer.push_back(id_rank.second);
+      }
+      MPI_Request& request = send_requests.emplace_back();
+      MPI_Isend(buffer.data(),
+                (int)buffer.size(),
+                MPI_INT,
+                pair.first,
+                tag,
+                comm.getMPIComm(),
+                &request);
+    }
+
+    for (int source : sources) {
+      if (source == rank) {
+        continue;
+      }
+      MPI_Status status;
+      MPI_Probe(source, tag, comm.getMPIComm(), &status);
+      int size;
+      MPI_Get_count(&status, MPI_INT, &size);
+      std::vector<int> buffer(size);
+      MPI_Recv(buffer.data(), size, MPI_INT, source, tag, comm.getMPIComm(), MPI_STATUS_IGNORE);
+      for (int i = 0; i < size; i += 2) {
+        incoming[buffer[i]] = buffer[i + 1];
+      }
+    }
+
+    MPI_Waitall((int)send_requests.size(), send_requests.data(), MPI_STATUSES_IGNORE);
+    return incoming;
+  }
+
+  /**
+   * @brief Move patches to their new ranks
+   *
+   * @param pinfos the local patches, in order
+   * @param new_ranks the new rank for each patch
+   * @param num_ghost_cells the number of ghost cells on each side of a patch
+   * @return std::vector<PatchInfo<D>> the patches that are now on this rank, in order
+   */
+  std::vector<PatchInfo<D>> migrate(const std::vector<PatchInfo<D>>& pinfos,
+                                    const std::vector<int>& new_ranks,
+                                    int num_ghost_cells) const
+  {
+    int size = comm.getSize();
+
+    std::vector<int> send_counts(size, 0);
+    for (size_t i = 0; i < pinfos.size(); i++) {
+      send_counts[new_ranks[i]] += pinfos[i].serialize(nullptr);
+    }
+    std::vector<int> send_offsets(size, 0);
+    for (int r = 1; r < size; r++) {
+      send_offsets[r] = send_offsets[r - 1] + send_counts[r - 1];
+    }
+    std::vector<char> send_buffer(send_offsets.back() + send_counts.back());
+    std::vector<int> positions = send_offsets;
+    for (size_t i = 0; i < pinfos.size(); i++) {
+      int& pos = positions[new_ranks[i]];
+      pos += pinfos[i].serialize(send_buffer.data() + pos);
+    }
+
+    std::vector<int> recv_counts(size);
+    MPI_Alltoall(
+      send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, comm.getMPIComm());
+    std::vector<int> recv_offsets(size, 0);
+    for (int r = 1; r < size; r++) {
+      recv_offsets[r] = recv_offsets[r - 1] + recv_counts[r - 1];
+    }
+    int recv_size = recv_offsets.back() + recv_counts.back();
+    std::vector<char> recv_buffer(recv_size);
+    MPI_Alltoallv(send_buffer.data(),
+                  send_counts.data(),
+                  send_offsets.data(),
+                  MPI_CHAR,
+                  recv_buffer.data(),
+                  recv_counts.data(),
+                  recv_offsets.data(),
+                  MPI_CHAR,
+                  comm.getMPIComm());
+
+    // patches arrive in order of source rank, which keeps the original ordering
+    std::vector<PatchInfo<D>> new_pinfos;
+    BufferReader reader(recv_buffer.data());
+    int pos = 0;
+    while (pos < recv_size) {
+      PatchInfo<D>& pinfo = new_pinfos.emplace_back();
+      reader >> pinfo;
+      pos = reader.getPos();
+      pinfo.num_ghost_cells = num_ghost_cells;
+    }
+    return new_pinfos;
+  }
+
+  /**
+   * @brief Redistribute a newly generated coarser domain, and update the parent ranks of the
+   * pending finer domain
+   *
+   * @param coarser the coarser domain from the wrapped generator
+   */
+  void agglomerate(const Domain<D>& coarser)
+  {
+    int rank = comm.getRank();
+    int size = comm.getSize();
+    PendingDomain& finer = pending.back();
+
+    PendingDomain& result = pending.emplace_back();
+    result.id = coarser.getId();
+    result.ns = coarser.getNs();
+    result.num_ghost_cells = coarser.getNumGhostCells();
+
+    int num_global = coarser.getNumGlobalPatches();
+    int num_active = std::clamp(num_global / min_patches_per_rank, 1, num_active_ranks);
+    const std::vector<PatchInfo<D>>& pinfos = coarser.getPatchInfoVector();
+
+    if (num_active == size) {
+      // keep the layout of the wrapped generator
+      result.comm = coarser.getCommunicator();
+      result.pinfos = pinfos;
+      result.original_patches.reserve(pinfos.size());
+      for (const PatchInfo<D>& pinfo : pinfos) {
+        result.original_patches.push_back({ pinfo.id, rank, pinfo.parent_id, pinfo.parent_rank });
+      }
+      num_active_ranks = size;
+      return;
+    }
+
+    // split the patches into contiguous ranges over the active ranks
+    int num_local = (int)pinfos.size();
+    int offset = 0;
+    MPI_Exscan(&num_local, &offset, 1, MPI_INT, MPI_SUM, comm.getMPIComm());
+    if (rank == 0) {
+      offset = 0;
+    }
+    std::vector<int> new_ranks(pinfos.size());
+    std::map<int, int> id_to_new_rank;
+    for (size_t i = 0; i < pinfos.size(); i++) {
+      new_ranks[i] = (int)((long long)(offset + i) * num_active / num_global);
+      id_to_new_rank[pinfos[i].id] = new_ranks[i];
+    }
+
+    // get the new ranks of neighbors
+    {
+      std::map<int, std::set<std::pair<int, int>>> outgoing;
+      std::set<int> sources;
+      for (size_t i = 0; i < pinfos.size(); i++) {
+        for (int nbr_rank : pinfos[i].getNbrRanks()) {
+          if (nbr_rank != rank) {
+            outgoing[nbr_rank].emplace(pinfos[i].id, new_ranks[i]);
+            sources.insert(nbr_rank);
+          }
+        }
+      }
+      std::map<int, int> nbr_new_ranks = exchange(outgoing, sources, 0);
+      id_to_new_rank.insert(nbr_new_ranks.begin(), nbr_new_ranks.end());
+    }
+
+    // get the new ranks of children, the children report to their original parent rank
+    std::map<int, int> child_new_ranks;
+    {
+      std::map<int, std::set<std::pair<int, int>>> outgoing;
+      std::set<int> sources;
+      for (const std::array<int, 4>& patch : finer.original_patches) {
+        if (patch[3] != -1) {
+          outgoing[patch[3]].emplace(patch[0], patch[1]);
+        }
+      }
+      for (const PatchInfo<D>& pinfo : pinfos) {
+        for (int child_rank : pinfo.child_ranks) {
+          if (child_rank != -1) {
+            sources.insert(child_rank);
+          }
+        }
+      }
+      child_new_ranks = exchange(outgoing, sources, 1);
+    }
+
+    // send the new ranks of parents to wherever the children are now
+    {
+      std::map<int, std::set<std::pair<int, int>>> outgoing;
+      std::set<int> sources;
+      for (size_t i = 0; i < pinfos.size(); i++) {
+        for (int child_id : pinfos[i].child_ids) {
+          if (child_id != -1) {
+            outgoing[child_new_ranks.at(child_id)].emplace(pinfos[i].id, new_ranks[i]);
+          }
+        }
+      }
+      for (const PatchInfo<D>& pinfo : finer.pinfos) {
+        if (pinfo.parent_rank != -1) {
+          sources.insert(pinfo.parent_rank);
+        }
+      }
+      std::map<int, int> parent_new_ranks = exchange(outgoing, sources, 2);
+      for (PatchInfo<D>& pinfo : finer.pinfos) {
+        if (pinfo.parent_id != -1) {
+          pinfo.parent_rank = parent_new_ranks.at(pinfo.parent_id);
+        }
+      }
+    }
+
+    // update rank information and move the patches
+    std::vector<PatchInfo<D>> updated_pinfos(pinfos);
+    result.original_patches.reserve(pinfos.size());
+    for (size_t i = 0; i < updated_pinfos.size(); i++) {
+      PatchInfo<D>& pinfo = updated_pinfos[i];
+      result.original_patches.push_back({ pinfo.id, new_ranks[i], pinfo.parent_id, pinfo.parent_rank });
+      pinfo.rank = new_ranks[i];
+      pinfo.setNeighborRanks(id_to_new_rank);
+      for (size_t orth = 0; orth < pinfo.child_ids.size(); orth++) {
+        if (pinfo.child_ids[orth] != -1) {
+          pinfo.child_ranks[orth] = child_new_ranks.at(pinfo.child_ids[orth]);
+        }
+      }
+    }
+    result.pinfos = migrate(updated_pinfos, new_ranks, result.num_ghost_cells);
+
+    // the active ranks get a sub-communicator, the rest work alone
+    MPI_Comm sub_comm;
+    MPI_Comm_split(comm.getMPIComm(), rank < num_active ? 0 : MPI_UNDEFINED, rank, &sub_comm);
+    if (sub_comm != MPI_COMM_NULL) {
+      result.comm = Communicator(sub_comm);
+      MPI_Comm_free(&sub_comm);
+    } else {
+      result.comm = Communicator(MPI_COMM_SELF);
+    }
+
+    num_active_ranks = num_active;
+  }
+
+  /**
+   * @brief Generate the next coarser level (if there is one) and return the pending finer
+   * domain
+   */
+  Domain<D> next()
+  {
+    if (generator->hasCoarserDomain()) {
+      agglomerate(generator->getCoarserDomain());
+    }
+    const PendingDomain& front = pending.front();
+    Domain<D> domain(front.comm,
+                     front.id,
+                     front.ns,
+                     front.num_ghost_cells,
+                     front.pinfos.begin(),
+                     front.pinfos.end());
+    pending.pop_front();
+    return domain;
+  }
+
+public:
+  /**
+   * @brief Construct a new AgglomeratingDomainGenerator object
+   *
+   * @param generator the generator to wrap
+   * @param min_patches_per_rank coarse levels are spread over at most (number of global patches) /
+   * min_patches_per_rank ranks
+   */
+  AgglomeratingDomainGenerator(std::shared_ptr<DomainGenerator<D>> generator,
+                               int min_patches_per_rank)
+    : generator(generator)
+    , min_patches_per_rank(min_patches_per_rank)
+  {
+    if (min_patches_per_rank < 1) {
+      throw RuntimeError("min_patches_per_rank has to be at least 1");
+    }
+  }
+  /**
+   * @brief Return the finest domain
+   *
+   * The finest domain is never redistributed.
+   */
+  Domain<D> getFinestDomain() override
+  {
+    Domain<D> finest = generator->getFinestDomain();
+    comm = Communicator(finest.getCommunicator().getMPIComm());
+    num_active_ranks = comm.getSize();
+
+    pending.clear();
+    PendingDomain& level = pending.emplace_back();
+    level.comm = finest.getCommunicator();
+    level.id = finest.getId();
+    level.ns = finest.getNs();
+    level.num_ghost_cells = finest.getNumGhostCells();
+    level.pinfos = finest.getPatchInfoVector();
+    level.original_patches.reserve(level.pinfos.size());
+    for (const PatchInfo<D>& pinfo : level.pinfos) {
+      level.original_patches.push_back(
+        { pinfo.id, comm.getRank(), pinfo.parent_id, pinfo.parent_rank });
+    }
+    return next();
+  }
+  /**
+   * @brief return true if there is a coarser domain to be generated.
+   */
+  bool hasCoarserDomain() override { return !pending.empty(); }
+  /**
+   * @brief Return a new coarser domain
+   */
+  Domain<D> getCoarserDomain() override
+  {
+    if (pending.empty()) {
+      throw RuntimeError("AgglomeratingDomainGenerator has no coarser domain to return, "
+                         "getFinestDomain has to be called first");
+    }
+    return next();
+  }
+  /**
+   * @brief Get the minimum average number of patches per rank on a level
+   */
+  int getMinPatchesPerRank() const { return min_patches_per_rank; }
+};
+extern template class AgglomeratingDomainGenerator<2>;
+extern template class AgglomeratingDomainGenerator<3>;
+} // namespace ThunderEgg
+#endif
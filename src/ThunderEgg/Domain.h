@@ -25,9 +25,15 @@
  *
  * @brief Domain class
  */
+#include <ThunderEgg/IdMap.h>
+#include <ThunderEgg/NbrTable.h>
 #include <ThunderEgg/PatchInfo.h>
+#include <ThunderEgg/PatchOrdering.h>
+#include <ThunderEgg/SpaceFillingCurve.h>
 #include <ThunderEgg/Timer.h>
+#include <algorithm>
 #include <map>
+#include <memory>
 #include <set>
 #include <vector>
 
@@ -44,6 +50,9 @@ namespace ThunderEgg {
  * This class mainly manages a set of patches that makes up the domain. It is responsible for
  * setting up the indexing of the domains, which is used in the rest of the ThunderEgg library.
  *
+ * The patches and the NbrTable are immutable after construction and are shared between copies of
+ * a Domain, so copying a Domain is cheap.
+ *
  * @tparam D the number of Cartesian dimensions
  */
 template<int D>
@@ -78,7 +87,11 @@ private:
    * @brief Vector of PatchInfo pointers where index in the vector corresponds to the patch's
    * local index
    */
-  std::vector<PatchInfo<D>> pinfos;
+  std::shared_ptr<const std::vector<PatchInfo<D>>> pinfos;
+  /**
+   * @brief The neighbors of the patches
+   */
+  std::shared_ptr<const NbrTable<D>> nbr_table;
   /**
    * @brief The global number of patches
    */
@@ -90,113 +103,129 @@ private:
 
   /**
    * @brief Give the patches local indexes.
+   *
+   * @param new_pinfos the patches
    */
-  void indexPatchesLocal()
+  static void indexPatchesLocal(std::vector<PatchInfo<D>>& new_pinfos)
   {
     // index patches
     int curr_index = 0;
-    std::map<int, int> id_to_local_index;
-    for (auto& pinfo : pinfos) {
+    IdMap id_to_local_index(new_pinfos.size());
+    for (auto& pinfo : new_pinfos) {
       pinfo.local_index = curr_index;
-      id_to_local_index[pinfo.id] = pinfo.local_index;
+      id_to_local_index.set(pinfo.id, pinfo.local_index);
       curr_index++;
     }
 
     // set local index in nbrinfo objects
-    for (auto& pinfo : pinfos) {
+    for (auto& pinfo : new_pinfos) {
       pinfo.setNeighborLocalIndexes(id_to_local_index);
     }
   }
+  /**
+   * @brief Sort (rank, id) pairs and remove duplicates
+   *
+   * @param pairs the pairs
+   * @return std::vector<size_t> the start of the range of pairs for each rank, with the end of
+   * the last range appended
+   */
+  static std::vector<size_t> sortByRank(std::vector<std::pair<int, int>>& pairs)
+  {
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    std::vector<size_t> rank_starts;
+    for (size_t i = 0; i < pairs.size(); i++) {
+      if (i == 0 || pairs[i].first != pairs[i - 1].first) {
+        rank_starts.push_back(i);
+      }
+    }
+    rank_starts.push_back(pairs.size());
+    return rank_starts;
+  }
   /**
    * @brief Give the patches global indexes
+   *
+   * @param new_pinfos the patches
    */
-  void indexPatchesGlobal()
+  void indexPatchesGlobal(std::vector<PatchInfo<D>>& new_pinfos)
   {
     // get starting global index
-    int num_local_patches = (int)pinfos.size();
+    int num_local_patches = (int)new_pinfos.size();
     int curr_global_index;
     MPI_Scan(&num_local_patches, &curr_global_index, 1, MPI_INT, MPI_SUM, comm.getMPIComm());
     curr_global_index -= num_local_patches;
 
     // index the patches
-    std::map<int, int> id_to_global_index;
-    for (auto& pinfo : pinfos) {
+    for (auto& pinfo : new_pinfos) {
       pinfo.global_index = curr_global_index;
-      id_to_global_index[pinfo.id] = pinfo.global_index;
       curr_global_index++;
     }
 
-    std::map<int, std::set<std::pair<int, int>>> ranks_to_ids_and_global_indexes_outgoing;
-    std::map<int, std::set<int>> ranks_to_ids_incoming;
-    for (auto& pinfo : pinfos) {
+    // (rank, id) pairs of the patches that are sent to each neighboring rank, and of the
+    // neighbors that are received from each neighboring rank. Both sides sort by id.
+    std::vector<std::pair<int, int>> outgoing;
+    std::vector<std::pair<int, int>> incoming;
+    for (auto& pinfo : new_pinfos) {
       auto ranks = pinfo.getNbrRanks();
       auto ids = pinfo.getNbrIds();
       for (size_t idx = 0; idx < ranks.size(); idx++) {
         int nbr_id = ids[idx];
         int nbr_rank = ranks[idx];
         if (nbr_rank != comm.getRank()) {
-          ranks_to_ids_and_global_indexes_outgoing[nbr_rank].insert(
-            std::make_pair(pinfo.id, pinfo.global_index));
-          ranks_to_ids_incoming[nbr_rank].insert(nbr_id);
+          outgoing.emplace_back(nbr_rank, pinfo.id);
+          incoming.emplace_back(nbr_rank, nbr_id);
         }
       }
     }
+    std::vector<size_t> outgoing_rank_starts = sortByRank(outgoing);
+    std::vector<size_t> incoming_rank_starts = sortByRank(incoming);
 
-    // prepare to recieve data
-    std::vector<MPI_Request> recv_requests;
-
-    // allocate incoming vectors and post recvs
-    std::map<int, std::vector<int>> rank_to_incoming_data;
-    for (const auto& pair : ranks_to_ids_incoming) {
-      int source_rank = pair.first;
-      std::vector<int>& incoming_data = rank_to_incoming_data[source_rank];
-      incoming_data.resize(pair.second.size());
+    IdMap id_to_global_index(new_pinfos.size() + incoming.size());
+    for (auto& pinfo : new_pinfos) {
+      id_to_global_index.set(pinfo.id, pinfo.global_index);
+    }
 
-      MPI_Request request;
-      MPI_Irecv(incoming_data.data(),
-                (int)incoming_data.size(),
+    // post recvs
+    std::vector<int> incoming_data(incoming.size());
+    std::vector<MPI_Request> recv_requests(incoming_rank_starts.size() - 1);
+    for (size_t i = 0; i < recv_requests.size(); i++) {
+      size_t start = incoming_rank_starts[i];
+      MPI_Irecv(incoming_data.data() + start,
+                (int)(incoming_rank_starts[i + 1] - start),
                 MPI_INT,
-                source_rank,
+                incoming[start].first,
                 0,
                 comm.getMPIComm(),
-                &request);
-      recv_requests.push_back(request);
+                &recv_requests[i]);
     }
 
-    // prepare outgoing vector of data and send it
-    std::vector<MPI_Request> send_requests;
-
-    // post sends
-    std::map<int, std::vector<int>> rank_to_outgoing_data;
-    for (const auto& pair : ranks_to_ids_and_global_indexes_outgoing) {
-      int dest_rank = pair.first;
-      // allocate and fill vector
-      std::vector<int>& data = rank_to_outgoing_data[dest_rank];
-      data.reserve(pair.second.size());
-      for (const auto& id_and_global_index : pair.second) {
-        data.push_back(id_and_global_index.second);
-      }
-      MPI_Request request;
-      MPI_Isend(data.data(), (int)data.size(), MPI_INT, dest_rank, 0, comm.getMPIComm(), &request);
-      send_requests.push_back(request);
+    // fill outgoing data and post sends
+    std::vector<int> outgoing_data;
+    outgoing_data.reserve(outgoing.size());
+    for (const auto& rank_and_id : outgoing) {
+      outgoing_data.push_back(id_to_global_index.at(rank_and_id.second));
+    }
+    std::vector<MPI_Request> send_requests(outgoing_rank_starts.size() - 1);
+    for (size_t i = 0; i < send_requests.size(); i++) {
+      size_t start = outgoing_rank_starts[i];
+      MPI_Isend(outgoing_data.data() + start,
+                (int)(outgoing_rank_starts[i + 1] - start),
+                MPI_INT,
+                outgoing[start].first,
+                0,
+                comm.getMPIComm(),
+                &send_requests[i]);
     }
 
     // add global indexes to map as recvs come in
     for (size_t i = 0; i < recv_requests.size(); i++) {
-      MPI_Status status;
       int request_index;
-      MPI_Waitany((int)recv_requests.size(), recv_requests.data(), &request_index, &status);
-
-      int source_rank = status.MPI_SOURCE;
-      const std::set<int>& incoming_ids = ranks_to_ids_incoming[source_rank];
-      const std::vector<int>& data = rank_to_incoming_data[source_rank];
-
-      auto curr_id = incoming_ids.cbegin();
-      auto curr_global_index_iter = data.cbegin();
-      while (curr_id != incoming_ids.cend()) {
-        id_to_global_index[*curr_id] = *curr_global_index_iter;
-        curr_id++;
-        curr_global_index_iter++;
+      MPI_Waitany(
+        (int)recv_requests.size(), recv_requests.data(), &request_index, MPI_STATUS_IGNORE);
+      for (size_t j = incoming_rank_starts[request_index];
+           j < incoming_rank_starts[request_index + 1];
+           j++) {
+        id_to_global_index.set(incoming[j].second, incoming_data[j]);
       }
     }
 
@@ -204,7 +233,7 @@ private:
     MPI_Waitall((int)send_requests.size(), send_requests.data(), MPI_STATUSES_IGNORE);
 
     // update global indexes in nbrinfo objects
-    for (auto& pinfo : pinfos) {
+    for (auto& pinfo : new_pinfos) {
       pinfo.setNeighborGlobalIndexes(id_to_global_index);
     }
   }
@@ -219,6 +248,9 @@ public:
    * @param num_ghost_cells the number of ghost cells on each side of the patch
    * @param first_pinfo start iterator for PatchInfo objects
    * @param last_pinfo end iterator for PatchInfo objects
+   * @param ordering the order to give the patches local indexes in, by default the order of the
+   * iterators. The space filling curve orders place neighboring patches, and parents and children
+   * on neighboring levels, near each other in memory.
    */
   template<class InputIterator>
   Domain(Communicator comm,
@@ -226,13 +258,14 @@ public:
          std::array<int, D> ns,
          int num_ghost_cells,
          InputIterator first_pinfo,
-         InputIterator last_pinfo)
+         InputIterator last_pinfo,
+         PatchOrdering ordering = PatchOrdering::Given)
     : comm(comm)
     , id(id)
     , ns(ns)
     , num_ghost_cells(num_ghost_cells)
-    , pinfos(first_pinfo, last_pinfo)
   {
+    auto new_pinfos = std::make_shared<std::vector<PatchInfo<D>>>(first_pinfo, last_pinfo);
     num_cells_in_patch = 1;
     num_cells_in_patch_with_ghost = 1;
     for (size_t i = 0; i < D; i++) {
@@ -240,11 +273,15 @@ public:
       num_cells_in_patch_with_ghost *= (ns[i] + 2 * num_ghost_cells);
     }
 
-    int num_local_domains = pinfos.size();
+    int num_local_domains = new_pinfos->size();
     MPI_Allreduce(&num_local_domains, &global_num_patches, 1, MPI_INT, MPI_SUM, comm.getMPIComm());
 
-    indexPatchesLocal();
-    indexPatchesGlobal();
+    SpaceFillingCurve<D>::sortPatches(*new_pinfos, ordering, comm);
+    indexPatchesLocal(*new_pinfos);
+    indexPatchesGlobal(*new_pinfos);
+
+    pinfos = new_pinfos;
+    nbr_table = std::make_shared<const NbrTable<D>>(*pinfos);
   }
   /**
    * @brief Get the Communicator object associated with this domain
@@ -256,7 +293,11 @@ public:
    * @brief Get a vector of PatchInfo pointers where index in the vector corresponds to the
    * patch's local index
    */
-  const std::vector<PatchInfo<D>>& getPatchInfoVector() const { return pinfos; }
+  const std::vector<PatchInfo<D>>& getPatchInfoVector() const { return *pinfos; }
+  /**
+   * @brief Get the neighbors of the local patches, indexed by local index
+   */
+  const NbrTable<D>& getNbrTable() const { return *nbr_table; }
   /**
    * @brief Get the number of cells in each direction
    *
@@ -269,7 +310,7 @@ public:
   /**
    * @brief Get the number of local patches
    */
-  int getNumLocalPatches() const { return (int)pinfos.size(); }
+  int getNumLocalPatches() const { return (int)pinfos->size(); }
   /**
    * @brief get the number of global cells
    */
@@ -277,13 +318,13 @@ public:
   /**
    * @brief Get get the number of local cells
    */
-  int getNumLocalCells() const { return ((int)pinfos.size()) * num_cells_in_patch; }
+  int getNumLocalCells() const { return ((int)pinfos->size()) * num_cells_in_patch; }
   /**
    * @brief Get get the number of local cells (including ghost cells)
    */
   int getNumLocalCellsWithGhost() const
   {
-    return ((int)pinfos.size()) * num_cells_in_patch_with_ghost;
+    return ((int)pinfos->size()) * num_cells_in_patch_with_ghost;
   }
   /**
    * @brief Get the number of cells in a patch
@@ -301,7 +342,7 @@ public:
   double volume() const
   {
     double sum = 0;
-    for (auto& pinfo : pinfos) {
+    for (auto& pinfo : *pinfos) {
       double patch_vol = 1;
       for (size_t i = 0; i < D; i++) {
         patch_vol *= pinfo.spacings[i] * pinfo.ns[i];
@@ -91,21 +91,27 @@ public:
       nbr_ranks.push_back(ranks[i]);
     }
   }
-  void setGlobalIndexes(const std::map<int, int>& id_to_global_index_map) override
+  void setGlobalIndexes(const IdMap& id_to_global_index_map) override
   {
     for (size_t i = 0; i < global_indexes.size(); i++) {
       global_indexes[i] = id_to_global_index_map.at(ids[i]);
     }
   }
-  void setLocalIndexes(const std::map<int, int>& id_to_local_index_map) override
+  void setLocalIndexes(const IdMap& id_to_local_index_map) override
   {
     for (size_t i = 0; i < local_indexes.size(); i++) {
-      auto iter = id_to_local_index_map.find(ids[i]);
-      if (iter != id_to_local_index_map.end()) {
-        local_indexes[i] = iter->second;
+      const int* local_index = id_to_local_index_map.find(ids[i]);
+      if (local_index != nullptr) {
+        local_indexes[i] = *local_index;
       }
     }
   }
+  void setRanks(const IdMap& id_to_rank_map) override
+  {
+    for (size_t i = 0; i < ranks.size(); i++) {
+      ranks[i] = id_to_rank_map.at(ids[i]);
+    }
+  }
   int serialize(char* buffer) const override
   {
     BufferWriter writer(buffer);
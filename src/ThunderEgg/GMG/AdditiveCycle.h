@@ -0,0 +1,114 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2018-2021 Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#ifndef THUNDEREGG_GMG_ADDITIVECYCLE_H
+#define THUNDEREGG_GMG_ADDITIVECYCLE_H
+/**
+ * @file
+ *
+ * @brief AdditiveCycle class
+ */
+#include <ThunderEgg/GMG/Cycle.h>
+#include <ThunderEgg/GMG/CycleOpts.h>
+namespace ThunderEgg::GMG {
+/**
+ * @brief Implementation of an additive (BPX-style) multigrid cycle
+ *
+ * The residual is restricted to every level, each level smooths its own restricted residual
+ * starting from a zero guess, and the corrections are interpolated back and summed. Unlike the
+ * multiplicative cycles, no level waits on the correction of another level, so the restriction
+ * to the coarser level is communicated while the current level is being smoothed.
+ *
+ * Each coarser correction is scaled by CycleOpts::additive_coarse_scale before it is interpolated.
+ * With averaging restriction and constant interpolation (LinearRestrictor and DirectInterpolator)
+ * the Galerkin coarse operator is twice the rediscretized one, so the default of 0.5 keeps the
+ * coarse levels from being over-weighted.
+ *
+ * With a symmetric smoother (such as a patch solver) this is a symmetric preconditioner, and it is
+ * meant to be used with Iterative::PCG rather than as a stationary iteration.
+ */
+template<int D>
+class AdditiveCycle : public Cycle<D>
+{
+private:
+  int num_sweeps = 1;
+  int num_coarse_sweeps = 1;
+  double coarse_scale = 0.5;
+
+protected:
+  /**
+   * @brief Implements the additive cycle. Start restricting, smooth, finish restricting, visit the
+   * coarser level, and then add the coarser correction.
+   *
+   * @param level the current level that is being visited.
+   */
+  void visit(const Level<D>& level, const Vector<D>& f, Vector<D>& u) const override
+  {
+    if (this->idle(f)) {
+      return;
+    }
+    if (level.coarsest()) {
+      for (int i = 0; i < num_coarse_sweeps; i++) {
+        level.getSmoother().smooth(f, u);
+      }
+    } else {
+      const Restrictor<D>& restrictor = level.getRestrictor();
+      restrictor.restrictStart(f);
+
+      for (int i = 0; i < num_sweeps; i++) {
+        level.getSmoother().smooth(f, u);
+      }
+
+      Vector<D> coarser_f = restrictor.restrictFinish(f);
+
+      const Level<D>& coarser_level = level.getCoarser();
+      Vector<D> coarser_u = coarser_f.getZeroClone();
+      this->visit(coarser_level, coarser_f, coarser_u);
+
+      coarser_u.scale(coarse_scale);
+      coarser_level.getInterpolator().interpolate(coarser_u, u);
+    }
+  }
+
+public:
+  /**
+   * @brief Create new additive cycle
+   *
+   * @param finest_level a pointer to the finest level
+   * @param opts the options, uses pre_sweeps for the number of sweeps on each level,
+   * coarse_sweeps, and additive_coarse_scale
+   */
+  AdditiveCycle(const Level<D>& finest_level, const CycleOpts& opts)
+    : Cycle<D>(finest_level)
+  {
+    num_sweeps = opts.pre_sweeps;
+    num_coarse_sweeps = opts.coarse_sweeps;
+    coarse_scale = opts.additive_coarse_scale;
+  }
+  /**
+   * @brief Get a clone of this AdditiveCycle
+   *
+   * @return AdditiveCycle<D>* a newly allocated copy
+   */
+  AdditiveCycle<D>* clone() const override { return new AdditiveCycle(*this); }
+};
+extern template class AdditiveCycle<2>;
+extern template class AdditiveCycle<3>;
+} // namespace ThunderEgg::GMG
+#endif
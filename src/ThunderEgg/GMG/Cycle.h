@@ -64,6 +64,21 @@ protected:
     return level.getRestrictor().restrict(r);
   }
 
+  /**
+   * @brief Check if there is nothing to do on a level on this rank.
+   *
+   * This is the case on ranks that were left without patches on a coarse level (see
+   * AgglomeratingDomainGenerator). Those ranks have the level on MPI_COMM_SELF, so they can skip
+   * it, along with all the coarser levels, without waiting on any other rank.
+   *
+   * @param f the rhs vector cooresponding to the level
+   * @return true if the level has no patches on this rank's communicator
+   */
+  static bool idle(const Vector<D>& f)
+  {
+    return f.getNumLocalPatches() == 0 && f.getCommunicator().getSize() == 1;
+  }
+
   /**
    * @brief Virtual visit function that needs to be implemented in derived classes.
    *
@@ -26,7 +26,10 @@
  * @brief CycleBuilder class
  */
 
+#include <ThunderEgg/GMG/AdditiveCycle.h>
+#include <ThunderEgg/GMG/DirectCoarseSolver.h>
 #include <ThunderEgg/GMG/FMGCycle.h>
+#include <ThunderEgg/GMG/KCycle.h>
 #include <ThunderEgg/GMG/Level.h>
 #include <ThunderEgg/GMG/VCycle.h>
 #include <ThunderEgg/GMG/WCycle.h>
@@ -167,6 +170,31 @@ public:
 
     prev_level->setCoarser(new_level);
   }
+  /**
+   * @brief Add the coarsest level to the Cycle, solving it directly instead of smoothing
+   *
+   * A DirectCoarseSolver is constructed for the level and used in place of the smoother. This is
+   * collective over the Domain's communicator, and is only intended for small coarse problems.
+   *
+   * @param op the Operator for the level
+   * @param domain the Domain for the level
+   * @param interpolator the Interpolator that restricts from this level to the finer level
+   * @param num_components the number of components in the vectors
+   */
+  void addCoarsestLevel(const Operator<D>& op,
+                        const Domain<D>& domain,
+                        const Interpolator<D>& interpolator,
+                        int num_components = 1)
+  {
+    if (!has_finest) {
+      throw RuntimeError("addFinestLevel has not been called yet");
+    }
+    if (has_coarsest) {
+      throw RuntimeError("addCoarsestLevel has already been called");
+    }
+    DirectCoarseSolver<D> solver(domain, op, num_components);
+    addCoarsestLevel(op, solver, interpolator);
+  }
   /**
    * @brief Get the completed Cycle object
    *
@@ -185,6 +213,10 @@ public:
       cycle.reset(new WCycle<D>(*finest_level, opts));
     } else if (opts.cycle_type == "F") {
       cycle.reset(new FMGCycle<D>(*finest_level, opts));
+    } else if (opts.cycle_type == "K") {
+      cycle.reset(new KCycle<D>(*finest_level, opts));
+    } else if (opts.cycle_type == "A") {
+      cycle.reset(new AdditiveCycle<D>(*finest_level, opts));
     } else {
       throw RuntimeError("Unsupported Cycle type: " + opts.cycle_type);
     }
@@ -49,7 +49,20 @@ struct CycleOpts
    */
   int coarse_sweeps = 1;
   /**
-   * @brief Cycle type
+   * @brief Number of Krylov iterations for each coarse-level correction in a K-cycle (1 or 2)
+   */
+  int kcycle_iterations = 2;
+  /**
+   * @brief The K-cycle skips the second Krylov iteration if the first one reduces the coarse
+   * residual by this factor
+   */
+  double kcycle_tolerance = 0.25;
+  /**
+   * @brief Scaling applied to each coarser correction in an additive cycle
+   */
+  double additive_coarse_scale = 0.5;
+  /**
+   * @brief Cycle type ("V", "W", "F", "K", or "A" for additive)
    */
   std::string cycle_type = "V";
 };
@@ -0,0 +1,538 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef THUNDEREGG_GMG_DIRECTCOARSESOLVER_H
+#define THUNDEREGG_GMG_DIRECTCOARSESOLVER_H
+/**
+ * @file
+ *
+ * @brief DirectCoarseSolver class
+ */
+
+#include <ThunderEgg/Domain.h>
+#include <ThunderEgg/GMG/Smoother.h>
+#include <ThunderEgg/Operator.h>
+#include <ThunderEgg/RuntimeError.h>
+#include <ThunderEgg/Vector.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+extern "C" void
+dgetrf_(int&, int&, double*, int&, int*, int&);
+extern "C" void
+dgetrs_(char&, int&, int&, double*, int&, int*, double*, int&, int&);
+
+namespace ThunderEgg::GMG {
+/**
+ * @brief Solves the coarsest level of a cycle exactly with a dense LU factorization.
+ *
+ * On construction, the operator is assembled column by column by applying it to unit vectors.
+ * The rows are gathered onto a single root rank of a sub-communicator that contains only the
+ * ranks that own patches on this level, and then factorized once (with LAPACK if it is enabled).
+ *
+ * Each call to smooth() gathers the rhs onto the root, solves with the factorization, and
+ * scatters the solution back. Ranks that have no patches on this level return immediately
+ * without communicating.
+ *
+ * If the operator annihilates the constant vector of a component, as a pure Neumann Poisson
+ * operator does, the first unknown of that component is pinned to zero so that the matrix can be
+ * factorized. The solution is then shifted to have zero mean in that component, since it is only
+ * defined up to a constant.
+ *
+ * Assembly requires one operator application per global unknown, and the factorization is
+ * stored densely, so this is only intended for small coarse problems. The number of global
+ * unknowns is capped by the max_unknowns constructor argument (DEFAULT_MAX_UNKNOWNS by default,
+ * which is a 128 MiB matrix), and a RuntimeError is thrown before anything is assembled if the
+ * level is larger than that.
+ *
+ * @tparam D the number of Cartesian dimensions
+ */
+template<int D>
+class DirectCoarseSolver : public Smoother<D>
+{
+private:
+  /**
+   * @brief The domain of the coarsest level
+   */
+  Domain<D> domain;
+  /**
+   * @brief The number of components
+   */
+  int num_components;
+  /**
+   * @brief The largest number of global unknowns that will be assembled
+   */
+  int max_unknowns;
+  /**
+   * @brief Sub-communicator of ranks that own patches on this level, null on other ranks
+   */
+  Communicator sub_comm;
+  /**
+   * @brief The number of local unknowns on each rank of the sub-communicator, only set on root
+   */
+  std::vector<int> counts;
+  /**
+   * @brief The offsets of each rank in the global unknowns, only set on root
+   */
+  std::vector<int> offsets;
+  /**
+   * @brief The global number of unknowns
+   */
+  int n = 0;
+  /**
+   * @brief The LU factorization in column-major order, only set on root
+   */
+  std::shared_ptr<std::vector<double>> lu;
+  /**
+   * @brief The pivots of the LU factorization, only set on root
+   */
+  std::shared_ptr<std::vector<int>> pivots;
+  /**
+   * @brief The pinned unknown of each component, -1 if the component is not singular, only set on
+   * root
+   */
+  std::shared_ptr<std::vector<int>> pinned;
+
+  /**
+   * @brief Copy the interior values of a vector into a contiguous buffer
+   *
+   * @param vec the vector
+   * @param buffer the buffer
+   */
+  static void pack(const Vector<D>& vec, std::vector<double>& buffer)
+  {
+    int idx = 0;
+    for (int i = 0; i < vec.getNumLocalPatches(); i++) {
+      PatchView<const double, D> view = vec.getPatchView(i);
+      Loop::OverInteriorIndexes<D + 1>(
+        view, [&](const std::array<int, D + 1>& coord) { buffer[idx++] = view[coord]; });
+    }
+  }
+  /**
+   * @brief Copy the values in a contiguous buffer into the interior of a vector
+   *
+   * @param buffer the buffer
+   * @param vec the vector
+   */
+  static void unpack(const std::vector<double>& buffer, Vector<D>& vec)
+  {
+    int idx = 0;
+    for (int i = 0; i < vec.getNumLocalPatches(); i++) {
+      PatchView<double, D> view = vec.getPatchView(i);
+      Loop::OverInteriorIndexes<D + 1>(
+        view, [&](const std::array<int, D + 1>& coord) { view[coord] = buffer[idx++]; });
+    }
+  }
+  /**
+   * @brief Assemble the operator and gather the rows onto the root of the sub-communicator
+   *
+   * @param op the operator
+   * @return std::vector<double> the column-major matrix on root, empty on other ranks
+   */
+  std::vector<double> assemble(const Operator<D>& op)
+  {
+    const Communicator& comm = domain.getCommunicator();
+    int num_local = domain.getNumLocalCells() * num_components;
+    int offset = 0;
+    MPI_Exscan(&num_local, &offset, 1, MPI_INT, MPI_SUM, comm.getMPIComm());
+    if (comm.getRank() == 0) {
+      offset = 0;
+    }
+    MPI_Allreduce(&num_local, &n, 1, MPI_INT, MPI_SUM, comm.getMPIComm());
+    if (n == 0) {
+      // an empty level, this happens on ranks that were agglomerated away from this level
+      return std::vector<double>();
+    }
+    if (n > max_unknowns) {
+      throw RuntimeError("DirectCoarseSolver coarse problem has " + std::to_string(n) +
+                         " unknowns, which is more than the limit of " +
+                         std::to_string(max_unknowns));
+    }
+
+    // the local rows of each column
+    std::vector<double> local_rows(num_local * (size_t)n);
+    std::vector<double> buffer(num_local);
+
+    Vector<D> e(domain, num_components);
+    Vector<D> col(domain, num_components);
+    for (int j = 0; j < n; j++) {
+      e.setWithGhost(0);
+      if (j >= offset && j < offset + num_local) {
+        std::fill(buffer.begin(), buffer.end(), 0);
+        buffer[j - offset] = 1;
+        unpack(buffer, e);
+      }
+      op.apply(e, col);
+      pack(col, buffer);
+      std::copy(buffer.begin(), buffer.end(), local_rows.begin() + (size_t)j * num_local);
+    }
+
+    if (num_local > 0) {
+      int sub_rank = sub_comm.getRank();
+      int sub_size = sub_comm.getSize();
+      if (sub_rank == 0) {
+        counts.resize(sub_size);
+        offsets.resize(sub_size);
+      }
+      MPI_Gather(&num_local, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, sub_comm.getMPIComm());
+      MPI_Gather(&offset, 1, MPI_INT, offsets.data(), 1, MPI_INT, 0, sub_comm.getMPIComm());
+
+      std::vector<int> block_counts;
+      std::vector<int> block_displs;
+      std::vector<double> blocks;
+      if (sub_rank == 0) {
+        block_counts.resize(sub_size);
+        block_displs.resize(sub_size);
+        int displ = 0;
+        for (int r = 0; r < sub_size; r++) {
+          block_counts[r] = counts[r] * n;
+          block_displs[r] = displ;
+          displ += block_counts[r];
+        }
+        blocks.resize((size_t)n * n);
+      }
+      MPI_Gatherv(local_rows.data(),
+                  (int)local_rows.size(),
+                  MPI_DOUBLE,
+                  blocks.data(),
+                  block_counts.data(),
+                  block_displs.data(),
+                  MPI_DOUBLE,
+                  0,
+                  sub_comm.getMPIComm());
+
+      if (sub_rank == 0) {
+        // reorder the per rank blocks into a single column-major matrix
+        std::vector<double> matrix((size_t)n * n);
+        for (int r = 0; r < sub_size; r++) {
+          const double* block = blocks.data() + block_displs[r];
+          for (int j = 0; j < n; j++) {
+            for (int i = 0; i < counts[r]; i++) {
+              matrix[(size_t)j * n + offsets[r] + i] = block[(size_t)j * counts[r] + i];
+            }
+          }
+        }
+        return matrix;
+      }
+    }
+    return std::vector<double>();
+  }
+  /**
+   * @brief Get the component of a global unknown
+   *
+   * @param j the index of the global unknown
+   * @return int the component
+   */
+  int componentOf(int j) const
+  {
+    int cells_in_patch = domain.getNumCellsInPatch();
+    return (j % (cells_in_patch * num_components)) / cells_in_patch;
+  }
+  /**
+   * @brief Pin one unknown of each component that has the constant vector in its null space
+   *
+   * The row of a pinned unknown is replaced with the corresponding row of the identity.
+   *
+   * @param matrix the column-major matrix
+   * @return std::vector<int> the pinned unknown of each component, -1 if the component is not
+   * singular
+   */
+  std::vector<int> pinNullSpace(std::vector<double>& matrix) const
+  {
+    // the row sums of the matrix restricted to the columns of each component, i.e. the operator
+    // applied to the constant vector of each component
+    std::vector<double> row_sums((size_t)n * num_components);
+    double scale = 0;
+    for (int i = 0; i < n; i++) {
+      double abs_sum = 0;
+      for (int j = 0; j < n; j++) {
+        double a_ij = matrix[(size_t)j * n + i];
+        row_sums[(size_t)componentOf(j) * n + i] += a_ij;
+        abs_sum += std::abs(a_ij);
+      }
+      scale = std::max(scale, abs_sum);
+    }
+    std::vector<int> pins(num_components, -1);
+    for (int c = 0; c < num_components; c++) {
+      double max_sum = 0;
+      for (int i = 0; i < n; i++) {
+        max_sum = std::max(max_sum, std::abs(row_sums[(size_t)c * n + i]));
+      }
+      if (max_sum <= 1e-10 * scale) {
+        int p = c * domain.getNumCellsInPatch();
+        for (int j = 0; j < n; j++) {
+          matrix[(size_t)j * n + p] = j == p ? 1 : 0;
+        }
+        pins[c] = p;
+      }
+    }
+    return pins;
+  }
+  /**
+   * @brief Shift a component of the global solution to have zero mean
+   *
+   * @param x the global solution
+   * @param component the component
+   */
+  void removeMean(std::vector<double>& x, int component) const
+  {
+    double sum = 0;
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+      if (componentOf(i) == component) {
+        sum += x[i];
+        count++;
+      }
+    }
+    double mean = sum / count;
+    for (int i = 0; i < n; i++) {
+      if (componentOf(i) == component) {
+        x[i] -= mean;
+      }
+    }
+  }
+  /**
+   * @brief Factorize the matrix in place
+   *
+   * @param matrix the column-major matrix, replaced with its LU factorization
+   * @param ipiv the resulting pivots
+   */
+  void factorize(std::vector<double>& matrix, std::vector<int>& ipiv) const
+  {
+    ipiv.resize(n);
+    int info = 0;
+    if constexpr (LAPACK_ENABLED) {
+      int lda = n;
+      int m = n;
+      dgetrf_(m, m, matrix.data(), lda, ipiv.data(), info);
+    } else {
+      // partial pivoting LU, pivots are 1-based to match LAPACK
+      for (int k = 0; k < n && info == 0; k++) {
+        int p = k;
+        for (int i = k + 1; i < n; i++) {
+          if (std::abs(matrix[(size_t)k * n + i]) > std::abs(matrix[(size_t)k * n + p])) {
+            p = i;
+          }
+        }
+        ipiv[k] = p + 1;
+        if (matrix[(size_t)k * n + p] == 0) {
+          info = k + 1;
+          break;
+        }
+        if (p != k) {
+          for (int j = 0; j < n; j++) {
+            std::swap(matrix[(size_t)j * n + k], matrix[(size_t)j * n + p]);
+          }
+        }
+        double pivot = matrix[(size_t)k * n + k];
+        for (int i = k + 1; i < n; i++) {
+          matrix[(size_t)k * n + i] /= pivot;
+        }
+        for (int j = k + 1; j < n; j++) {
+          double a_kj = matrix[(size_t)j * n + k];
+          for (int i = k + 1; i < n; i++) {
+            matrix[(size_t)j * n + i] -= matrix[(size_t)k * n + i] * a_kj;
+          }
+        }
+      }
+    }
+    if (info != 0) {
+      throw RuntimeError("DirectCoarseSolver failed to factorize the coarse matrix, info: " +
+                         std::to_string(info));
+    }
+  }
+  /**
+   * @brief Solve using the factorization, in place
+   *
+   * @param x the rhs on input, the solution on output
+   */
+  void solveFactored(std::vector<double>& x) const
+  {
+    if constexpr (LAPACK_ENABLED) {
+      char T = 'N';
+      int nrhs = 1;
+      int lda = n;
+      int m = n;
+      int info = 0;
+      dgetrs_(T, m, nrhs, lu->data(), lda, pivots->data(), x.data(), lda, info);
+    } else {
+      const std::vector<double>& a = *lu;
+      for (int k = 0; k < n; k++) {
+        std::swap(x[k], x[(*pivots)[k] - 1]);
+      }
+      for (int j = 0; j < n; j++) {
+        for (int i = j + 1; i < n; i++) {
+          x[i] -= a[(size_t)j * n + i] * x[j];
+        }
+      }
+      for (int j = n - 1; j >= 0; j--) {
+        x[j] /= a[(size_t)j * n + j];
+        for (int i = 0; i < j; i++) {
+          x[i] -= a[(size_t)j * n + i] * x[j];
+        }
+      }
+    }
+  }
+
+public:
+  /**
+   * @brief The default limit on the number of global unknowns
+   */
+  static constexpr int DEFAULT_MAX_UNKNOWNS = 4096;
+  /**
+   * @brief Construct a new DirectCoarseSolver object
+   *
+   * This is collective over the Domain's communicator.
+   *
+   * @param domain the Domain of the coarsest level
+   * @param op the Operator of the coarsest level, it has to be linear
+   * @param num_components the number of components in the vectors
+   * @param max_unknowns the largest number of global unknowns to assemble
+   * @exception RuntimeError if the level has more than max_unknowns global unknowns
+   */
+  DirectCoarseSolver(const Domain<D>& domain,
+                     const Operator<D>& op,
+                     int num_components = 1,
+                     int max_unknowns = DEFAULT_MAX_UNKNOWNS)
+    : domain(domain)
+    , num_components(num_components)
+    , max_unknowns(max_unknowns)
+  {
+    const Communicator& comm = domain.getCommunicator();
+    int color = domain.getNumLocalPatches() > 0 ? 0 : MPI_UNDEFINED;
+    MPI_Comm split;
+    MPI_Comm_split(comm.getMPIComm(), color, comm.getRank(), &split);
+    if (split != MPI_COMM_NULL) {
+      sub_comm = Communicator(split);
+      MPI_Comm_free(&split);
+    }
+
+    std::vector<double> matrix = assemble(op);
+    if (!matrix.empty()) {
+      pinned = std::make_shared<std::vector<int>>(pinNullSpace(matrix));
+      lu = std::make_shared<std::vector<double>>(std::move(matrix));
+      pivots = std::make_shared<std::vector<int>>();
+      factorize(*lu, *pivots);
+    }
+  }
+  /**
+   * @brief Assemble and factor the Operator again, for example after its coefficients changed
+   *
+   * The factorization is updated in place, so clones of this solver (such as the one held by a
+   * GMG::Level) use the new factorization. This is collective over the Domain's communicator.
+   *
+   * @param op the new Operator of the coarsest level, it has to be linear
+   * @exception RuntimeError if the level has more than max_unknowns global unknowns
+   */
+  void refactor(const Operator<D>& op)
+  {
+    std::vector<double> matrix = assemble(op);
+    if (!matrix.empty()) {
+      *pinned = pinNullSpace(matrix);
+      *lu = std::move(matrix);
+      factorize(*lu, *pivots);
+    }
+  }
+  /**
+   * @brief Clone this solver
+   *
+   * @return DirectCoarseSolver<D>* a newly allocated copy, the factorization is shared
+   */
+  DirectCoarseSolver<D>* clone() const override { return new DirectCoarseSolver<D>(*this); }
+  /**
+   * @brief Solve the coarse problem exactly
+   *
+   * The initial values in u are ignored, and the interior values are overwritten.
+   *
+   * @param f the RHS vector
+   * @param u the solution vector
+   */
+  void smooth(const Vector<D>& f, Vector<D>& u) const override
+  {
+    if (domain.getNumLocalPatches() == 0) {
+      return;
+    }
+    if (domain.hasTimer()) {
+      domain.getTimer()->startDomainTiming(domain.getId(), "Coarse Direct Solve");
+    }
+    int num_local = domain.getNumLocalCells() * num_components;
+    std::vector<double> local(num_local);
+    pack(f, local);
+
+    std::vector<double> global;
+    if (sub_comm.getRank() == 0) {
+      global.resize(n);
+    }
+    MPI_Gatherv(local.data(),
+                num_local,
+                MPI_DOUBLE,
+                global.data(),
+                counts.data(),
+                offsets.data(),
+                MPI_DOUBLE,
+                0,
+                sub_comm.getMPIComm());
+    if (sub_comm.getRank() == 0) {
+      for (int p : *pinned) {
+        if (p != -1) {
+          global[p] = 0;
+        }
+      }
+      solveFactored(global);
+      for (int c = 0; c < num_components; c++) {
+        if ((*pinned)[c] != -1) {
+          removeMean(global, c);
+        }
+      }
+    }
+    MPI_Scatterv(global.data(),
+                 counts.data(),
+                 offsets.data(),
+                 MPI_DOUBLE,
+                 local.data(),
+                 num_local,
+                 MPI_DOUBLE,
+                 0,
+                 sub_comm.getMPIComm());
+
+    unpack(local, u);
+    if (domain.hasTimer()) {
+      domain.getTimer()->stopDomainTiming(domain.getId(), "Coarse Direct Solve");
+    }
+  }
+  /**
+   * @brief Get the global number of unknowns in the coarse problem
+   *
+   * @return int the number of unknowns
+   */
+  int getNumUnknowns() const { return n; }
+  /**
+   * @brief Check if this rank takes part in the coarse solve
+   *
+   * @return true if this rank owns patches on the coarsest level
+   */
+  bool participates() const { return domain.getNumLocalPatches() > 0; }
+};
+extern template class DirectCoarseSolver<2>;
+extern template class DirectCoarseSolver<3>;
+} // namespace ThunderEgg::GMG
+#endif
@@ -42,6 +42,9 @@ private:
 
   void v_visit(const Level<D>& level, const Vector<D>& f, Vector<D>& u) const
   {
+    if (this->idle(f)) {
+      return;
+    }
     if (level.coarsest()) {
       for (int i = 0; i < num_coarse_sweeps; i++) {
         level.getSmoother().smooth(f, u);
@@ -69,6 +72,9 @@ private:
 protected:
   void visit(const Level<D>& level, const Vector<D>& f, Vector<D>& u) const override
   {
+    if (this->idle(f)) {
+      return;
+    }
     if (level.coarsest()) {
       for (int i = 0; i < num_coarse_sweeps; i++) {
         level.getSmoother().smooth(f, u);
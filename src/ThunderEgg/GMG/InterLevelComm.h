@@ -28,6 +28,8 @@
 
 #include <ThunderEgg/RuntimeError.h>
 #include <ThunderEgg/Vector.h>
+#include <algorithm>
+#include <array>
 
 namespace ThunderEgg::GMG {
 /**
@@ -47,6 +49,9 @@ namespace ThunderEgg::GMG {
  *
  * Scatter functions are provided for scattering to and from the coarse vector to the coarse ghost
  * vector.
+ *
+ * The coarser domain may live on a subset of the ranks of the finer domain (see
+ * AgglomeratingDomainGenerator), so communication is done over the finer domain's communicator.
  */
 template<int D>
 class InterLevelComm
@@ -115,6 +120,29 @@ private:
   std::vector<std::vector<double>> send_buffers;
   std::vector<MPI_Request> send_requests;
 
+  /**
+   * @brief Group (rank, id, local index) triples by rank
+   *
+   * @param triples the triples, these will be sorted and have duplicates removed
+   * @return std::vector<std::pair<int, std::vector<int>>> the ranks and their local indexes, the
+   * local indexes are in order of their cooresponding id, which is the order that the other
+   * processor expects them in
+   */
+  static std::vector<std::pair<int, std::vector<int>>>
+  groupByRank(std::vector<std::array<int, 3>>& triples)
+  {
+    std::sort(triples.begin(), triples.end());
+    triples.erase(std::unique(triples.begin(), triples.end()), triples.end());
+    std::vector<std::pair<int, std::vector<int>>> ranks_and_local_indexes;
+    for (const std::array<int, 3>& triple : triples) {
+      if (ranks_and_local_indexes.empty() || ranks_and_local_indexes.back().first != triple[0]) {
+        ranks_and_local_indexes.emplace_back(triple[0], std::vector<int>());
+      }
+      ranks_and_local_indexes.back().second.push_back(triple[2]);
+    }
+    return ranks_and_local_indexes;
+  }
+
 public:
   /**
    * @brief Create a new InterLevelComm object.
@@ -123,7 +151,7 @@ public:
    * @param fine_domain the finer DomainCollection.
    */
   InterLevelComm(const Domain<D>& coarser_domain, const Domain<D>& finer_domain)
-    : comm(coarser_domain.getCommunicator())
+    : comm(finer_domain.getCommunicator())
     , coarser_domain(coarser_domain)
     , finer_domain(finer_domain)
     , ns(finer_domain.getNs())
@@ -138,23 +166,25 @@ public:
     // sort into patches with local parents and patches with ghost parents
     std::deque<std::pair<int, std::reference_wrapper<const PatchInfo<D>>>> local_parents;
     std::deque<std::reference_wrapper<const PatchInfo<D>>> ghost_parents;
-    std::set<int> ghost_parents_ids;
+    std::vector<int> ghost_parents_ids;
 
     int rank;
     MPI_Comm_rank(comm.getMPIComm(), &rank);
-    // TODO this has to be changed when domain class is updated
-    std::map<int, int> coarser_domain_id_to_local_index_map;
+    IdMap coarser_domain_id_to_local_index_map(this->coarser_domain.getNumLocalPatches());
     for (const PatchInfo<D>& pinfo : this->coarser_domain.getPatchInfoVector()) {
-      coarser_domain_id_to_local_index_map[pinfo.id] = pinfo.local_index;
+      coarser_domain_id_to_local_index_map.set(pinfo.id, pinfo.local_index);
     }
     for (const PatchInfo<D>& patch : this->finer_domain.getPatchInfoVector()) {
       if (patch.parent_rank == rank) {
-        local_parents.emplace_back(coarser_domain_id_to_local_index_map[patch.parent_id], patch);
+        local_parents.emplace_back(coarser_domain_id_to_local_index_map.at(patch.parent_id), patch);
       } else {
         ghost_parents.push_back(patch);
-        ghost_parents_ids.insert(patch.parent_id);
+        ghost_parents_ids.push_back(patch.parent_id);
       }
     }
+    std::sort(ghost_parents_ids.begin(), ghost_parents_ids.end());
+    ghost_parents_ids.erase(std::unique(ghost_parents_ids.begin(), ghost_parents_ids.end()),
+                            ghost_parents_ids.end());
     num_ghost_patches = ghost_parents_ids.size();
 
     // fill in local vector
@@ -162,65 +192,35 @@ public:
       std::vector<std::pair<int, std::reference_wrapper<const PatchInfo<D>>>>(local_parents.begin(),
                                                                               local_parents.end());
     // find local coarse patches that are ghost paches on other ranks
-    std::map<int, std::map<int, int>>
-      ranks_and_local_patches; // map from rank -> (map of ids -> local
-                               // indexes). The second map is for when
-                               // local indexes are iterated over, they
-                               // are sorted by their cooresponding id
+    std::vector<std::array<int, 3>> ranks_ids_and_local_indexes;
     for (const PatchInfo<D>& pinfo : this->coarser_domain.getPatchInfoVector()) {
       for (int child_rank : pinfo.child_ranks) {
         if (child_rank != -1 && child_rank != rank)
-          ranks_and_local_patches[child_rank][pinfo.id] = pinfo.local_index;
-      }
-    }
-
-    rank_and_local_indexes_for_vector.reserve(ranks_and_local_patches.size());
-    for (auto pair : ranks_and_local_patches) {
-      std::vector<int> local_indexes;
-      // the map sould have sorted patches by id, the other processors will expect things in
-      // this order
-      local_indexes.reserve(pair.second.size());
-      for (auto id_local_index_pair : pair.second) {
-        local_indexes.push_back(id_local_index_pair.second);
+          ranks_ids_and_local_indexes.push_back({ child_rank, pinfo.id, pinfo.local_index });
       }
-      rank_and_local_indexes_for_vector.emplace_back(pair.first, local_indexes);
     }
+    rank_and_local_indexes_for_vector = groupByRank(ranks_ids_and_local_indexes);
 
     // fill in ghost vector
-    // first, assign local indexes in ghost vector for ghost patches
-    std::map<int, int> id_ghost_vector_local_index_map;
-    int index = 0;
-    for (int id : ghost_parents_ids) {
-      id_ghost_vector_local_index_map[id] = index;
-      index++;
+    // first, assign local indexes in ghost vector for ghost patches, in order of id
+    IdMap id_ghost_vector_local_index_map(ghost_parents_ids.size());
+    for (size_t index = 0; index < ghost_parents_ids.size(); index++) {
+      id_ghost_vector_local_index_map.set(ghost_parents_ids[index], (int)index);
     }
 
-    std::map<int, std::map<int, int>>
-      ranks_and_ghost_patches; // map from rank -> (map of ids -> ghost
-                               // indexes). The second map is for when
-                               // local indexes are iterated over, they
-                               // are sorted by their cooresponding id
+    std::vector<std::array<int, 3>> ranks_ids_and_ghost_indexes;
+    ranks_ids_and_ghost_indexes.reserve(ghost_parents.size());
     patches_with_ghost_parent.reserve(ghost_parents.size());
     for (auto patch_ref_wrap : ghost_parents) {
       const PatchInfo<D>& patch = patch_ref_wrap.get();
-      int ghost_local_index = id_ghost_vector_local_index_map[patch.parent_id];
+      int ghost_local_index = id_ghost_vector_local_index_map.at(patch.parent_id);
 
-      ranks_and_ghost_patches[patch.parent_rank][patch.parent_id] = ghost_local_index;
+      ranks_ids_and_ghost_indexes.push_back(
+        { patch.parent_rank, patch.parent_id, ghost_local_index });
 
       patches_with_ghost_parent.emplace_back(ghost_local_index, patch);
     }
-
-    rank_and_local_indexes_for_ghost_vector.reserve(ranks_and_local_patches.size());
-    for (auto pair : ranks_and_ghost_patches) {
-      // the map sould have sorted patches by id, the other processors will expect things in
-      // this order
-      std::vector<int> local_indexes;
-      local_indexes.reserve(pair.second.size());
-      for (auto id_local_index_pair : pair.second) {
-        local_indexes.push_back(id_local_index_pair.second);
-      }
-      rank_and_local_indexes_for_ghost_vector.emplace_back(pair.first, local_indexes);
-    }
+    rank_and_local_indexes_for_ghost_vector = groupByRank(ranks_ids_and_ghost_indexes);
   }
   /**
    * @brief Copy construct a new Inter Level Comm object
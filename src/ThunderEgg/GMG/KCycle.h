@@ -0,0 +1,176 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2018-2021 Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef THUNDEREGG_GMG_KCYCLE_H
+#define THUNDEREGG_GMG_KCYCLE_H
+/**
+ * @file
+ *
+ * @brief KCycle class
+ */
+#include <ThunderEgg/GMG/Cycle.h>
+#include <ThunderEgg/GMG/CycleOpts.h>
+namespace ThunderEgg::GMG {
+/**
+ * @brief Implementation of a K-cycle
+ *
+ * The coarse-level correction on every level (other than the one just above the coarsest
+ * level) is computed with up to two iterations of flexible CG on the coarser level's operator,
+ * preconditioned by a K-cycle on the coarser level. This follows Notay and Vassilevski,
+ * "Recursive Krylov-based multigrid cycles" (2008).
+ *
+ * The second iteration is skipped if the first one already reduced the coarse residual by a
+ * factor of CycleOpts::kcycle_tolerance. The cost per cycle is then between that of a V-cycle
+ * and that of a W-cycle, while being much less sensitive to coefficient jumps than a V-cycle.
+ */
+template<int D>
+class KCycle : public Cycle<D>
+{
+private:
+  int num_pre_sweeps = 1;
+  int num_post_sweeps = 1;
+  int num_coarse_sweeps = 1;
+  int num_iterations = 2;
+  double tolerance = 0.25;
+
+  /**
+   * @brief Approximately solve the coarser system with flexible CG, preconditioned by a K-cycle
+   * on the coarser level.
+   *
+   * @param coarser_level the coarser level
+   * @param r the restricted residual
+   * @param e the resulting correction, should be zero on input
+   */
+  void krylovCorrection(const Level<D>& coarser_level, const Vector<D>& r, Vector<D>& e) const
+  {
+    const Operator<D>& op = coarser_level.getOperator();
+
+    Vector<D> c1 = r.getZeroClone();
+    this->visit(coarser_level, r, c1);
+    Vector<D> v1 = r.getZeroClone();
+    op.apply(c1, v1);
+
+    double rho1 = c1.dot(v1);
+    double alpha1 = c1.dot(r);
+    if (rho1 == 0) {
+      return;
+    }
+
+    if (num_iterations == 1) {
+      e.addScaled(alpha1 / rho1, c1);
+      return;
+    }
+
+    Vector<D> r2 = r.getZeroClone();
+    r2.addScaled(1.0, r, -alpha1 / rho1, v1);
+    if (r2.twoNorm() <= tolerance * r.twoNorm()) {
+      e.addScaled(alpha1 / rho1, c1);
+      return;
+    }
+
+    Vector<D> c2 = r.getZeroClone();
+    this->visit(coarser_level, r2, c2);
+    Vector<D>& v2 = r2;
+    double alpha2 = c2.dot(r2);
+    op.apply(c2, v2);
+
+    double gamma = c2.dot(v1);
+    double beta = c2.dot(v2);
+    double rho2 = beta - gamma * gamma / rho1;
+    if (rho2 == 0) {
+      e.addScaled(alpha1 / rho1, c1);
+      return;
+    }
+
+    e.addScaled(alpha1 / rho1 - gamma * alpha2 / (rho1 * rho2), c1, alpha2 / rho2, c2);
+  }
+
+protected:
+  /**
+   * @brief Implements K-cycle. Pre-smooth, Krylov-accelerated coarse correction, and then
+   * post-smooth.
+   *
+   * @param level the current level that is being visited.
+   */
+  void visit(const Level<D>& level, const Vector<D>& f, Vector<D>& u) const override
+  {
+    if (this->idle(f)) {
+      return;
+    }
+    if (level.coarsest()) {
+      for (int i = 0; i < num_coarse_sweeps; i++) {
+        level.getSmoother().smooth(f, u);
+      }
+    } else {
+      for (int i = 0; i < num_pre_sweeps; i++) {
+        level.getSmoother().smooth(f, u);
+      }
+
+      Vector<D> coarser_f = this->restrict(level, f, u);
+
+      const Level<D>& coarser_level = level.getCoarser();
+      Vector<D> coarser_u = coarser_f.getZeroClone();
+
+      if (coarser_level.coarsest() || this->idle(coarser_f)) {
+        this->visit(coarser_level, coarser_f, coarser_u);
+      } else {
+        krylovCorrection(coarser_level, coarser_f, coarser_u);
+      }
+
+      coarser_level.getInterpolator().interpolate(coarser_u, u);
+
+      for (int i = 0; i < num_post_sweeps; i++) {
+        level.getSmoother().smooth(f, u);
+      }
+    }
+  }
+
+public:
+  /**
+   * @brief Create new K-cycle
+   *
+   * @param finest_level a pointer to the finest level
+   * @param opts the options, uses pre_sweeps, post_sweeps, coarse_sweeps, kcycle_iterations,
+   * and kcycle_tolerance
+   */
+  KCycle(const Level<D>& finest_level, const CycleOpts& opts)
+    : Cycle<D>(finest_level)
+  {
+    num_pre_sweeps = opts.pre_sweeps;
+    num_post_sweeps = opts.post_sweeps;
+    num_coarse_sweeps = opts.coarse_sweeps;
+    num_iterations = opts.kcycle_iterations;
+    tolerance = opts.kcycle_tolerance;
+    if (num_iterations != 1 && num_iterations != 2) {
+      throw RuntimeError("KCycle supports 1 or 2 Krylov iterations, got " +
+                         std::to_string(num_iterations));
+    }
+  }
+  /**
+   * @brief Get a clone of this KCycle
+   *
+   * @return KCycle<D>* a newly allocated copy
+   */
+  KCycle<D>* clone() const override { return new KCycle(*this); }
+};
+extern template class KCycle<2>;
+extern template class KCycle<3>;
+} // namespace ThunderEgg::GMG
+#endif
@@ -33,6 +33,11 @@ namespace ThunderEgg::GMG {
 /**
  * @brief Base class that makes the necessary mpi calls, derived classes only have to
  * implement restrictPatches() method
+ *
+ * The vectors of a restriction that was started with restrictStart() are held by this object
+ * until restrictFinish() is called, so it is not reentrant: only one restriction can be in
+ * progress at a time on each object. Starting a second restriction before the first is finished
+ * throws a RuntimeError.
  */
 template<int D>
 class MPIRestrictor : public Restrictor<D>
@@ -42,6 +47,18 @@ private:
    * @brief The communication package for restricting between levels.
    */
   mutable InterLevelComm<D> ilc;
+  /**
+   * @brief The coarse vector of the restriction in progress
+   */
+  mutable Vector<D> coarse;
+  /**
+   * @brief The ghost patches of the restriction in progress
+   */
+  mutable Vector<D> coarse_ghost;
+  /**
+   * @brief Whether a restriction was started and not yet finished
+   */
+  mutable bool restricting = false;
 
 public:
   /**
@@ -54,6 +71,14 @@ public:
   {}
   Vector<D> restrict(const Vector<D>& fine) const override
   {
+    restrictStart(fine);
+    return restrictFinish(fine);
+  }
+  void restrictStart(const Vector<D>& fine) const override
+  {
+    if (restricting) {
+      throw RuntimeError("MPIRestrictor has a restriction in progress that is unfinished");
+    }
     if constexpr (ENABLE_DEBUG) {
       if (fine.getNumLocalPatches() != ilc.getFinerDomain().getNumLocalPatches()) {
         throw RuntimeError("fine vector is incorrect length. Expected Length of " +
@@ -61,8 +86,8 @@ public:
                            " but vector was length " + std::to_string(fine.getNumLocalPatches()));
       }
     }
-    Vector<D> coarse(ilc.getCoarserDomain(), fine.getNumComponents());
-    Vector<D> coarse_ghost = ilc.getNewGhostVector(fine.getNumComponents());
+    coarse = Vector<D>(ilc.getCoarserDomain(), fine.getNumComponents());
+    coarse_ghost = ilc.getNewGhostVector(fine.getNumComponents());
 
     // fill in ghost values
     restrictPatches(ilc.getPatchesWithGhostParent(), fine, coarse_ghost);
@@ -76,10 +101,20 @@ public:
     // fill in local values
     restrictPatches(ilc.getPatchesWithLocalParent(), fine, coarse);
 
+    restricting = true;
+  }
+  Vector<D> restrictFinish(const Vector<D>& /*fine*/) const override
+  {
+    if (!restricting) {
+      throw RuntimeError("MPIRestrictor cannot finish a restriction that was not started");
+    }
+    restricting = false;
+
     // finish scatter for ghost values
     ilc.sendGhostPatchesFinish(coarse, coarse_ghost);
 
-    return coarse;
+    coarse_ghost = Vector<D>();
+    return std::move(coarse);
   }
   /**
    * @brief Restrict values into coarse vector
@@ -52,6 +52,25 @@ public:
    * @param fine
    */
   virtual Vector<D> restrict(const Vector<D>& fine) const = 0;
+  /**
+   * @brief Start restricting a vector
+   *
+   * This, along with restrictFinish(), allows for the communication needed for restriction to
+   * overlap with other work. Only one restriction can be in progress at a time, and the fine
+   * vector must not be modified until restrictFinish() is called.
+   *
+   * The default implementation does nothing, and all the work is done in restrictFinish().
+   *
+   * @param fine the vector to restrict
+   */
+  virtual void restrictStart(const Vector<D>& /*fine*/) const {}
+  /**
+   * @brief Finish restricting a vector that was passed to restrictStart()
+   *
+   * @param fine the vector that was passed to restrictStart()
+   * @return Vector<D> the restricted vector
+   */
+  virtual Vector<D> restrictFinish(const Vector<D>& fine) const { return restrict(fine); }
 };
 } // namespace ThunderEgg::GMG
 #endif
\ No newline at end of file
@@ -45,6 +45,9 @@ protected:
    */
   void visit(const Level<D>& level, const Vector<D>& f, Vector<D>& u) const override
   {
+    if (this->idle(f)) {
+      return;
+    }
     if (level.coarsest()) {
       for (int i = 0; i < num_coarse_sweeps; i++) {
         level.getSmoother().smooth(f, u);
@@ -0,0 +1,194 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef THUNDEREGG_IDMAP_H
+#define THUNDEREGG_IDMAP_H
+/**
+ * @file
+ *
+ * @brief IdMap class
+ */
+#include <ThunderEgg/RuntimeError.h>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ThunderEgg {
+/**
+ * @brief A map from patch ids to integer values, such as local indexes, global indexes, or ranks
+ *
+ * This is an open addressing hash table with linear probing. The keys and values are stored in
+ * flat arrays, so building a map for n patches takes O(n) time and a single allocation when the
+ * size is known in advance.
+ *
+ * The id std::numeric_limits<int>::min() is reserved and can't be inserted.
+ */
+class IdMap
+{
+private:
+  /**
+   * @brief key of an empty bucket
+   */
+  static constexpr int empty = std::numeric_limits<int>::min();
+  /**
+   * @brief the key in each bucket, the number of buckets is a power of two
+   */
+  std::vector<int> keys;
+  /**
+   * @brief the value in each bucket
+   */
+  std::vector<int> values;
+  /**
+   * @brief the number of entries
+   */
+  size_t num_entries = 0;
+  /**
+   * @brief 32 - log2 of the number of buckets
+   */
+  int shift = 32;
+
+  /**
+   * @brief Get the first bucket to probe for an id
+   */
+  size_t getBucket(int id) const
+  {
+    // Fibonacci hashing, the ids of neighboring patches are often consecutive
+    return (size_t)(((uint32_t)id * UINT32_C(2654435769)) >> shift);
+  }
+  /**
+   * @brief Resize the table to hold at least num_entries entries at a load factor of 1/2
+   */
+  void reserveBuckets(size_t num_entries)
+  {
+    int new_shift = 29;
+    while (new_shift > 0 && ((size_t)1 << (32 - new_shift)) < 2 * num_entries) {
+      new_shift--;
+    }
+    std::vector<int> old_keys = std::move(keys);
+    std::vector<int> old_values = std::move(values);
+    shift = new_shift;
+    keys.assign((size_t)1 << (32 - shift), empty);
+    values.assign(keys.size(), 0);
+    for (size_t i = 0; i < old_keys.size(); i++) {
+      if (old_keys[i] != empty) {
+        size_t bucket = probe(old_keys[i]);
+        keys[bucket] = old_keys[i];
+        values[bucket] = old_values[i];
+      }
+    }
+  }
+  /**
+   * @brief Get the bucket of an id, or the empty bucket where it would be inserted
+   */
+  size_t probe(int id) const
+  {
+    size_t mask = keys.size() - 1;
+    size_t bucket = getBucket(id);
+    while (keys[bucket] != id && keys[bucket] != empty) {
+      bucket = (bucket + 1) & mask;
+    }
+    return bucket;
+  }
+
+public:
+  /**
+   * @brief Construct an empty IdMap
+   *
+   * @param expected_size the expected number of entries, the table will not have to grow until it
+   * has more entries than this
+   */
+  explicit IdMap(size_t expected_size = 0) { reserveBuckets(expected_size); }
+  /**
+   * @brief Construct an IdMap with the entries of a std::map
+   *
+   * @param map the map from id to value
+   */
+  explicit IdMap(const std::map<int, int>& map)
+    : IdMap(map.size())
+  {
+    for (const auto& pair : map) {
+      set(pair.first, pair.second);
+    }
+  }
+  /**
+   * @brief Set the value for an id, replacing any previous value
+   *
+   * @param id the id
+   * @param value the value
+   */
+  void set(int id, int value)
+  {
+    if (id == empty) {
+      throw RuntimeError("IdMap: id " + std::to_string(id) + " is reserved");
+    }
+    size_t bucket = probe(id);
+    if (keys[bucket] == empty) {
+      if (2 * (num_entries + 1) > keys.size()) {
+        reserveBuckets(num_entries + 1);
+        bucket = probe(id);
+      }
+      keys[bucket] = id;
+      num_entries++;
+    }
+    values[bucket] = value;
+  }
+  /**
+   * @brief Find the value for an id
+   *
+   * @param id the id
+   * @return const int* a pointer to the value, nullptr if the id is not in the map
+   */
+  const int* find(int id) const
+  {
+    if (id == empty) {
+      return nullptr;
+    }
+    size_t bucket = probe(id);
+    return keys[bucket] == id ? &values[bucket] : nullptr;
+  }
+  /**
+   * @brief Get the value for an id
+   *
+   * @param id the id
+   * @return int the value
+   * @exception RuntimeError if the id is not in the map
+   */
+  int at(int id) const
+  {
+    const int* value = find(id);
+    if (value == nullptr) {
+      throw RuntimeError("IdMap: id " + std::to_string(id) + " not found");
+    }
+    return *value;
+  }
+  /**
+   * @brief Check if an id is in the map
+   */
+  bool contains(int id) const { return find(id) != nullptr; }
+  /**
+   * @brief Get the number of entries
+   */
+  size_t size() const { return num_entries; }
+};
+} // namespace ThunderEgg
+#endif
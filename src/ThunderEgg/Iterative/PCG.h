@@ -0,0 +1,204 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef THUNDEREGG_ITERATIVE_PCG_H
+#define THUNDEREGG_ITERATIVE_PCG_H
+/**
+ * @file
+ *
+ * @brief PCG class
+ */
+
+#include <ThunderEgg/Iterative/BreakdownError.h>
+#include <ThunderEgg/Iterative/Solver.h>
+#include <ThunderEgg/Operator.h>
+#include <ThunderEgg/Timer.h>
+
+namespace ThunderEgg::Iterative {
+/**
+ * @brief Preconditioned CG iterative solver.
+ *
+ * The preconditioner is applied to the residual on every iteration, z = M r, and the search
+ * directions are built from the preconditioned residuals. Both the operator and the preconditioner
+ * have to be symmetric and definite, for example a GMG::AdditiveCycle with a symmetric smoother.
+ * Without a preconditioner this is the same as CG.
+ *
+ * @tparam D the number of Cartesian dimensions
+ */
+template<int D>
+class PCG : public Solver<D>
+{
+private:
+  /**
+   * @brief The maximum number of iterations
+   */
+  int max_iterations = 1000;
+  /**
+   * @brief The maximum number of iterations
+   */
+  double tolerance = 1e-12;
+  /**
+   * @brief The timer
+   */
+  std::shared_ptr<Timer> timer = nullptr;
+
+  /**
+   * @brief Apply the preconditioner to the residual, or copy the residual if there is none
+   *
+   * @param M the preconditioner, may be nullptr
+   * @param r the residual
+   * @param z the preconditioned residual
+   */
+  void applyPreconditioner(const Operator<D>* M, const Vector<D>& r, Vector<D>& z) const
+  {
+    if (M == nullptr) {
+      z.copy(r);
+    } else {
+      M->apply(r, z);
+    }
+  }
+
+public:
+  /**
+   * @brief Clone this solver
+   *
+   * @return PCG<D>* a newly allocated copy of this solver
+   */
+  PCG<D>* clone() const override { return new PCG<D>(*this); }
+  /**
+   * @brief Set the maximum number of iterations.
+   *
+   * Default is 1000
+   *
+   * @param max_iterations_in the maximum number of iterations
+   */
+  void setMaxIterations(int max_iterations_in) { max_iterations = max_iterations_in; };
+  /**
+   * @brief Get the maximum number of iterations
+   *
+   * Default is 1000
+   *
+   * @return int the maximum number of iterations
+   */
+  int getMaxIterations() const { return max_iterations; }
+  /**
+   * @brief Set the stopping tolerance
+   *
+   * Default is 1e-12
+   *
+   * @param tolerance_in the stopping tolerance
+   */
+  void setTolerance(double tolerance_in) { tolerance = tolerance_in; };
+  /**
+   * @brief Get the stopping tolerance
+   *
+   * Default is 1e-12
+   *
+   * @return double the stopping tolerance
+   */
+  double getTolerance() const { return tolerance; }
+  /**
+   * @brief Set the Timer object
+   *
+   * @param timer_in the Timer
+   */
+  void setTimer(std::shared_ptr<Timer> timer_in) { timer = timer_in; }
+
+  /**
+   * @brief Get the Timer object
+   *
+   * @return std::shared_ptr<Timer> the Timer
+   */
+  std::shared_ptr<Timer> getTimer() const { return timer; }
+
+public:
+  int solve(const Operator<D>& A,
+            Vector<D>& x,
+            const Vector<D>& b,
+            const Operator<D>* Mr = nullptr,
+            bool output = false,
+            std::ostream& os = std::cout) const override
+  {
+    Vector<D> resid = b.getZeroClone();
+
+    A.apply(x, resid);
+    resid.scaleThenAdd(-1, b);
+
+    Vector<D> initial_guess = x;
+    x.set(0);
+
+    double r0_norm = b.twoNorm();
+    Vector<D> z = b.getZeroClone();
+    applyPreconditioner(Mr, resid, z);
+    Vector<D> p = z;
+    Vector<D> ap = b.getZeroClone();
+
+    double rho = resid.dot(z);
+
+    int num_its = 0;
+    if (r0_norm == 0) {
+      return num_its;
+    }
+    double residual = resid.twoNorm() / r0_norm;
+    if (output) {
+      char buf[100];
+      sprintf(buf, "%5d %16.8e\n", num_its, residual);
+      os << std::string(buf);
+    }
+    while (residual > tolerance && num_its < max_iterations) {
+      if (timer) {
+        timer->start("Iteration");
+      }
+
+      if (rho == 0) {
+        throw BreakdownError("PCG broke down, rho was 0 on iteration " + std::to_string(num_its));
+      }
+
+      A.apply(p, ap);
+      double alpha = rho / p.dot(ap);
+      x.addScaled(alpha, p);
+      resid.addScaled(-alpha, ap);
+
+      applyPreconditioner(Mr, resid, z);
+      double rho_new = resid.dot(z);
+      double beta = rho_new / rho;
+      p.scaleThenAdd(beta, z);
+
+      num_its++;
+      rho = rho_new;
+      residual = resid.twoNorm() / r0_norm;
+
+      if (output) {
+        char buf[100];
+        sprintf(buf, "%5d %16.8e\n", num_its, residual);
+        os << std::string(buf);
+      }
+      if (timer) {
+        timer->stop("Iteration");
+      }
+    }
+    x.add(initial_guess);
+    return num_its;
+  }
+};
+} // namespace ThunderEgg::Iterative
+extern template class ThunderEgg::Iterative::PCG<2>;
+extern template class ThunderEgg::Iterative::PCG<3>;
+#endif
@@ -28,18 +28,30 @@
 
 #include <ThunderEgg/Domain.h>
 #include <ThunderEgg/GMG/Level.h>
+#include <ThunderEgg/Iterative/BiCGStab.h>
 #include <ThunderEgg/Iterative/BreakdownError.h>
+#include <ThunderEgg/Iterative/CG.h>
 #include <ThunderEgg/Iterative/Solver.h>
+#include <ThunderEgg/PatchArray.h>
 #include <ThunderEgg/PatchOperator.h>
 #include <ThunderEgg/PatchSolver.h>
+#include <ThunderEgg/RuntimeError.h>
 #include <ThunderEgg/Vector.h>
 #include <bitset>
 #include <map>
+#include <typeinfo>
 
 namespace ThunderEgg::Iterative {
 /**
  * @brief Solves the patches using an iterative Solver on each patch
  *
+ * If the solver is a CG or BiCGStab solver without a Timer (and not a subclass of one), the
+ * patches are solved with a patch-local version of the same method. It works directly on the patch views with workspace
+ * arrays that are allocated once per thread, and does not do any MPI calls. Other solvers are
+ * given single patch Vectors on MPI_COMM_SELF.
+ *
+ * The patch-local methods can also use an adaptive tolerance, see setAdaptiveTolerance.
+ *
  * @tparam D the number of cartesian dimensions
  */
 template<int D>
@@ -87,6 +99,32 @@ private:
     SinglePatchOp* clone() const override { return new SinglePatchOp(*this); }
   };
 
+  /**
+   * @brief The Krylov methods that have a patch-local implementation
+   */
+  enum class PatchKrylov
+  {
+    None,
+    CG,
+    BiCGStab
+  };
+  /**
+   * @brief Workspace for the patch-local Krylov methods
+   */
+  struct Workspace
+  {
+    std::array<int, D> ns = {};
+    int num_components = 0;
+    int num_ghost_cells = 0;
+    PatchArray<D> f_copy;
+    PatchArray<D> resid;
+    PatchArray<D> rhat;
+    PatchArray<D> p;
+    PatchArray<D> ap;
+    PatchArray<D> s;
+    PatchArray<D> as;
+  };
+
   /**
    * @brief The iterative solver being u_viewed
    */
@@ -102,6 +140,231 @@ private:
    */
   bool continue_on_breakdown;
 
+  /**
+   * @brief The patch-local method to use, None if the solver does not have one
+   */
+  PatchKrylov patch_krylov = PatchKrylov::None;
+  /**
+   * @brief The tolerance of the solver
+   */
+  double tolerance = 0;
+  /**
+   * @brief The maximum number of iterations of the solver
+   */
+  int max_iterations = 0;
+  /**
+   * @brief Whether the patch-local methods use an adaptive tolerance
+   */
+  bool adaptive = false;
+  /**
+   * @brief The factor that the residual of the initial guess is reduced by, for the adaptive
+   * tolerance
+   */
+  double residual_reduction = 0;
+  /**
+   * @brief The maximum number of iterations for a patch, for the adaptive tolerance
+   */
+  int max_patch_iterations = 0;
+
+  /**
+   * @brief Get the workspace for the calling thread
+   *
+   * @param ns the number of cells along each axis of a patch
+   * @param num_components the number of components
+   * @param num_ghost_cells the number of ghost cells
+   * @return Workspace& the workspace
+   */
+  static Workspace&
+  getWorkspace(const std::array<int, D>& ns, int num_components, int num_ghost_cells)
+  {
+    static thread_local Workspace workspace;
+    if (workspace.ns != ns || workspace.num_components != num_components ||
+        workspace.num_ghost_cells != num_ghost_cells) {
+      workspace.ns = ns;
+      workspace.num_components = num_components;
+      workspace.num_ghost_cells = num_ghost_cells;
+      PatchArray<D> array(ns, num_components, num_ghost_cells);
+      workspace.f_copy = array;
+      workspace.resid = array;
+      workspace.rhat = array;
+      workspace.p = array;
+      workspace.ap = array;
+      workspace.s = array;
+      workspace.as = array;
+    }
+    return workspace;
+  }
+  /**
+   * @brief dot product of the interior values of two patches
+   */
+  static double dot(const PatchView<const double, D>& a, const PatchView<const double, D>& b)
+  {
+    double sum = 0;
+    Loop::OverInteriorIndexes<D + 1>(
+      a, [&](const std::array<int, D + 1>& coord) { sum += a[coord] * b[coord]; });
+    return sum;
+  }
+  /**
+   * @brief two norm of the interior values of a patch
+   */
+  static double twoNorm(const PatchView<const double, D>& a) { return sqrt(dot(a, a)); }
+  /**
+   * @brief Get the stopping criteria for a patch-local solve
+   *
+   * @param f the rhs
+   * @param resid the residual of the initial guess
+   * @param tol set to the relative tolerance
+   * @param max_its set to the maximum number of iterations
+   * @return double the norm that the tolerance is relative to
+   */
+  double getStoppingCriteria(const PatchView<const double, D>& f,
+                             const PatchView<const double, D>& resid,
+                             double& tol,
+                             int& max_its) const
+  {
+    if (adaptive) {
+      tol = residual_reduction;
+      max_its = std::min(max_iterations, max_patch_iterations);
+      return twoNorm(resid);
+    }
+    tol = tolerance;
+    max_its = max_iterations;
+    return twoNorm(f);
+  }
+  /**
+   * @brief Solve a patch with CG, this follows CG::solve
+   *
+   * @return int the number of iterations
+   */
+  int solveWithCG(const PatchInfo<D>& pinfo,
+                  Workspace& workspace,
+                  const PatchView<const double, D>& f,
+                  const PatchView<double, D>& x) const
+  {
+    const PatchView<double, D>& resid = workspace.resid.getView();
+    const PatchView<double, D>& p = workspace.p.getView();
+    const PatchView<double, D>& ap = workspace.ap.getView();
+
+    op->applySinglePatchWithInternalBoundaryConditions(pinfo, x, resid);
+    Loop::OverInteriorIndexes<D + 1>(resid, [&](const std::array<int, D + 1>& coord) {
+      resid[coord] = f[coord] - resid[coord];
+      p[coord] = resid[coord];
+    });
+
+    double tol;
+    int max_its;
+    double r0_norm = getStoppingCriteria(f, resid, tol, max_its);
+    double rho = dot(resid, resid);
+
+    int num_its = 0;
+    if (r0_norm == 0) {
+      if (!adaptive) {
+        // the rhs is zero, so the solution is zero
+        Loop::OverInteriorIndexes<D + 1>(
+          x, [&](const std::array<int, D + 1>& coord) { x[coord] = 0; });
+      }
+      return num_its;
+    }
+    double residual = sqrt(rho) / r0_norm;
+    while (residual > tol && num_its < max_its) {
+      if (rho == 0) {
+        throw BreakdownError("CG broke down, rho was 0 on iteration " + std::to_string(num_its));
+      }
+
+      op->applySinglePatchWithInternalBoundaryConditions(pinfo, p, ap);
+      double alpha = rho / dot(p, ap);
+      Loop::OverInteriorIndexes<D + 1>(resid, [&](const std::array<int, D + 1>& coord) {
+        x[coord] += alpha * p[coord];
+        resid[coord] -= alpha * ap[coord];
+      });
+
+      double rho_new = dot(resid, resid);
+      double beta = rho_new / rho;
+      Loop::OverInteriorIndexes<D + 1>(p, [&](const std::array<int, D + 1>& coord) {
+        p[coord] = resid[coord] + beta * p[coord];
+      });
+
+      num_its++;
+      rho = rho_new;
+      residual = sqrt(rho) / r0_norm;
+    }
+    return num_its;
+  }
+  /**
+   * @brief Solve a patch with BiCGStab, this follows BiCGStab::solve
+   *
+   * @return int the number of iterations
+   */
+  int solveWithBiCGStab(const PatchInfo<D>& pinfo,
+                        Workspace& workspace,
+                        const PatchView<const double, D>& f,
+                        const PatchView<double, D>& x) const
+  {
+    const PatchView<double, D>& resid = workspace.resid.getView();
+    const PatchView<double, D>& rhat = workspace.rhat.getView();
+    const PatchView<double, D>& p = workspace.p.getView();
+    const PatchView<double, D>& ap = workspace.ap.getView();
+    const PatchView<double, D>& s = workspace.s.getView();
+    const PatchView<double, D>& as = workspace.as.getView();
+
+    op->applySinglePatchWithInternalBoundaryConditions(pinfo, x, resid);
+    Loop::OverInteriorIndexes<D + 1>(resid, [&](const std::array<int, D + 1>& coord) {
+      resid[coord] = f[coord] - resid[coord];
+      rhat[coord] = resid[coord];
+      p[coord] = resid[coord];
+    });
+
+    double tol;
+    int max_its;
+    double r0_norm = getStoppingCriteria(f, resid, tol, max_its);
+    double rho = dot(rhat, resid);
+
+    int num_its = 0;
+    if (r0_norm == 0) {
+      if (!adaptive) {
+        // the rhs is zero, so the solution is zero
+        Loop::OverInteriorIndexes<D + 1>(
+          x, [&](const std::array<int, D + 1>& coord) { x[coord] = 0; });
+      }
+      return num_its;
+    }
+    double residual = twoNorm(resid) / r0_norm;
+    while (residual > tol && num_its < max_its) {
+      if (rho == 0) {
+        throw BreakdownError("BiCGStab broke down, rho was 0 on iteration " +
+                             std::to_string(num_its));
+      }
+
+      op->applySinglePatchWithInternalBoundaryConditions(pinfo, p, ap);
+      double alpha = rho / dot(rhat, ap);
+      Loop::OverInteriorIndexes<D + 1>(s, [&](const std::array<int, D + 1>& coord) {
+        s[coord] = resid[coord] - alpha * ap[coord];
+      });
+      if (twoNorm(s) / r0_norm <= tol) {
+        Loop::OverInteriorIndexes<D + 1>(
+          x, [&](const std::array<int, D + 1>& coord) { x[coord] += alpha * p[coord]; });
+        break;
+      }
+      op->applySinglePatchWithInternalBoundaryConditions(pinfo, s, as);
+      double omega = dot(as, s) / dot(as, as);
+      Loop::OverInteriorIndexes<D + 1>(x, [&](const std::array<int, D + 1>& coord) {
+        x[coord] += alpha * p[coord] + omega * s[coord];
+        resid[coord] -= alpha * ap[coord] + omega * as[coord];
+      });
+
+      double rho_new = dot(resid, rhat);
+      double beta = rho_new * alpha / (rho * omega);
+      Loop::OverInteriorIndexes<D + 1>(p, [&](const std::array<int, D + 1>& coord) {
+        p[coord] = resid[coord] + beta * (p[coord] - omega * ap[coord]);
+      });
+
+      num_its++;
+      rho = rho_new;
+      residual = twoNorm(resid) / r0_norm;
+    }
+    return num_its;
+  }
+
 public:
   /**
    * @brief Construct a new IterativePatchSolver object
@@ -124,17 +387,96 @@ public:
     , solver(solver.clone())
     , op(op.clone())
     , continue_on_breakdown(continue_on_breakdown)
-  {}
+  {
+    // subclasses of CG and BiCGStab may override solve, so they use the generic path
+    if (typeid(solver) == typeid(CG<D>)) {
+      auto& cg = static_cast<const CG<D>&>(solver);
+      if (cg.getTimer() == nullptr) {
+        patch_krylov = PatchKrylov::CG;
+        tolerance = cg.getTolerance();
+        max_iterations = cg.getMaxIterations();
+      }
+    } else if (typeid(solver) == typeid(BiCGStab<D>)) {
+      auto& bcgs = static_cast<const BiCGStab<D>&>(solver);
+      if (bcgs.getTimer() == nullptr) {
+        patch_krylov = PatchKrylov::BiCGStab;
+        tolerance = bcgs.getTolerance();
+        max_iterations = bcgs.getMaxIterations();
+      }
+    }
+  }
   /**
    * @brief Clone this patch solver
    *
    * @return PatchSolver<D>* a newly allocated copy of this patch solver
    */
   PatchSolver<D>* clone() const override { return new PatchSolver<D>(*this); }
+  /**
+   * @brief Use an adaptive tolerance for the patch solves
+   *
+   * Instead of solving each patch to the tolerance of the solver relative to the rhs, each patch
+   * solve stops once the residual of the initial guess has been reduced by a factor. When used as
+   * a smoother, the initial residual of a patch follows the residual of the outer solve, so only a
+   * few digits are gained on each sweep. Smoothers on different levels of a cycle can be given
+   * different factors.
+   *
+   * The "Iterations" info of the Timer shows the number of iterations of each patch solve.
+   *
+   * @param residual_reduction the factor that the residual of each patch solve is reduced by
+   * @param max_patch_iterations the maximum number of iterations for each patch solve
+   * @exception RuntimeError if the patches are not solved with the patch-local CG or BiCGStab
+   */
+  void setAdaptiveTolerance(double residual_reduction, int max_patch_iterations)
+  {
+    if (patch_krylov == PatchKrylov::None) {
+      throw RuntimeError(
+        "Adaptive tolerance is only supported for CG and BiCGStab solvers without a Timer");
+    }
+    adaptive = true;
+    this->residual_reduction = residual_reduction;
+    this->max_patch_iterations = max_patch_iterations;
+  }
+  /**
+   * @brief Solve each patch to the tolerance of the solver, this is the default
+   */
+  void setFixedTolerance() { adaptive = false; }
+  /**
+   * @brief Check if the patch solves use an adaptive tolerance
+   *
+   * @return true if setAdaptiveTolerance was called
+   */
+  bool hasAdaptiveTolerance() const { return adaptive; }
+  /**
+   * @brief Get the factor that the residual of each patch solve is reduced by, for the adaptive
+   * tolerance
+   *
+   * @return double the factor
+   */
+  double getResidualReduction() const { return residual_reduction; }
+  /**
+   * @brief Get the maximum number of iterations for each patch solve, for the adaptive tolerance
+   *
+   * @return int the maximum number of iterations
+   */
+  int getMaxPatchIterations() const { return max_patch_iterations; }
+  /**
+   * @brief Check if solveSinglePatch can be called from multiple threads at the same time
+   *
+   * Only the patch-local methods are thread safe, other solvers are given Vectors on
+   * MPI_COMM_SELF, which make MPI calls.
+   *
+   * @return true if the patches are solved with the patch-local CG or BiCGStab
+   */
+  bool isThreadSafe() const override { return patch_krylov != PatchKrylov::None; }
   void solveSinglePatch(const PatchInfo<D>& pinfo,
                         const PatchView<const double, D>& f_view,
                         const PatchView<double, D>& u_view) const override
   {
+    if (patch_krylov != PatchKrylov::None) {
+      solveSinglePatchLocally(pinfo, f_view, u_view);
+      return;
+    }
+
     SinglePatchOp single_op(pinfo, op);
 
     std::array<int, D + 1> f_lengths;
@@ -173,6 +515,42 @@ public:
       this->getDomain().getTimer()->addIntInfo("Iterations", iterations);
     }
   }
+  /**
+   * @brief Solve a patch with the patch-local Krylov method
+   *
+   * @param pinfo the patch
+   * @param f_view the rhs
+   * @param u_view the solution
+   */
+  void solveSinglePatchLocally(const PatchInfo<D>& pinfo,
+                               const PatchView<const double, D>& f_view,
+                               const PatchView<double, D>& u_view) const
+  {
+    Workspace& workspace = getWorkspace(this->getDomain().getNs(),
+                                        f_view.getEnd()[D] + 1,
+                                        this->getDomain().getNumGhostCells());
+
+    const PatchView<double, D>& f_copy = workspace.f_copy.getView();
+    Loop::OverInteriorIndexes<D + 1>(
+      f_copy, [&](const std::array<int, D + 1>& coord) { f_copy[coord] = f_view[coord]; });
+    op->modifyRHSForInternalBoundaryConditions(pinfo, u_view, f_copy);
+
+    int iterations = 0;
+    try {
+      if (patch_krylov == PatchKrylov::CG) {
+        iterations = solveWithCG(pinfo, workspace, f_copy, u_view);
+      } else {
+        iterations = solveWithBiCGStab(pinfo, workspace, f_copy, u_view);
+      }
+    } catch (const BreakdownError& err) {
+      if (!continue_on_breakdown) {
+        throw err;
+      }
+    }
+    if (this->getDomain().hasTimer()) {
+      this->getDomain().getTimer()->addIntInfo("Iterations", iterations);
+    }
+  }
 };
 } // namespace ThunderEgg::Iterative
 extern template class ThunderEgg::Iterative::PatchSolver<2>;
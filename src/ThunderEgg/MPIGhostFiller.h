@@ -30,6 +30,7 @@
 #include <ThunderEgg/Domain.h>
 #include <ThunderEgg/GhostFiller.h>
 #include <ThunderEgg/GhostFillingType.h>
+#include <algorithm>
 
 namespace ThunderEgg {
 /**
@@ -717,98 +718,19 @@ private:
   }
 
   /**
-   * @brief Add a normal neighbor call for given dimension
+   * @brief Sort (rank, prototype) pairs by rank then prototype, and remove duplicates
    *
-   * @tparam M the dimension of the face
-   * @param pinfo the PatchInfo object for the patch that is being filled from
-   * @param f the the face
-   * @param my_local_calls the local calls deque
-   * @param rank_to_remote_call_prototypes the remote calls map
-   * @param rank_to_incoming_ghost_prototypes the incoming ghosts map
-   */
-  template<int M>
-  static void addNormalNbrCalls(
-    const PatchInfo<D>& pinfo,
-    Face<D, M> f,
-    std::deque<LocalCall<M>>& my_local_calls,
-    std::map<int, std::set<RemoteCallPrototype<M>>>& rank_to_remote_call_prototypes,
-    std::map<int, std::set<IncomingGhostPrototype<M>>>& rank_to_incoming_ghost_prototypes)
-  {
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    auto nbrinfo = pinfo.getNormalNbrInfo(f);
-    if (nbrinfo.rank == rank) {
-      my_local_calls.emplace_back(
-        f, NbrType::Normal, Orthant<M>::null(), pinfo.local_index, nbrinfo.local_index);
-    } else {
-      rank_to_remote_call_prototypes[nbrinfo.rank].emplace(
-        nbrinfo.id, f, NbrType::Normal, Orthant<M>::null(), pinfo.local_index);
-      rank_to_incoming_ghost_prototypes[nbrinfo.rank].emplace(pinfo.id, f, pinfo.local_index);
-    }
-  }
-
-  /**
-   * @brief Add a fine neighbor call for given dimension
-   *
-   * @tparam M the dimension of the face
-   * @param pinfo the PatchInfo object for the patch that is being filled from
-   * @param f the the face
-   * @param my_local_calls the local calls deque
-   * @param rank_to_remote_call_prototypes the remote calls map
-   * @param rank_to_incoming_ghost_prototypes the incoming ghosts map
-   */
-  template<int M>
-  static void addFineNbrCalls(
-    const PatchInfo<D>& pinfo,
-    Face<D, M> f,
-    std::deque<LocalCall<M>>& my_local_calls,
-    std::map<int, std::set<RemoteCallPrototype<M>>>& rank_to_remote_call_prototypes,
-    std::map<int, std::set<IncomingGhostPrototype<M>>>& rank_to_incoming_ghost_prototypes)
-  {
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    auto nbrinfo = pinfo.getFineNbrInfo(f);
-    for (size_t i = 0; i < Orthant<M>::num_orthants; i++) {
-      if (nbrinfo.ranks[i] == rank) {
-        my_local_calls.emplace_back(
-          f, NbrType::Fine, Orthant<M>(i), pinfo.local_index, nbrinfo.local_indexes[i]);
-      } else {
-        rank_to_remote_call_prototypes[nbrinfo.ranks[i]].emplace(
-          nbrinfo.ids[i], f, NbrType::Fine, Orthant<M>(i), pinfo.local_index);
-        rank_to_incoming_ghost_prototypes[nbrinfo.ranks[i]].emplace(pinfo.id, f, pinfo.local_index);
-      }
-    }
-  }
-
-  /**
-   * @brief Add a coarse neighbor call for given dimension
-   *
-   * @tparam M the dimension of the face
-   * @param pinfo the PatchInfo object for the patch that is being filled from
-   * @param f the the face
-   * @param my_local_calls the local calls deque
-   * @param rank_to_remote_call_prototypes the remote calls map
-   * @param rank_to_incoming_ghost_prototypes the incoming ghosts map
+   * @tparam Prototype the prototype type, has to have operator<
+   * @param pairs the pairs
    */
-  template<int M>
-  static void addCoarseNbrCalls(
-    const PatchInfo<D>& pinfo,
-    Face<D, M> f,
-    std::deque<LocalCall<M>>& my_local_calls,
-    std::map<int, std::set<RemoteCallPrototype<M>>>& rank_to_remote_call_prototypes,
-    std::map<int, std::set<IncomingGhostPrototype<M>>>& rank_to_incoming_ghost_prototypes)
+  template<class Prototype>
+  static void sortAndRemoveDuplicates(std::vector<std::pair<int, Prototype>>& pairs)
   {
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    auto nbrinfo = pinfo.getCoarseNbrInfo(f);
-    if (nbrinfo.rank == rank) {
-      my_local_calls.emplace_back(
-        f, NbrType::Coarse, nbrinfo.orth_on_coarse, pinfo.local_index, nbrinfo.local_index);
-    } else {
-      rank_to_remote_call_prototypes[nbrinfo.rank].emplace(
-        nbrinfo.id, f, NbrType::Coarse, nbrinfo.orth_on_coarse, pinfo.local_index);
-      rank_to_incoming_ghost_prototypes[nbrinfo.rank].emplace(pinfo.id, f, pinfo.local_index);
-    }
+    std::sort(pairs.begin(), pairs.end());
+    auto equivalent = [](const std::pair<int, Prototype>& a, const std::pair<int, Prototype>& b) {
+      return !(a < b) && !(b < a);
+    };
+    pairs.erase(std::unique(pairs.begin(), pairs.end(), equivalent), pairs.end());
   }
 
   /**
@@ -824,73 +746,86 @@ private:
   {
     int rank;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    std::map<int, std::set<RemoteCallPrototype<M>>> rank_to_remote_call_prototypes;
-    std::map<int, std::set<IncomingGhostPrototype<M>>> rank_to_incoming_ghost_prototypes;
+    // (rank, prototype) pairs, these are sorted by rank then prototype after they are all added
+    std::vector<std::pair<int, RemoteCallPrototype<M>>> remote_call_prototypes;
+    std::vector<std::pair<int, IncomingGhostPrototype<M>>> incoming_ghost_prototypes;
 
+    const NbrTable<D>& nbrs = domain.getNbrTable();
     for (const PatchInfo<D>& pinfo : domain.getPatchInfoVector()) {
+      int local_index = pinfo.local_index;
       for (Face<D, M> f : Face<D, M>::getValues()) {
-        if (pinfo.hasNbr(f)) {
-          switch (pinfo.getNbrType(f)) {
-            case NbrType::Normal:
-              addNormalNbrCalls(pinfo,
-                                f,
-                                my_local_calls,
-                                rank_to_remote_call_prototypes,
-                                rank_to_incoming_ghost_prototypes);
-              break;
-            case NbrType::Fine:
-              addFineNbrCalls(pinfo,
-                              f,
-                              my_local_calls,
-                              rank_to_remote_call_prototypes,
-                              rank_to_incoming_ghost_prototypes);
-              break;
-            case NbrType::Coarse:
-              addCoarseNbrCalls(pinfo,
-                                f,
-                                my_local_calls,
-                                rank_to_remote_call_prototypes,
-                                rank_to_incoming_ghost_prototypes);
-              break;
-            default:
-              throw RuntimeError("Unsupported NbrType");
+        if (!nbrs.hasNbr(local_index, f)) {
+          continue;
+        }
+        NbrType type = nbrs.getNbrType(local_index, f);
+        Orthant<M> orthant = Orthant<M>::null();
+        if (type == NbrType::Coarse) {
+          orthant = nbrs.getOrthOnCoarse(local_index, f);
+        }
+        const int* nbr_ids = nbrs.getIds(local_index, f);
+        const int* nbr_ranks = nbrs.getRanks(local_index, f);
+        const int* nbr_local_indexes = nbrs.getLocalIndexes(local_index, f);
+        for (int i = 0; i < nbrs.getNumNbrs(local_index, f); i++) {
+          // fine neighbors have one entry for each orthant of the face
+          if (type == NbrType::Fine) {
+            orthant = Orthant<M>((unsigned char)i);
+          }
+          if (nbr_ranks[i] == rank) {
+            my_local_calls.emplace_back(f, type, orthant, local_index, nbr_local_indexes[i]);
+          } else {
+            remote_call_prototypes.emplace_back(
+              nbr_ranks[i], RemoteCallPrototype<M>(nbr_ids[i], f, type, orthant, local_index));
+            incoming_ghost_prototypes.emplace_back(
+              nbr_ranks[i], IncomingGhostPrototype<M>(pinfo.id, f, local_index));
           }
         }
       }
     }
+    // group the local calls by the patch that is being filled, so that its ghost cells are filled
+    // from all of its neighbors while they are in cache
+    std::stable_sort(my_local_calls.begin(),
+                     my_local_calls.end(),
+                     [](const LocalCall<M>& a, const LocalCall<M>& b) {
+                       return a.nbr_local_index < b.nbr_local_index;
+                     });
+    sortAndRemoveDuplicates(remote_call_prototypes);
+    sortAndRemoveDuplicates(incoming_ghost_prototypes);
+
     const GhostViewInfo<M>& ghost_local_data_info = ghost_local_data_infos.template get<M>();
-    for (const auto& pair : rank_to_remote_call_prototypes) {
-      int rank = pair.first;
-      rank_to_remote_call_sets.emplace(rank, rank);
-      RemoteCallSet& remote_call_set = rank_to_remote_call_sets.at(rank);
-      std::tuple<int, Face<D, M>> prev_id_side;
-      for (const RemoteCallPrototype<M>& call : pair.second) {
-        size_t offset = remote_call_set.send_buffer_length;
+    // the prototypes for each rank are contiguous
+    RemoteCallSet* remote_call_set = nullptr;
+    std::tuple<int, Face<D, M>> prev_id_side;
+    for (const auto& rank_and_call : remote_call_prototypes) {
+      const RemoteCallPrototype<M>& call = rank_and_call.second;
+      if (remote_call_set == nullptr || remote_call_set->rank != rank_and_call.first) {
+        int rank = rank_and_call.first;
+        remote_call_set = &rank_to_remote_call_sets.emplace(rank, rank).first->second;
+        prev_id_side = std::tuple<int, Face<D, M>>();
+      }
+      size_t offset = remote_call_set->send_buffer_length;
 
-        // calculate length in buffer need for ghost cells
-        size_t length = ghost_local_data_info.getSize(call.face);
-        // add length to buffer length
-        // if its the same side of the patch, resuse the previous buffer space
-        if (std::make_tuple(call.id, call.face) == prev_id_side) {
-          offset -= length;
-        } else {
-          remote_call_set.send_buffer_length += length;
-        }
-        remote_call_set.remote_calls.template get<M>().emplace_back(call, offset);
-        prev_id_side = std::make_tuple(call.id, call.face);
+      // calculate length in buffer need for ghost cells
+      size_t length = ghost_local_data_info.getSize(call.face);
+      // add length to buffer length
+      // if its the same side of the patch, resuse the previous buffer space
+      if (std::make_tuple(call.id, call.face) == prev_id_side) {
+        offset -= length;
+      } else {
+        remote_call_set->send_buffer_length += length;
       }
+      remote_call_set->remote_calls.template get<M>().emplace_back(call, offset);
+      prev_id_side = std::make_tuple(call.id, call.face);
     }
-    for (const auto& pair : rank_to_incoming_ghost_prototypes) {
-      RemoteCallSet& remote_call_set = rank_to_remote_call_sets.at(pair.first);
-      for (const IncomingGhostPrototype<M>& prototype : pair.second) {
-        // add length for ghosts to buffer length
-        size_t length = ghost_local_data_info.getSize(prototype.face);
-        size_t offset = remote_call_set.recv_buffer_length;
-        remote_call_set.recv_buffer_length += length;
+    for (const auto& rank_and_prototype : incoming_ghost_prototypes) {
+      RemoteCallSet& remote_call_set = rank_to_remote_call_sets.at(rank_and_prototype.first);
+      const IncomingGhostPrototype<M>& prototype = rank_and_prototype.second;
+      // add length for ghosts to buffer length
+      size_t length = ghost_local_data_info.getSize(prototype.face);
+      size_t offset = remote_call_set.recv_buffer_length;
+      remote_call_set.recv_buffer_length += length;
 
-        // add ghost to incoming ghosts
-        remote_call_set.incoming_ghosts.template get<M>().emplace_back(prototype, offset);
-      }
+      // add ghost to incoming ghosts
+      remote_call_set.incoming_ghosts.template get<M>().emplace_back(prototype, offset);
     }
   }
 
@@ -24,10 +24,10 @@
  *
  * @brief NbrInfoBase class
  */
+#include <ThunderEgg/IdMap.h>
 #include <ThunderEgg/NbrType.h>
 #include <ThunderEgg/Serializable.h>
 #include <deque>
-#include <map>
 #include <memory>
 
 namespace ThunderEgg {
@@ -60,13 +60,19 @@ public:
    *
    * @param rev_map map from id to local_index
    */
-  virtual void setGlobalIndexes(const std::map<int, int>& rev_map) = 0;
+  virtual void setGlobalIndexes(const IdMap& rev_map) = 0;
   /**
    * @brief Set the global indexes in the NbrInfo objects
    *
    * @param rev_map map from local_index to global_index
    */
-  virtual void setLocalIndexes(const std::map<int, int>& rev_map) = 0;
+  virtual void setLocalIndexes(const IdMap& rev_map) = 0;
+  /**
+   * @brief Set the ranks in the NbrInfo objects
+   *
+   * @param rev_map map from id to rank
+   */
+  virtual void setRanks(const IdMap& rev_map) = 0;
   /**
    * @brief get a clone of this object (equivalent to copy constructor)
    *
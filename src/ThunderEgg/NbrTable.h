@@ -0,0 +1,283 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef THUNDEREGG_NBRTABLE_H
+#define THUNDEREGG_NBRTABLE_H
+/**
+ * @file
+ *
+ * @brief NbrTable class
+ */
+#include <ThunderEgg/PatchInfo.h>
+#include <vector>
+
+namespace ThunderEgg {
+/**
+ * @brief The neighbors of all the local patches of a Domain, in flat arrays
+ *
+ * The neighbors are indexed by the local index of the patch and a face of any dimension. Each face
+ * has a slot with the type of the neighbor, and a contiguous range of neighbor entries: one for a
+ * normal or coarse neighbor, one for each orthant of the face for fine neighbors. The ids, ranks,
+ * local indexes and global indexes of the entries are each stored in their own array.
+ *
+ * Unlike PatchInfo, the accessors are inlined array lookups, with no virtual calls or casts.
+ *
+ * @tparam D the number of Cartesian dimensions
+ */
+template<int D>
+class NbrTable
+{
+public:
+  /**
+   * @brief the number of face slots for each patch, this counts faces of all dimensions
+   */
+  static constexpr int num_slots = (int)Face<D, D>::sum_of_faces;
+
+private:
+  /**
+   * @brief the NbrType of each slot, -1 if there is no neighbor
+   */
+  std::vector<signed char> types;
+  /**
+   * @brief the Orthant::getIndex() of the patch on the coarser neighbor for each slot with a
+   * coarse neighbor
+   */
+  std::vector<unsigned char> orths_on_coarse;
+  /**
+   * @brief the start of the entries of each slot, has one more element than the number of slots
+   */
+  std::vector<int> starts;
+  /**
+   * @brief the id of each entry
+   */
+  std::vector<int> ids;
+  /**
+   * @brief the rank of each entry
+   */
+  std::vector<int> ranks;
+  /**
+   * @brief the local index of each entry, -1 if the neighbor is not on this rank
+   */
+  std::vector<int> local_indexes;
+  /**
+   * @brief the global index of each entry
+   */
+  std::vector<int> global_indexes;
+
+  /**
+   * @brief Get the slot for a face of a patch
+   *
+   * @param local_index the local index of the patch
+   * @param f the face
+   * @return int the slot
+   */
+  template<int M>
+  static int getSlot(int local_index, Face<D, M> f)
+  {
+    return local_index * num_slots + (int)Face<D, M>::sum_of_faces + (int)f.getIndex();
+  }
+  /**
+   * @brief Add the entries of a patch's faces of dimension M and lower
+   *
+   * @param pinfo the patch
+   */
+  template<int M>
+  void addFaces(const PatchInfo<D>& pinfo);
+  /**
+   * @brief Add an entry for the current slot
+   */
+  void addEntry(int id, int rank, int local_index, int global_index)
+  {
+    ids.push_back(id);
+    ranks.push_back(rank);
+    local_indexes.push_back(local_index);
+    global_indexes.push_back(global_index);
+  }
+
+public:
+  /**
+   * @brief Construct an empty NbrTable
+   */
+  NbrTable() = default;
+  /**
+   * @brief Construct a new NbrTable object
+   *
+   * @param pinfos the patches, the index in the vector has to be the local index of the patch
+   */
+  explicit NbrTable(const std::vector<PatchInfo<D>>& pinfos);
+  /**
+   * @brief Get the number of patches in the table
+   */
+  int getNumPatches() const { return (int)types.size() / num_slots; }
+  /**
+   * @brief Check if a patch has a neighbor on a face
+   *
+   * @param local_index the local index of the patch
+   * @param f the face
+   */
+  template<int M>
+  bool hasNbr(int local_index, Face<D, M> f) const
+  {
+    return types[getSlot(local_index, f)] != -1;
+  }
+  /**
+   * @brief Get the NbrType of the neighbor on a face
+   *
+   * The patch has to have a neighbor on the face.
+   *
+   * @param local_index the local index of the patch
+   * @param f the face
+   */
+  template<int M>
+  NbrType getNbrType(int local_index, Face<D, M> f) const
+  {
+    return static_cast<NbrType>(types[getSlot(local_index, f)]);
+  }
+  /**
+   * @brief Get the number of neighbor patches on a face
+   *
+   * @param local_index the local index of the patch
+   * @param f the face
+   * @return int 0 if there is no neighbor, 1 for a normal or coarse neighbor, or the number of
+   * orthants on the face for fine neighbors
+   */
+  template<int M>
+  int getNumNbrs(int local_index, Face<D, M> f) const
+  {
+    int slot = getSlot(local_index, f);
+    return starts[slot + 1] - starts[slot];
+  }
+  /**
+   * @brief Get the ids of the neighbor patches on a face
+   *
+   * @param local_index the local index of the patch
+   * @param f the face
+   * @return const int* the getNumNbrs() ids, fine neighbors are in order of Orthant
+   */
+  template<int M>
+  const int* getIds(int local_index, Face<D, M> f) const
+  {
+    return ids.data() + starts[getSlot(local_index, f)];
+  }
+  /**
+   * @brief Get the ranks of the neighbor patches on a face
+   *
+   * @param local_index the local index of the patch
+   * @param f the face
+   * @return const int* the getNumNbrs() ranks, fine neighbors are in order of Orthant
+   */
+  template<int M>
+  const int* getRanks(int local_index, Face<D, M> f) const
+  {
+    return ranks.data() + starts[getSlot(local_index, f)];
+  }
+  /**
+   * @brief Get the local indexes of the neighbor patches on a face
+   *
+   * @param local_index the local index of the patch
+   * @param f the face
+   * @return const int* the getNumNbrs() local indexes, -1 for neighbors on other ranks, fine
+   * neighbors are in order of Orthant
+   */
+  template<int M>
+  const int* getLocalIndexes(int local_index, Face<D, M> f) const
+  {
+    return local_indexes.data() + starts[getSlot(local_index, f)];
+  }
+  /**
+   * @brief Get the global indexes of the neighbor patches on a face
+   *
+   * @param local_index the local index of the patch
+   * @param f the face
+   * @return const int* the getNumNbrs() global indexes, fine neighbors are in order of Orthant
+   */
+  template<int M>
+  const int* getGlobalIndexes(int local_index, Face<D, M> f) const
+  {
+    return global_indexes.data() + starts[getSlot(local_index, f)];
+  }
+  /**
+   * @brief Get the orthant of the patch on its coarser neighbor
+   *
+   * The neighbor on the face has to be coarse.
+   *
+   * @param local_index the local index of the patch
+   * @param f the face
+   */
+  template<int M>
+  Orthant<M> getOrthOnCoarse(int local_index, Face<D, M> f) const
+  {
+    return Orthant<M>(orths_on_coarse[getSlot(local_index, f)]);
+  }
+};
+template<int D>
+template<int M>
+void
+NbrTable<D>::addFaces(const PatchInfo<D>& pinfo)
+{
+  if constexpr (M > 0) {
+    addFaces<M - 1>(pinfo);
+  }
+  // slots are added in order of dimension then face index, which is the order of getSlot
+  for (Face<D, M> f : Face<D, M>::getValues()) {
+    signed char type = -1;
+    unsigned char orth_on_coarse = 0;
+    if (pinfo.hasNbr(f)) {
+      type = static_cast<signed char>(pinfo.getNbrType(f));
+      switch (pinfo.getNbrType(f)) {
+        case NbrType::Normal: {
+          const NormalNbrInfo<M>& info = pinfo.getNormalNbrInfo(f);
+          addEntry(info.id, info.rank, info.local_index, info.global_index);
+        } break;
+        case NbrType::Coarse: {
+          const CoarseNbrInfo<M>& info = pinfo.getCoarseNbrInfo(f);
+          addEntry(info.id, info.rank, info.local_index, info.global_index);
+          orth_on_coarse = (unsigned char)info.orth_on_coarse.getIndex();
+        } break;
+        case NbrType::Fine: {
+          const FineNbrInfo<M>& info = pinfo.getFineNbrInfo(f);
+          for (size_t i = 0; i < Orthant<M>::num_orthants; i++) {
+            addEntry(info.ids[i], info.ranks[i], info.local_indexes[i], info.global_indexes[i]);
+          }
+        } break;
+        default:
+          throw RuntimeError("Unsupported NbrType");
+      }
+    }
+    types.push_back(type);
+    orths_on_coarse.push_back(orth_on_coarse);
+    starts.push_back((int)ids.size());
+  }
+}
+template<int D>
+NbrTable<D>::NbrTable(const std::vector<PatchInfo<D>>& pinfos)
+{
+  types.reserve(pinfos.size() * num_slots);
+  orths_on_coarse.reserve(pinfos.size() * num_slots);
+  starts.reserve(pinfos.size() * num_slots + 1);
+  starts.push_back(0);
+  for (const PatchInfo<D>& pinfo : pinfos) {
+    addFaces<D - 1>(pinfo);
+  }
+}
+extern template class NbrTable<2>;
+extern template class NbrTable<3>;
+} // namespace ThunderEgg
+#endif
@@ -68,17 +68,21 @@ public:
   NbrType getNbrType() const override { return NbrType::Normal; }
   void getNbrIds(std::deque<int>& nbr_ids) const override { nbr_ids.push_back(id); }
   void getNbrRanks(std::deque<int>& nbr_ranks) const override { nbr_ranks.push_back(rank); }
-  void setGlobalIndexes(const std::map<int, int>& id_to_global_index_map) override
+  void setGlobalIndexes(const IdMap& id_to_global_index_map) override
   {
     global_index = id_to_global_index_map.at(id);
   }
-  void setLocalIndexes(const std::map<int, int>& id_to_local_index_map) override
+  void setLocalIndexes(const IdMap& id_to_local_index_map) override
   {
-    auto iter = id_to_local_index_map.find(id);
-    if (iter != id_to_local_index_map.end()) {
-      local_index = iter->second;
+    const int* new_local_index = id_to_local_index_map.find(id);
+    if (new_local_index != nullptr) {
+      local_index = *new_local_index;
     }
   }
+  void setRanks(const IdMap& id_to_rank_map) override
+  {
+    rank = id_to_rank_map.at(id);
+  }
   int serialize(char* buffer) const override
   {
     BufferWriter writer(buffer);
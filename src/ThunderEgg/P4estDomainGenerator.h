@@ -28,6 +28,7 @@
 #include <ThunderEgg/DomainGenerator.h>
 #include <functional>
 #include <list>
+#include <map>
 #include <p4est_extended.h>
 namespace ThunderEgg {
 /**
@@ -138,6 +139,24 @@ public:
   Domain<2> getFinestDomain();
   bool hasCoarserDomain();
   Domain<2> getCoarserDomain();
+  /**
+   * @brief Repartition a p4est so that the ranks have about the same total cost
+   *
+   * The costs are usually measured on the finest Domain that was generated from the p4est, with
+   * Timer::getPatchTimes or with the "Iterations" from Timer::getPatchIntInfoSums. The finest
+   * patch ids are the global indexes of the quadrants, so the p4est can not have been changed since
+   * the Domain was generated. Patches without a cost are given the mean cost. Families of
+   * quadrants are kept on one rank so that the tree can still be coarsened.
+   *
+   * The Domain hierarchy is rebuilt by constructing a new P4estDomainGenerator from the p4est.
+   * This is collective over the communicator of the p4est.
+   *
+   * @param p4est the p4est object
+   * @param patch_costs map from the id of each finest patch on this rank to its cost
+   * @return p4est_gloidx_t the global number of quadrants that were moved to a different rank
+   * @exception RuntimeError if a patch id is not the id of a quadrant on this rank
+   */
+  static p4est_gloidx_t Repartition(p4est_t* p4est, const std::map<int, double>& patch_costs);
 };
 } // namespace ThunderEgg
 #endif
@@ -214,6 +214,19 @@ SetIds(p8est_t* p8est)
     false);
 }
 
+/**
+ * @brief Weight callback for p8est_partition_ext, the weights of the local quadrants are in a
+ * vector pointed to by the user pointer of the p8est
+ */
+int
+WeightWrap(p8est_t* p8est, p4est_topidx_t which_tree, p8est_quadrant_t* quadrant)
+{
+  const vector<int>& weights = *(const vector<int>*)p8est->user_pointer;
+  const p8est_tree_t* tree = p8est_tree_array_index(p8est->trees, which_tree);
+  size_t index = tree->quadrants_offset + (quadrant - (p8est_quadrant_t*)tree->quadrants.array);
+  return weights[index];
+}
+
 } // namespace
 
 /*
@@ -951,3 +964,41 @@ P8estDomainGenerator::hasCoarserDomain()
 {
   return !domain_patches.empty();
 }
+
+p4est_gloidx_t
+P8estDomainGenerator::Repartition(p8est_t* p8est, const std::map<int, double>& patch_costs)
+{
+  // mean of the costs on all ranks
+  array<double, 2> cost_sum_and_count = { 0, 0 };
+  for (const auto& id_and_cost : patch_costs) {
+    cost_sum_and_count[0] += id_and_cost.second;
+    cost_sum_and_count[1]++;
+  }
+  MPI_Allreduce(
+    MPI_IN_PLACE, cost_sum_and_count.data(), 2, MPI_DOUBLE, MPI_SUM, p8est->mpicomm);
+  double mean_cost = 0;
+  if (cost_sum_and_count[1] > 0) {
+    mean_cost = cost_sum_and_count[0] / cost_sum_and_count[1];
+  }
+
+  // the weights are integers, the mean cost is given a weight of 1000 so that costs down to a
+  // thousandth of the mean are distinguished
+  const double mean_weight = 1000;
+  vector<int> weights(p8est->local_num_quadrants, (int)mean_weight);
+  p4est_gloidx_t first_id = p8est->global_first_quadrant[p8est->mpirank];
+  for (const auto& id_and_cost : patch_costs) {
+    p4est_gloidx_t index = id_and_cost.first - first_id;
+    if (index < 0 || index >= p8est->local_num_quadrants) {
+      throw RuntimeError("Patch with id " + to_string(id_and_cost.first) +
+                         " is not a quadrant on this rank");
+    }
+    double weight = mean_cost > 0 ? id_and_cost.second / mean_cost * mean_weight : mean_weight;
+    weights[index] = (int)max(1.0, min(round(weight), (double)numeric_limits<int>::max()));
+  }
+
+  void* user_pointer = p8est->user_pointer;
+  p8est->user_pointer = &weights;
+  p4est_gloidx_t num_moved = p8est_partition_ext(p8est, true, WeightWrap);
+  p8est->user_pointer = user_pointer;
+  return num_moved;
+}
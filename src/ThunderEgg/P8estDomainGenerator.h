@@ -27,6 +27,7 @@
  */
 #include <ThunderEgg/DomainGenerator.h>
 #include <functional>
+#include <map>
 #include <p8est.h>
 namespace ThunderEgg {
 /**
@@ -144,6 +145,24 @@ public:
   Domain<3> getFinestDomain();
   bool hasCoarserDomain();
   Domain<3> getCoarserDomain();
+  /**
+   * @brief Repartition a p8est so that the ranks have about the same total cost
+   *
+   * The costs are usually measured on the finest Domain that was generated from the p8est, with
+   * Timer::getPatchTimes or with the "Iterations" from Timer::getPatchIntInfoSums. The finest
+   * patch ids are the global indexes of the quadrants, so the p8est can not have been changed since
+   * the Domain was generated. Patches without a cost are given the mean cost. Families of
+   * quadrants are kept on one rank so that the tree can still be coarsened.
+   *
+   * The Domain hierarchy is rebuilt by constructing a new P8estDomainGenerator from the p8est.
+   * This is collective over the communicator of the p8est.
+   *
+   * @param p8est the p8est object
+   * @param patch_costs map from the id of each finest patch on this rank to its cost
+   * @return p4est_gloidx_t the global number of quadrants that were moved to a different rank
+   * @exception RuntimeError if a patch id is not the id of a quadrant on this rank
+   */
+  static p4est_gloidx_t Repartition(p8est_t* p8est, const std::map<int, double>& patch_costs);
 };
 } // namespace ThunderEgg
 #endif
@@ -25,6 +25,7 @@
  * @brief PatchInfo class
  */
 #include <ThunderEgg/CoarseNbrInfo.h>
+#include <ThunderEgg/Config.h>
 #include <ThunderEgg/FineNbrInfo.h>
 #include <ThunderEgg/NormalNbrInfo.h>
 #include <ThunderEgg/Orthant.h>
@@ -197,6 +198,19 @@ public:
     }
     return *this;
   }
+  /**
+   * @brief Move constructor, the NbrInfo objects are moved instead of cloned
+   *
+   * @param other_pinfo the object to move
+   */
+  PatchInfo(PatchInfo<D>&& other_pinfo) = default;
+  /**
+   * @brief Move assignment, the NbrInfo objects are moved instead of cloned
+   *
+   * @param other_pinfo the object to move
+   * @return PatchInfo<D>& this object
+   */
+  PatchInfo<D>& operator=(PatchInfo<D>&& other_pinfo) = default;
   /**
    * @brief Compare the ids of the patches
    *
@@ -237,7 +251,7 @@ public:
   /**
    * @brief Get the NormalNbrInfo object for a side
    *
-   * Neighbor must be of Normal type, otherwise behavior is undefined.
+   * Neighbor must be of Normal type, this is only checked in debug builds.
    *
    * @param s the side
    * @return NormalNbrInfo<D>& the object
@@ -245,26 +259,37 @@ public:
   template<int M>
   NormalNbrInfo<M>& getNormalNbrInfo(Face<D, M> s) const
   {
-    return *dynamic_cast<NormalNbrInfo<M>*>(
+    if constexpr (ENABLE_DEBUG) {
+      if (!hasNbr(s) || getNbrType(s) != NbrType::Normal) {
+        throw RuntimeError("Neighbor is not of Normal type");
+      }
+    }
+    return *static_cast<NormalNbrInfo<M>*>(
       nbr_infos[Face<D, M>::sum_of_faces + s.getIndex()].get());
   }
   /**
    * @brief Get the CoarseNbrInfo object
    *
-
+   * Neighbor must be of Coarse type, this is only checked in debug builds.
+   *
    * @param s the side
    * @return CoarseNbrInfo<D>& the object
-  */
+   */
   template<int M>
   CoarseNbrInfo<M>& getCoarseNbrInfo(Face<D, M> s) const
   {
-    return *dynamic_cast<CoarseNbrInfo<M>*>(
+    if constexpr (ENABLE_DEBUG) {
+      if (!hasNbr(s) || getNbrType(s) != NbrType::Coarse) {
+        throw RuntimeError("Neighbor is not of Coarse type");
+      }
+    }
+    return *static_cast<CoarseNbrInfo<M>*>(
       nbr_infos[Face<D, M>::sum_of_faces + s.getIndex()].get());
   }
   /**
    * @brief Get the FineNbrInfo object
    *
-   * Neighbor must be of Fine type, otherwise behavior is undefined.
+   * Neighbor must be of Fine type, this is only checked in debug builds.
    *
    * @param s the side
    * @return FineNbrInfo<D>& the object
@@ -272,7 +297,12 @@ public:
   template<int M>
   FineNbrInfo<M>& getFineNbrInfo(Face<D, M> s) const
   {
-    return *dynamic_cast<FineNbrInfo<M>*>(nbr_infos[Face<D, M>::sum_of_faces + s.getIndex()].get());
+    if constexpr (ENABLE_DEBUG) {
+      if (!hasNbr(s) || getNbrType(s) != NbrType::Fine) {
+        throw RuntimeError("Neighbor is not of Fine type");
+      }
+    }
+    return *static_cast<FineNbrInfo<M>*>(nbr_infos[Face<D, M>::sum_of_faces + s.getIndex()].get());
   }
   /**
    * @brief Return whether the patch has a neighbor
@@ -307,7 +337,7 @@ public:
    *
    * @param id_to_local_index_map map from id to local_index
    */
-  void setNeighborLocalIndexes(const std::map<int, int>& id_to_local_index_map)
+  void setNeighborLocalIndexes(const IdMap& id_to_local_index_map)
   {
     for (size_t i = 0; i < nbr_infos.size(); i++) {
       if (nbr_infos[i] != nullptr) {
@@ -315,12 +345,21 @@ public:
       }
     }
   }
+  /**
+   * @brief Set the local indexes in the NbrInfo objects from a std::map
+   *
+   * @param id_to_local_index_map map from id to local_index
+   */
+  void setNeighborLocalIndexes(const std::map<int, int>& id_to_local_index_map)
+  {
+    setNeighborLocalIndexes(IdMap(id_to_local_index_map));
+  }
   /**
    * @brief Set the global indexes in the NbrInfo objects
    *
    * @param id_to_global_index_map map form id to global_index
    */
-  void setNeighborGlobalIndexes(const std::map<int, int>& id_to_global_index_map)
+  void setNeighborGlobalIndexes(const IdMap& id_to_global_index_map)
   {
     for (size_t i = 0; i < nbr_infos.size(); i++) {
       if (nbr_infos[i] != nullptr) {
@@ -328,6 +367,37 @@ public:
       }
     }
   }
+  /**
+   * @brief Set the global indexes in the NbrInfo objects from a std::map
+   *
+   * @param id_to_global_index_map map from id to global_index
+   */
+  void setNeighborGlobalIndexes(const std::map<int, int>& id_to_global_index_map)
+  {
+    setNeighborGlobalIndexes(IdMap(id_to_global_index_map));
+  }
+  /**
+   * @brief Set the ranks in the NbrInfo objects
+   *
+   * @param id_to_rank_map map from id to rank
+   */
+  void setNeighborRanks(const IdMap& id_to_rank_map)
+  {
+    for (size_t i = 0; i < nbr_infos.size(); i++) {
+      if (nbr_infos[i] != nullptr) {
+        nbr_infos[i]->setRanks(id_to_rank_map);
+      }
+    }
+  }
+  /**
+   * @brief Set the ranks in the NbrInfo objects from a std::map
+   *
+   * @param id_to_rank_map map from id to rank
+   */
+  void setNeighborRanks(const std::map<int, int>& id_to_rank_map)
+  {
+    setNeighborRanks(IdMap(id_to_rank_map));
+  }
   /**
    * @brief return a vector of neighbor ids
    */
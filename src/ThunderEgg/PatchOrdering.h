@@ -0,0 +1,51 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef THUNDEREGG_PATCHORDERING_H
+#define THUNDEREGG_PATCHORDERING_H
+/**
+ * @file
+ *
+ * @brief PatchOrdering enum
+ */
+
+namespace ThunderEgg {
+/**
+ * @brief The order of the local patches in a Domain, this is also the order of the patches in a
+ * Vector
+ */
+enum class PatchOrdering
+{
+  /**
+   * @brief The order that the PatchInfo objects were given in
+   */
+  Given,
+  /**
+   * @brief Morton (Z) order of the lower corners of the patches
+   */
+  Morton,
+  /**
+   * @brief Hilbert order of the lower corners of the patches
+   */
+  Hilbert
+};
+} // namespace ThunderEgg
+
+#endif
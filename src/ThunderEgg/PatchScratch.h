@@ -0,0 +1,80 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef THUNDEREGG_PATCHSCRATCH_H
+#define THUNDEREGG_PATCHSCRATCH_H
+/**
+ * @file
+ *
+ * @brief PatchScratch class
+ */
+
+#include <ThunderEgg/PatchView.h>
+#include <vector>
+
+namespace ThunderEgg {
+/**
+ * @brief Thread local scratch buffers for patch solvers that work on contiguous copies of patches
+ */
+class PatchScratch
+{
+public:
+  /**
+   * @brief Get the scratch buffer for the calling thread
+   *
+   * The buffer is shared by every caller on the thread, and is only valid until the next call.
+   *
+   * @param size the number of values needed
+   * @return double* the buffer
+   */
+  static double* GetBuffer(size_t size)
+  {
+    static thread_local std::vector<double> scratch;
+    if (scratch.size() < size) {
+      scratch.resize(size);
+    }
+    return scratch.data();
+  }
+  /**
+   * @brief Get a view of a patch in a contiguous buffer, the first axis is the fastest
+   *
+   * @tparam D the number of Cartesian dimensions
+   * @param buffer pointer to the start of the patch in the buffer
+   * @param ns the number of cells along each axis of the patch
+   * @return PatchView<double, D> the view, with a single component and no ghost cells
+   */
+  template<int D>
+  static PatchView<double, D> GetView(double* buffer, const std::array<int, D>& ns)
+  {
+    std::array<int, D + 1> strides;
+    std::array<int, D + 1> lengths;
+    int stride = 1;
+    for (size_t axis = 0; axis < D; axis++) {
+      strides[axis] = stride;
+      lengths[axis] = ns[axis];
+      stride *= ns[axis];
+    }
+    strides[D] = stride;
+    lengths[D] = 1;
+    return PatchView<double, D>(buffer, strides, lengths, 0);
+  }
+};
+} // namespace ThunderEgg
+#endif
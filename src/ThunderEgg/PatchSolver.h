@@ -98,6 +98,14 @@ public:
   virtual void solveSinglePatch(const PatchInfo<D>& pinfo,
                                 const PatchView<const double, D>& f_view,
                                 const PatchView<double, D>& u_view) const = 0;
+  /**
+   * @brief Check if solveSinglePatch can be called from multiple threads at the same time
+   *
+   * This has to be false if solveSinglePatch makes any MPI calls.
+   *
+   * @return false, unless overridden by a derived class
+   */
+  virtual bool isThreadSafe() const { return false; }
   /**
    * @brief Solve all the patches in the domain, assuming zero boundary conditions for the patches
    *
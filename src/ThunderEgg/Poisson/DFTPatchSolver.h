@@ -28,26 +28,44 @@
 #include <ThunderEgg/Domain.h>
 #include <ThunderEgg/PatchArray.h>
 #include <ThunderEgg/PatchOperator.h>
+#include <ThunderEgg/PatchScratch.h>
 #include <ThunderEgg/PatchSolver.h>
 #include <ThunderEgg/Vector.h>
 #include <bitset>
 #include <map>
 #include <valarray>
+#include <vector>
 #include <functional>
 
 extern "C" void
-dgemv_(char&, int&, int&, double&, double*, int&, double*, int&, double&, double*, int&);
+dgemm_(char&,
+       char&,
+       int&,
+       int&,
+       int&,
+       double&,
+       double*,
+       int&,
+       double*,
+       int&,
+       double&,
+       double*,
+       int&);
 
 namespace ThunderEgg::Poisson {
 /**
  * @brief Use DFT transforms to solve for the Poisson equation
  *
+ * The transforms are done on contiguous copies of the patch, where the transform along an axis is a
+ * matrix-matrix product for every slab of the patch that is normal to the higher axes. This is a
+ * single product for the first and last axes.
+ *
  * @tparam D the number of Cartesian dimensions
  */
 template<int D>
 class DFTPatchSolver : public PatchSolver<D>
 {
-private:
+public:
   /**
    * @brief Enum of DFT types
    */
@@ -60,6 +78,74 @@ private:
     DST_III,
     DST_IV
   };
+  /**
+   * @brief Get a dft Transform matrix for a certain type and size
+   *
+   * @param type the DFT type
+   * @param n the size of the matrix
+   * @return std::valarray<double> an nxn DFT matrix, transforming x is y[i] = sum_j
+   * matrix[i * n + j] * x[j]. The forward and inverse transforms of the same boundary conditions
+   * are inverses of each other up to a factor of 2/n.
+   */
+  static std::valarray<double> getTransformMatrix(DftType type, int n)
+  {
+    std::valarray<double> matrix(n * n);
+    switch (type) {
+      case DftType::DCT_II:
+        for (int j = 0; j < n; j++) {
+          for (int i = 0; i < n; i++) {
+            matrix[i * n + j] = cos(M_PI / n * (i * (j + 0.5)));
+          }
+        }
+        break;
+      case DftType::DCT_III:
+        for (int i = 0; i < n; i++) {
+          matrix[i * n] = 0.5;
+        }
+        for (int j = 1; j < n; j++) {
+          for (int i = 0; i < n; i++) {
+            matrix[i * n + j] = cos(M_PI / n * ((i + 0.5) * j));
+          }
+        }
+        break;
+      case DftType::DCT_IV:
+        for (int j = 0; j < n; j++) {
+          for (int i = 0; i < n; i++) {
+            matrix[i * n + j] = cos(M_PI / n * ((i + 0.5) * (j + 0.5)));
+          }
+        }
+        break;
+      case DftType::DST_II:
+        for (int i = 0; i < n; i++) {
+          for (int j = 0; j < n; j++) {
+            matrix[i * n + j] = sin(M_PI / n * ((i + 1) * (j + 0.5)));
+          }
+        }
+        break;
+      case DftType::DST_III:
+        for (int i = 0; i < n; i += 2) {
+          matrix[i * n + n - 1] = 0.5;
+        }
+        for (int i = 1; i < n; i += 2) {
+          matrix[i * n + n - 1] = -0.5;
+        }
+        for (int i = 0; i < n; i++) {
+          for (int j = 0; j < n - 1; j++) {
+            matrix[i * n + j] = sin(M_PI / n * ((i + 0.5) * (j + 1)));
+          }
+        }
+        break;
+      case DftType::DST_IV:
+        for (int j = 0; j < n; j++) {
+          for (int i = 0; i < n; i++) {
+            matrix[i * n + j] = sin(M_PI / n * ((i + 0.5) * (j + 0.5)));
+          }
+        }
+    }
+    return matrix;
+  }
+
+private:
   /**
    * @brief Comparator used in the maps, patches with the same spacings and boundary conditions
    * will be equal
@@ -133,62 +219,8 @@ private:
     std::shared_ptr<std::valarray<double>> matrix_ptr;
 
     if (transform_matrixes.count(std::make_tuple(type, n)) == 0) {
-      matrix_ptr = std::make_shared<std::valarray<double>>(n * n);
+      matrix_ptr = std::make_shared<std::valarray<double>>(getTransformMatrix(type, n));
       transform_matrixes[std::make_tuple(type, n)] = matrix_ptr;
-      std::valarray<double>& matrix = *matrix_ptr;
-
-      switch (type) {
-        case DftType::DCT_II:
-          for (int j = 0; j < n; j++) {
-            for (int i = 0; i < n; i++) {
-              matrix[i * n + j] = cos(M_PI / n * (i * (j + 0.5)));
-            }
-          }
-          break;
-        case DftType::DCT_III:
-          for (int i = 0; i < n; i++) {
-            matrix[i * n] = 0.5;
-          }
-          for (int j = 1; j < n; j++) {
-            for (int i = 0; i < n; i++) {
-              matrix[i * n + j] = cos(M_PI / n * ((i + 0.5) * j));
-            }
-          }
-          break;
-        case DftType::DCT_IV:
-          for (int j = 0; j < n; j++) {
-            for (int i = 0; i < n; i++) {
-              matrix[i * n + j] = cos(M_PI / n * ((i + 0.5) * (j + 0.5)));
-            }
-          }
-          break;
-        case DftType::DST_II:
-          for (int i = 0; i < n; i++) {
-            for (int j = 0; j < n; j++) {
-              matrix[i * n + j] = sin(M_PI / n * ((i + 1) * (j + 0.5)));
-            }
-          }
-          break;
-        case DftType::DST_III:
-          for (int i = 0; i < n; i += 2) {
-            matrix[i * n + n - 1] = 0.5;
-          }
-          for (int i = 1; i < n; i += 2) {
-            matrix[i * n + n - 1] = -0.5;
-          }
-          for (int i = 0; i < n; i++) {
-            for (int j = 0; j < n - 1; j++) {
-              matrix[i * n + j] = sin(M_PI / n * ((i + 0.5) * (j + 1)));
-            }
-          }
-          break;
-        case DftType::DST_IV:
-          for (int j = 0; j < n; j++) {
-            for (int i = 0; i < n; i++) {
-              matrix[i * n + j] = sin(M_PI / n * ((i + 0.5) * (j + 0.5)));
-            }
-          }
-      }
     } else {
       matrix_ptr = transform_matrixes.at(std::make_tuple(type, n));
     }
@@ -197,70 +229,64 @@ private:
   /**
    * @brief Execute a given DFT plan
    *
+   * The patch is stored contiguously with the first axis the fastest. Viewed as a column-major
+   * matrix with the lower axes as rows, the axis being transformed as columns, and the higher axes
+   * as separate slabs, the transform is out_slab = in_slab * matrix for each slab.
+   *
    * @param plan the plan (the matrixes for each axis)
-   * @param in the input values
+   * @param in the input values, is not modified
    * @param out the resulting values after the transform
-   * @param inverse weather we a re calculate
+   * @param tmp a buffer for intermediate results, can be nullptr if D is 1
    */
   void executePlan(const std::array<std::shared_ptr<std::valarray<double>>, D>& plan,
-                   const PatchView<double, D>& in,
-                   const PatchView<double, D>& out) const
+                   double* in,
+                   double* out,
+                   double* tmp) const
   {
-    PatchView<double, D> prev_result = in;
-
-    PatchArray<D> local_tmp;
-    if (!(D % 2)) {
-      local_tmp = PatchArray<D>(op->getDomain().getNs(), 1, 0);
+    const std::array<int, D>& ns = this->getDomain().getNs();
+    int patch_size = 1;
+    for (size_t axis = 0; axis < D; axis++) {
+      patch_size *= ns[axis];
     }
 
-    for (size_t axis = 0; axis < D; axis++) {
-      int n = this->getDomain().getNs()[axis];
-      std::array<int, D + 1> start = in.getStart();
-      std::array<int, D + 1> end = in.getEnd();
-      end[axis] = 0;
+    char N = 'N';
+    char T = 'T';
+    double one = 1;
+    double zero = 0;
 
-      std::valarray<double>& matrix = *plan[axis];
+    double* prev_result = in;
+    int lower_size = 1;
+    for (size_t axis = 0; axis < D; axis++) {
+      int n = ns[axis];
+      int slab_size = lower_size * n;
+      int num_slabs = patch_size / slab_size;
+      // alternate between out and tmp, so that the last axis ends up in out
+      double* new_result = ((D - 1 - axis) % 2 == 0) ? out : tmp;
 
-      PatchView<double, D> new_result;
-      if (D % 2) {
-        if (axis % 2) {
-          new_result = in;
-        } else {
-          new_result = out;
-        }
+      double* matrix = &(*plan[axis])[0];
+      if (axis == 0) {
+        // every line is a column of prev_result, new_result = matrix^T * prev_result
+        dgemm_(T, N, n, num_slabs, n, one, matrix, n, prev_result, n, zero, new_result, n);
       } else {
-        if (axis == D - 1) {
-          new_result = out;
-        } else if (axis == D - 2) {
-          new_result = local_tmp.getView();
-        } else if (axis % 2) {
-          new_result = in;
-        } else {
-          new_result = out;
+        for (int slab = 0; slab < num_slabs; slab++) {
+          dgemm_(N,
+                 N,
+                 lower_size,
+                 n,
+                 n,
+                 one,
+                 prev_result + slab * slab_size,
+                 lower_size,
+                 matrix,
+                 n,
+                 zero,
+                 new_result + slab * slab_size,
+                 lower_size);
         }
       }
 
-      int pstride = prev_result.getStrides()[axis];
-      int nstride = new_result.getStrides()[axis];
-
-      char T = 'T';
-      double one = 1;
-      double zero = 0;
-      Loop::Nested<D + 1>(start, end, [&](std::array<int, D + 1> coord) {
-        dgemv_(T,
-               n,
-               n,
-               one,
-               &matrix[0],
-               n,
-               &prev_result[coord],
-               pstride,
-               zero,
-               &new_result[coord],
-               nstride);
-      });
-
       prev_result = new_result;
+      lower_size = slab_size;
     }
   }
   /**
@@ -417,36 +443,52 @@ public:
    * @return DFTPatchSolver<D>* a newly allocated copy of this patch solver
    */
   DFTPatchSolver<D>* clone() const override { return new DFTPatchSolver<D>(*this); }
+  /**
+   * @brief Check if solveSinglePatch can be called from multiple threads at the same time
+   *
+   * @return true, the patches are solved in scratch buffers that are allocated once per thread
+   */
+  bool isThreadSafe() const override { return true; }
   void solveSinglePatch(const PatchInfo<D>& pinfo,
                         const PatchView<const double, D>& f_view,
                         const PatchView<double, D>& u_view) const override
   {
-    PatchArray<D> f_copy(op->getDomain().getNs(), 1, 0);
-    PatchArray<D> tmp(op->getDomain().getNs(), 1, 0);
+    int patch_size = 1;
+    for (size_t axis = 0; axis < D; axis++) {
+      patch_size *= this->getDomain().getNs()[axis];
+    }
+    double* scratch = PatchScratch::GetBuffer(3 * patch_size);
+    double* in = scratch;
+    double* out = scratch + patch_size;
+    double* tmp = scratch + 2 * patch_size;
 
+    PatchView<double, D> in_view = PatchScratch::GetView<D>(in, this->getDomain().getNs());
     Loop::OverInteriorIndexes<D + 1>(
-      f_view, [&](std::array<int, D + 1> coord) { f_copy[coord] = f_view[coord]; });
+      in_view, [&](const std::array<int, D + 1>& coord) { in_view[coord] = f_view[coord]; });
 
-    op->modifyRHSForInternalBoundaryConditions(pinfo, u_view, f_copy.getView());
+    op->modifyRHSForInternalBoundaryConditions(pinfo, u_view, in_view);
 
-    executePlan(plan1.at(pinfo), f_copy.getView(), tmp.getView());
+    executePlan(plan1.at(pinfo), in, out, tmp);
 
+    PatchView<double, D> out_view = PatchScratch::GetView<D>(out, this->getDomain().getNs());
     const PatchArray<D>& eigen_vals_view = eigen_vals.at(pinfo);
-    Loop::OverInteriorIndexes<D + 1>(
-      tmp, [&](std::array<int, D + 1> coord) { tmp[coord] /= eigen_vals_view[coord]; });
+    Loop::OverInteriorIndexes<D + 1>(out_view, [&](const std::array<int, D + 1>& coord) {
+      out_view[coord] /= eigen_vals_view[coord];
+    });
 
     if (neumann.all() && !pinfo.hasNbr()) {
-      tmp[tmp.getStart()] = 0;
+      out[0] = 0;
     }
 
-    executePlan(plan2.at(pinfo), tmp.getView(), u_view);
+    executePlan(plan2.at(pinfo), out, in, tmp);
 
     double scale = 1;
     for (size_t axis = 0; axis < D; axis++) {
       scale *= 2.0 / this->getDomain().getNs()[axis];
     }
-    Loop::OverInteriorIndexes<D + 1>(u_view,
-                                     [&](std::array<int, D + 1> coord) { u_view[coord] *= scale; });
+    Loop::OverInteriorIndexes<D + 1>(u_view, [&](const std::array<int, D + 1>& coord) {
+      u_view[coord] = in_view[coord] * scale;
+    });
   }
 };
 
@@ -27,18 +27,74 @@
  */
 #include <ThunderEgg/PatchArray.h>
 #include <ThunderEgg/PatchOperator.h>
+#include <ThunderEgg/PatchScratch.h>
 #include <ThunderEgg/PatchSolver.h>
+#include <ThunderEgg/RuntimeError.h>
 #include <ThunderEgg/Vector.h>
 #include <bitset>
+#include <cstdlib>
 #include <fftw3.h>
-#include <map>
+#include <set>
 #include <valarray>
-#include <functional>
 
 namespace ThunderEgg::Poisson {
+/**
+ * @brief How much effort FFTW puts into finding fast plans
+ */
+enum class FFTWPlanningRigor
+{
+  /**
+   * @brief FFTW_ESTIMATE, choose plans with heuristics, planning is very fast
+   */
+  Estimate,
+  /**
+   * @brief FFTW_MEASURE, time a number of plans and choose the fastest
+   */
+  Measure,
+  /**
+   * @brief FFTW_PATIENT, time a wider range of plans than Measure
+   */
+  Patient
+};
+/**
+ * @brief Options for FFTWPatchSolver
+ */
+struct FFTWPatchSolverOpts
+{
+  /**
+   * @brief The planning rigor
+   */
+  FFTWPlanningRigor planning_rigor = FFTWPlanningRigor::Measure;
+  /**
+   * @brief Plan the single patch transforms on rank 0, and broadcast the FFTW wisdom to the other
+   * ranks, so that they do not have to measure them. Each rank still plans its own batched
+   * transforms.
+   */
+  bool share_wisdom = false;
+  /**
+   * @brief If not empty, rank 0 imports FFTW wisdom from this file (if it exists) before planning.
+   * After planning, the wisdom of every rank, including their batched transforms, is merged on
+   * rank 0 and exported to the file, so that a later run with the same partitioning does not have
+   * to plan anything. Implies share_wisdom.
+   */
+  std::string wisdom_file;
+};
 /**
  * @brief Use FFT transforms to solve for the Poisson equation
  *
+ * Patches with the same spacings and boundary conditions share a group of FFTW plans, and each
+ * local patch is assigned its group when the solver is constructed. apply() and smooth() transform
+ * all the local patches of a group with a single batched plan. If the Domain has a Timer, the
+ * patches are solved one at a time instead, so that the timings of each patch are recorded.
+ *
+ * The transforms are done in scratch buffers that are allocated once per thread.
+ *
+ * The setup time is recorded in the Timer of the Domain as "FFTWPatchSolver Setup". Setup time is
+ * dominated by FFTW planning, which can be reduced with the FFTWPatchSolverOpts: the planning rigor
+ * can be lowered, and the wisdom can be planned once on rank 0 and cached on disk between runs.
+ * Plans are always looked up in the FFTW wisdom first, getNumFreshPlans() gives the number of plans
+ * that had to be planned from scratch.
+ *
  * @tparam D the number of Cartesian dimensions
  */
 template<int D>
@@ -46,32 +102,118 @@ class FFTWPatchSolver : public PatchSolver<D>
 {
 private:
   /**
-   * @brief Comparator used in the maps, patches with the same spacings and boundary conditions
-   * will be equal
+   * @brief Patches with the same key can share plans. The first value has a bit set for each side
+   * with a neumann boundary condition, the second value is the spacing.
+   */
+  using PlanKey = std::pair<unsigned long, double>;
+  /**
+   * @brief The plans and eigenvalues for a group of patches with the same PlanKey
+   */
+  struct PlanGroup
+  {
+    /**
+     * @brief The key for this group
+     */
+    PlanKey key;
+    /**
+     * @brief DFT plan for a single patch
+     */
+    std::shared_ptr<fftw_plan> plan1;
+    /**
+     * @brief Inverse DFT plan for a single patch
+     */
+    std::shared_ptr<fftw_plan> plan2;
+    /**
+     * @brief DFT plan for all the local patches in the group
+     */
+    std::shared_ptr<fftw_plan> batch_plan1;
+    /**
+     * @brief Inverse DFT plan for all the local patches in the group
+     */
+    std::shared_ptr<fftw_plan> batch_plan2;
+    /**
+     * @brief The reciprocal of the eigenvalues times the normalization of the transforms, zero for
+     * the zero eigenvalue of a pure neumann problem
+     */
+    std::vector<double> inv_eigen_vals;
+    /**
+     * @brief The local indexes of the patches in this group
+     */
+    std::vector<int> local_indexes;
+  };
+  /**
+   * @brief Scratch buffers allocated with fftw_malloc, so that they have the alignment that the
+   * plans were created with
    */
-  using CompareFunction = std::function<bool(const PatchInfo<D>&, const PatchInfo<D>&)>;
+  struct Scratch
+  {
+    double* in = nullptr;
+    double* out = nullptr;
+    size_t size = 0;
+    Scratch() = default;
+    Scratch(const Scratch&) = delete;
+    Scratch& operator=(const Scratch&) = delete;
+    ~Scratch()
+    {
+      fftw_free(in);
+      fftw_free(out);
+    }
+    /**
+     * @brief Make sure each buffer has at least size values
+     */
+    void reserve(size_t new_size)
+    {
+      if (new_size > size) {
+        fftw_free(in);
+        fftw_free(out);
+        in = fftw_alloc_real(new_size);
+        out = fftw_alloc_real(new_size);
+        size = new_size;
+      }
+    }
+  };
 
   /**
    * @brief The patch opertar that we are solving for
    */
   std::shared_ptr<const PatchOperator<D>> op;
   /**
-   * @brief Map of patchinfo to DFT plan
+   * @brief Neumann boundary conditions for domain
    */
-  std::map<const PatchInfo<D>, std::shared_ptr<fftw_plan>, CompareFunction> plan1;
+  std::bitset<Side<D>::number_of> neumann;
   /**
-   * @brief Map of patchinfo to inverse DFT plan
+   * @brief The number of cells in a patch
    */
-  std::map<const PatchInfo<D>, std::shared_ptr<fftw_plan>, CompareFunction> plan2;
+  int patch_size = 1;
   /**
-   * @brief Map of PatchInfo object to it's respective eigenvalue array.
+   * @brief The planning rigor
    */
-  std::map<const PatchInfo<D>, PatchArray<D>, CompareFunction> eigen_vals;
+  FFTWPlanningRigor rigor = FFTWPlanningRigor::Measure;
   /**
-   * @brief Neumann boundary conditions for domain
+   * @brief The plan groups
    */
-  std::bitset<Side<D>::number_of> neumann;
+  std::vector<PlanGroup> groups;
+  /**
+   * @brief The index in groups for each local patch
+   */
+  std::vector<int> patch_groups;
+  /**
+   * @brief The number of plans that were not found in the FFTW wisdom
+   */
+  int num_fresh_plans = 0;
 
+  /**
+   * @brief Get the scratch buffers for the calling thread
+   *
+   * @param size the number of values needed in each buffer
+   * @return Scratch& the buffers
+   */
+  static Scratch& getScratch(size_t size)
+  {
+    static thread_local Scratch scratch;
+    scratch.reserve(size);
+    return scratch;
+  }
   /**
    * @brief Return if a patch has a neumann boundary condition on a particular side
    *
@@ -80,28 +222,30 @@ private:
    * @return true if neumann
    * @return false if not neumann
    */
-  bool patchIsNeumannOnSide(const PatchInfo<D>& pinfo, Side<D> s)
+  bool patchIsNeumannOnSide(const PatchInfo<D>& pinfo, Side<D> s) const
   {
     return !pinfo.hasNbr(s) && neumann[s.getIndex()];
   }
   /**
-   * @brief Get the fft transform types for a patch
+   * @brief Get the fft transform types for a group of patches
    *
-   * @param pinfo the patch
+   * @param neumann_sides a bit set for each side of the patch with a neumann boundary condition
    * @return std::array<fftw_r2r_kind, D> an array of tranforms for each axis, the order of
    * dimensions is reversed because FFTW uses row-major format
    */
-  std::array<fftw_r2r_kind, D> getTransformsForPatch(const PatchInfo<D>& pinfo)
+  static std::array<fftw_r2r_kind, D> getTransforms(unsigned long neumann_sides)
   {
+    std::bitset<Side<D>::number_of> sides(neumann_sides);
     // get transform types for each axis
     std::array<fftw_r2r_kind, D> transforms;
     for (size_t axis = 0; axis < D; axis++) {
-      if (patchIsNeumannOnSide(pinfo, LowerSideOnAxis<D>(axis)) &&
-          patchIsNeumannOnSide(pinfo, HigherSideOnAxis<D>(axis))) {
+      bool lower = sides[LowerSideOnAxis<D>(axis).getIndex()];
+      bool higher = sides[HigherSideOnAxis<D>(axis).getIndex()];
+      if (lower && higher) {
         transforms[D - 1 - axis] = FFTW_REDFT10;
-      } else if (patchIsNeumannOnSide(pinfo, LowerSideOnAxis<D>(axis))) {
+      } else if (lower) {
         transforms[D - 1 - axis] = FFTW_REDFT11;
-      } else if (patchIsNeumannOnSide(pinfo, HigherSideOnAxis<D>(axis))) {
+      } else if (higher) {
         transforms[D - 1 - axis] = FFTW_RODFT11;
       } else {
         transforms[D - 1 - axis] = FFTW_RODFT10;
@@ -110,23 +254,25 @@ private:
     return transforms;
   }
   /**
-   * @brief Get the inverse fft transform types for a patch
+   * @brief Get the inverse fft transform types for a group of patches
    *
-   * @param pinfo the patch
+   * @param neumann_sides a bit set for each side of the patch with a neumann boundary condition
    * @return std::array<fftw_r2r_kind, D> an array of tranforms for each axis, the order of
    * dimensions is reversed because FFTW uses row-major format
    */
-  std::array<fftw_r2r_kind, D> getInverseTransformsForPatch(const PatchInfo<D>& pinfo)
+  static std::array<fftw_r2r_kind, D> getInverseTransforms(unsigned long neumann_sides)
   {
+    std::bitset<Side<D>::number_of> sides(neumann_sides);
     // get transform types for each axis
     std::array<fftw_r2r_kind, D> transforms_inv;
     for (size_t axis = 0; axis < D; axis++) {
-      if (patchIsNeumannOnSide(pinfo, LowerSideOnAxis<D>(axis)) &&
-          patchIsNeumannOnSide(pinfo, HigherSideOnAxis<D>(axis))) {
+      bool lower = sides[LowerSideOnAxis<D>(axis).getIndex()];
+      bool higher = sides[HigherSideOnAxis<D>(axis).getIndex()];
+      if (lower && higher) {
         transforms_inv[D - 1 - axis] = FFTW_REDFT01;
-      } else if (patchIsNeumannOnSide(pinfo, LowerSideOnAxis<D>(axis))) {
+      } else if (lower) {
         transforms_inv[D - 1 - axis] = FFTW_REDFT11;
-      } else if (patchIsNeumannOnSide(pinfo, HigherSideOnAxis<D>(axis))) {
+      } else if (higher) {
         transforms_inv[D - 1 - axis] = FFTW_RODFT11;
       } else {
         transforms_inv[D - 1 - axis] = FFTW_RODFT01;
@@ -134,13 +280,156 @@ private:
     }
     return transforms_inv;
   }
+  /**
+   * @brief Get the key for a patch
+   *
+   * @param pinfo the patch
+   * @return PlanKey the key
+   */
+  PlanKey getKey(const PatchInfo<D>& pinfo) const
+  {
+    std::bitset<Side<D>::number_of> patch_neumann;
+    for (Side<D> s : Side<D>::getValues()) {
+      patch_neumann[s.getIndex()] = patchIsNeumannOnSide(pinfo, s);
+    }
+    return PlanKey(patch_neumann.to_ulong(), pinfo.spacings[0]);
+  }
+  /**
+   * @brief Get the index of the plan group for a patch
+   *
+   * Patches of the Domain use the table that was filled in on construction, other patches (added
+   * with addPatch()) are looked up by their key.
+   *
+   * @param pinfo the patch
+   * @return int the index in groups
+   */
+  int getGroupIndex(const PatchInfo<D>& pinfo) const
+  {
+    PlanKey key = getKey(pinfo);
+    if (pinfo.local_index >= 0 && pinfo.local_index < (int)patch_groups.size() &&
+        groups[patch_groups[pinfo.local_index]].key == key) {
+      return patch_groups[pinfo.local_index];
+    }
+    for (size_t i = 0; i < groups.size(); i++) {
+      if (groups[i].key == key) {
+        return i;
+      }
+    }
+    throw RuntimeError("FFTWPatchSolver does not have a plan for patch " + std::to_string(pinfo.id));
+  }
+  /**
+   * @brief Copy the rhs of a patch into a scratch buffer, and modify it for the internal boundary
+   * conditions
+   *
+   * @param pinfo the patch
+   * @param f_view the rhs
+   * @param u_view the solution, with ghost values filled
+   * @param buffer pointer to the start of the patch in the buffer
+   */
+  void loadPatch(const PatchInfo<D>& pinfo,
+                 const PatchView<const double, D>& f_view,
+                 const PatchView<const double, D>& u_view,
+                 double* buffer) const
+  {
+    PatchView<double, D> view = PatchScratch::GetView<D>(buffer, this->getDomain().getNs());
+    Loop::OverInteriorIndexes<D + 1>(
+      view, [&](const std::array<int, D + 1>& coord) { view[coord] = f_view[coord]; });
+    op->modifyRHSForInternalBoundaryConditions(pinfo, u_view, view);
+  }
+  /**
+   * @brief Copy a solution from a scratch buffer
+   *
+   * @param buffer pointer to the start of the patch in the buffer
+   * @param u_view the solution
+   */
+  void storePatch(double* buffer, const PatchView<double, D>& u_view) const
+  {
+    PatchView<double, D> view = PatchScratch::GetView<D>(buffer, this->getDomain().getNs());
+    Loop::OverInteriorIndexes<D + 1>(
+      u_view, [&](const std::array<int, D + 1>& coord) { u_view[coord] = view[coord]; });
+  }
+  /**
+   * @brief Divide transformed patches by the eigenvalues
+   *
+   * @param group the plan group
+   * @param buffer the transformed patches
+   * @param num_patches the number of patches in the buffer
+   */
+  void divideByEigenValues(const PlanGroup& group, double* buffer, int num_patches) const
+  {
+    const double* inv_eigen_vals = group.inv_eigen_vals.data();
+    for (int k = 0; k < num_patches; k++) {
+      double* patch = buffer + k * patch_size;
+      for (int i = 0; i < patch_size; i++) {
+        patch[i] *= inv_eigen_vals[i];
+      }
+    }
+  }
+  /**
+   * @brief Create a plan
+   *
+   * The plan is created with scratch buffers allocated by fftw_malloc, so it can be used with any
+   * other buffers allocated by fftw_malloc. The plan is first looked up in the FFTW wisdom, and is
+   * only planned from scratch (and counted in num_fresh_plans) if it is not found.
+   *
+   * @param num_patches the number of patches the plan transforms
+   * @param transforms the transform for each axis, in row-major order
+   * @return std::shared_ptr<fftw_plan> the plan
+   */
+  std::shared_ptr<fftw_plan> createPlan(int num_patches, std::array<fftw_r2r_kind, D> transforms)
+  {
+    // revers ns because FFTW is row major
+    std::array<int, D> ns_reversed;
+    for (size_t i = 0; i < D; i++) {
+      ns_reversed[D - 1 - i] = this->getDomain().getNs()[i];
+    }
+
+    double* in = fftw_alloc_real(num_patches * patch_size);
+    double* out = fftw_alloc_real(num_patches * patch_size);
+
+    auto plan_many = [&](unsigned flags) {
+      return fftw_plan_many_r2r(D,
+                                ns_reversed.data(),
+                                num_patches,
+                                in,
+                                nullptr,
+                                1,
+                                patch_size,
+                                out,
+                                nullptr,
+                                1,
+                                patch_size,
+                                transforms.data(),
+                                flags);
+    };
+    unsigned flags = getPlannerFlags() | FFTW_DESTROY_INPUT;
+    fftw_plan* plan = new fftw_plan();
+    *plan = nullptr;
+    if (rigor != FFTWPlanningRigor::Estimate) {
+      *plan = plan_many(flags | FFTW_WISDOM_ONLY);
+    }
+    if (*plan == nullptr) {
+      *plan = plan_many(flags);
+      if (rigor != FFTWPlanningRigor::Estimate) {
+        num_fresh_plans++;
+      }
+    }
+
+    fftw_free(in);
+    fftw_free(out);
+
+    return std::shared_ptr<fftw_plan>(plan, [](fftw_plan* plan) {
+      fftw_destroy_plan(*plan);
+      delete plan;
+    });
+  }
   /**
    * @brief Get an array of eigenvalues for a patch
    *
    * @param pinfo the patch
    * @return PatchArray<D> the eigen values
    */
-  PatchArray<D> getEigenValues(const PatchInfo<D>& pinfo)
+  PatchArray<D> getEigenValues(const PatchInfo<D>& pinfo) const
   {
     PatchArray<D> retval(this->getDomain().getNs(), 1, 0);
 
@@ -183,129 +472,352 @@ private:
     return retval;
   }
 
+  /**
+   * @brief Add a plan group for a patch, if there is not one already
+   *
+   * The plans of a new group are not created, see planGroup()
+   *
+   * @param pinfo the patch
+   * @return int the index of the group in groups
+   */
+  int addGroup(const PatchInfo<D>& pinfo)
+  {
+    PlanKey key = getKey(pinfo);
+    for (size_t i = 0; i < groups.size(); i++) {
+      if (groups[i].key == key) {
+        return i;
+      }
+    }
+
+    PlanGroup group;
+    group.key = key;
+
+    double scale = 1;
+    for (size_t axis = 0; axis < D; axis++) {
+      scale *= 2.0 * this->getDomain().getNs()[axis];
+    }
+    group.inv_eigen_vals.resize(patch_size);
+    PatchArray<D> eigen_vals = getEigenValues(pinfo);
+    PatchView<double, D> inv_view =
+      PatchScratch::GetView<D>(group.inv_eigen_vals.data(), this->getDomain().getNs());
+    Loop::OverInteriorIndexes<D + 1>(inv_view, [&](const std::array<int, D + 1>& coord) {
+      double eigen_val = eigen_vals[coord];
+      inv_view[coord] = (eigen_val == 0) ? 0 : 1 / (eigen_val * scale);
+    });
+
+    groups.push_back(group);
+    return groups.size() - 1;
+  }
+  /**
+   * @brief Create the plans for a group, the batched plans are only created if the group has local
+   * patches
+   *
+   * @param group the group
+   */
+  void planGroup(PlanGroup& group)
+  {
+    group.plan1 = createPlan(1, getTransforms(group.key.first));
+    group.plan2 = createPlan(1, getInverseTransforms(group.key.first));
+    int num_patches = group.local_indexes.size();
+    if (num_patches > 0) {
+      group.batch_plan1 = createPlan(num_patches, getTransforms(group.key.first));
+      group.batch_plan2 = createPlan(num_patches, getInverseTransforms(group.key.first));
+    }
+  }
+  /**
+   * @brief Get the FFTW planner flag for the planning rigor
+   */
+  unsigned getPlannerFlags() const
+  {
+    switch (rigor) {
+      case FFTWPlanningRigor::Estimate:
+        return FFTW_ESTIMATE;
+      case FFTWPlanningRigor::Patient:
+        return FFTW_PATIENT;
+      default:
+        return FFTW_MEASURE;
+    }
+  }
+  /**
+   * @brief Plan the single patch transforms that are needed by the ranks of the domain on rank 0,
+   * and broadcast the resulting FFTW wisdom to the other ranks
+   *
+   * Each transform is identified by the neumann sides of its group. Only single patch transforms
+   * are planned on rank 0, each rank plans its own batched transforms afterwards, so rank 0 does
+   * not have to plan a batch size for every rank. If there is a wisdom file, rank 0 imports it
+   * before planning, it may already contain the batched transforms of every rank.
+   *
+   * @param wisdom_file the wisdom file, can be empty
+   */
+  void shareWisdom(const std::string& wisdom_file)
+  {
+    MPI_Comm comm = this->getDomain().getCommunicator().getMPIComm();
+    int rank;
+    int size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // the neumann sides of each group
+    std::vector<unsigned long> problems;
+    for (const PlanGroup& group : groups) {
+      problems.push_back(group.key.first);
+    }
+
+    int num_problems = problems.size();
+    std::vector<int> counts(size);
+    MPI_Gather(&num_problems, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, comm);
+    std::vector<int> offsets(size + 1, 0);
+    for (int i = 0; i < size; i++) {
+      offsets[i + 1] = offsets[i] + counts[i];
+    }
+    std::vector<unsigned long> all_problems(offsets[size]);
+    MPI_Gatherv(problems.data(),
+                num_problems,
+                MPI_UNSIGNED_LONG,
+                all_problems.data(),
+                counts.data(),
+                offsets.data(),
+                MPI_UNSIGNED_LONG,
+                0,
+                comm);
+
+    std::string wisdom;
+    if (rank == 0) {
+      if (!wisdom_file.empty()) {
+        // a missing file is fine, it will be created
+        fftw_import_wisdom_from_filename(wisdom_file.c_str());
+      }
+      std::set<unsigned long> planned;
+      for (unsigned long problem : all_problems) {
+        if (planned.insert(problem).second) {
+          createPlan(1, getTransforms(problem));
+          createPlan(1, getInverseTransforms(problem));
+        }
+      }
+      char* wisdom_string = fftw_export_wisdom_to_string();
+      wisdom = wisdom_string;
+      free(wisdom_string);
+    }
+
+    int wisdom_size = wisdom.size();
+    MPI_Bcast(&wisdom_size, 1, MPI_INT, 0, comm);
+    wisdom.resize(wisdom_size);
+    MPI_Bcast(wisdom.data(), wisdom_size, MPI_CHAR, 0, comm);
+    if (rank != 0) {
+      fftw_import_wisdom_from_string(wisdom.c_str());
+    }
+  }
+  /**
+   * @brief Merge the FFTW wisdom of every rank on rank 0, and export it to the wisdom file
+   *
+   * This is called after every rank planned its batched transforms, so that the file contains all
+   * the plans that were used.
+   *
+   * @param wisdom_file the wisdom file
+   *
+   * @exception RuntimeError on every rank if the wisdom could not be written to the file
+   */
+  void saveWisdom(const std::string& wisdom_file) const
+  {
+    MPI_Comm comm = this->getDomain().getCommunicator().getMPIComm();
+    int rank;
+    int size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    char* wisdom_string = fftw_export_wisdom_to_string();
+    std::string wisdom = wisdom_string;
+    free(wisdom_string);
+
+    // include the null terminator, so that each rank's wisdom can be imported in place
+    int wisdom_size = wisdom.size() + 1;
+    std::vector<int> sizes(size);
+    MPI_Gather(&wisdom_size, 1, MPI_INT, sizes.data(), 1, MPI_INT, 0, comm);
+    std::vector<int> offsets(size + 1, 0);
+    for (int i = 0; i < size; i++) {
+      offsets[i + 1] = offsets[i] + sizes[i];
+    }
+    std::vector<char> all_wisdom(offsets[size]);
+    MPI_Gatherv(wisdom.c_str(),
+                wisdom_size,
+                MPI_CHAR,
+                all_wisdom.data(),
+                sizes.data(),
+                offsets.data(),
+                MPI_CHAR,
+                0,
+                comm);
+
+    int exported = 1;
+    if (rank == 0) {
+      for (int i = 1; i < size; i++) {
+        fftw_import_wisdom_from_string(all_wisdom.data() + offsets[i]);
+      }
+      exported = fftw_export_wisdom_to_filename(wisdom_file.c_str());
+    }
+
+    // let every rank know if the export failed, so that they all throw together
+    MPI_Bcast(&exported, 1, MPI_INT, 0, comm);
+    if (!exported) {
+      throw RuntimeError("FFTWPatchSolver could not write wisdom to " + wisdom_file);
+    }
+  }
+  /**
+   * @brief Solve all the local patches, a group at a time
+   *
+   * @param f the rhs
+   * @param u the solution, with ghost values filled
+   */
+  void solveAllPatches(const Vector<D>& f, Vector<D>& u) const
+  {
+    const std::vector<PatchInfo<D>>& pinfos = this->getDomain().getPatchInfoVector();
+    for (const PlanGroup& group : groups) {
+      int num_patches = group.local_indexes.size();
+      if (num_patches == 0) {
+        continue;
+      }
+      Scratch& scratch = getScratch(num_patches * patch_size);
+      for (int k = 0; k < num_patches; k++) {
+        int local_index = group.local_indexes[k];
+        loadPatch(pinfos[local_index],
+                  f.getPatchView(local_index),
+                  u.getPatchView(local_index),
+                  scratch.in + k * patch_size);
+      }
+
+      fftw_execute_r2r(*group.batch_plan1, scratch.in, scratch.out);
+      divideByEigenValues(group, scratch.out, num_patches);
+      fftw_execute_r2r(*group.batch_plan2, scratch.out, scratch.in);
+
+      for (int k = 0; k < num_patches; k++) {
+        int local_index = group.local_indexes[k];
+        storePatch(scratch.in + k * patch_size, u.getPatchView(local_index));
+      }
+    }
+  }
+
 public:
   /**
    * @brief Construct a new FftwPatchSolver object
    *
+   * If the options ask for the wisdom to be shared, this has to be called on every rank of the
+   * domain.
+   *
    * @param op the Poisson PatchOperator that cooresponds to this DftPatchSolver
    * @param neumann true if domain has neumann boundary conditions on a side
+   * @param opts the planning options
    */
-  FFTWPatchSolver(const PatchOperator<D>& op, std::bitset<Side<D>::number_of> neumann)
+  FFTWPatchSolver(const PatchOperator<D>& op,
+                  std::bitset<Side<D>::number_of> neumann,
+                  const FFTWPatchSolverOpts& opts = FFTWPatchSolverOpts())
     : PatchSolver<D>(op.getDomain(), op.getGhostFiller())
     , op(op.clone())
     , neumann(neumann)
+    , rigor(opts.planning_rigor)
   {
-    CompareFunction compare = [&](const PatchInfo<D>& a, const PatchInfo<D>& b) {
-      std::bitset<Side<D>::number_of> a_neumann;
-      std::bitset<Side<D>::number_of> b_neumann;
-      for (Side<D> s : Side<D>::getValues()) {
-        a_neumann[s.getIndex()] = patchIsNeumannOnSide(a, s);
-        b_neumann[s.getIndex()] = patchIsNeumannOnSide(b, s);
-      }
-      return std::forward_as_tuple(a_neumann.to_ulong(), a.spacings[0]) <
-             std::forward_as_tuple(b_neumann.to_ulong(), b.spacings[0]);
-    };
+    const Domain<D>& domain = this->getDomain();
+    if (domain.hasTimer()) {
+      domain.getTimer()->startDomainTiming(domain.getId(), "FFTWPatchSolver Setup");
+    }
 
-    plan1 = std::map<const PatchInfo<D>, std::shared_ptr<fftw_plan>, CompareFunction>(compare);
-    plan2 = std::map<const PatchInfo<D>, std::shared_ptr<fftw_plan>, CompareFunction>(compare);
-    eigen_vals = std::map<const PatchInfo<D>, PatchArray<D>, CompareFunction>(compare);
+    for (size_t axis = 0; axis < D; axis++) {
+      patch_size *= domain.getNs()[axis];
+    }
 
     // process patches
-    for (auto pinfo : this->getDomain().getPatchInfoVector()) {
-      addPatch(pinfo);
+    const std::vector<PatchInfo<D>>& pinfos = domain.getPatchInfoVector();
+    patch_groups.resize(pinfos.size());
+    for (const PatchInfo<D>& pinfo : pinfos) {
+      int group_index = addGroup(pinfo);
+      patch_groups[pinfo.local_index] = group_index;
+      groups[group_index].local_indexes.push_back(pinfo.local_index);
+    }
+
+    if (opts.share_wisdom || !opts.wisdom_file.empty()) {
+      shareWisdom(opts.wisdom_file);
+    }
+
+    for (PlanGroup& group : groups) {
+      planGroup(group);
+    }
+
+    if (!opts.wisdom_file.empty()) {
+      saveWisdom(opts.wisdom_file);
+    }
+
+    if (domain.hasTimer()) {
+      domain.getTimer()->stopDomainTiming(domain.getId(), "FFTWPatchSolver Setup");
     }
   }
   /**
    * @brief Clone this patch solver
    *
-   * @return FFTWPatchSolver<D>* a newly allocated copy of this patch solver
+   * @return FFTWPatchSolver<D>* a newly allocated copy of this patch solver, the plans are shared
    */
   FFTWPatchSolver<D>* clone() const override { return new FFTWPatchSolver<D>(*this); }
+  /**
+   * @brief Check if solveSinglePatch can be called from multiple threads at the same time
+   *
+   * @return true, the patches are solved in scratch buffers that are allocated once per thread
+   */
+  bool isThreadSafe() const override { return true; }
   void solveSinglePatch(const PatchInfo<D>& pinfo,
                         const PatchView<const double, D>& f_view,
                         const PatchView<double, D>& u_view) const override
   {
-    PatchArray<D> f_copy(pinfo.ns, 1, 0);
-    PatchArray<D> tmp(pinfo.ns, 1, 0);
-    PatchArray<D> sol(pinfo.ns, 1, 0);
+    const PlanGroup& group = groups[getGroupIndex(pinfo)];
+    Scratch& scratch = getScratch(patch_size);
 
-    Loop::OverInteriorIndexes<D + 1>(
-      f_copy, [&](std::array<int, D + 1> coord) { f_copy[coord] = f_view[coord]; });
-
-    op->modifyRHSForInternalBoundaryConditions(pinfo, u_view, f_copy.getView());
+    loadPatch(pinfo, f_view, u_view, scratch.in);
 
-    fftw_execute_r2r(*plan1.at(pinfo), &f_copy[f_copy.getStart()], &tmp[tmp.getStart()]);
-
-    const PatchArray<D>& eigen_vals_view = eigen_vals.at(pinfo);
-    Loop::OverInteriorIndexes<D + 1>(
-      tmp, [&](std::array<int, D + 1> coord) { tmp[coord] /= eigen_vals_view[coord]; });
+    fftw_execute_r2r(*group.plan1, scratch.in, scratch.out);
+    divideByEigenValues(group, scratch.out, 1);
+    fftw_execute_r2r(*group.plan2, scratch.out, scratch.in);
 
-    if (neumann.all() && !pinfo.hasNbr()) {
-      tmp[tmp.getStart()] = 0;
+    storePatch(scratch.in, u_view);
+  }
+  void apply(const Vector<D>& f, Vector<D>& u) const override
+  {
+    if (this->getDomain().hasTimer()) {
+      PatchSolver<D>::apply(f, u);
+    } else {
+      u.setWithGhost(0);
+      solveAllPatches(f, u);
     }
-
-    fftw_execute_r2r(*plan2.at(pinfo), &tmp[tmp.getStart()], &sol[sol.getStart()]);
-
-    double scale = 1;
-    for (size_t axis = 0; axis < D; axis++) {
-      scale *= 2.0 * this->getDomain().getNs()[axis];
+  }
+  void smooth(const Vector<D>& f, Vector<D>& u) const override
+  {
+    if (this->getDomain().hasTimer()) {
+      PatchSolver<D>::smooth(f, u);
+    } else {
+      this->getGhostFiller().fillGhost(u);
+      solveAllPatches(f, u);
     }
-    Loop::OverInteriorIndexes<D + 1>(
-      u_view, [&](std::array<int, D + 1> coord) { u_view[coord] = sol[coord] / scale; });
   }
   /**
    * @brief add a patch to the solver
    *
-   * This will calculate the necessary coefficients needed for the patch
+   * This will calculate the necessary coefficients needed for the patch. This is only needed for
+   * patches that are not in the Domain, for example when assembling a Schur complement matrix.
    *
    * @param pinfo the patch
    */
   void addPatch(const PatchInfo<D>& pinfo)
   {
-    if (plan1.count(pinfo) == 0) {
-      // revers ns because FFTW is row major
-      std::array<int, D> ns_reversed;
-      for (size_t i = 0; i < D; i++) {
-        ns_reversed[D - 1 - i] = pinfo.ns[i];
-      }
-      std::array<fftw_r2r_kind, D> transforms = getTransformsForPatch(pinfo);
-      std::array<fftw_r2r_kind, D> transforms_inv = getInverseTransformsForPatch(pinfo);
-
-      PatchArray<D> f_copy(pinfo.ns, 1, 0);
-      PatchArray<D> tmp(pinfo.ns, 1, 0);
-      PatchArray<D> sol(pinfo.ns, 1, 0);
-
-      fftw_plan* fftw_plan1 = new fftw_plan();
-
-      *fftw_plan1 = fftw_plan_r2r(D,
-                                  ns_reversed.data(),
-                                  &f_copy[f_copy.getStart()],
-                                  &tmp[tmp.getStart()],
-                                  transforms.data(),
-                                  FFTW_MEASURE | FFTW_DESTROY_INPUT | FFTW_UNALIGNED);
-
-      plan1[pinfo] = std::shared_ptr<fftw_plan>(fftw_plan1, [](fftw_plan* plan) {
-        fftw_destroy_plan(*plan);
-        delete plan;
-      });
-
-      fftw_plan* fftw_plan2 = new fftw_plan();
-
-      *fftw_plan2 = fftw_plan_r2r(D,
-                                  ns_reversed.data(),
-                                  &tmp[tmp.getStart()],
-                                  &sol[sol.getStart()],
-                                  transforms_inv.data(),
-                                  FFTW_MEASURE | FFTW_DESTROY_INPUT | FFTW_UNALIGNED);
-
-      plan2[pinfo] = std::shared_ptr<fftw_plan>(fftw_plan2, [](fftw_plan* plan) {
-        fftw_destroy_plan(*plan);
-        delete plan;
-      });
-
-      eigen_vals.emplace(pinfo, getEigenValues(pinfo));
+    PlanGroup& group = groups[addGroup(pinfo)];
+    if (group.plan1 == nullptr) {
+      planGroup(group);
     }
   }
+  /**
+   * @brief Get the number of plans that this solver had to plan from scratch, because they were
+   * not found in the FFTW wisdom
+   *
+   * Plans made with the Estimate planning rigor are not counted, since they are not measured.
+   *
+   * @return int the number of plans
+   */
+  int getNumFreshPlans() const { return num_fresh_plans; }
   /**
    * @brief Get the neumann boundary conditions for this operator
    *
@@ -0,0 +1,118 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef THUNDEREGG_POISSON_FASTSCHURBLOCKCACHE_H
+#define THUNDEREGG_POISSON_FASTSCHURBLOCKCACHE_H
+/**
+ * @file
+ *
+ * @brief FastSchurBlockCache class
+ */
+#include <ThunderEgg/Face.h>
+#include <ThunderEgg/Schur/IfaceType.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+namespace ThunderEgg::Poisson {
+/**
+ * @brief A cache of the coefficient blocks used to form the Schur complement matrix
+ *
+ * FastSchurMatrixAssemble2D and FastSchurMatrixAssemble3D compute each distinct coefficient block
+ * with patch solves on a reference patch with a spacing of 1/n. A block only depends on the type
+ * of ghost filler, the number of cells n along a side of the patch, which sides of the patch have
+ * non-Dirichlet boundary conditions, the side of the patch that the affected interface is on, and
+ * the type of that interface. The blocks are stored before any flips or rotations are applied, so
+ * only unique blocks are kept.
+ *
+ * A cache can be shared between assemblies, for example across time steps or between levels that
+ * use the same patch size. It should only be shared between patch solvers that use the same
+ * operator.
+ *
+ * @tparam D the number of Cartesian dimensions
+ */
+template<int D>
+class FastSchurBlockCache
+{
+public:
+  /**
+   * @brief The key of a block.
+   *
+   * The ghost filler type name, the number of cells along a side of the patch, the non-Dirichlet
+   * boundary bits, the side of the affected interface, and the type of the affected interface.
+   */
+  using Key = std::tuple<std::string, int, unsigned long, Side<D>, Schur::IfaceType<D>>;
+
+private:
+  /**
+   * @brief Map from key to block of coefficients
+   */
+  std::map<Key, std::shared_ptr<const std::vector<double>>> blocks;
+
+public:
+  /**
+   * @brief Find a block in the cache
+   *
+   * @param key the key of the block
+   * @return std::shared_ptr<const std::vector<double>> the block, nullptr if it is not cached
+   */
+  std::shared_ptr<const std::vector<double>> find(const Key& key) const
+  {
+    auto iter = blocks.find(key);
+    if (iter == blocks.end()) {
+      return nullptr;
+    }
+    return iter->second;
+  }
+  /**
+   * @brief Add a block to the cache, replacing any block with the same key
+   *
+   * @param key the key of the block
+   * @param block the coefficients, in row major order
+   */
+  void insert(const Key& key, std::shared_ptr<const std::vector<double>> block)
+  {
+    blocks[key] = block;
+  }
+  /**
+   * @brief Get the number of blocks in the cache
+   */
+  size_t getNumBlocks() const { return blocks.size(); }
+  /**
+   * @brief Get the number of bytes used by the coefficients in the cache
+   */
+  size_t getNumBytes() const
+  {
+    size_t num_bytes = 0;
+    for (const auto& pair : blocks) {
+      num_bytes += pair.second->size() * sizeof(double);
+    }
+    return num_bytes;
+  }
+  /**
+   * @brief Remove all blocks from the cache
+   */
+  void clear() { blocks.clear(); }
+};
+extern template class FastSchurBlockCache<2>;
+extern template class FastSchurBlockCache<3>;
+} // namespace ThunderEgg::Poisson
+#endif
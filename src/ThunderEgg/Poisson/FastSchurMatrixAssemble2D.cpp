@@ -19,9 +19,14 @@
  ***************************************************************************/
 
 #include "FastSchurMatrixAssemble2D.h"
+#ifdef THUNDEREGG_PETSC_ENABLED
+#include "FastSchurMatrixFree.h"
+#endif
 #include <ThunderEgg/BiLinearGhostFiller.h>
 #include <ThunderEgg/BiQuadraticGhostFiller.h>
-#include <numeric>
+#include <algorithm>
+#include <functional>
+#include <tuple>
 #include <typeinfo>
 using namespace std;
 using namespace ThunderEgg;
@@ -412,71 +417,221 @@ FillBlockCoeffs(CoeffMap coeffs, const PatchInfo<2>& pinfo, Poisson::FFTWPatchSo
     }
   }
 }
+#ifdef THUNDEREGG_PETSC_ENABLED
+/**
+ * @brief Get the number of nonzero blocks in each of this rank's block rows of the matrix
+ *
+ * This visits the same (i, j) pairs as GetBlocks, so the counts are exact.
+ *
+ * @param iface_domain the InterfaceDomain
+ * @param d_nnz (output) the number of blocks in the diagonal portion of each block row
+ * @param o_nnz (output) the number of blocks in the off-diagonal portion of each block row
+ */
+void
+GetBlockNonzeros(const InterfaceDomain<2>& iface_domain,
+                 vector<PetscInt>& d_nnz,
+                 vector<PetscInt>& o_nnz)
+{
+  int num_local_ifaces = iface_domain.getNumLocalInterfaces();
+  d_nnz.assign(num_local_ifaces, 0);
+  o_nnz.assign(num_local_ifaces, 0);
+  if (num_local_ifaces == 0) {
+    return;
+  }
+  // the local interfaces have contiguous global indexes
+  auto first_iface = iface_domain.getInterfaces().front();
+  int start = first_iface->global_index - first_iface->local_index;
+  int end = start + num_local_ifaces;
+
+  vector<int> cols;
+  for (auto iface : iface_domain.getInterfaces()) {
+    cols.clear();
+    for (auto patch : iface->patches) {
+      const PatchIfaceInfo<2>& sinfo = *patch.piinfo;
+      for (Side<2> s : Side<2>::getValues()) {
+        if (sinfo.pinfo.hasNbr(s)) {
+          cols.push_back(sinfo.getIfaceInfo(s)->global_index);
+        }
+      }
+    }
+    sort(cols.begin(), cols.end());
+    cols.erase(unique(cols.begin(), cols.end()), cols.end());
+    for (int j : cols) {
+      if (j >= start && j < end) {
+        d_nnz[iface->local_index]++;
+      } else {
+        o_nnz[iface->local_index]++;
+      }
+    }
+  }
+}
+#endif
+/**
+ * @brief Write the coefficients of a block, with the i and/or j indexes flipped, into flipped
+ *
+ * @param n the number of rows and columns in the block
+ * @param flip_i true if the i indexes are flipped
+ * @param flip_j true if the j indexes are flipped
+ * @param orig the original coefficients
+ * @param flipped (output) the flipped coefficients
+ */
+void
+FlipBlock(int n, bool flip_i, bool flip_j, const vector<double>& orig, vector<double>& flipped)
+{
+  for (int i = 0; i < n; i++) {
+    int orig_i = flip_i ? n - i - 1 : i;
+    for (int j = 0; j < n; j++) {
+      int orig_j = flip_j ? n - j - 1 : j;
+      flipped[i * n + j] = orig[orig_i * n + orig_j];
+    }
+  }
+}
+/**
+ * @brief Wrap an inserter of blocks so that it can be passed to assembleMatrix
+ *
+ * The blocks arrive grouped by coefficients and flips, so the last flipped copy of the
+ * coefficients is reused until either changes.
+ *
+ * @tparam BlockInserter has the arguments (int block_i, int block_j, const double* block), the
+ * block is in row-major order
+ * @param n the number of cells along a side of the patch
+ * @param insertBlock the BlockInserter
+ * @return the Inserter for assembleMatrix
+ */
+template<class BlockInserter>
+auto
+GetFlippingInserter(int n, BlockInserter insertBlock)
+{
+  return [n,
+          insertBlock,
+          flipped = vector<double>(n * n),
+          flipped_orig = (const vector<double>*)nullptr,
+          flipped_i = false,
+          flipped_j = false](const Block& block,
+                             const shared_ptr<const vector<double>>& coeffs) mutable {
+    const double* values = coeffs->data();
+    if (block.flip_i || block.flip_j) {
+      if (flipped_orig != coeffs.get() || flipped_i != block.flip_i ||
+          flipped_j != block.flip_j) {
+        FlipBlock(n, block.flip_i, block.flip_j, *coeffs, flipped);
+        flipped_orig = coeffs.get();
+        flipped_i = block.flip_i;
+        flipped_j = block.flip_j;
+      }
+      values = flipped.data();
+    }
+    insertBlock(block.i, block.j, values);
+  };
+}
+/**
+ * @brief Get the key of a block's coefficients in the FastSchurBlockCache
+ *
+ * @param ghost_filler_name the name of the ghost filler type
+ * @param n the number of cells along a side of the patch
+ * @param block the block
+ * @return FastSchurBlockCache<2>::Key the key
+ */
+Poisson::FastSchurBlockCache<2>::Key
+GetCacheKey(const string& ghost_filler_name, int n, const Block& block)
+{
+  return make_tuple(
+    ghost_filler_name, n, block.non_dirichlet_boundary.to_ulong(), block.s, block.type);
+}
 /**
  * @brief Assemble the matrix
  *
  * @tparam Inserter has the follow arguments
- *  (int block_i, int block_j, shared_ptr<vector<double>> block, bool flip_i, bool flip_j)
+ *  (const Block& block, const shared_ptr<const vector<double>>& coeffs)
+ *  the coefficients are not flipped yet
  * @param iface_domain the InterfaceDomain
  * @param solver the PatchSolver
+ * @param cache the cache of coefficients, any missing coefficients are computed and added
  * @param insertBlock the Inserter
  */
 template<class Inserter>
 void
 assembleMatrix(const InterfaceDomain<2>& iface_domain,
                Poisson::FFTWPatchSolver<2>& solver,
+               Poisson::FastSchurBlockCache<2>& cache,
                Inserter insertBlock)
 {
   auto ns = iface_domain.getDomain().getNs();
   int n = ns[0];
+  const GhostFiller<2>& gf = solver.getGhostFiller();
+  string ghost_filler_name = typeid(gf).name();
+
+  using BlockCompare = std::function<bool(const Block& a, const Block& b)>;
+  auto compare = [](const Block& a, const Block& b) {
+    return std::tie(a.s, a.type) < std::tie(b.s, b.type);
+  };
 
   for (const set<Block>& blocks : GetBlocks(iface_domain, solver.getNeumann())) {
-    // create domain representing curr_type
-    PatchInfo<2> pinfo;
-    pinfo.setNbrInfo(Side<2>::west(), new NormalNbrInfo<1>());
-    pinfo.num_ghost_cells = 1;
-    auto piinfo = make_shared<PatchIfaceInfo<2>>(pinfo);
-    pinfo.ns.fill(n);
-    pinfo.spacings.fill(1.0 / n);
-    piinfo->setIfaceInfo(Side<2>::west(), make_shared<NormalIfaceInfo<2>>(pinfo, Side<2>::west()));
-
-    for (Side<2> s : Side<2>::getValues()) {
-      if (!blocks.begin()->non_dirichlet_boundary[s.getIndex()]) {
-        pinfo.setNbrInfo(s, new NormalNbrInfo<1>());
+    // coefficients are grouped by block's side and type
+    map<Block, shared_ptr<const vector<double>>, BlockCompare> coeffs(compare);
+    // the coefficients that are not in the cache yet
+    map<Block, shared_ptr<vector<double>>, BlockCompare> new_coeffs(compare);
+
+    for (const Block& b : blocks) {
+      shared_ptr<const vector<double>>& ptr = coeffs[b];
+      if (ptr == nullptr) {
+        ptr = cache.find(GetCacheKey(ghost_filler_name, n, b));
+        if (ptr == nullptr) {
+          auto new_ptr = make_shared<vector<double>>(n * n);
+          new_coeffs[b] = new_ptr;
+          ptr = new_ptr;
+        }
       }
     }
 
-    solver.addPatch(pinfo);
+    if (!new_coeffs.empty()) {
+      // create domain representing curr_type
+      PatchInfo<2> pinfo;
+      pinfo.setNbrInfo(Side<2>::west(), new NormalNbrInfo<1>());
+      pinfo.num_ghost_cells = 1;
+      pinfo.ns.fill(n);
+      pinfo.spacings.fill(1.0 / n);
 
-    std::vector<std::shared_ptr<PatchIfaceInfo<2>>> single_domain;
-    single_domain.push_back(piinfo);
+      for (Side<2> s : Side<2>::getValues()) {
+        if (!blocks.begin()->non_dirichlet_boundary[s.getIndex()]) {
+          pinfo.setNbrInfo(s, new NormalNbrInfo<1>());
+        }
+      }
 
-    // coefficients are grouped by block's side and type
-    map<Block, shared_ptr<vector<double>>, std::function<bool(const Block& a, const Block& b)>>
-      coeffs([](const Block& a, const Block& b) {
-        return std::tie(a.s, a.type) < std::tie(b.s, b.type);
-      });
+      solver.addPatch(pinfo);
 
-    // allocate blocks of coefficients
-    for (const Block& b : blocks) {
-      shared_ptr<vector<double>> ptr = coeffs[b];
-      if (ptr.get() == nullptr) {
-        coeffs[b] = shared_ptr<vector<double>>(new vector<double>(n * n));
+      FillBlockCoeffs(new_coeffs, pinfo, solver);
+
+      for (const auto& pair : new_coeffs) {
+        cache.insert(GetCacheKey(ghost_filler_name, n, pair.first), pair.second);
       }
     }
 
-    FillBlockCoeffs(coeffs, pinfo, solver);
+    // order the blocks so that blocks sharing coefficients and flips are inserted together, that
+    // way each flipped copy of the coefficients only has to be formed once
+    vector<pair<shared_ptr<const vector<double>>, Block>> ordered_blocks;
+    ordered_blocks.reserve(blocks.size());
+    for (const Block& block : blocks) {
+      ordered_blocks.emplace_back(coeffs[block], block);
+    }
+    sort(ordered_blocks.begin(),
+         ordered_blocks.end(),
+         [](const pair<shared_ptr<const vector<double>>, Block>& a,
+            const pair<shared_ptr<const vector<double>>, Block>& b) {
+           return std::make_tuple(a.first.get(), a.second.flip_i, a.second.flip_j) <
+                  std::make_tuple(b.first.get(), b.second.flip_i, b.second.flip_j);
+         });
 
     // now insert these results into the matrix for each interface
-    for (Block block : blocks) {
-      insertBlock(block.i, block.j, coeffs[block], block.flip_i, block.flip_j);
+    for (const auto& pair : ordered_blocks) {
+      insertBlock(pair.second, pair.first);
     }
   }
 }
-} // namespace
-Mat
-ThunderEgg::Poisson::FastSchurMatrixAssemble2D(const InterfaceDomain<2>& iface_domain,
-                                               Poisson::FFTWPatchSolver<2>& solver)
+/**
+ * @brief Throw an exception if the InterfaceDomain or PatchSolver are not supported
+ */
+void
+CheckSupported(const InterfaceDomain<2>& iface_domain, Poisson::FFTWPatchSolver<2>& solver)
 {
   array<int, 2> ns = iface_domain.getDomain().getNs();
   if (ns[0] != ns[1]) {
@@ -487,45 +642,117 @@ ThunderEgg::Poisson::FastSchurMatrixAssemble2D(const InterfaceDomain<2>& iface_d
     throw RuntimeError(
       "FastSchurMatrixAssembler2D only supports BiLinearGhostFiller and BiQuadraticGhostFiller");
   }
-  int n = ns[0];
+}
+/**
+ * @brief Get the global index of the first interface on this rank
+ */
+int
+GetFirstGlobalIndex(const InterfaceDomain<2>& iface_domain)
+{
+  if (iface_domain.getNumLocalInterfaces() == 0) {
+    return 0;
+  }
+  // the local interfaces have contiguous global indexes
+  auto first_iface = iface_domain.getInterfaces().front();
+  return first_iface->global_index - first_iface->local_index;
+}
+} // namespace
+#ifdef THUNDEREGG_PETSC_ENABLED
+Mat
+ThunderEgg::Poisson::FastSchurMatrixAssemble2D(const InterfaceDomain<2>& iface_domain,
+                                               Poisson::FFTWPatchSolver<2>& solver,
+                                               MatType type)
+{
+  Poisson::FastSchurBlockCache<2> cache;
+  return FastSchurMatrixAssemble2D(iface_domain, solver, cache, type);
+}
+Mat
+ThunderEgg::Poisson::FastSchurMatrixAssemble2D(const InterfaceDomain<2>& iface_domain,
+                                               Poisson::FFTWPatchSolver<2>& solver,
+                                               Poisson::FastSchurBlockCache<2>& cache,
+                                               MatType type)
+{
+  CheckSupported(iface_domain, solver);
+  int n = iface_domain.getDomain().getNs()[0];
   Mat A;
-  MatCreate(MPI_COMM_WORLD, &A);
+  MatCreate(iface_domain.getDomain().getCommunicator().getMPIComm(), &A);
   int local_size = iface_domain.getNumLocalInterfaces() * n;
   int global_size = iface_domain.getNumGlobalInterfaces() * n;
   MatSetSizes(A, local_size, local_size, global_size, global_size);
-  MatSetType(A, MATMPIAIJ);
-  MatMPIAIJSetPreallocation(A, 19 * n, nullptr, 19 * n, nullptr);
-
-  auto insertBlock =
-    [&](int block_i, int block_j, shared_ptr<vector<double>> block, bool flip_i, bool flip_j) {
-      int matrix_i = block_i * n;
-      int matrix_j = block_j * n;
-
-      vector<double>& orig = *block;
-      vector<double> copy(n * n);
-      for (int i = 0; i < n; i++) {
-        int orig_i = i;
-        if (flip_i) {
-          orig_i = n - i - 1;
-        }
-        for (int j = 0; j < n; j++) {
-          int orig_j = j;
-          if (flip_j) {
-            orig_j = n - j - 1;
-          }
-          copy[i * n + j] = orig[orig_i * n + orig_j];
-        }
-      }
-      vector<int> inds_i(n);
-      iota(inds_i.begin(), inds_i.end(), matrix_i);
-      vector<int> inds_j(n);
-      iota(inds_j.begin(), inds_j.end(), matrix_j);
+  MatSetType(A, type);
+
+  vector<PetscInt> d_nnz;
+  vector<PetscInt> o_nnz;
+  GetBlockNonzeros(iface_domain, d_nnz, o_nnz);
+  MatXAIJSetPreallocation(A, n, d_nnz.data(), o_nnz.data(), nullptr, nullptr);
 
-      MatSetValues(A, n, &inds_i[0], n, &inds_j[0], &copy[0], ADD_VALUES);
-    };
+  auto insertBlock = [&](PetscInt block_i, PetscInt block_j, const double* block) {
+    MatSetValuesBlocked(A, 1, &block_i, 1, &block_j, block, ADD_VALUES);
+  };
 
-  assembleMatrix(iface_domain, solver, insertBlock);
+  assembleMatrix(iface_domain, solver, cache, GetFlippingInserter(n, insertBlock));
   MatAssemblyBegin(A, MAT_FINAL_ASSEMBLY);
   MatAssemblyEnd(A, MAT_FINAL_ASSEMBLY);
   return A;
 }
+Mat
+ThunderEgg::Poisson::FastSchurMatrixFree2D(const InterfaceDomain<2>& iface_domain,
+                                           Poisson::FFTWPatchSolver<2>& solver,
+                                           Poisson::FastSchurBlockCache<2>& cache)
+{
+  CheckSupported(iface_domain, solver);
+  int n = iface_domain.getDomain().getNs()[0];
+  Poisson::FastSchurMatrixFree matrix(iface_domain.getDomain().getCommunicator(),
+                                      n,
+                                      GetFirstGlobalIndex(iface_domain),
+                                      iface_domain.getNumLocalInterfaces(),
+                                      iface_domain.getNumGlobalInterfaces());
+
+  auto reversed = make_shared<vector<int>>(n);
+  for (int i = 0; i < n; i++) {
+    (*reversed)[i] = n - i - 1;
+  }
+  Poisson::FastSchurMatrixFree::Permutation flip = reversed;
+
+  auto addBlock = [&](const Block& block, const shared_ptr<const vector<double>>& coeffs) {
+    matrix.addBlock(block.i,
+                    block.j,
+                    coeffs,
+                    block.flip_i ? flip : nullptr,
+                    block.flip_j ? flip : nullptr);
+  };
+
+  assembleMatrix(iface_domain, solver, cache, addBlock);
+  return matrix.getMat();
+}
+#endif
+SparseMatrix<1>
+ThunderEgg::Poisson::FastSchurSparseMatrixAssemble2D(const InterfaceDomain<2>& iface_domain,
+                                                     Poisson::FFTWPatchSolver<2>& solver)
+{
+  Poisson::FastSchurBlockCache<2> cache;
+  return FastSchurSparseMatrixAssemble2D(iface_domain, solver, cache);
+}
+SparseMatrix<1>
+ThunderEgg::Poisson::FastSchurSparseMatrixAssemble2D(const InterfaceDomain<2>& iface_domain,
+                                                     Poisson::FFTWPatchSolver<2>& solver,
+                                                     Poisson::FastSchurBlockCache<2>& cache)
+{
+  CheckSupported(iface_domain, solver);
+  int n = iface_domain.getDomain().getNs()[0];
+  // the interface vectors have no ghost cells, so the whole interface is one block
+  SparseMatrix<1> A(iface_domain.getDomain().getCommunicator(),
+                    { n },
+                    1,
+                    iface_domain.getNumLocalInterfaces(),
+                    0,
+                    n);
+
+  auto insertBlock = [&](int block_i, int block_j, const double* block) {
+    A.addBlock(block_i, block_j, block);
+  };
+
+  assembleMatrix(iface_domain, solver, cache, GetFlippingInserter(n, insertBlock));
+  A.assemble();
+  return A;
+}
@@ -19,8 +19,14 @@
  ***************************************************************************/
 
 #include "FastSchurMatrixAssemble3D.h"
+#ifdef THUNDEREGG_PETSC_ENABLED
+#include "FastSchurMatrixFree.h"
+#endif
 #include <ThunderEgg/MPIGhostFiller.h>
 #include <ThunderEgg/TriLinearGhostFiller.h>
+#include <algorithm>
+#include <functional>
+#include <tuple>
 using namespace std;
 using namespace ThunderEgg;
 using namespace ThunderEgg::Schur;
@@ -204,6 +210,32 @@ const char Block::rot_quad_lookup_right[4][4] = { { 0, 1, 2, 3 },
                                                   { 3, 2, 1, 0 },
                                                   { 1, 3, 0, 2 } };
 const char Block::quad_flip_lookup[4] = { 1, 0, 3, 2 };
+/**
+ * @brief Determines how the rows and columns of a block's coefficients are transformed before
+ * being inserted into the matrix
+ */
+using TransformKey = tuple<bool, bool, unsigned char, bool, bool, unsigned char>;
+/**
+ * @brief Get the TransformKey for a block
+ */
+TransformKey
+GetTransformKey(const Block& b)
+{
+  return make_tuple(sideIsLeftOriented(b.main),
+                    b.mainFlipped(),
+                    b.main_rotation,
+                    sideIsLeftOriented(b.aux),
+                    b.auxFlipped(),
+                    b.aux_rotation);
+}
+/**
+ * @brief true if the coefficients of a block can be inserted into the matrix as is
+ */
+bool
+HasIdentityTransform(const Block& b)
+{
+  return !b.mainFlipped() && b.main_rotation == 0 && !b.auxFlipped() && b.aux_rotation == 0;
+}
 
 /**
  * @brief Get the view for the buffer
@@ -511,49 +543,6 @@ FillBlockCoeffs(CoeffMap coeffs, const PatchInfo<3>& pinfo, Poisson::FFTWPatchSo
     }
   }
 }
-template<class Inserter>
-void
-AssembleMatrix(const Schur::InterfaceDomain<3>& iface_domain,
-               Poisson::FFTWPatchSolver<3>& solver,
-               Inserter insertBlock)
-{
-  auto ns = iface_domain.getDomain().getNs();
-  int n = ns[0];
-
-  for (const set<Block>& blocks : GetBlocks(iface_domain, solver.getNeumann())) {
-    // create domain representing curr_type
-    PatchInfo<3> pinfo;
-    pinfo.setNbrInfo(Side<3>::west(), new NormalNbrInfo<2>());
-    pinfo.ns.fill(n);
-    pinfo.spacings.fill(1.0 / n);
-    pinfo.num_ghost_cells = 1;
-    for (Side<3> s : Side<3>::getValues()) {
-      if (!blocks.begin()->non_dirichlet_boundary[s.getIndex()]) {
-        pinfo.setNbrInfo(s, new NormalNbrInfo<2>());
-      }
-    }
-    solver.addPatch(pinfo);
-
-    map<Block, shared_ptr<vector<double>>, std::function<bool(const Block& a, const Block& b)>>
-      coeffs([](const Block& a, const Block& b) {
-        return std::tie(a.aux, a.type) < std::tie(b.aux, b.type);
-      });
-    // allocate blocks of coefficients
-    for (const Block& b : blocks) {
-      shared_ptr<vector<double>> ptr = coeffs[b];
-      if (ptr.get() == nullptr) {
-        coeffs[b] = shared_ptr<vector<double>>(new vector<double>(n * n * n * n));
-      }
-    }
-
-    FillBlockCoeffs(coeffs, pinfo, solver);
-
-    // now insert these results into the matrix for each interface
-    for (Block block : blocks) {
-      insertBlock(block, coeffs[block]);
-    }
-  }
-}
 const function<int(int, int, int)> transforms_left[4] = {
   [](int n, int xi, int yi) { return xi + yi * n; },
   [](int n, int xi, int yi) { return n - yi - 1 + xi * n; },
@@ -638,33 +627,237 @@ GetRowTransform(const Block& b)
   }
   return row_trans;
 }
-vector<double>
-FlipBlock(int n, const Block& b, const vector<double>& orig)
+/**
+ * @brief Get the index permutation for a transform
+ *
+ * @param n the number of cells along a side of the interface
+ * @param trans the transform
+ * @return vector<int> the original index for each transformed index
+ */
+vector<int>
+GetPermutation(int n, const function<int(int, int, int)>& trans)
+{
+  vector<int> perm(n * n);
+  for (int yi = 0; yi < n; yi++) {
+    for (int xi = 0; xi < n; xi++) {
+      perm[xi + yi * n] = trans(n, xi, yi);
+    }
+  }
+  return perm;
+}
+/**
+ * @brief Write the coefficients of a block, with its rows and columns transformed, into flipped
+ *
+ * @param n the number of cells along a side of the interface
+ * @param b the block
+ * @param orig the original coefficients
+ * @param flipped (output) the transformed coefficients
+ */
+void
+FlipBlock(int n, const Block& b, const vector<double>& orig, vector<double>& flipped)
+{
+  vector<int> col_perm = GetPermutation(n, GetColTransform(b));
+  vector<int> row_perm = GetPermutation(n, GetRowTransform(b));
+
+  int block_n = n * n;
+  for (int i_dest = 0; i_dest < block_n; i_dest++) {
+    const double* orig_row = &orig[row_perm[i_dest] * block_n];
+    double* flipped_row = &flipped[i_dest * block_n];
+    for (int j_dest = 0; j_dest < block_n; j_dest++) {
+      flipped_row[j_dest] = orig_row[col_perm[j_dest]];
+    }
+  }
+}
+#ifdef THUNDEREGG_PETSC_ENABLED
+/**
+ * @brief Get the number of nonzero blocks in each of this rank's block rows of the matrix
+ *
+ * This visits the same (i, j) pairs as GetBlocks, so the counts are exact.
+ *
+ * @param iface_domain the InterfaceDomain
+ * @param d_nnz (output) the number of blocks in the diagonal portion of each block row
+ * @param o_nnz (output) the number of blocks in the off-diagonal portion of each block row
+ */
+void
+GetBlockNonzeros(const InterfaceDomain<3>& iface_domain,
+                 vector<PetscInt>& d_nnz,
+                 vector<PetscInt>& o_nnz)
 {
-  vector<double> copy(n * n * n * n);
-  function<int(int, int, int)> col_trans = GetColTransform(b);
-  function<int(int, int, int)> row_trans = GetRowTransform(b);
-
-  for (int row_yi = 0; row_yi < n; row_yi++) {
-    for (int row_xi = 0; row_xi < n; row_xi++) {
-      int i_dest = row_xi + row_yi * n;
-      int i_orig = row_trans(n, row_xi, row_yi);
-      for (int col_yi = 0; col_yi < n; col_yi++) {
-        for (int col_xi = 0; col_xi < n; col_xi++) {
-          int j_dest = col_xi + col_yi * n;
-          int j_orig = col_trans(n, col_xi, col_yi);
-
-          copy[i_dest * n * n + j_dest] = orig[i_orig * n * n + j_orig];
+  int num_local_ifaces = iface_domain.getNumLocalInterfaces();
+  d_nnz.assign(num_local_ifaces, 0);
+  o_nnz.assign(num_local_ifaces, 0);
+  if (num_local_ifaces == 0) {
+    return;
+  }
+  // the local interfaces have contiguous global indexes
+  auto first_iface = iface_domain.getInterfaces().front();
+  int start = first_iface->global_index - first_iface->local_index;
+  int end = start + num_local_ifaces;
+
+  vector<int> cols;
+  for (auto iface : iface_domain.getInterfaces()) {
+    cols.clear();
+    for (auto patch : iface->patches) {
+      const PatchIfaceInfo<3>& sinfo = *patch.piinfo;
+      for (Side<3> s : Side<3>::getValues()) {
+        if (sinfo.pinfo.hasNbr(s)) {
+          cols.push_back(sinfo.getIfaceInfo(s)->global_index);
         }
       }
     }
+    sort(cols.begin(), cols.end());
+    cols.erase(unique(cols.begin(), cols.end()), cols.end());
+    for (int j : cols) {
+      if (j >= start && j < end) {
+        d_nnz[iface->local_index]++;
+      } else {
+        o_nnz[iface->local_index]++;
+      }
+    }
   }
-  return copy;
 }
-} // namespace
-Mat
-ThunderEgg::Poisson::FastSchurMatrixAssemble3D(const Schur::InterfaceDomain<3>& iface_domain,
-                                               Poisson::FFTWPatchSolver<3>& solver)
+#endif
+/**
+ * @brief Wrap an inserter of blocks so that it can be passed to AssembleMatrix
+ *
+ * The blocks arrive grouped by coefficients and transforms, so the last transformed copy of the
+ * coefficients is reused until either changes.
+ *
+ * @tparam BlockInserter has the arguments (int block_i, int block_j, const double* block), the
+ * block is in row-major order
+ * @param n the number of cells along a side of the patch
+ * @param insertBlock the BlockInserter
+ * @return the Inserter for AssembleMatrix
+ */
+template<class BlockInserter>
+auto
+GetTransformingInserter(int n, BlockInserter insertBlock)
+{
+  return [n,
+          insertBlock,
+          flipped = vector<double>(n * n * n * n),
+          flipped_orig = (const vector<double>*)nullptr,
+          flipped_key = TransformKey()](const Block& block,
+                                        const shared_ptr<const vector<double>>& coeffs) mutable {
+    const double* values = coeffs->data();
+    if (!HasIdentityTransform(block)) {
+      TransformKey key = GetTransformKey(block);
+      if (flipped_orig != coeffs.get() || flipped_key != key) {
+        FlipBlock(n, block, *coeffs, flipped);
+        flipped_orig = coeffs.get();
+        flipped_key = key;
+      }
+      values = flipped.data();
+    }
+    insertBlock(block.i, block.j, values);
+  };
+}
+/**
+ * @brief Get the key of a block's coefficients in the FastSchurBlockCache
+ *
+ * @param ghost_filler_name the name of the ghost filler type
+ * @param n the number of cells along a side of the patch
+ * @param block the block
+ * @return FastSchurBlockCache<3>::Key the key
+ */
+Poisson::FastSchurBlockCache<3>::Key
+GetCacheKey(const string& ghost_filler_name, int n, const Block& block)
+{
+  return make_tuple(
+    ghost_filler_name, n, block.non_dirichlet_boundary.to_ulong(), block.aux, block.type);
+}
+/**
+ * @brief Assemble the matrix
+ *
+ * @tparam Inserter has the follow arguments
+ *  (const Block& block, const shared_ptr<const vector<double>>& coeffs)
+ *  the coefficients are not transformed yet
+ * @param iface_domain the InterfaceDomain
+ * @param solver the PatchSolver
+ * @param cache the cache of coefficients, any missing coefficients are computed and added
+ * @param insertBlock the Inserter
+ */
+template<class Inserter>
+void
+AssembleMatrix(const Schur::InterfaceDomain<3>& iface_domain,
+               Poisson::FFTWPatchSolver<3>& solver,
+               Poisson::FastSchurBlockCache<3>& cache,
+               Inserter insertBlock)
+{
+  auto ns = iface_domain.getDomain().getNs();
+  int n = ns[0];
+  const GhostFiller<3>& gf = solver.getGhostFiller();
+  string ghost_filler_name = typeid(gf).name();
+
+  using BlockCompare = std::function<bool(const Block& a, const Block& b)>;
+  auto compare = [](const Block& a, const Block& b) {
+    return std::tie(a.aux, a.type) < std::tie(b.aux, b.type);
+  };
+
+  for (const set<Block>& blocks : GetBlocks(iface_domain, solver.getNeumann())) {
+    map<Block, shared_ptr<const vector<double>>, BlockCompare> coeffs(compare);
+    // the coefficients that are not in the cache yet
+    map<Block, shared_ptr<vector<double>>, BlockCompare> new_coeffs(compare);
+
+    for (const Block& b : blocks) {
+      shared_ptr<const vector<double>>& ptr = coeffs[b];
+      if (ptr == nullptr) {
+        ptr = cache.find(GetCacheKey(ghost_filler_name, n, b));
+        if (ptr == nullptr) {
+          auto new_ptr = make_shared<vector<double>>(n * n * n * n);
+          new_coeffs[b] = new_ptr;
+          ptr = new_ptr;
+        }
+      }
+    }
+
+    if (!new_coeffs.empty()) {
+      // create domain representing curr_type
+      PatchInfo<3> pinfo;
+      pinfo.setNbrInfo(Side<3>::west(), new NormalNbrInfo<2>());
+      pinfo.ns.fill(n);
+      pinfo.spacings.fill(1.0 / n);
+      pinfo.num_ghost_cells = 1;
+      for (Side<3> s : Side<3>::getValues()) {
+        if (!blocks.begin()->non_dirichlet_boundary[s.getIndex()]) {
+          pinfo.setNbrInfo(s, new NormalNbrInfo<2>());
+        }
+      }
+      solver.addPatch(pinfo);
+
+      FillBlockCoeffs(new_coeffs, pinfo, solver);
+
+      for (const auto& pair : new_coeffs) {
+        cache.insert(GetCacheKey(ghost_filler_name, n, pair.first), pair.second);
+      }
+    }
+
+    // order the blocks so that blocks sharing coefficients and transforms are inserted together,
+    // that way each transformed copy of the coefficients only has to be formed once
+    vector<pair<shared_ptr<const vector<double>>, Block>> ordered_blocks;
+    ordered_blocks.reserve(blocks.size());
+    for (const Block& block : blocks) {
+      ordered_blocks.emplace_back(coeffs[block], block);
+    }
+    sort(ordered_blocks.begin(),
+         ordered_blocks.end(),
+         [](const pair<shared_ptr<const vector<double>>, Block>& a,
+            const pair<shared_ptr<const vector<double>>, Block>& b) {
+           return std::make_tuple(a.first.get(), GetTransformKey(a.second)) <
+                  std::make_tuple(b.first.get(), GetTransformKey(b.second));
+         });
+
+    // now insert these results into the matrix for each interface
+    for (const auto& pair : ordered_blocks) {
+      insertBlock(pair.second, pair.first);
+    }
+  }
+}
+/**
+ * @brief Throw an exception if the InterfaceDomain or PatchSolver are not supported
+ */
+void
+CheckSupported(const Schur::InterfaceDomain<3>& iface_domain, Poisson::FFTWPatchSolver<3>& solver)
 {
   auto ns = iface_domain.getDomain().getNs();
   if (ns[0] != ns[1] && ns[0] != ns[2]) {
@@ -674,31 +867,122 @@ ThunderEgg::Poisson::FastSchurMatrixAssemble3D(const Schur::InterfaceDomain<3>&
   if (typeid(gf) != typeid(TriLinearGhostFiller)) {
     throw RuntimeError("FastSchurMatrixAssemble3D only supports TriLinearGhostFiller");
   }
+}
+/**
+ * @brief Get the global index of the first interface on this rank
+ */
+int
+GetFirstGlobalIndex(const InterfaceDomain<3>& iface_domain)
+{
+  if (iface_domain.getNumLocalInterfaces() == 0) {
+    return 0;
+  }
+  // the local interfaces have contiguous global indexes
+  auto first_iface = iface_domain.getInterfaces().front();
+  return first_iface->global_index - first_iface->local_index;
+}
+} // namespace
+#ifdef THUNDEREGG_PETSC_ENABLED
+Mat
+ThunderEgg::Poisson::FastSchurMatrixAssemble3D(const Schur::InterfaceDomain<3>& iface_domain,
+                                               Poisson::FFTWPatchSolver<3>& solver,
+                                               MatType type)
+{
+  Poisson::FastSchurBlockCache<3> cache;
+  return FastSchurMatrixAssemble3D(iface_domain, solver, cache, type);
+}
+Mat
+ThunderEgg::Poisson::FastSchurMatrixAssemble3D(const Schur::InterfaceDomain<3>& iface_domain,
+                                               Poisson::FFTWPatchSolver<3>& solver,
+                                               Poisson::FastSchurBlockCache<3>& cache,
+                                               MatType type)
+{
+  CheckSupported(iface_domain, solver);
   Mat A;
-  MatCreate(MPI_COMM_WORLD, &A);
-  int n = ns[0];
+  MatCreate(iface_domain.getDomain().getCommunicator().getMPIComm(), &A);
+  int n = iface_domain.getDomain().getNs()[0];
   int local_size = iface_domain.getNumLocalInterfaces() * n * n;
   int global_size = iface_domain.getNumGlobalInterfaces() * n * n;
   MatSetSizes(A, local_size, local_size, global_size, global_size);
-  MatSetType(A, MATMPIAIJ);
-  MatMPIAIJSetPreallocation(A, 26 * n * n, nullptr, 26 * n * n, nullptr);
-
-  auto insertBlock = [&](const Block& b, shared_ptr<vector<double>> coeffs) {
-    int global_i = b.i * n * n;
-    int global_j = b.j * n * n;
+  MatSetType(A, type);
 
-    vector<double> copy = FlipBlock(n, b, *coeffs);
+  vector<PetscInt> d_nnz;
+  vector<PetscInt> o_nnz;
+  GetBlockNonzeros(iface_domain, d_nnz, o_nnz);
+  MatXAIJSetPreallocation(A, n * n, d_nnz.data(), o_nnz.data(), nullptr, nullptr);
 
-    vector<int> inds_i(n * n);
-    iota(inds_i.begin(), inds_i.end(), global_i);
-    vector<int> inds_j(n * n);
-    iota(inds_j.begin(), inds_j.end(), global_j);
-
-    MatSetValues(A, n * n, &inds_i[0], n * n, &inds_j[0], &copy[0], ADD_VALUES);
+  auto insertBlock = [&](PetscInt block_i, PetscInt block_j, const double* block) {
+    MatSetValuesBlocked(A, 1, &block_i, 1, &block_j, block, ADD_VALUES);
   };
 
-  AssembleMatrix(iface_domain, solver, insertBlock);
+  AssembleMatrix(iface_domain, solver, cache, GetTransformingInserter(n, insertBlock));
   MatAssemblyBegin(A, MAT_FINAL_ASSEMBLY);
   MatAssemblyEnd(A, MAT_FINAL_ASSEMBLY);
   return A;
-}
\ No newline at end of file
+}
+Mat
+ThunderEgg::Poisson::FastSchurMatrixFree3D(const Schur::InterfaceDomain<3>& iface_domain,
+                                           Poisson::FFTWPatchSolver<3>& solver,
+                                           Poisson::FastSchurBlockCache<3>& cache)
+{
+  CheckSupported(iface_domain, solver);
+  int n = iface_domain.getDomain().getNs()[0];
+  Poisson::FastSchurMatrixFree matrix(iface_domain.getDomain().getCommunicator(),
+                                      n * n,
+                                      GetFirstGlobalIndex(iface_domain),
+                                      iface_domain.getNumLocalInterfaces(),
+                                      iface_domain.getNumGlobalInterfaces());
+
+  // the permutations are shared by all blocks with the same transform
+  using Permutation = Poisson::FastSchurMatrixFree::Permutation;
+  map<TransformKey, pair<Permutation, Permutation>> perms;
+
+  auto addBlock = [&](const Block& block, const shared_ptr<const vector<double>>& coeffs) {
+    if (HasIdentityTransform(block)) {
+      matrix.addBlock(block.i, block.j, coeffs, nullptr, nullptr);
+    } else {
+      TransformKey key = GetTransformKey(block);
+      auto iter = perms.find(key);
+      if (iter == perms.end()) {
+        auto row_perm = make_shared<const vector<int>>(GetPermutation(n, GetRowTransform(block)));
+        auto col_perm = make_shared<const vector<int>>(GetPermutation(n, GetColTransform(block)));
+        iter = perms.emplace(key, make_pair(row_perm, col_perm)).first;
+      }
+      matrix.addBlock(block.i, block.j, coeffs, iter->second.first, iter->second.second);
+    }
+  };
+
+  AssembleMatrix(iface_domain, solver, cache, addBlock);
+  return matrix.getMat();
+}
+#endif
+SparseMatrix<2>
+ThunderEgg::Poisson::FastSchurSparseMatrixAssemble3D(const Schur::InterfaceDomain<3>& iface_domain,
+                                                     Poisson::FFTWPatchSolver<3>& solver)
+{
+  Poisson::FastSchurBlockCache<3> cache;
+  return FastSchurSparseMatrixAssemble3D(iface_domain, solver, cache);
+}
+SparseMatrix<2>
+ThunderEgg::Poisson::FastSchurSparseMatrixAssemble3D(const Schur::InterfaceDomain<3>& iface_domain,
+                                                     Poisson::FFTWPatchSolver<3>& solver,
+                                                     Poisson::FastSchurBlockCache<3>& cache)
+{
+  CheckSupported(iface_domain, solver);
+  int n = iface_domain.getDomain().getNs()[0];
+  // the interface vectors have no ghost cells, so the whole interface is one block
+  SparseMatrix<2> A(iface_domain.getDomain().getCommunicator(),
+                    { n, n },
+                    1,
+                    iface_domain.getNumLocalInterfaces(),
+                    0,
+                    n * n);
+
+  auto insertBlock = [&](int block_i, int block_j, const double* block) {
+    A.addBlock(block_i, block_j, block);
+  };
+
+  AssembleMatrix(iface_domain, solver, cache, GetTransformingInserter(n, insertBlock));
+  A.assemble();
+  return A;
+}
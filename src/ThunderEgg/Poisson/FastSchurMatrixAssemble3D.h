@@ -25,22 +25,96 @@
  *
  * @brief FastSchurMatrixAssemble3D class
  */
+#include <ThunderEgg/Config.h>
 #include <ThunderEgg/Poisson/FFTWPatchSolver.h>
+#include <ThunderEgg/Poisson/FastSchurBlockCache.h>
 #include <ThunderEgg/Schur/InterfaceDomain.h>
+#include <ThunderEgg/SparseMatrix.h>
+#ifdef THUNDEREGG_PETSC_ENABLED
 #include <petscmat.h>
+#endif
 namespace ThunderEgg::Poisson {
+#ifdef THUNDEREGG_PETSC_ENABLED
 /**
  * @brief A fast algorithm for forming the Schur compliment matrix
  *
  * Currently this algorithm only supports the FFTWPatchSolver and it has to use
  * TriLinearGhostFiller
  *
+ * The matrix has a block size of n*n, where n is the number of cells along a patch's side, and is
+ * preallocated with the exact block nonzero pattern of the InterfaceDomain.
+ *
  * @param iface_domain the interface domain to form the schur compliment matrix for
  * @param solver the patch solver to use for the formation
+ * @param type the PETSc matrix type, MATBAIJ by default. MATAIJ can be used for preconditioners
+ * that require it.
+ * @return Mat the PETSc matrix, user is responsible for destroying
+ */
+Mat
+FastSchurMatrixAssemble3D(const Schur::InterfaceDomain<3>& iface_domain,
+                          Poisson::FFTWPatchSolver<3>& solver,
+                          MatType type = MATBAIJ);
+/**
+ * @brief A fast algorithm for forming the Schur compliment matrix, with a cache of coefficients
+ *
+ * Same as the version without a cache, except that the blocks of coefficients are looked up in,
+ * and added to, the cache. Passing the same cache to later assemblies avoids the patch solves for
+ * the blocks that were already computed.
+ *
+ * @param iface_domain the interface domain to form the Schur compliment matrix for
+ * @param solver the patch solver to use for the formation
+ * @param cache the cache of coefficients
+ * @param type the PETSc matrix type, MATBAIJ by default. MATAIJ can be used for preconditioners
+ * that require it.
  * @return Mat the PETSc matrix, user is responsible for destroying
  */
 Mat
 FastSchurMatrixAssemble3D(const Schur::InterfaceDomain<3>& iface_domain,
-                          Poisson::FFTWPatchSolver<3>& solver);
+                          Poisson::FFTWPatchSolver<3>& solver,
+                          FastSchurBlockCache<3>& cache,
+                          MatType type = MATBAIJ);
+/**
+ * @brief Form a matrix-free version of the Schur compliment matrix
+ *
+ * The matrix is a PETSc MATSHELL that only supports MatMult. Instead of storing each block of the
+ * matrix, it refers to the unique blocks of coefficients in the cache and applies the rotations and
+ * flips on the fly. The same restrictions as FastSchurMatrixAssemble3D apply.
+ *
+ * @param iface_domain the interface domain to form the Schur compliment matrix for
+ * @param solver the patch solver to use for the formation
+ * @param cache the cache of coefficients, any missing coefficients are computed and added
+ * @return Mat the PETSc matrix, user is responsible for destroying
+ */
+Mat
+FastSchurMatrixFree3D(const Schur::InterfaceDomain<3>& iface_domain,
+                      Poisson::FFTWPatchSolver<3>& solver,
+                      FastSchurBlockCache<3>& cache);
+#endif
+/**
+ * @brief A fast algorithm for forming the Schur compliment matrix as a SparseMatrix
+ *
+ * This is the same as FastSchurMatrixAssemble3D but does not require PETSc. The matrix has a block
+ * size of n*n, and can be applied to the vectors of the InterfaceDomain.
+ *
+ * @param iface_domain the interface domain to form the Schur compliment matrix for
+ * @param solver the patch solver to use for the formation
+ * @return SparseMatrix<2> the assembled matrix
+ */
+SparseMatrix<2>
+FastSchurSparseMatrixAssemble3D(const Schur::InterfaceDomain<3>& iface_domain,
+                                Poisson::FFTWPatchSolver<3>& solver);
+/**
+ * @brief A fast algorithm for forming the Schur compliment matrix as a SparseMatrix, with a cache
+ * of coefficients
+ *
+ * @param iface_domain the interface domain to form the Schur compliment matrix for
+ * @param solver the patch solver to use for the formation
+ * @param cache the cache of coefficients, any missing coefficients are computed and added
+ * @return SparseMatrix<2> the assembled matrix
+ */
+SparseMatrix<2>
+FastSchurSparseMatrixAssemble3D(const Schur::InterfaceDomain<3>& iface_domain,
+                                Poisson::FFTWPatchSolver<3>& solver,
+                                FastSchurBlockCache<3>& cache);
 } // namespace ThunderEgg::Poisson
 #endif
@@ -0,0 +1,237 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include <ThunderEgg/Poisson/FastSchurMatrixFree.h>
+#include <ThunderEgg/RuntimeError.h>
+#include <algorithm>
+#include <set>
+using namespace std;
+using namespace ThunderEgg;
+using namespace ThunderEgg::Poisson;
+namespace {
+/**
+ * @brief The context of the MATSHELL
+ */
+struct ShellContext
+{
+  /**
+   * @brief A block with its column translated to a position in x_cols
+   */
+  struct Entry
+  {
+    int local_row;
+    int col_slot;
+    const double* coeffs;
+    const int* row_perm;
+    const int* col_perm;
+  };
+  /**
+   * @brief the number of rows and columns in each block
+   */
+  int block_size;
+  /**
+   * @brief the blocks, sorted by row, the coefficients are kept alive by this
+   */
+  vector<FastSchurMatrixFree::Block> blocks;
+  /**
+   * @brief the blocks with their columns translated
+   */
+  vector<Entry> entries;
+  /**
+   * @brief the values of the columns referenced on this rank
+   */
+  Vec x_cols;
+  /**
+   * @brief scatter from the global vector to x_cols
+   */
+  VecScatter scatter;
+  /**
+   * @brief work arrays
+   */
+  vector<double> x_perm;
+  vector<double> y_block;
+
+  /**
+   * @brief Compute y += A x for this rank's rows
+   *
+   * @param x_cols_ptr the values of the referenced columns
+   * @param y_ptr this rank's portion of the output
+   */
+  void apply(const double* x_cols_ptr, double* y_ptr)
+  {
+    int bs = block_size;
+    for (const Entry& entry : entries) {
+      const double* x = x_cols_ptr + entry.col_slot * bs;
+      if (entry.col_perm != nullptr) {
+        for (int c = 0; c < bs; c++) {
+          x_perm[entry.col_perm[c]] = x[c];
+        }
+        x = x_perm.data();
+      }
+      double* y = y_ptr + entry.local_row * bs;
+      // with a row permutation the product goes through y_block first
+      double* y_out = y;
+      if (entry.row_perm != nullptr) {
+        fill(y_block.begin(), y_block.end(), 0.0);
+        y_out = y_block.data();
+      }
+      for (int r = 0; r < bs; r++) {
+        const double* row = entry.coeffs + r * bs;
+        double sum = 0;
+        for (int c = 0; c < bs; c++) {
+          sum += row[c] * x[c];
+        }
+        y_out[r] += sum;
+      }
+      if (entry.row_perm != nullptr) {
+        for (int r = 0; r < bs; r++) {
+          y[r] += y_block[entry.row_perm[r]];
+        }
+      }
+    }
+  }
+};
+PetscErrorCode
+ShellMult(Mat A, Vec x, Vec y)
+{
+  ShellContext* ctx;
+  MatShellGetContext(A, &ctx);
+
+  VecScatterBegin(ctx->scatter, x, ctx->x_cols, INSERT_VALUES, SCATTER_FORWARD);
+  VecScatterEnd(ctx->scatter, x, ctx->x_cols, INSERT_VALUES, SCATTER_FORWARD);
+
+  VecSet(y, 0);
+  const PetscScalar* x_cols_ptr;
+  VecGetArrayRead(ctx->x_cols, &x_cols_ptr);
+  PetscScalar* y_ptr;
+  VecGetArray(y, &y_ptr);
+
+  ctx->apply(x_cols_ptr, y_ptr);
+
+  VecRestoreArray(y, &y_ptr);
+  VecRestoreArrayRead(ctx->x_cols, &x_cols_ptr);
+  return 0;
+}
+PetscErrorCode
+ShellDestroy(Mat A)
+{
+  ShellContext* ctx;
+  MatShellGetContext(A, &ctx);
+  VecScatterDestroy(&ctx->scatter);
+  VecDestroy(&ctx->x_cols);
+  delete ctx;
+  return 0;
+}
+} // namespace
+FastSchurMatrixFree::FastSchurMatrixFree(const Communicator& comm,
+                                         int block_size,
+                                         int first_block_row,
+                                         int num_local_block_rows,
+                                         int num_global_block_rows)
+  : comm(comm)
+  , block_size(block_size)
+  , first_block_row(first_block_row)
+  , num_local_block_rows(num_local_block_rows)
+  , num_global_block_rows(num_global_block_rows)
+{}
+void
+FastSchurMatrixFree::addBlock(int i,
+                              int j,
+                              shared_ptr<const vector<double>> coeffs,
+                              Permutation row_perm,
+                              Permutation col_perm)
+{
+  if (i < first_block_row || i >= first_block_row + num_local_block_rows) {
+    throw RuntimeError("FastSchurMatrixFree block row is not on this rank");
+  }
+  if ((int)coeffs->size() != block_size * block_size) {
+    throw RuntimeError("FastSchurMatrixFree block has the wrong number of coefficients");
+  }
+  blocks.push_back({ i, j, coeffs, row_perm, col_perm });
+}
+const vector<FastSchurMatrixFree::Block>&
+FastSchurMatrixFree::getBlocks() const
+{
+  return blocks;
+}
+size_t
+FastSchurMatrixFree::getNumCoeffBytes() const
+{
+  set<const vector<double>*> distinct_coeffs;
+  for (const Block& block : blocks) {
+    distinct_coeffs.insert(block.coeffs.get());
+  }
+  size_t num_bytes = 0;
+  for (const vector<double>* coeffs : distinct_coeffs) {
+    num_bytes += coeffs->size() * sizeof(double);
+  }
+  return num_bytes;
+}
+Mat
+FastSchurMatrixFree::getMat() const
+{
+  ShellContext* ctx = new ShellContext();
+  ctx->block_size = block_size;
+  ctx->blocks = blocks;
+  stable_sort(ctx->blocks.begin(), ctx->blocks.end(), [](const Block& a, const Block& b) {
+    return a.i < b.i;
+  });
+  ctx->x_perm.resize(block_size);
+  ctx->y_block.resize(block_size);
+
+  // the columns referenced on this rank, each gets a slot in x_cols
+  vector<PetscInt> cols;
+  cols.reserve(blocks.size());
+  for (const Block& block : blocks) {
+    cols.push_back(block.j);
+  }
+  sort(cols.begin(), cols.end());
+  cols.erase(unique(cols.begin(), cols.end()), cols.end());
+
+  ctx->entries.reserve(ctx->blocks.size());
+  for (const Block& block : ctx->blocks) {
+    ShellContext::Entry entry;
+    entry.local_row = block.i - first_block_row;
+    entry.col_slot = (int)(lower_bound(cols.begin(), cols.end(), block.j) - cols.begin());
+    entry.coeffs = block.coeffs->data();
+    entry.row_perm = block.row_perm == nullptr ? nullptr : block.row_perm->data();
+    entry.col_perm = block.col_perm == nullptr ? nullptr : block.col_perm->data();
+    ctx->entries.push_back(entry);
+  }
+
+  int local_size = num_local_block_rows * block_size;
+  int global_size = num_global_block_rows * block_size;
+
+  Vec x;
+  VecCreateMPI(comm.getMPIComm(), local_size, global_size, &x);
+  VecCreateSeq(PETSC_COMM_SELF, (PetscInt)cols.size() * block_size, &ctx->x_cols);
+  IS col_is;
+  ISCreateBlock(
+    PETSC_COMM_SELF, block_size, (PetscInt)cols.size(), cols.data(), PETSC_COPY_VALUES, &col_is);
+  VecScatterCreate(x, col_is, ctx->x_cols, nullptr, &ctx->scatter);
+  ISDestroy(&col_is);
+  VecDestroy(&x);
+
+  Mat A;
+  MatCreateShell(comm.getMPIComm(), local_size, local_size, global_size, global_size, ctx, &A);
+  MatShellSetOperation(A, MATOP_MULT, (void (*)(void))ShellMult);
+  MatShellSetOperation(A, MATOP_DESTROY, (void (*)(void))ShellDestroy);
+  return A;
+}
@@ -0,0 +1,151 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef THUNDEREGG_POISSON_FASTSCHURMATRIXFREE_H
+#define THUNDEREGG_POISSON_FASTSCHURMATRIXFREE_H
+/**
+ * @file
+ *
+ * @brief FastSchurMatrixFree class
+ */
+#include <ThunderEgg/Communicator.h>
+#include <memory>
+#include <petscmat.h>
+#include <vector>
+namespace ThunderEgg::Poisson {
+/**
+ * @brief A Schur complement matrix that is applied from blocks of coefficients instead of being
+ * assembled
+ *
+ * Each block of the matrix refers to a shared block of coefficients, along with optional
+ * permutations of its rows and columns. A block of coefficients that appears many times in the
+ * matrix, possibly flipped or rotated, is only stored once.
+ *
+ * The block at block row i and block column j of the matrix has the entries
+ * coeffs[row_perm[r] * block_size + col_perm[c]] for r, c in [0, block_size).
+ */
+class FastSchurMatrixFree
+{
+public:
+  /**
+   * @brief A permutation of the rows or columns of a block, nullptr for the identity
+   */
+  using Permutation = std::shared_ptr<const std::vector<int>>;
+  /**
+   * @brief A block of the matrix
+   */
+  struct Block
+  {
+    /**
+     * @brief the global block row
+     */
+    int i;
+    /**
+     * @brief the global block column
+     */
+    int j;
+    /**
+     * @brief the coefficients, in row major order
+     */
+    std::shared_ptr<const std::vector<double>> coeffs;
+    /**
+     * @brief the permutation of the rows of the coefficients
+     */
+    Permutation row_perm;
+    /**
+     * @brief the permutation of the columns of the coefficients
+     */
+    Permutation col_perm;
+  };
+
+private:
+  /**
+   * @brief the communicator
+   */
+  Communicator comm;
+  /**
+   * @brief the number of rows and columns in each block
+   */
+  int block_size;
+  /**
+   * @brief the first global block row on this rank
+   */
+  int first_block_row;
+  /**
+   * @brief the number of block rows on this rank
+   */
+  int num_local_block_rows;
+  /**
+   * @brief the number of block rows globally
+   */
+  int num_global_block_rows;
+  /**
+   * @brief the blocks in this rank's rows
+   */
+  std::vector<Block> blocks;
+
+public:
+  /**
+   * @brief Construct a new FastSchurMatrixFree object with no blocks
+   *
+   * @param comm the communicator
+   * @param block_size the number of rows and columns in each block
+   * @param first_block_row the first global block row on this rank
+   * @param num_local_block_rows the number of block rows on this rank
+   * @param num_global_block_rows the number of block rows globally
+   */
+  FastSchurMatrixFree(const Communicator& comm,
+                      int block_size,
+                      int first_block_row,
+                      int num_local_block_rows,
+                      int num_global_block_rows);
+  /**
+   * @brief Add a block to the matrix, blocks in the same position are summed
+   *
+   * @param i the global block row, has to be on this rank
+   * @param j the global block column
+   * @param coeffs the coefficients, in row major order
+   * @param row_perm the permutation of the rows of the coefficients, nullptr for the identity
+   * @param col_perm the permutation of the columns of the coefficients, nullptr for the identity
+   */
+  void addBlock(int i,
+                int j,
+                std::shared_ptr<const std::vector<double>> coeffs,
+                Permutation row_perm,
+                Permutation col_perm);
+  /**
+   * @brief Get the blocks that have been added on this rank
+   */
+  const std::vector<Block>& getBlocks() const;
+  /**
+   * @brief Get the number of bytes used by the distinct blocks of coefficients on this rank
+   */
+  size_t getNumCoeffBytes() const;
+  /**
+   * @brief Create a PETSc MATSHELL that applies the matrix
+   *
+   * The blocks are copied into the shell's context. Only MatMult is supported.
+   *
+   * @return Mat the PETSc matrix, user is responsible for destroying
+   */
+  Mat getMat() const;
+};
+} // namespace ThunderEgg::Poisson
+#endif
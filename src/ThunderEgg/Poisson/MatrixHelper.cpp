@@ -19,6 +19,7 @@
  ***************************************************************************/
 
 #include <ThunderEgg/Poisson/MatrixHelper.h>
+#include <ThunderEgg/Poisson/MatrixRowAssembler.h>
 #include <valarray>
 using namespace std;
 using namespace ThunderEgg;
@@ -590,11 +591,13 @@ getStencilHelper(const PatchInfo<3>& pinfo, Side<3> s, std::bitset<6> neumann)
 /**
  * @brief Add the the center coefficients to the Matrix
  *
- * @param A the matrix
+ * @tparam Inserter has the arguments (int row, int size, const int* cols, const double* coeffs)
+ * @param insert the Inserter
  * @param pinfo the patch we are processing
  */
+template<class Inserter>
 static void
-addCenterCoefficients(Mat A, const PatchInfo<3>& pinfo)
+addCenterCoefficients(Inserter& insert, const PatchInfo<3>& pinfo)
 {
   int nx = pinfo.ns[0];
   int ny = pinfo.ns[1];
@@ -609,7 +612,7 @@ addCenterCoefficients(Mat A, const PatchInfo<3>& pinfo)
     for (int y_i = 0; y_i < ny; y_i++) {
       for (int x_i = 0; x_i < nx; x_i++) {
         int row = start + x_i + nx * y_i + nx * ny * z_i;
-        MatSetValues(A, 1, &row, 1, &row, &coeff, ADD_VALUES);
+        insert(row, 1, &row, &coeff);
       }
     }
   }
@@ -618,11 +621,13 @@ addCenterCoefficients(Mat A, const PatchInfo<3>& pinfo)
  * @brief Add the the west coefficients to the Matrix
  * will not add ghost coefficients
  *
- * @param A the matrix
+ * @tparam Inserter has the arguments (int row, int size, const int* cols, const double* coeffs)
+ * @param insert the Inserter
  * @param pinfo the patch we are processing
  */
+template<class Inserter>
 static void
-addWestCoefficients(Mat A, const PatchInfo<3>& pinfo)
+addWestCoefficients(Inserter& insert, const PatchInfo<3>& pinfo)
 {
   int nx = pinfo.ns[0];
   int ny = pinfo.ns[1];
@@ -636,7 +641,7 @@ addWestCoefficients(Mat A, const PatchInfo<3>& pinfo)
       for (int x_i = 1; x_i < nx; x_i++) {
         int row = start + x_i + nx * y_i + nx * ny * z_i;
         int col = start + x_i - 1 + nx * y_i + nx * ny * z_i;
-        MatSetValues(A, 1, &row, 1, &col, &coeff, ADD_VALUES);
+        insert(row, 1, &col, &coeff);
       }
     }
   }
@@ -645,11 +650,13 @@ addWestCoefficients(Mat A, const PatchInfo<3>& pinfo)
  * @brief Add the the east coefficients to the Matrix
  * will not add ghost coefficients
  *
- * @param A the matrix
+ * @tparam Inserter has the arguments (int row, int size, const int* cols, const double* coeffs)
+ * @param insert the Inserter
  * @param pinfo the patch we are processing
  */
+template<class Inserter>
 static void
-addEastCoefficients(Mat A, const PatchInfo<3>& pinfo)
+addEastCoefficients(Inserter& insert, const PatchInfo<3>& pinfo)
 {
   int nx = pinfo.ns[0];
   int ny = pinfo.ns[1];
@@ -663,7 +670,7 @@ addEastCoefficients(Mat A, const PatchInfo<3>& pinfo)
       for (int x_i = 0; x_i < nx - 1; x_i++) {
         int row = start + x_i + nx * y_i + nx * ny * z_i;
         int col = start + x_i + 1 + nx * y_i + nx * ny * z_i;
-        MatSetValues(A, 1, &row, 1, &col, &coeff, ADD_VALUES);
+        insert(row, 1, &col, &coeff);
       }
     }
   }
@@ -672,11 +679,13 @@ addEastCoefficients(Mat A, const PatchInfo<3>& pinfo)
  * @brief Add the the north coefficients to the Matrix
  * will not add ghost coefficients
  *
- * @param A the matrix
+ * @tparam Inserter has the arguments (int row, int size, const int* cols, const double* coeffs)
+ * @param insert the Inserter
  * @param pinfo the patch we are processing
  */
+template<class Inserter>
 static void
-addNorthCoefficients(Mat A, const PatchInfo<3>& pinfo)
+addNorthCoefficients(Inserter& insert, const PatchInfo<3>& pinfo)
 {
   int nx = pinfo.ns[0];
   int ny = pinfo.ns[1];
@@ -690,7 +699,7 @@ addNorthCoefficients(Mat A, const PatchInfo<3>& pinfo)
       for (int x_i = 0; x_i < nx; x_i++) {
         int row = start + x_i + nx * y_i + nx * ny * z_i;
         int col = start + x_i + nx * (y_i + 1) + nx * ny * z_i;
-        MatSetValues(A, 1, &row, 1, &col, &coeff, ADD_VALUES);
+        insert(row, 1, &col, &coeff);
       }
     }
   }
@@ -699,11 +708,13 @@ addNorthCoefficients(Mat A, const PatchInfo<3>& pinfo)
  * @brief Add the the south coefficients to the Matrix
  * will not add ghost coefficients
  *
- * @param A the matrix
+ * @tparam Inserter has the arguments (int row, int size, const int* cols, const double* coeffs)
+ * @param insert the Inserter
  * @param pinfo the patch we are processing
  */
+template<class Inserter>
 static void
-addSouthCoefficients(Mat A, const PatchInfo<3>& pinfo)
+addSouthCoefficients(Inserter& insert, const PatchInfo<3>& pinfo)
 {
   int nx = pinfo.ns[0];
   int ny = pinfo.ns[1];
@@ -717,7 +728,7 @@ addSouthCoefficients(Mat A, const PatchInfo<3>& pinfo)
       for (int x_i = 0; x_i < nx; x_i++) {
         int row = start + x_i + nx * y_i + nx * ny * z_i;
         int col = start + x_i + nx * (y_i - 1) + nx * ny * z_i;
-        MatSetValues(A, 1, &row, 1, &col, &coeff, ADD_VALUES);
+        insert(row, 1, &col, &coeff);
       }
     }
   }
@@ -726,11 +737,13 @@ addSouthCoefficients(Mat A, const PatchInfo<3>& pinfo)
  * @brief Add the the top coefficients to the Matrix
  * will not add ghost coefficients
  *
- * @param A the matrix
+ * @tparam Inserter has the arguments (int row, int size, const int* cols, const double* coeffs)
+ * @param insert the Inserter
  * @param pinfo the patch we are processing
  */
+template<class Inserter>
 static void
-addTopCoefficients(Mat A, const PatchInfo<3>& pinfo)
+addTopCoefficients(Inserter& insert, const PatchInfo<3>& pinfo)
 {
   int nx = pinfo.ns[0];
   int ny = pinfo.ns[1];
@@ -744,7 +757,7 @@ addTopCoefficients(Mat A, const PatchInfo<3>& pinfo)
       for (int x_i = 0; x_i < nx; x_i++) {
         int row = start + x_i + nx * y_i + nx * ny * z_i;
         int col = start + x_i + nx * y_i + nx * ny * (z_i + 1);
-        MatSetValues(A, 1, &row, 1, &col, &coeff, ADD_VALUES);
+        insert(row, 1, &col, &coeff);
       }
     }
   }
@@ -753,11 +766,13 @@ addTopCoefficients(Mat A, const PatchInfo<3>& pinfo)
  * @brief Add the the bottom coefficients to the Matrix
  * will not add ghost coefficients
  *
- * @param A the matrix
+ * @tparam Inserter has the arguments (int row, int size, const int* cols, const double* coeffs)
+ * @param insert the Inserter
  * @param pinfo the patch we are processing
  */
+template<class Inserter>
 static void
-addBottomCoefficients(Mat A, const PatchInfo<3>& pinfo)
+addBottomCoefficients(Inserter& insert, const PatchInfo<3>& pinfo)
 {
   int nx = pinfo.ns[0];
   int ny = pinfo.ns[1];
@@ -771,11 +786,68 @@ addBottomCoefficients(Mat A, const PatchInfo<3>& pinfo)
       for (int x_i = 0; x_i < nx; x_i++) {
         int row = start + x_i + nx * y_i + nx * ny * z_i;
         int col = start + x_i + nx * y_i + nx * ny * (z_i - 1);
-        MatSetValues(A, 1, &row, 1, &col, &coeff, ADD_VALUES);
+        insert(row, 1, &col, &coeff);
       }
     }
   }
 }
+/**
+ * @brief Add the coefficients of a patch's rows
+ *
+ * @tparam Inserter has the arguments (int row, int size, const int* cols, const double* coeffs)
+ * @param pinfo the patch we are processing
+ * @param neumann the boundary conditions
+ * @param insert the Inserter
+ */
+template<class Inserter>
+static void
+addCoefficients(const PatchInfo<3>& pinfo, std::bitset<6> neumann, Inserter& insert)
+{
+  addCenterCoefficients(insert, pinfo);
+  addWestCoefficients(insert, pinfo);
+  addEastCoefficients(insert, pinfo);
+  addNorthCoefficients(insert, pinfo);
+  addSouthCoefficients(insert, pinfo);
+  addTopCoefficients(insert, pinfo);
+  addBottomCoefficients(insert, pinfo);
+  // boundaries
+  for (Side<3> s : Side<3>::getValues()) {
+    unique_ptr<StencilHelper> sh = getStencilHelper(pinfo, s, neumann);
+    for (int yi = 0; yi < sh->ny; yi++) {
+      for (int xi = 0; xi < sh->nx; xi++) {
+        int row = sh->row(xi, yi);
+        int size = sh->size(xi, yi);
+        const double* coeffs = sh->coeffs(xi, yi);
+        const int* cols = sh->cols(xi, yi);
+        insert(row, size, cols, coeffs);
+      }
+    }
+  }
+}
+/**
+ * @brief Gather the rows of the matrix on this rank, one patch at a time
+ *
+ * @param domain the domain
+ * @param neumann the boundary conditions
+ * @return MatrixRowAssembler the finished rows
+ */
+static MatrixRowAssembler
+assembleRows(const Domain<3>& domain, std::bitset<6> neumann)
+{
+  MatrixRowAssembler rows(domain);
+  auto insert = [&](int row, int size, const int* cols, const double* coeffs) {
+    rows.add(row, size, cols, coeffs);
+  };
+  int patch_size = domain.getNumCellsInPatch();
+  for (const PatchInfo<3>* pinfo : MatrixRowAssembler::getPatchesInRowOrder(domain)) {
+    rows.beginRows(pinfo->global_index * patch_size, patch_size);
+    addCoefficients(*pinfo, neumann, insert);
+    rows.endRows();
+  }
+  rows.finish();
+  return rows;
+}
+#ifdef THUNDEREGG_PETSC_ENABLED
 Mat
 MatrixHelper::formCRSMatrix()
 {
@@ -788,31 +860,19 @@ MatrixHelper::formCRSMatrix()
   int global_size = domain.getNumGlobalPatches() * nx * ny * nz;
   MatSetSizes(A, local_size, local_size, global_size, global_size);
   MatSetType(A, MATMPIAIJ);
-  MatMPIAIJSetPreallocation(A, 19, nullptr, 19, nullptr);
 
-  for (auto pinfo : domain.getPatchInfoVector()) {
-    addCenterCoefficients(A, pinfo);
-    addWestCoefficients(A, pinfo);
-    addEastCoefficients(A, pinfo);
-    addNorthCoefficients(A, pinfo);
-    addSouthCoefficients(A, pinfo);
-    addTopCoefficients(A, pinfo);
-    addBottomCoefficients(A, pinfo);
-    // boundaries
-    for (Side<3> s : Side<3>::getValues()) {
-      unique_ptr<StencilHelper> sh = getStencilHelper(pinfo, s, neumann);
-      for (int yi = 0; yi < sh->ny; yi++) {
-        for (int xi = 0; xi < sh->nx; xi++) {
-          int row = sh->row(xi, yi);
-          int size = sh->size(xi, yi);
-          const double* coeffs = sh->coeffs(xi, yi);
-          const int* cols = sh->cols(xi, yi);
-          MatSetValues(A, 1, &row, size, cols, coeffs, ADD_VALUES);
-        }
-      }
-    }
-  }
+  assembleRows(domain, neumann).insertInto(A);
+
   MatAssemblyBegin(A, MAT_FINAL_ASSEMBLY);
   MatAssemblyEnd(A, MAT_FINAL_ASSEMBLY);
   return A;
 }
+#endif
+SparseMatrix<3>
+MatrixHelper::formSparseMatrix()
+{
+  SparseMatrix<3> A(domain, 1);
+  assembleRows(domain, neumann).insertInto(A);
+  A.assemble();
+  return A;
+}
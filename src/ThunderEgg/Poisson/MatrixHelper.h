@@ -26,8 +26,12 @@
  * @brief MatrixHelper class
  */
 
+#include <ThunderEgg/Config.h>
 #include <ThunderEgg/Domain.h>
+#include <ThunderEgg/SparseMatrix.h>
+#ifdef THUNDEREGG_PETSC_ENABLED
 #include <petscmat.h>
+#endif
 
 namespace ThunderEgg::Poisson {
 /**
@@ -56,12 +60,20 @@ public:
    */
   explicit MatrixHelper(const Domain<3>& domain, std::bitset<6> neumann);
 
+#ifdef THUNDEREGG_PETSC_ENABLED
   /**
    * @brief Form the matrix for the domain
    *
    * @return the formed matrix
    */
   Mat formCRSMatrix();
+#endif
+  /**
+   * @brief Form the matrix for the domain as a SparseMatrix, this does not require PETSc
+   *
+   * @return SparseMatrix<3> the assembled matrix
+   */
+  SparseMatrix<3> formSparseMatrix();
 };
 } // namespace ThunderEgg::Poisson
 #endif
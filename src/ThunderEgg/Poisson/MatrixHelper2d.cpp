@@ -19,6 +19,7 @@
  ***************************************************************************/
 
 #include "MatrixHelper2d.h"
+#include <ThunderEgg/Poisson/MatrixRowAssembler.h>
 #include <iostream>
 #include <valarray>
 using namespace std;
@@ -441,7 +442,107 @@ getStencilHelper(const PatchInfo<2>& d, Side<2> s, std::bitset<4> neumann)
   }
   return retval;
 }
+/**
+ * @brief Add the coefficients of a patch's rows
+ *
+ * @tparam Inserter has the arguments (int row, int size, const int* cols, const double* coeffs),
+ * the coefficients are added to the row
+ * @param pinfo the patch
+ * @param neumann the boundary conditions
+ * @param lambda the constant that is added to the diagonal
+ * @param insert the Inserter
+ */
+template<class Inserter>
+void
+AddCoefficients(const PatchInfo<2>& pinfo, std::bitset<4> neumann, double lambda, Inserter& insert)
+{
+  int nx = pinfo.ns[0];
+  int ny = pinfo.ns[1];
+  double h_x = pinfo.spacings[0];
+  double h_y = pinfo.spacings[1];
+  int start = nx * ny * pinfo.global_index;
+
+  // center coeffs
+  double coeff = -2.0 / (h_x * h_x) - 2.0 / (h_y * h_y) + lambda;
+  for (int y_i = 0; y_i < ny; y_i++) {
+    for (int x_i = 0; x_i < nx; x_i++) {
+      int row = start + x_i + nx * y_i;
+      insert(row, 1, &row, &coeff);
+    }
+  }
+  // north coeffs
+  coeff = 1.0 / (h_y * h_y);
+  for (int y_i = 0; y_i < ny - 1; y_i++) {
+    for (int x_i = 0; x_i < nx; x_i++) {
+      int row = start + x_i + nx * y_i;
+      int col = start + x_i + nx * (y_i + 1);
+      insert(row, 1, &col, &coeff);
+    }
+  }
+  // south coeffs
+  for (int y_i = 1; y_i < ny; y_i++) {
+    for (int x_i = 0; x_i < nx; x_i++) {
+      int row = start + x_i + nx * y_i;
+      int col = start + x_i + nx * (y_i - 1);
+      insert(row, 1, &col, &coeff);
+    }
+  }
+  coeff = 1.0 / (h_x * h_x);
+  // east coeffs
+  for (int y_i = 0; y_i < ny; y_i++) {
+    for (int x_i = 0; x_i < nx - 1; x_i++) {
+      int row = start + x_i + nx * y_i;
+      int col = start + x_i + 1 + nx * y_i;
+      insert(row, 1, &col, &coeff);
+    }
+  }
+  // west coeffs
+  for (int y_i = 0; y_i < ny; y_i++) {
+    for (int x_i = 1; x_i < nx; x_i++) {
+      int row = start + x_i + nx * y_i;
+      int col = start + x_i - 1 + nx * y_i;
+      insert(row, 1, &col, &coeff);
+    }
+  }
+  // boundaries
+  for (Side<2> s : Side<2>::getValues()) {
+    StencilHelper2d* sh = getStencilHelper(pinfo, s, neumann);
+    for (int i = 0; i < sh->n; i++) {
+      int row = sh->row(i);
+      int size = sh->size(i);
+      double* coeffs = sh->coeffs(i);
+      int* cols = sh->cols(i);
+      insert(row, size, cols, coeffs);
+    }
+    delete sh;
+  }
+}
+/**
+ * @brief Gather the rows of the matrix on this rank, one patch at a time
+ *
+ * @param domain the domain
+ * @param neumann the boundary conditions
+ * @param lambda the constant that is added to the diagonal
+ * @return MatrixRowAssembler the finished rows
+ */
+MatrixRowAssembler
+AssembleRows(const Domain<2>& domain, std::bitset<4> neumann, double lambda)
+{
+  MatrixRowAssembler rows(domain);
+  auto insert = [&](int row, int size, const int* cols, const double* coeffs) {
+    rows.add(row, size, cols, coeffs);
+  };
+  int patch_size = domain.getNumCellsInPatch();
+  for (const PatchInfo<2>* pinfo : MatrixRowAssembler::getPatchesInRowOrder(domain)) {
+    rows.beginRows(pinfo->global_index * patch_size, patch_size);
+    AddCoefficients(*pinfo, neumann, lambda, insert);
+    rows.endRows();
+  }
+  rows.finish();
+  return rows;
+}
 } // namespace
+#ifdef THUNDEREGG_PETSC_ENABLED
 Mat
 MatrixHelper2d::formCRSMatrix(double lambda)
 {
@@ -453,69 +554,19 @@ MatrixHelper2d::formCRSMatrix(double lambda)
   int global_size = domain.getNumGlobalPatches() * nx * ny;
   MatSetSizes(A, local_size, local_size, global_size, global_size);
   MatSetType(A, MATMPIAIJ);
-  MatMPIAIJSetPreallocation(A, 19, nullptr, 19, nullptr);
 
-  for (auto& pinfo : domain.getPatchInfoVector()) {
-    double h_x = pinfo.spacings[0];
-    double h_y = pinfo.spacings[1];
-    int start = nx * ny * pinfo.global_index;
+  AssembleRows(domain, neumann, lambda).insertInto(A);
 
-    // center coeffs
-    double coeff = -2.0 / (h_x * h_x) - 2.0 / (h_y * h_y) + lambda;
-    for (int y_i = 0; y_i < ny; y_i++) {
-      for (int x_i = 0; x_i < nx; x_i++) {
-        int row = start + x_i + nx * y_i;
-        MatSetValues(A, 1, &row, 1, &row, &coeff, ADD_VALUES);
-      }
-    }
-    // north coeffs
-    coeff = 1.0 / (h_y * h_y);
-    for (int y_i = 0; y_i < ny - 1; y_i++) {
-      for (int x_i = 0; x_i < nx; x_i++) {
-        int row = start + x_i + nx * y_i;
-        int col = start + x_i + nx * (y_i + 1);
-        MatSetValues(A, 1, &row, 1, &col, &coeff, ADD_VALUES);
-      }
-    }
-    // south coeffs
-    for (int y_i = 1; y_i < ny; y_i++) {
-      for (int x_i = 0; x_i < nx; x_i++) {
-        int row = start + x_i + nx * y_i;
-        int col = start + x_i + nx * (y_i - 1);
-        MatSetValues(A, 1, &row, 1, &col, &coeff, ADD_VALUES);
-      }
-    }
-    coeff = 1.0 / (h_x * h_x);
-    // east coeffs
-    for (int y_i = 0; y_i < ny; y_i++) {
-      for (int x_i = 0; x_i < nx - 1; x_i++) {
-        int row = start + x_i + nx * y_i;
-        int col = start + x_i + 1 + nx * y_i;
-        MatSetValues(A, 1, &row, 1, &col, &coeff, ADD_VALUES);
-      }
-    }
-    // west coeffs
-    for (int y_i = 0; y_i < ny; y_i++) {
-      for (int x_i = 1; x_i < nx; x_i++) {
-        int row = start + x_i + nx * y_i;
-        int col = start + x_i - 1 + nx * y_i;
-        MatSetValues(A, 1, &row, 1, &col, &coeff, ADD_VALUES);
-      }
-    }
-    // boundaries
-    for (Side<2> s : Side<2>::getValues()) {
-      StencilHelper2d* sh = getStencilHelper(pinfo, s, neumann);
-      for (int i = 0; i < sh->n; i++) {
-        int row = sh->row(i);
-        int size = sh->size(i);
-        double* coeffs = sh->coeffs(i);
-        int* cols = sh->cols(i);
-        MatSetValues(A, 1, &row, size, cols, coeffs, ADD_VALUES);
-      }
-      delete sh;
-    }
-  }
   MatAssemblyBegin(A, MAT_FINAL_ASSEMBLY);
   MatAssemblyEnd(A, MAT_FINAL_ASSEMBLY);
   return A;
 }
+#endif
+SparseMatrix<2>
+MatrixHelper2d::formSparseMatrix(double lambda)
+{
+  SparseMatrix<2> A(domain, 1);
+  AssembleRows(domain, neumann, lambda).insertInto(A);
+  A.assemble();
+  return A;
+}
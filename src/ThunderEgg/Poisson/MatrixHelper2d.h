@@ -26,8 +26,12 @@
  * @brief MatrixHelper2D class
  */
 
+#include <ThunderEgg/Config.h>
 #include <ThunderEgg/Domain.h>
+#include <ThunderEgg/SparseMatrix.h>
+#ifdef THUNDEREGG_PETSC_ENABLED
 #include <petscmat.h>
+#endif
 
 namespace ThunderEgg::Poisson {
 /**
@@ -48,12 +52,21 @@ public:
    */
   MatrixHelper2d(const Domain<2>& domain, std::bitset<4> neumann);
 
+#ifdef THUNDEREGG_PETSC_ENABLED
   /**
    * @brief Form the matrix
    *
    * @return the formed matrix
    */
   Mat formCRSMatrix(double lambda = 0);
+#endif
+  /**
+   * @brief Form the matrix as a SparseMatrix, this does not require PETSc
+   *
+   * @param lambda the constant that is added to the diagonal
+   * @return SparseMatrix<2> the assembled matrix
+   */
+  SparseMatrix<2> formSparseMatrix(double lambda = 0);
 };
 } // namespace ThunderEgg::Poisson
 #endif
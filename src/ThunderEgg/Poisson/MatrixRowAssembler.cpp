@@ -0,0 +1,151 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include <ThunderEgg/Poisson/MatrixRowAssembler.h>
+using namespace std;
+using namespace ThunderEgg;
+using namespace ThunderEgg::Poisson;
+MatrixRowAssembler::MatrixRowAssembler(int first_row, int num_rows)
+  : first_row(first_row)
+  , num_rows(num_rows)
+  , batch_start(first_row)
+{
+  row_ptr.reserve(num_rows + 1);
+  row_ptr.push_back(0);
+}
+void
+MatrixRowAssembler::finishRowsUntil(int row)
+{
+  while (first_row + getNumFinishedRows() < row) {
+    row_ptr.push_back((int)cols.size());
+  }
+}
+void
+MatrixRowAssembler::beginRows(int start, int size)
+{
+  if (batch_size != -1) {
+    throw RuntimeError("MatrixRowAssembler batch has already been started");
+  }
+  if (start < first_row + getNumFinishedRows() || start + size > first_row + num_rows) {
+    throw RuntimeError("MatrixRowAssembler rows are not available on this rank");
+  }
+  finishRowsUntil(start);
+  batch_start = start;
+  batch_size = size;
+}
+void
+MatrixRowAssembler::endRows()
+{
+  if (batch_size == -1) {
+    throw RuntimeError("MatrixRowAssembler batch has not been started");
+  }
+  // bucket the coefficients by row
+  batch_row_ptr.assign(batch_size + 1, 0);
+  for (int row : batch_rows) {
+    batch_row_ptr[row - batch_start + 1]++;
+  }
+  for (int i = 0; i < batch_size; i++) {
+    batch_row_ptr[i + 1] += batch_row_ptr[i];
+  }
+  batch_order.resize(batch_rows.size());
+  for (size_t k = 0; k < batch_rows.size(); k++) {
+    batch_order[batch_row_ptr[batch_rows[k] - batch_start]++] = (int)k;
+  }
+  // batch_row_ptr now holds the end of each bucket
+  int bucket_start = 0;
+  for (int i = 0; i < batch_size; i++) {
+    int bucket_end = batch_row_ptr[i];
+    // rows only have a handful of coefficients, so an insertion sort is the fastest
+    for (int k = bucket_start + 1; k < bucket_end; k++) {
+      int order = batch_order[k];
+      int m = k;
+      while (m > bucket_start && batch_cols[batch_order[m - 1]] > batch_cols[order]) {
+        batch_order[m] = batch_order[m - 1];
+        m--;
+      }
+      batch_order[m] = order;
+    }
+    int row_start = (int)cols.size();
+    for (int k = bucket_start; k < bucket_end; k++) {
+      int order = batch_order[k];
+      if ((int)cols.size() > row_start && cols.back() == batch_cols[order]) {
+        values.back() += batch_values[order];
+      } else {
+        cols.push_back(batch_cols[order]);
+        values.push_back(batch_values[order]);
+      }
+    }
+    row_ptr.push_back((int)cols.size());
+    bucket_start = bucket_end;
+  }
+  batch_rows.clear();
+  batch_cols.clear();
+  batch_values.clear();
+  batch_size = -1;
+}
+void
+MatrixRowAssembler::finish()
+{
+  if (batch_size != -1) {
+    throw RuntimeError("MatrixRowAssembler batch has not been ended");
+  }
+  finishRowsUntil(first_row + num_rows);
+}
+void
+MatrixRowAssembler::getNumNonzeros(vector<int>& diag_nnz, vector<int>& offd_nnz) const
+{
+  int num_finished_rows = getNumFinishedRows();
+  diag_nnz.assign(num_finished_rows, 0);
+  offd_nnz.assign(num_finished_rows, 0);
+  for (int i = 0; i < num_finished_rows; i++) {
+    for (int k = row_ptr[i]; k < row_ptr[i + 1]; k++) {
+      if (cols[k] >= first_row && cols[k] < first_row + num_rows) {
+        diag_nnz[i]++;
+      } else {
+        offd_nnz[i]++;
+      }
+    }
+  }
+}
+#ifdef THUNDEREGG_PETSC_ENABLED
+void
+MatrixRowAssembler::insertInto(Mat A) const
+{
+  vector<int> diag_nnz;
+  vector<int> offd_nnz;
+  getNumNonzeros(diag_nnz, offd_nnz);
+  vector<PetscInt> d_nnz(diag_nnz.begin(), diag_nnz.end());
+  vector<PetscInt> o_nnz(offd_nnz.begin(), offd_nnz.end());
+  MatXAIJSetPreallocation(A, 1, d_nnz.data(), o_nnz.data(), nullptr, nullptr);
+
+  vector<PetscInt> row_cols;
+  for (int i = 0; i < getNumFinishedRows(); i++) {
+    PetscInt row = first_row + i;
+    row_cols.assign(cols.begin() + row_ptr[i], cols.begin() + row_ptr[i + 1]);
+    MatSetValues(A,
+                 1,
+                 &row,
+                 (PetscInt)row_cols.size(),
+                 row_cols.data(),
+                 values.data() + row_ptr[i],
+                 INSERT_VALUES);
+  }
+}
+#endif
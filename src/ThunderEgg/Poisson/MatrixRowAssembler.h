@@ -0,0 +1,269 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef THUNDEREGG_POISSON_MATRIXROWASSEMBLER_H
+#define THUNDEREGG_POISSON_MATRIXROWASSEMBLER_H
+/**
+ * @file
+ *
+ * @brief MatrixRowAssembler class
+ */
+#include <ThunderEgg/Config.h>
+#include <ThunderEgg/Domain.h>
+#include <ThunderEgg/RuntimeError.h>
+#include <ThunderEgg/SparseMatrix.h>
+#include <algorithm>
+#include <vector>
+#ifdef THUNDEREGG_PETSC_ENABLED
+#include <petscmat.h>
+#endif
+namespace ThunderEgg::Poisson {
+/**
+ * @brief Gathers the coefficients of a rank's rows into compressed sparse rows
+ *
+ * The rows are filled in batches, typically a patch at a time. Within a batch the coefficients
+ * can be added in any order and a coefficient can be added to the same column more than once.
+ * When the batch is ended the coefficients are bucketed by row, sorted by column, and the
+ * duplicates are summed, so each finished row can be inserted into a matrix with a single call.
+ *
+ * Batches have to be started in increasing order of rows. Rows that are skipped over are left
+ * empty.
+ */
+class MatrixRowAssembler
+{
+private:
+  /**
+   * @brief the global index of the first row on this rank
+   */
+  int first_row;
+  /**
+   * @brief the number of rows on this rank
+   */
+  int num_rows;
+  /**
+   * @brief the global index of the first row of the current batch
+   */
+  int batch_start;
+  /**
+   * @brief the number of rows in the current batch, -1 if there is no current batch
+   */
+  int batch_size = -1;
+  /**
+   * @brief the start of each finished row in cols and values, has one more element than the
+   * number of finished rows
+   */
+  std::vector<int> row_ptr;
+  /**
+   * @brief the global column indexes of the finished rows, sorted within each row
+   */
+  std::vector<int> cols;
+  /**
+   * @brief the values of the finished rows
+   */
+  std::vector<double> values;
+  /**
+   * @brief the rows of the coefficients added to the current batch
+   */
+  std::vector<int> batch_rows;
+  /**
+   * @brief the columns of the coefficients added to the current batch
+   */
+  std::vector<int> batch_cols;
+  /**
+   * @brief the values of the coefficients added to the current batch
+   */
+  std::vector<double> batch_values;
+  /**
+   * @brief workspace for bucketing the batch by row
+   */
+  std::vector<int> batch_row_ptr;
+  /**
+   * @brief workspace for bucketing the batch by row
+   */
+  std::vector<int> batch_order;
+  /**
+   * @brief add empty rows until the given row
+   *
+   * @param row the global index of the row
+   */
+  void finishRowsUntil(int row);
+  /**
+   * @brief Get the global index of the first row of a Domain on this rank
+   *
+   * @tparam D the number of Cartesian dimensions
+   * @param domain the Domain
+   * @return int the first row, 0 if there are no patches on this rank
+   */
+  template<int D>
+  static int getFirstRow(const Domain<D>& domain)
+  {
+    if (domain.getNumLocalPatches() == 0) {
+      return 0;
+    }
+    int first_global_index = domain.getPatchInfoVector()[0].global_index;
+    for (const PatchInfo<D>& pinfo : domain.getPatchInfoVector()) {
+      first_global_index = std::min(first_global_index, pinfo.global_index);
+    }
+    return first_global_index * domain.getNumCellsInPatch();
+  }
+
+public:
+  /**
+   * @brief Construct a new MatrixRowAssembler object
+   *
+   * @param first_row the global index of the first row on this rank
+   * @param num_rows the number of rows on this rank
+   */
+  MatrixRowAssembler(int first_row, int num_rows);
+  /**
+   * @brief Construct a new MatrixRowAssembler object for the rows of a Domain
+   *
+   * There is one row for each cell, numbered the same way as PETSc::MatWrapper and SparseMatrix
+   * number them.
+   *
+   * @tparam D the number of Cartesian dimensions
+   * @param domain the Domain
+   */
+  template<int D>
+  explicit MatrixRowAssembler(const Domain<D>& domain)
+    : MatrixRowAssembler(getFirstRow(domain), domain.getNumLocalCells())
+  {}
+  /**
+   * @brief Get the local patches of a Domain in the order of their rows
+   *
+   * @tparam D the number of Cartesian dimensions
+   * @param domain the Domain
+   * @return std::vector<const PatchInfo<D>*> the patches, sorted by global index
+   */
+  template<int D>
+  static std::vector<const PatchInfo<D>*> getPatchesInRowOrder(const Domain<D>& domain)
+  {
+    std::vector<const PatchInfo<D>*> pinfos;
+    pinfos.reserve(domain.getNumLocalPatches());
+    for (const PatchInfo<D>& pinfo : domain.getPatchInfoVector()) {
+      pinfos.push_back(&pinfo);
+    }
+    std::sort(pinfos.begin(), pinfos.end(), [](const PatchInfo<D>* a, const PatchInfo<D>* b) {
+      return a->global_index < b->global_index;
+    });
+    return pinfos;
+  }
+  /**
+   * @brief Start a batch of rows
+   *
+   * @param start the global index of the first row in the batch
+   * @param size the number of rows in the batch
+   * @exception RuntimeError if the rows are not on this rank, are before a finished row, or if a
+   * batch has already been started
+   */
+  void beginRows(int start, int size);
+  /**
+   * @brief Add coefficients to a row of the current batch
+   *
+   * @param row the global index of the row
+   * @param size the number of coefficients
+   * @param cols the global column indexes of the coefficients
+   * @param coeffs the coefficients
+   * @exception RuntimeError if the row is not in the current batch
+   */
+  void add(int row, int size, const int* cols, const double* coeffs)
+  {
+    if (row < batch_start || row >= batch_start + batch_size) {
+      throw RuntimeError("MatrixRowAssembler row is not in the current batch");
+    }
+    for (int k = 0; k < size; k++) {
+      batch_rows.push_back(row);
+      batch_cols.push_back(cols[k]);
+      batch_values.push_back(coeffs[k]);
+    }
+  }
+  /**
+   * @brief Finish the rows of the current batch
+   *
+   * @exception RuntimeError if there is no current batch
+   */
+  void endRows();
+  /**
+   * @brief Finish the remaining rows on this rank, they are left empty
+   *
+   * @exception RuntimeError if there is a current batch
+   */
+  void finish();
+  /**
+   * @brief Get the global index of the first row on this rank
+   */
+  int getFirstRow() const { return first_row; }
+  /**
+   * @brief Get the number of rows on this rank
+   */
+  int getNumRows() const { return num_rows; }
+  /**
+   * @brief Get the number of finished rows
+   */
+  int getNumFinishedRows() const { return (int)row_ptr.size() - 1; }
+  /**
+   * @brief Get the start of each finished row in getCols() and getValues(), this has one more
+   * element than the number of finished rows
+   */
+  const std::vector<int>& getRowPtr() const { return row_ptr; }
+  /**
+   * @brief Get the global column indexes of the finished rows, sorted within each row
+   */
+  const std::vector<int>& getCols() const { return cols; }
+  /**
+   * @brief Get the values of the finished rows
+   */
+  const std::vector<double>& getValues() const { return values; }
+  /**
+   * @brief Count the nonzeros of each finished row
+   *
+   * @param diag_nnz filled with the number of nonzeros in the columns owned by this rank
+   * @param offd_nnz filled with the number of nonzeros in the columns owned by other ranks
+   */
+  void getNumNonzeros(std::vector<int>& diag_nnz, std::vector<int>& offd_nnz) const;
+  /**
+   * @brief Add the finished rows to a SparseMatrix, one call per row
+   *
+   * @tparam D the number of Cartesian dimensions of the matrix
+   * @param A the matrix, it has to have the same rows on this rank
+   */
+  template<int D>
+  void insertInto(SparseMatrix<D>& A) const
+  {
+    for (int i = 0; i < getNumFinishedRows(); i++) {
+      A.addValues(first_row + i,
+                  row_ptr[i + 1] - row_ptr[i],
+                  cols.data() + row_ptr[i],
+                  values.data() + row_ptr[i]);
+    }
+  }
+#ifdef THUNDEREGG_PETSC_ENABLED
+  /**
+   * @brief Preallocate a PETSc Mat with the exact number of nonzeros of each row, then insert the
+   * finished rows, one call per row
+   *
+   * @param A the matrix, the sizes and type have to be set, and it has to have the same rows on
+   * this rank
+   */
+  void insertInto(Mat A) const;
+#endif
+};
+} // namespace ThunderEgg::Poisson
+#endif
@@ -0,0 +1,491 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2020-2021 Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef THUNDEREGG_POISSON_TRIDIAGPATCHSOLVER_H
+#define THUNDEREGG_POISSON_TRIDIAGPATCHSOLVER_H
+/**
+ * @file
+ *
+ * @brief TridiagPatchSolver class
+ */
+#include <ThunderEgg/PatchArray.h>
+#include <ThunderEgg/PatchOperator.h>
+#include <ThunderEgg/PatchScratch.h>
+#include <ThunderEgg/PatchSolver.h>
+#include <ThunderEgg/Poisson/DFTPatchSolver.h>
+#include <ThunderEgg/RuntimeError.h>
+#include <bitset>
+#include <valarray>
+#include <vector>
+
+namespace ThunderEgg::Poisson {
+/**
+ * @brief Solve for the Poisson equation by transforming all but the last axis with DFTs, and
+ * solving tridiagonal systems along the last axis
+ *
+ * This does not need FFTW, and takes O(n^(D+1)) work for the transforms of the first D-1 axes,
+ * which are matrix-matrix products over whole slabs, and O(n^D) for the tridiagonal solves. The
+ * tridiagonal systems of all the modes of a patch are solved together with the Thomas algorithm,
+ * the loop over the modes is the innermost loop so that it is vectorized. The LU factorization of
+ * the tridiagonal systems is computed once for each group of patches with the same spacings and
+ * boundary conditions.
+ *
+ * @tparam D the number of Cartesian dimensions
+ */
+template<int D>
+class TridiagPatchSolver : public PatchSolver<D>
+{
+private:
+  using DftType = typename DFTPatchSolver<D>::DftType;
+  /**
+   * @brief Patches with the same key can share factorizations. The first value has a bit set for
+   * each side with a neumann boundary condition, the second value is the spacing.
+   */
+  using PlanKey = std::pair<unsigned long, double>;
+  /**
+   * @brief The transforms and tridiagonal factorizations for a group of patches with the same
+   * PlanKey
+   */
+  struct PlanGroup
+  {
+    /**
+     * @brief The key for this group
+     */
+    PlanKey key;
+    /**
+     * @brief The DFT matrix for each of the first D-1 axes
+     */
+    std::array<std::shared_ptr<std::valarray<double>>, D - 1> forward;
+    /**
+     * @brief The inverse DFT matrix for each of the first D-1 axes
+     */
+    std::array<std::shared_ptr<std::valarray<double>>, D - 1> inverse;
+    /**
+     * @brief The reciprocals of the pivots of the Thomas algorithm, for each value of the last axis
+     * and each mode
+     */
+    std::vector<double> inv_pivots;
+    /**
+     * @brief The modified super diagonal of the Thomas algorithm, for each value of the last axis
+     * and each mode
+     */
+    std::vector<double> upper;
+    /**
+     * @brief The off diagonal value of the tridiagonal systems
+     */
+    double off_diag = 0;
+    /**
+     * @brief True if the system for the first mode is singular (a pure neumann problem)
+     */
+    bool singular = false;
+  };
+
+  /**
+   * @brief The patch opertar that we are solving for
+   */
+  std::shared_ptr<const PatchOperator<D>> op;
+  /**
+   * @brief Neumann boundary conditions for domain
+   */
+  std::bitset<Side<D>::number_of> neumann;
+  /**
+   * @brief The number of cells in a patch
+   */
+  int patch_size = 1;
+  /**
+   * @brief The number of modes, the number of cells in a slab normal to the last axis
+   */
+  int num_modes = 1;
+  /**
+   * @brief The plan groups
+   */
+  std::vector<PlanGroup> groups;
+  /**
+   * @brief The index in groups for each local patch
+   */
+  std::vector<int> patch_groups;
+
+  /**
+   * @brief Return if a patch has a neumann boundary condition on a particular side
+   *
+   * @param pinfo the patch
+   * @param s the side
+   * @return true if neumann
+   * @return false if not neumann
+   */
+  bool patchIsNeumannOnSide(const PatchInfo<D>& pinfo, Side<D> s) const
+  {
+    return !pinfo.hasNbr(s) && neumann[s.getIndex()];
+  }
+  /**
+   * @brief Get the key for a patch
+   *
+   * @param pinfo the patch
+   * @return PlanKey the key
+   */
+  PlanKey getKey(const PatchInfo<D>& pinfo) const
+  {
+    std::bitset<Side<D>::number_of> patch_neumann;
+    for (Side<D> s : Side<D>::getValues()) {
+      patch_neumann[s.getIndex()] = patchIsNeumannOnSide(pinfo, s);
+    }
+    return PlanKey(patch_neumann.to_ulong(), pinfo.spacings[0]);
+  }
+  /**
+   * @brief Get the index of the plan group for a patch
+   *
+   * Patches of the Domain use the table that was filled in on construction, other patches (added
+   * with addPatch()) are looked up by their key.
+   *
+   * @param pinfo the patch
+   * @return int the index in groups
+   */
+  int getGroupIndex(const PatchInfo<D>& pinfo) const
+  {
+    PlanKey key = getKey(pinfo);
+    if (pinfo.local_index >= 0 && pinfo.local_index < (int)patch_groups.size() &&
+        groups[patch_groups[pinfo.local_index]].key == key) {
+      return patch_groups[pinfo.local_index];
+    }
+    for (size_t i = 0; i < groups.size(); i++) {
+      if (groups[i].key == key) {
+        return i;
+      }
+    }
+    throw RuntimeError("TridiagPatchSolver does not have a plan for patch " +
+                       std::to_string(pinfo.id));
+  }
+  /**
+   * @brief Get the eigenvalue of the 1d laplacian along an axis
+   *
+   * @param lower_neumann true if there is a neumann boundary condition on the lower side
+   * @param higher_neumann true if there is a neumann boundary condition on the higher side
+   * @param n the number of cells along the axis
+   * @param h the spacing along the axis
+   * @param xi the mode
+   * @return double the eigenvalue
+   */
+  static double
+  getEigenValue(bool lower_neumann, bool higher_neumann, int n, double h, int xi)
+  {
+    double shift;
+    if (lower_neumann && higher_neumann) {
+      shift = 0;
+    } else if (lower_neumann || higher_neumann) {
+      shift = 0.5;
+    } else {
+      shift = 1;
+    }
+    return -4 / (h * h) * pow(sin((xi + shift) * M_PI / (2 * n)), 2);
+  }
+  /**
+   * @brief Add a plan group for a patch, if there is not one already
+   *
+   * @param pinfo the patch
+   * @return int the index of the group in groups
+   */
+  int addGroup(const PatchInfo<D>& pinfo)
+  {
+    PlanKey key = getKey(pinfo);
+    for (size_t i = 0; i < groups.size(); i++) {
+      if (groups[i].key == key) {
+        return i;
+      }
+    }
+
+    const std::array<int, D>& ns = this->getDomain().getNs();
+    PlanGroup group;
+    group.key = key;
+
+    // transforms and eigenvalues of the first D-1 axes
+    std::vector<double> eigen_vals(num_modes, 0.0);
+    int stride = 1;
+    for (size_t axis = 0; axis < D - 1; axis++) {
+      bool lower = patchIsNeumannOnSide(pinfo, LowerSideOnAxis<D>(axis));
+      bool higher = patchIsNeumannOnSide(pinfo, HigherSideOnAxis<D>(axis));
+      DftType type;
+      DftType type_inv;
+      if (lower && higher) {
+        type = DftType::DCT_II;
+        type_inv = DftType::DCT_III;
+      } else if (lower) {
+        type = DftType::DCT_IV;
+        type_inv = DftType::DCT_IV;
+      } else if (higher) {
+        type = DftType::DST_IV;
+        type_inv = DftType::DST_IV;
+      } else {
+        type = DftType::DST_II;
+        type_inv = DftType::DST_III;
+      }
+      group.forward[axis] = std::make_shared<std::valarray<double>>(
+        DFTPatchSolver<D>::getTransformMatrix(type, ns[axis]));
+      group.inverse[axis] = std::make_shared<std::valarray<double>>(
+        DFTPatchSolver<D>::getTransformMatrix(type_inv, ns[axis]));
+
+      for (int mode = 0; mode < num_modes; mode++) {
+        int xi = (mode / stride) % ns[axis];
+        eigen_vals[mode] += getEigenValue(lower, higher, ns[axis], pinfo.spacings[axis], xi);
+      }
+      stride *= ns[axis];
+    }
+
+    // factor the tridiagonal systems along the last axis
+    int n = ns[D - 1];
+    double h = pinfo.spacings[D - 1];
+    bool lower = patchIsNeumannOnSide(pinfo, LowerSideOnAxis<D>(D - 1));
+    bool higher = patchIsNeumannOnSide(pinfo, HigherSideOnAxis<D>(D - 1));
+    group.off_diag = 1 / (h * h);
+    group.singular = lower && higher && eigen_vals[0] == 0;
+    group.inv_pivots.resize(patch_size);
+    group.upper.resize(patch_size);
+    for (int mode = 0; mode < num_modes; mode++) {
+      double prev_upper = 0;
+      for (int j = 0; j < n; j++) {
+        double diag = -2 / (h * h) + eigen_vals[mode];
+        if (j == 0) {
+          // the ghost value is u_0 for neumann and -u_0 for dirichlet
+          diag += (lower ? 1 : -1) / (h * h);
+        }
+        if (j == n - 1) {
+          diag += (higher ? 1 : -1) / (h * h);
+        }
+        double pivot = diag - group.off_diag * prev_upper;
+        double inv_pivot = (group.singular && mode == 0) ? 0 : 1 / pivot;
+        group.inv_pivots[j * num_modes + mode] = inv_pivot;
+        group.upper[j * num_modes + mode] = group.off_diag * inv_pivot;
+        prev_upper = group.upper[j * num_modes + mode];
+      }
+    }
+
+    groups.push_back(group);
+    return groups.size() - 1;
+  }
+  /**
+   * @brief Transform the first D-1 axes of a patch
+   *
+   * The patch is stored contiguously with the first axis the fastest, see
+   * DFTPatchSolver::executePlan
+   *
+   * @param matrices the DFT matrix for each axis
+   * @param in the input values, is not modified
+   * @param out the resulting values after the transform
+   * @param tmp a buffer for intermediate results
+   */
+  void transform(const std::array<std::shared_ptr<std::valarray<double>>, D - 1>& matrices,
+                 double* in,
+                 double* out,
+                 double* tmp) const
+  {
+    const std::array<int, D>& ns = this->getDomain().getNs();
+
+    char N = 'N';
+    char T = 'T';
+    double one = 1;
+    double zero = 0;
+
+    double* prev_result = in;
+    int lower_size = 1;
+    for (size_t axis = 0; axis < D - 1; axis++) {
+      int n = ns[axis];
+      int slab_size = lower_size * n;
+      int num_slabs = patch_size / slab_size;
+      // alternate between out and tmp, so that the last transform ends up in out
+      double* new_result = ((D - 2 - axis) % 2 == 0) ? out : tmp;
+
+      double* matrix = &(*matrices[axis])[0];
+      if (axis == 0) {
+        dgemm_(T, N, n, num_slabs, n, one, matrix, n, prev_result, n, zero, new_result, n);
+      } else {
+        for (int slab = 0; slab < num_slabs; slab++) {
+          dgemm_(N,
+                 N,
+                 lower_size,
+                 n,
+                 n,
+                 one,
+                 prev_result + slab * slab_size,
+                 lower_size,
+                 matrix,
+                 n,
+                 zero,
+                 new_result + slab * slab_size,
+                 lower_size);
+        }
+      }
+
+      prev_result = new_result;
+      lower_size = slab_size;
+    }
+  }
+  /**
+   * @brief Solve the tridiagonal systems along the last axis for all the modes
+   *
+   * @param group the plan group
+   * @param x the transformed rhs, overwritten with the solution
+   * @param work a buffer with room for a value along the last axis
+   */
+  void solveTridiagonal(const PlanGroup& group, double* x, double* work) const
+  {
+    int n = this->getDomain().getNs()[D - 1];
+    const double* inv_pivots = group.inv_pivots.data();
+    const double* upper = group.upper.data();
+    double off_diag = group.off_diag;
+
+    if (group.singular) {
+      for (int j = 0; j < n; j++) {
+        work[j] = x[j * num_modes];
+      }
+    }
+
+    // forward elimination
+    for (int mode = 0; mode < num_modes; mode++) {
+      x[mode] *= inv_pivots[mode];
+    }
+    for (int j = 1; j < n; j++) {
+      double* x_j = x + j * num_modes;
+      const double* x_prev = x + (j - 1) * num_modes;
+      const double* inv_pivots_j = inv_pivots + j * num_modes;
+      for (int mode = 0; mode < num_modes; mode++) {
+        x_j[mode] = (x_j[mode] - off_diag * x_prev[mode]) * inv_pivots_j[mode];
+      }
+    }
+    // back substitution
+    for (int j = n - 2; j >= 0; j--) {
+      double* x_j = x + j * num_modes;
+      const double* x_next = x + (j + 1) * num_modes;
+      const double* upper_j = upper + j * num_modes;
+      for (int mode = 0; mode < num_modes; mode++) {
+        x_j[mode] -= upper_j[mode] * x_next[mode];
+      }
+    }
+
+    if (group.singular) {
+      // the first mode is only defined up to a constant, remove the part of the rhs that is not in
+      // the range, march up from the lower boundary, and then shift to the zero mean solution
+      double rhs_mean = 0;
+      for (int j = 0; j < n; j++) {
+        rhs_mean += work[j];
+      }
+      rhs_mean /= n;
+      double h2 = 1 / off_diag;
+      x[0] = 0;
+      if (n > 1) {
+        x[num_modes] = h2 * (work[0] - rhs_mean);
+      }
+      for (int j = 1; j < n - 1; j++) {
+        x[(j + 1) * num_modes] =
+          2 * x[j * num_modes] - x[(j - 1) * num_modes] + h2 * (work[j] - rhs_mean);
+      }
+      double mean = 0;
+      for (int j = 0; j < n; j++) {
+        mean += x[j * num_modes];
+      }
+      mean /= n;
+      for (int j = 0; j < n; j++) {
+        x[j * num_modes] -= mean;
+      }
+    }
+  }
+
+public:
+  /**
+   * @brief Construct a new TridiagPatchSolver object
+   *
+   * @param op the Poisson PatchOperator that cooresponds to this TridiagPatchSolver
+   * @param neumann true if domain has neumann boundary conditions on a side
+   */
+  TridiagPatchSolver(const PatchOperator<D>& op, std::bitset<Side<D>::number_of> neumann)
+    : PatchSolver<D>(op.getDomain(), op.getGhostFiller())
+    , op(op.clone())
+    , neumann(neumann)
+  {
+    const std::array<int, D>& ns = this->getDomain().getNs();
+    for (size_t axis = 0; axis < D; axis++) {
+      patch_size *= ns[axis];
+    }
+    num_modes = patch_size / ns[D - 1];
+
+    const std::vector<PatchInfo<D>>& pinfos = this->getDomain().getPatchInfoVector();
+    patch_groups.resize(pinfos.size());
+    for (const PatchInfo<D>& pinfo : pinfos) {
+      patch_groups[pinfo.local_index] = addGroup(pinfo);
+    }
+  }
+  /**
+   * @brief Clone this patch solver
+   *
+   * @return TridiagPatchSolver<D>* a newly allocated copy of this patch solver
+   */
+  TridiagPatchSolver<D>* clone() const override { return new TridiagPatchSolver<D>(*this); }
+  /**
+   * @brief Check if solveSinglePatch can be called from multiple threads at the same time
+   *
+   * @return true, the patches are solved in scratch buffers that are allocated once per thread
+   */
+  bool isThreadSafe() const override { return true; }
+  void solveSinglePatch(const PatchInfo<D>& pinfo,
+                        const PatchView<const double, D>& f_view,
+                        const PatchView<double, D>& u_view) const override
+  {
+    const PlanGroup& group = groups[getGroupIndex(pinfo)];
+    double* scratch = PatchScratch::GetBuffer(3 * patch_size);
+    double* in = scratch;
+    double* out = scratch + patch_size;
+    double* tmp = scratch + 2 * patch_size;
+
+    PatchView<double, D> in_view = PatchScratch::GetView<D>(in, this->getDomain().getNs());
+    Loop::OverInteriorIndexes<D + 1>(
+      in_view, [&](const std::array<int, D + 1>& coord) { in_view[coord] = f_view[coord]; });
+
+    op->modifyRHSForInternalBoundaryConditions(pinfo, u_view, in_view);
+
+    transform(group.forward, in, out, tmp);
+    solveTridiagonal(group, out, tmp);
+    transform(group.inverse, out, in, tmp);
+
+    double scale = 1;
+    for (size_t axis = 0; axis < D - 1; axis++) {
+      scale *= 2.0 / this->getDomain().getNs()[axis];
+    }
+    Loop::OverInteriorIndexes<D + 1>(u_view, [&](const std::array<int, D + 1>& coord) {
+      u_view[coord] = in_view[coord] * scale;
+    });
+  }
+  /**
+   * @brief add a patch to the solver
+   *
+   * This will calculate the necessary coefficients needed for the patch. This is only needed for
+   * patches that are not in the Domain.
+   *
+   * @param pinfo the patch
+   */
+  void addPatch(const PatchInfo<D>& pinfo) { addGroup(pinfo); }
+  /**
+   * @brief Get the neumann boundary conditions for this operator
+   *
+   * @return std::bitset<Side<D>::number_of> the boundary conditions
+   */
+  std::bitset<Side<D>::number_of> getNeumann() const { return neumann; }
+};
+extern template class TridiagPatchSolver<2>;
+extern template class TridiagPatchSolver<3>;
+} // namespace ThunderEgg::Poisson
+#endif
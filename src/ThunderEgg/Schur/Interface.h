@@ -27,9 +27,11 @@
  */
 #include <ThunderEgg/BufferReader.h>
 #include <ThunderEgg/BufferWriter.h>
+#include <ThunderEgg/Communicator.h>
 #include <ThunderEgg/Schur/IfaceType.h>
 #include <ThunderEgg/Schur/PatchIfaceInfo.h>
 #include <bitset>
+#include <deque>
 #include <map>
 #include <mpi.h>
 #include <set>
@@ -228,41 +230,29 @@ private:
     iface_ptr->insert(s, piinfo);
   }
   /**
-   * @brief Will insert the interface shared with a normal neighbor into rank_id_iface_map, and
-   * will add any ranks that are sending messages to us into incoming_procs
+   * @brief Will insert the interface shared with a normal neighbor into rank_id_iface_map
    *
    * @param rank_id_iface_map the map from rank to the interface's id to Interface
-   * @param incoming_procs the set of ranks that are sending messages this rank
    * @param piinfo the PatchIfaceInfo object
    * @param s the side of the patch that the interface is on
    */
   static void InsertInterfaceWithNormalNbr(
     std::map<int, std::map<int, std::shared_ptr<Interface<D>>>>& rank_id_iface_map,
-    std::set<int>& incoming_procs,
     std::shared_ptr<const PatchIfaceInfo<D>> piinfo,
     Side<D> s)
   {
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     auto info = piinfo->getNormalIfaceInfo(s);
-    auto nbr_info = piinfo->pinfo.getNormalNbrInfo(s);
     InsertPatchToInterface(rank_id_iface_map, info->rank, info->id, s, piinfo);
-    if (info->rank == piinfo->pinfo.rank && nbr_info.rank != piinfo->pinfo.rank) {
-      incoming_procs.insert(nbr_info.rank);
-    }
   }
   /**
-   * @brief Will insert the interfaces shared with a finer neighbor into rank_id_iface_map, and
-   * will add any ranks that are sending messages to us into incoming_procs
+   * @brief Will insert the interfaces shared with a finer neighbor into rank_id_iface_map
    *
    * @param rank_id_iface_map the map from rank to the interface's id to Interface
-   * @param incoming_procs the set of ranks that are sending messages this rank
    * @param piinfo the PatchIfaceInfo object
    * @param s the side of the patch that the interface is on
    */
   static void InsertInterfacesWithFineNbr(
     std::map<int, std::map<int, std::shared_ptr<Interface<D>>>>& rank_id_iface_map,
-    std::set<int>& incoming_procs,
     std::shared_ptr<const PatchIfaceInfo<D>> piinfo,
     Side<D> s)
   {
@@ -272,24 +262,17 @@ private:
 
     for (size_t i = 0; i < Orthant<D - 1>::num_orthants; i++) {
       InsertPatchToInterface(rank_id_iface_map, info->fine_ranks[i], info->fine_ids[i], s, piinfo);
-
-      if (info->fine_ranks[i] != piinfo->pinfo.rank) {
-        incoming_procs.insert(info->fine_ranks[i]);
-      }
     }
   }
   /**
-   * @brief Will insert the interfaces shared with a coarser neighbor into rank_id_iface_map, and
-   * will add any ranks that are sending messages to us into incoming_procs
+   * @brief Will insert the interfaces shared with a coarser neighbor into rank_id_iface_map
    *
    * @param rank_id_iface_map the map from rank to the interface's id to Interface
-   * @param incoming_procs the set of ranks that are sending messages this rank
    * @param piinfo the PatchIfaceInfo object
    * @param s the side of the patch that the interface is on
    */
   static void InsertInterfacesWithCoarseNbr(
     std::map<int, std::map<int, std::shared_ptr<Interface<D>>>>& rank_id_iface_map,
-    std::set<int>& incoming_procs,
     std::shared_ptr<const PatchIfaceInfo<D>> piinfo,
     Side<D> s)
   {
@@ -297,17 +280,58 @@ private:
 
     InsertPatchToInterface(rank_id_iface_map, info->rank, info->id, s, piinfo);
     InsertPatchToInterface(rank_id_iface_map, info->coarse_rank, info->coarse_id, s, piinfo);
-
-    if (info->coarse_rank != piinfo->pinfo.rank) {
-      incoming_procs.insert(info->coarse_rank);
+  }
+  /**
+   * @brief Deserialize the interfaces in a message from another rank and merge them into this
+   * rank's interfaces
+   *
+   * @param buffer the received message
+   * @param size the size of the message in bytes
+   * @param id_iface_map map from id to Interface for this rank
+   * @param id_to_off_proc_piinfo_map map from patch id to the PatchIfaceInfo objects received so
+   * far, used so that each off processor patch is only stored once
+   */
+  static void MergeReceivedInterfaces(
+    std::vector<char>& buffer,
+    int size,
+    std::map<int, std::shared_ptr<Interface<D>>>& id_iface_map,
+    std::map<int, std::shared_ptr<PatchIfaceInfo<D>>>& id_to_off_proc_piinfo_map)
+  {
+    BufferReader reader(buffer.data());
+    while (reader.getPos() < size) {
+      Interface<D> ifs;
+      reader >> ifs;
+      for (auto& patch : ifs.patches) {
+        auto& ptr = id_to_off_proc_piinfo_map[patch.piinfo->pinfo.id];
+        if (ptr == nullptr) {
+          // need to cast to remove const modifier
+          ptr = std::const_pointer_cast<PatchIfaceInfo<D>>(patch.piinfo);
+        } else {
+          patch.piinfo = ptr;
+        }
+      }
+      id_iface_map.at(ifs.id)->merge(ifs);
     }
   }
+  /**
+   * @brief The tag used for the messages in EnumerateIfacesFromPiinfoVector.
+   *
+   * The messages are received from MPI_ANY_SOURCE, so this has to differ from the tag used by the
+   * point-to-point communication that follows it on the same communicator.
+   */
+  static constexpr int enumerate_tag = 1;
 
 public:
   /**
    * @brief Will enumerate a map from interface id to this rank's interfaces, will also do any
-   * neccesary communication to get additional information. This is collective on all processors.
+   * neccesary communication to get additional information. This is collective on comm.
+   *
+   * The ranks that will send to this rank are not known in advance, so this uses a non-blocking
+   * sparse data exchange: each rank posts synchronous sends to the ranks it shares interfaces
+   * with, receives whatever arrives, and enters a non-blocking barrier once its own sends have
+   * been matched. When the barrier completes every message has been received.
    *
+   * @param comm the communicator
    * @param piinfos vector of this ranks piinfo objects
    * @param rank_id_iface_map the map from rank to interface id to interface. The interfaces on
    * this rank will contain PatchIfaceInfo objects from other processors. The interfaces for other
@@ -315,26 +339,26 @@ public:
    * @param off_proc_piinfos a vector of piinfo objects received from other processors.
    */
   static void EnumerateIfacesFromPiinfoVector(
+    const Communicator& comm,
     std::vector<std::shared_ptr<const PatchIfaceInfo<D>>> piinfos,
     std::map<int, std::map<int, std::shared_ptr<Interface<D>>>>& rank_id_iface_map,
     std::vector<std::shared_ptr<PatchIfaceInfo<D>>>& off_proc_piinfos)
   {
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    int rank = comm.getRank();
+    MPI_Comm mpi_comm = comm.getMPIComm();
     rank_id_iface_map.clear();
-    std::set<int> incoming_procs;
     for (auto piinfo : piinfos) {
       for (Side<D> s : Side<D>::getValues()) {
         if (piinfo->pinfo.hasNbr(s)) {
           switch (piinfo->pinfo.getNbrType(s)) {
             case NbrType::Normal:
-              InsertInterfaceWithNormalNbr(rank_id_iface_map, incoming_procs, piinfo, s);
+              InsertInterfaceWithNormalNbr(rank_id_iface_map, piinfo, s);
               break;
             case NbrType::Fine:
-              InsertInterfacesWithFineNbr(rank_id_iface_map, incoming_procs, piinfo, s);
+              InsertInterfacesWithFineNbr(rank_id_iface_map, piinfo, s);
               break;
             case NbrType::Coarse:
-              InsertInterfacesWithCoarseNbr(rank_id_iface_map, incoming_procs, piinfo, s);
+              InsertInterfacesWithCoarseNbr(rank_id_iface_map, piinfo, s);
               break;
             default:
               throw RuntimeError("Unsupported NbrType value");
@@ -360,48 +384,51 @@ public:
           writer << *iface;
         }
         MPI_Request request;
-        MPI_Isend(buffers.back().data(), size, MPI_BYTE, dest, 0, MPI_COMM_WORLD, &request);
+        MPI_Issend(buffers.back().data(), size, MPI_BYTE, dest, enumerate_tag, mpi_comm, &request);
         send_requests.push_back(request);
       }
     }
-    // recv info
+    // recv info until every rank's sends have been matched
     std::map<int, std::shared_ptr<PatchIfaceInfo<D>>> id_to_off_proc_piinfo_map;
-
-    MPI_Barrier(MPI_COMM_WORLD);
-
-    size_t num_incoming = incoming_procs.size();
-    for (size_t i = 0; i < num_incoming; i++) {
+    MPI_Request barrier_request = MPI_REQUEST_NULL;
+    bool barrier_started = false;
+    int done = false;
+    while (!done) {
+      int incoming;
       MPI_Status status;
-      MPI_Probe(MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &status);
-      int size;
-      MPI_Get_count(&status, MPI_BYTE, &size);
-      std::vector<char> buffer(size);
-
-      MPI_Recv(
-        buffer.data(), size, MPI_BYTE, status.MPI_SOURCE, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-
-      BufferReader reader(buffer.data());
-      while (reader.getPos() < size) {
-        Interface<D> ifs;
-        reader >> ifs;
-        for (auto& patch : ifs.patches) {
-          auto& ptr = id_to_off_proc_piinfo_map[patch.piinfo->pinfo.id];
-          if (ptr == nullptr) {
-            // need to cast to remove const modifier
-            ptr = std::const_pointer_cast<PatchIfaceInfo<D>>(patch.piinfo);
-          } else {
-            patch.piinfo = ptr;
-          }
-        }
-        rank_id_iface_map.at(rank).at(ifs.id)->merge(ifs);
+      MPI_Iprobe(MPI_ANY_SOURCE, enumerate_tag, mpi_comm, &incoming, &status);
+      if (incoming) {
+        int size;
+        MPI_Get_count(&status, MPI_BYTE, &size);
+        std::vector<char> buffer(size);
+        MPI_Recv(buffer.data(),
+                 size,
+                 MPI_BYTE,
+                 status.MPI_SOURCE,
+                 enumerate_tag,
+                 mpi_comm,
+                 MPI_STATUS_IGNORE);
+        MergeReceivedInterfaces(
+          buffer, size, rank_id_iface_map.at(rank), id_to_off_proc_piinfo_map);
       }
-      off_proc_piinfos.clear();
-      for (auto pair : id_to_off_proc_piinfo_map) {
-        off_proc_piinfos.push_back(pair.second);
+      if (barrier_started) {
+        MPI_Test(&barrier_request, &done, MPI_STATUS_IGNORE);
+      } else {
+        int sends_matched = true;
+        if (!send_requests.empty()) {
+          MPI_Testall(
+            (int)send_requests.size(), send_requests.data(), &sends_matched, MPI_STATUSES_IGNORE);
+        }
+        if (sends_matched) {
+          MPI_Ibarrier(mpi_comm, &barrier_request);
+          barrier_started = true;
+        }
       }
     }
-    // wait for all
-    MPI_Waitall((int)send_requests.size(), &send_requests[0], MPI_STATUSES_IGNORE);
+    off_proc_piinfos.clear();
+    for (auto pair : id_to_off_proc_piinfo_map) {
+      off_proc_piinfos.push_back(pair.second);
+    }
   }
 };
 extern template class Interface<2>;
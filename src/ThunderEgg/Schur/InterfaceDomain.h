@@ -246,16 +246,18 @@ private:
   /**
    * @brief Set global indexes for all of the interfaces, local indexes should already be set
    *
+   * @param comm the communicator
    * @param interfaces the vector of Interface objects for this processor
    * @param piinfos the vector PatchIfaceInfo objects for this processor
    */
-  static void IndexIfacesGlobal(const std::vector<std::shared_ptr<Interface<D>>>& interfaces,
+  static void IndexIfacesGlobal(const Communicator& comm,
+                                const std::vector<std::shared_ptr<Interface<D>>>& interfaces,
                                 const std::vector<std::shared_ptr<PatchIfaceInfo<D>>>& piinfos)
   {
     // get starting global index for this rank
     int starting_global_index;
     int num_local_interfaces = (int)interfaces.size();
-    MPI_Scan(&num_local_interfaces, &starting_global_index, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Scan(&num_local_interfaces, &starting_global_index, 1, MPI_INT, MPI_SUM, comm.getMPIComm());
     starting_global_index -= num_local_interfaces;
 
     // index local interfaces first
@@ -280,15 +282,17 @@ private:
         }
       }
     }
-    SendAndReceiveGlobalIndexes(interfaces, piinfos);
+    SendAndReceiveGlobalIndexes(comm, interfaces, piinfos);
   }
   /**
    * @brief Do the necessary communication to get the global indexes from other processors
    *
+   * @param comm the communicator
    * @param interfaces the set of Interface objects
    * @param piinfos  the set of PatchIfaceInfo objects
    */
   static void SendAndReceiveGlobalIndexes(
+    const Communicator& comm,
     const std::vector<std::shared_ptr<Interface<D>>>& interfaces,
     const std::vector<std::shared_ptr<PatchIfaceInfo<D>>>& piinfos)
   {
@@ -296,11 +300,11 @@ private:
     std::deque<std::vector<int>> recv_buffers;
     std::vector<MPI_Request> recv_requests;
     SetupGlobalIndexRecvRequests(
-      interfaces, piinfos, rank_to_id_to_global_indexes_to_set, recv_buffers, recv_requests);
+      comm, interfaces, piinfos, rank_to_id_to_global_indexes_to_set, recv_buffers, recv_requests);
 
     std::deque<std::vector<int>> send_buffers;
     std::vector<MPI_Request> send_requests;
-    SetupGlobalIndexSendRequests(interfaces, send_buffers, send_requests);
+    SetupGlobalIndexSendRequests(comm, interfaces, send_buffers, send_requests);
 
     size_t num_recvs = recv_requests.size();
     for (size_t i = 0; i < num_recvs; i++) {
@@ -326,6 +330,7 @@ private:
   /**
    * @brief Setup the MPI_Irecv calls
    *
+   * @param comm the communicator
    * @param interfaces the vector of Interface objects
    * @param piinfos the vector of PatchIfaceInfo objects
    * @param rank_to_id_to_global_indexes_to_set (output) Map from rank of incoming process to
@@ -335,6 +340,7 @@ private:
    * @param recv_requests (output) MPI_Irecv request status, one for each incoming rank.
    */
   static void SetupGlobalIndexRecvRequests(
+    const Communicator& comm,
     const std::vector<std::shared_ptr<Interface<D>>>& interfaces,
     const std::vector<std::shared_ptr<PatchIfaceInfo<D>>>& piinfos,
     std::map<int, std::map<int, std::set<int*>>>& rank_to_id_to_global_indexes_to_set,
@@ -351,7 +357,7 @@ private:
                 MPI_INT,
                 pair.first,
                 0,
-                MPI_COMM_WORLD,
+                comm.getMPIComm(),
                 &request);
       recv_requests.push_back(request);
     }
@@ -460,18 +466,20 @@ private:
   /**
    * @brief Setup the MPI_Isend calls
    *
+   * @param comm the communicator
    * @param interfaces the vector of Interface objects
    * @param send_buffers (output) the buffers for the send requests. Should not be deallocated
    * until sends are done.
    * @param send_requests (output) MPI_Isend request status, one for each outgoing rank
    */
   static void SetupGlobalIndexSendRequests(
+    const Communicator& comm,
     const std::vector<std::shared_ptr<Interface<D>>>& interfaces,
     std::deque<std::vector<int>>& send_buffers,
     std::vector<MPI_Request>& send_requests)
   {
     std::map<int, std::set<std::pair<int, int>>> rank_to_id_and_global_index_pairs;
-    GetGlobalIndexesToSend(interfaces, rank_to_id_and_global_index_pairs);
+    GetGlobalIndexesToSend(comm.getRank(), interfaces, rank_to_id_and_global_index_pairs);
 
     for (auto pair : rank_to_id_and_global_index_pairs) {
       send_buffers.emplace_back();
@@ -488,7 +496,7 @@ private:
                 MPI_INT,
                 pair.first,
                 0,
-                MPI_COMM_WORLD,
+                comm.getMPIComm(),
                 &request);
       send_requests.push_back(request);
     }
@@ -496,16 +504,16 @@ private:
   /**
    * @brief Get the global indexes that have to be sent
    *
+   * @param rank the rank of this processor
    * @param interfaces the vector of Interface objects
    * @param rank_to_id_and_global_index_pairs (output) Map from rank of incoming process to set
    * of pairs of ids and global indexes
    */
   static void GetGlobalIndexesToSend(
+    int rank,
     const std::vector<std::shared_ptr<Interface<D>>>& interfaces,
     std::map<int, std::set<std::pair<int, int>>>& rank_to_id_and_global_index_pairs)
   {
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     for (auto iface : interfaces) {
       for (auto patch : iface->patches) {
         auto piinfo = patch.piinfo;
@@ -530,7 +538,7 @@ private:
         if (patch.type.isNormal() || patch.type.isCoarseToCoarse() || patch.type.isFineToFine()) {
           // this interface will affect the values of the outer interfaces
           GetGlobalIndexesToSendForOuterInterfaces(
-            iface, piinfo, rank_to_id_and_global_index_pairs);
+            rank, iface, piinfo, rank_to_id_and_global_index_pairs);
         }
       }
     }
@@ -538,18 +546,18 @@ private:
   /**
    * @brief Get global indexes that have to be sent for patch
    *
+   * @param rank the rank of this processor
    * @param interface the Interface that we are sending the global index from
    * @param piinfo the PatchIfaceInfo object
    * @param rank_to_id_to_global_indexes_to_set (output) Map from rank of incoming process to
    * id of interface to pointers to global index values that have to be set
    */
   static void GetGlobalIndexesToSendForOuterInterfaces(
+    int rank,
     std::shared_ptr<const Interface<D>> interface,
     std::shared_ptr<const PatchIfaceInfo<D>> piinfo,
     std::map<int, std::set<std::pair<int, int>>>& rank_to_id_and_global_index_pairs)
   {
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     for (Side<D> s : Side<D>::getValues()) {
       if (piinfo->pinfo.hasNbr(s)) {
         NbrType nbr_type = piinfo->pinfo.getNbrType(s);
@@ -584,8 +592,8 @@ public:
     : domain(domain)
   {
     iface_ns.fill(domain.getNs()[0]);
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    const Communicator& comm = domain.getCommunicator();
+    int rank = comm.getRank();
 
     std::vector<std::shared_ptr<PatchIfaceInfo<D>>> piinfos_non_const;
     piinfos.reserve(domain.getNumLocalPatches());
@@ -597,11 +605,12 @@ public:
 
     std::map<int, std::map<int, std::shared_ptr<Schur::Interface<D>>>> rank_id_iface_map;
     std::vector<std::shared_ptr<Schur::PatchIfaceInfo<D>>> off_proc_piinfos;
-    Interface<D>::EnumerateIfacesFromPiinfoVector(piinfos, rank_id_iface_map, off_proc_piinfos);
+    Interface<D>::EnumerateIfacesFromPiinfoVector(
+      comm, piinfos, rank_id_iface_map, off_proc_piinfos);
 
     std::vector<std::shared_ptr<Schur::Interface<D>>> interfaces_non_const;
     IndexIfacesLocal(rank_id_iface_map[rank], piinfos_non_const, interfaces_non_const);
-    IndexIfacesGlobal(interfaces_non_const, piinfos_non_const);
+    IndexIfacesGlobal(comm, interfaces_non_const, piinfos_non_const);
 
     interfaces.reserve(interfaces_non_const.size());
     for (auto iface : interfaces_non_const) {
@@ -609,7 +618,8 @@ public:
     }
 
     int num_ifaces = interfaces.size();
-    MPI_Allreduce(&num_ifaces, &num_global_ifaces, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(
+      &num_ifaces, &num_global_ifaces, 1, MPI_INT, MPI_SUM, comm.getMPIComm());
   }
 
   /**
@@ -36,19 +36,96 @@ namespace Schur {
  * The scatters functions are split with a Start and Finish, this allows for local computation to
  * occur while the communicating
  *
+ * The communication uses the communicator of the InterfaceDomain. The buffers and persistent MPI
+ * requests are created on the first scatter and reused after that, so only one scatter can be in
+ * progress at a time.
+ *
  * @tparam D the number of cartesian dimensions on a patch
  */
 template<int D>
 class PatchIfaceScatter
 {
 private:
-  class StatePrivate
+  /**
+   * @brief The buffers and persistent requests, these are created on the first scatter and reused
+   * for every scatter after that
+   */
+  class Buffers
   {
   public:
     std::vector<std::vector<double>> send_buffers;
     std::vector<std::vector<double>> recv_buffers;
     std::vector<MPI_Request> send_requests;
     std::vector<MPI_Request> recv_requests;
+    /**
+     * @brief true if the requests have been started and not completed
+     */
+    bool communicating = false;
+
+    Buffers(size_t send_buffers_size, size_t recv_buffers_size)
+      : send_buffers(send_buffers_size)
+      , recv_buffers(recv_buffers_size)
+      , send_requests(send_buffers_size, MPI_REQUEST_NULL)
+      , recv_requests(recv_buffers_size, MPI_REQUEST_NULL)
+    {}
+    Buffers(const Buffers&) = delete;
+    Buffers& operator=(const Buffers&) = delete;
+    /**
+     * @brief Wait for all of the requests to complete
+     */
+    void waitAll()
+    {
+      MPI_Waitall(recv_requests.size(), recv_requests.data(), MPI_STATUSES_IGNORE);
+      MPI_Waitall(send_requests.size(), send_requests.data(), MPI_STATUSES_IGNORE);
+      communicating = false;
+    }
+    ~Buffers()
+    {
+      int finalized;
+      MPI_Finalized(&finalized);
+      if (!finalized) {
+        if (communicating) {
+          waitAll();
+        }
+        for (MPI_Request& request : send_requests) {
+          if (request != MPI_REQUEST_NULL) {
+            MPI_Request_free(&request);
+          }
+        }
+        for (MPI_Request& request : recv_requests) {
+          if (request != MPI_REQUEST_NULL) {
+            MPI_Request_free(&request);
+          }
+        }
+      }
+    }
+  };
+  /**
+   * @brief Holds the Buffers of a PatchIfaceScatter, copies of the scatter get their own buffers
+   */
+  class BuffersHolder
+  {
+  public:
+    std::shared_ptr<Buffers> ptr;
+    BuffersHolder() = default;
+    BuffersHolder(const BuffersHolder&) {}
+    BuffersHolder& operator=(const BuffersHolder&)
+    {
+      ptr = nullptr;
+      return *this;
+    }
+  };
+
+  class StatePrivate
+  {
+  public:
+    /**
+     * @brief The buffers that are being communicated
+     */
+    std::shared_ptr<Buffers> buffers;
+    /**
+     * @brief true if the scatter of this state has not been finished
+     */
     bool communicating = true;
     /**
      * @brief The global vector passed to scatterStart
@@ -59,17 +136,13 @@ private:
      */
     const Vector<D - 1>* curr_local_vector = nullptr;
 
-    StatePrivate(size_t send_buffers_size, size_t recv_buffers_size)
-      : send_buffers(send_buffers_size)
-      , recv_buffers(recv_buffers_size)
-      , send_requests(send_buffers_size)
-      , recv_requests(recv_buffers_size)
+    explicit StatePrivate(std::shared_ptr<Buffers> buffers)
+      : buffers(buffers)
     {}
     ~StatePrivate()
     {
       if (communicating) {
-        MPI_Waitall(recv_requests.size(), recv_requests.data(), MPI_STATUSES_IGNORE);
-        MPI_Waitall(send_requests.size(), send_requests.data(), MPI_STATUSES_IGNORE);
+        buffers->waitAll();
       }
     }
   };
@@ -78,11 +151,20 @@ private:
   {
   public:
     std::shared_ptr<StatePrivate> ptr;
-    State(size_t num_send, size_t num_recv)
-      : ptr(new StatePrivate(num_send, num_recv))
+    explicit State(std::shared_ptr<Buffers> buffers)
+      : ptr(new StatePrivate(buffers))
     {}
   };
 
+  /**
+   * @brief The communicator of the InterfaceDomain
+   */
+  Communicator comm;
+  /**
+   * @brief The buffers, created on the first scatter
+   */
+  mutable BuffersHolder buffers;
+
 public:
   /**
    * @brief the number of cells in each direction of the interface
@@ -129,8 +211,7 @@ public:
    */
   void setIncomingBufferMapsAndDetermineLocalVectorSize(const InterfaceDomain<D>& iface_domain)
   {
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    int rank = comm.getRank();
 
     std::map<int, std::set<std::pair<int, int>>> incoming_ranks_to_id_local_index_pairs;
 
@@ -176,8 +257,7 @@ public:
    */
   void setOutgoingBufferMaps(const InterfaceDomain<D>& iface_domain)
   {
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    int rank = comm.getRank();
 
     std::map<int, std::set<std::pair<int, int>>> outgoing_ranks_to_id_local_index_pairs;
     for (auto iface : iface_domain.getInterfaces()) {
@@ -208,23 +288,37 @@ public:
     }
   }
   /**
-   * @brief Initialize the mpi buffers
+   * @brief Initialize the mpi buffers and the persistent requests
    */
-  State initializeMPIBuffers() const
+  std::shared_ptr<Buffers> initializeMPIBuffers() const
   {
-    State state(send_ranks.size(), recv_ranks.size());
+    auto new_buffers = std::make_shared<Buffers>(send_ranks.size(), recv_ranks.size());
 
     for (int send_index = 0; send_index < num_sends; send_index++) {
-      state.ptr->send_buffers[send_index].resize(send_local_indexes[send_index].size() *
-                                                 iface_stride);
+      std::vector<double>& buffer = new_buffers->send_buffers[send_index];
+      buffer.resize(send_local_indexes[send_index].size() * iface_stride);
+      MPI_Send_init(buffer.data(),
+                    buffer.size(),
+                    MPI_DOUBLE,
+                    send_ranks[send_index],
+                    0,
+                    comm.getMPIComm(),
+                    &new_buffers->send_requests[send_index]);
     }
 
     for (int recv_index = 0; recv_index < num_recvs; recv_index++) {
-      state.ptr->recv_buffers[recv_index].resize(recv_local_indexes[recv_index].size() *
-                                                 iface_stride);
+      std::vector<double>& buffer = new_buffers->recv_buffers[recv_index];
+      buffer.resize(recv_local_indexes[recv_index].size() * iface_stride);
+      MPI_Recv_init(buffer.data(),
+                    buffer.size(),
+                    MPI_DOUBLE,
+                    recv_ranks[recv_index],
+                    0,
+                    comm.getMPIComm(),
+                    &new_buffers->recv_requests[recv_index]);
     }
 
-    return state;
+    return new_buffers;
   }
 
 public:
@@ -234,6 +328,7 @@ public:
    * @param iface_domain the InterfaceDomain
    */
   explicit PatchIfaceScatter(const InterfaceDomain<D>& iface_domain)
+    : comm(iface_domain.getDomain().getCommunicator())
   {
     std::array<int, D> ns = iface_domain.getDomain().getNs();
     for (int i = 1; i < D; i++) {
@@ -273,29 +368,21 @@ public:
   State scatterStart(const Vector<D - 1>& global_vector,
                      Vector<D - 1>& local_patch_iface_vector) const
   {
-    for (int i = 0; i < global_vector.getNumLocalPatches(); i++) {
-      auto global_data = global_vector.getComponentView(0, i);
-      auto local_data = local_patch_iface_vector.getComponentView(0, i);
-      Loop::Nested<D - 1>(
-        local_data.getStart(), local_data.getEnd(), [&](const std::array<int, D - 1>& coord) {
-          local_data[coord] = global_data[coord];
-        });
+    if (buffers.ptr == nullptr) {
+      buffers.ptr = initializeMPIBuffers();
     }
+    if (buffers.ptr->communicating) {
+      throw RuntimeError("scatterStart was called while a scatter was in progress");
+    }
+    State state(buffers.ptr);
 
-    State state = initializeMPIBuffers();
-
-    for (int recv_index = 0; recv_index < num_recvs; recv_index++) {
-      MPI_Irecv(state.ptr->recv_buffers[recv_index].data(),
-                state.ptr->recv_buffers[recv_index].size(),
-                MPI_DOUBLE,
-                recv_ranks[recv_index],
-                0,
-                MPI_COMM_WORLD,
-                &state.ptr->recv_requests[recv_index]);
+    if (num_recvs > 0) {
+      MPI_Startall(num_recvs, buffers.ptr->recv_requests.data());
     }
+    buffers.ptr->communicating = true;
 
     for (int send_index = 0; send_index < num_sends; send_index++) {
-      std::vector<double>& buffer = state.ptr->send_buffers[send_index];
+      std::vector<double>& buffer = buffers.ptr->send_buffers[send_index];
 
       int buffer_index = 0;
       for (int local_index : send_local_indexes[send_index]) {
@@ -306,13 +393,7 @@ public:
         });
       }
 
-      MPI_Isend(buffer.data(),
-                buffer.size(),
-                MPI_DOUBLE,
-                send_ranks[send_index],
-                0,
-                MPI_COMM_WORLD,
-                &state.ptr->send_requests[send_index]);
+      MPI_Start(&buffers.ptr->send_requests[send_index]);
     }
 
     for (int local_iface = 0; local_iface < global_vector.getNumLocalPatches(); local_iface++) {
@@ -350,9 +431,9 @@ public:
     for (int i = 0; i < num_recvs; i++) {
       MPI_Status status;
       int recv_index;
-      MPI_Waitany(num_recvs, state.ptr->recv_requests.data(), &recv_index, &status);
+      MPI_Waitany(num_recvs, state.ptr->buffers->recv_requests.data(), &recv_index, &status);
 
-      std::vector<double>& buffer = state.ptr->recv_buffers[recv_index];
+      std::vector<double>& buffer = state.ptr->buffers->recv_buffers[recv_index];
 
       int buffer_index = 0;
       for (int local_index : recv_local_indexes[recv_index]) {
@@ -364,8 +445,9 @@ public:
       }
     }
 
-    MPI_Waitall(num_sends, state.ptr->send_requests.data(), MPI_STATUSES_IGNORE);
+    MPI_Waitall(num_sends, state.ptr->buffers->send_requests.data(), MPI_STATUSES_IGNORE);
 
+    state.ptr->buffers->communicating = false;
     state.ptr->communicating = false;
   }
 };
@@ -28,12 +28,19 @@
 
 #include <ThunderEgg/PatchSolver.h>
 #include <ThunderEgg/Schur/PatchIfaceScatter.h>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 namespace ThunderEgg {
 namespace Schur {
 /**
  * @brief Creates a Schur compliment matrix operator for an InterfaceDomain by using a PatchSolver.
  *
+ * The patches can be solved with multiple threads, see setNumThreads. The vectors used for the
+ * domain solution are allocated once and reused for each apply.
+ *
  * @tparam D the number of Cartesian dimensions
  */
 template<int D>
@@ -60,6 +67,74 @@ private:
    * @brief Set of patches that have interafce on neighboring ranks
    */
   std::deque<std::shared_ptr<const PatchIfaceInfo<D>>> patches_with_ifaces_on_neighbor_rank;
+  /**
+   * @brief The number of threads used for the patch solves
+   */
+  int num_threads = 1;
+  /**
+   * @brief Workspace for the domain solution
+   */
+  mutable Vector<D> u;
+  /**
+   * @brief Workspace for the domain rhs, this is always zero
+   */
+  mutable Vector<D> f;
+  /**
+   * @brief Workspace for the local patch iface vector
+   */
+  mutable Vector<D - 1> local_x;
+
+  /**
+   * @brief Solve a set of patches, the patches are split between the calling thread and
+   * num_threads - 1 additional threads
+   *
+   * Additional threads are only used if the PatchSolver reports that solveSinglePatch is thread
+   * safe, which also means that it does not make MPI calls.
+   *
+   * @param piinfos the patches to solve
+   * @param f the rhs
+   * @param u the solution
+   */
+  template<typename Container>
+  void solvePatches(const Container& piinfos, const Vector<D>& f, Vector<D>& u) const
+  {
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto worker = [&]() {
+      try {
+        for (size_t i = next++; i < piinfos.size(); i = next++) {
+          const PatchInfo<D>& pinfo = piinfos[i]->pinfo;
+          PatchView<double, D> u_view = u.getPatchView(pinfo.local_index);
+          PatchView<const double, D> f_view = f.getPatchView(pinfo.local_index);
+          solver->solveSinglePatch(pinfo, f_view, u_view);
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        next = piinfos.size();
+      }
+    };
+
+    // a Timer is not thread safe, so patches are not solved concurrently when the domain has one
+    bool threaded = solver->isThreadSafe() && !solver->getDomain().hasTimer();
+    int num_workers = threaded ? num_threads - 1 : 0;
+    num_workers = std::min<int>(num_workers, piinfos.size());
+    std::vector<std::thread> workers;
+    workers.reserve(num_workers);
+    for (int i = 0; i < num_workers; i++) {
+      workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : workers) {
+      thread.join();
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
 
 public:
   /**
@@ -72,6 +147,9 @@ public:
     : iface_domain(std::make_shared<InterfaceDomain<D>>(iface_domain))
     , solver(solver.clone())
     , scatter(iface_domain)
+    , u(solver.getDomain(), 1)
+    , f(solver.getDomain(), 1)
+    , local_x(*scatter.getNewLocalPatchIfaceVector())
   {
     int rank;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
@@ -94,6 +172,27 @@ public:
    * @return PatchSolverWrapper<D>* a newly allocated copy of this PatchSolverWrapper
    */
   PatchSolverWrapper<D>* clone() const override { return new PatchSolverWrapper<D>(*this); }
+  /**
+   * @brief Set the number of threads used to solve the patches
+   *
+   * If the PatchSolver is not thread safe (see PatchSolver::isThreadSafe), or if the Domain has a
+   * Timer, the patches are solved on a single thread.
+   *
+   * @param num_threads the number of threads, including the calling thread
+   */
+  void setNumThreads(int num_threads)
+  {
+    if (num_threads < 1) {
+      throw RuntimeError("The number of threads has to be at least 1");
+    }
+    this->num_threads = num_threads;
+  }
+  /**
+   * @brief Get the number of threads used to solve the patches
+   *
+   * @return int the number of threads
+   */
+  int getNumThreads() const { return num_threads; }
   /**
    * @brief Apply Schur matrix
    *
@@ -105,12 +204,10 @@ public:
     int rank;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
-    Vector<D> u(solver->getDomain(), 1);
-    Vector<D> f(solver->getDomain(), 1);
+    u.setWithGhost(0);
 
     // scatter local iface vector
-    auto local_x = scatter.getNewLocalPatchIfaceVector();
-    auto state = scatter.scatterStart(x, *local_x);
+    auto state = scatter.scatterStart(x, local_x);
 
     // each patch has a local interface, go ahead and set the ghost values using those
     // interfaces
@@ -119,21 +216,17 @@ public:
         auto local_data = u.getComponentView(0, piinfo->pinfo.local_index);
         if (piinfo->pinfo.hasNbr(s) && piinfo->getIfaceInfo(s)->rank == rank) {
           auto ghosts = local_data.getSliceOn(s, { -1 });
-          auto interface = local_x->getComponentView(0, piinfo->getIfaceInfo(s)->patch_local_index);
+          auto interface = local_x.getComponentView(0, piinfo->getIfaceInfo(s)->patch_local_index);
           Loop::OverInteriorIndexes<D - 1>(interface, [&](const std::array<int, D - 1>& coord) {
             ghosts[coord] = 2 * interface[coord];
           });
         }
       }
     }
-    // go ahead and solve for patches with only local interfaces
-    for (auto piinfo : patches_with_only_local_ifaces) {
-      PatchView<double, D> u_view = u.getPatchView(piinfo->pinfo.local_index);
-      PatchView<double, D> f_view = f.getPatchView(piinfo->pinfo.local_index);
-      solver->solveSinglePatch(piinfo->pinfo, f_view, u_view);
-    }
+    // go ahead and solve for patches with only local interfaces while the scatter is in flight
+    solvePatches(patches_with_only_local_ifaces, f, u);
 
-    scatter.scatterFinish(state, x, *local_x);
+    scatter.scatterFinish(state, x, local_x);
 
     // set ghosts using interfaces that were on a neighboring rank
     for (auto piinfo : patches_with_ifaces_on_neighbor_rank) {
@@ -141,7 +234,7 @@ public:
         auto local_data = u.getComponentView(0, piinfo->pinfo.local_index);
         if (piinfo->pinfo.hasNbr(s) && piinfo->getIfaceInfo(s)->rank != rank) {
           auto ghosts = local_data.getSliceOn(s, { -1 });
-          auto interface = local_x->getComponentView(0, piinfo->getIfaceInfo(s)->patch_local_index);
+          auto interface = local_x.getComponentView(0, piinfo->getIfaceInfo(s)->patch_local_index);
           Loop::OverInteriorIndexes<D - 1>(interface, [&](const std::array<int, D - 1>& coord) {
             ghosts[coord] = 2 * interface[coord];
           });
@@ -149,11 +242,7 @@ public:
       }
     }
     // solve the remaining patches
-    for (auto piinfo : patches_with_ifaces_on_neighbor_rank) {
-      PatchView<double, D> u_view = u.getPatchView(piinfo->pinfo.local_index);
-      PatchView<double, D> f_view = f.getPatchView(piinfo->pinfo.local_index);
-      solver->solveSinglePatch(piinfo->pinfo, f_view, u_view);
-    }
+    solvePatches(patches_with_ifaces_on_neighbor_rank, f, u);
 
     solver->getGhostFiller().fillGhost(u);
 
@@ -187,7 +276,7 @@ public:
     int rank;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
-    Vector<D> u(solver->getDomain(), 1);
+    u.setWithGhost(0);
 
     for (auto piinfo : iface_domain->getPatchIfaceInfos()) {
       for (Side<D> s : Side<D>::getValues()) {
@@ -202,11 +291,7 @@ public:
         }
       }
     }
-    for (auto piinfo : iface_domain->getPatchIfaceInfos()) {
-      PatchView<double, D> u_view = u.getPatchView(piinfo->pinfo.local_index);
-      PatchView<const double, D> f_view = domain_b.getPatchView(piinfo->pinfo.local_index);
-      solver->solveSinglePatch(piinfo->pinfo, f_view, u_view);
-    }
+    solvePatches(iface_domain->getPatchIfaceInfos(), domain_b, u);
 
     solver->getGhostFiller().fillGhost(u);
 
@@ -0,0 +1,184 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef THUNDEREGG_SPACEFILLINGCURVE_H
+#define THUNDEREGG_SPACEFILLINGCURVE_H
+/**
+ * @file
+ *
+ * @brief SpaceFillingCurve class
+ */
+#include <ThunderEgg/Communicator.h>
+#include <ThunderEgg/PatchInfo.h>
+#include <ThunderEgg/PatchOrdering.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace ThunderEgg {
+/**
+ * @brief Morton and Hilbert indexes of points on an integer grid, used to order patches
+ *
+ * Points are given as integer coordinates on a grid with 2^bits points along each axis. The
+ * indexes of the points along both curves fit in 64 bits.
+ *
+ * @tparam D the number of Cartesian dimensions
+ */
+template<int D>
+class SpaceFillingCurve
+{
+public:
+  /**
+   * @brief the number of bits in each coordinate, at most 32 so that the coordinates fit in a
+   * uint32_t
+   */
+  static constexpr int bits = 63 / D < 32 ? 63 / D : 32;
+  /**
+   * @brief Get the Morton index of a point
+   *
+   * The bits of the coordinates are interleaved, with axis 0 as the lowest bit of each group.
+   *
+   * @param coord the coordinates of the point, each has to be less than 2^bits
+   * @return uint64_t the index
+   */
+  static uint64_t getMortonIndex(const std::array<uint32_t, D>& coord)
+  {
+    uint64_t index = 0;
+    for (int bit = bits - 1; bit >= 0; bit--) {
+      for (int axis = D - 1; axis >= 0; axis--) {
+        index = (index << 1) | ((coord[axis] >> bit) & 1);
+      }
+    }
+    return index;
+  }
+  /**
+   * @brief Get the Hilbert index of a point
+   *
+   * This uses the transpose algorithm of Skilling, "Programming the Hilbert curve", AIP Conference
+   * Proceedings 707, 2004.
+   *
+   * @param coord the coordinates of the point, each has to be less than 2^bits
+   * @return uint64_t the index
+   */
+  static uint64_t getHilbertIndex(std::array<uint32_t, D> coord)
+  {
+    // inverse undo excess work
+    for (uint32_t q = (uint32_t)1 << (bits - 1); q > 1; q >>= 1) {
+      uint32_t p = q - 1;
+      for (int axis = 0; axis < D; axis++) {
+        if (coord[axis] & q) {
+          // invert
+          coord[0] ^= p;
+        } else {
+          // exchange
+          uint32_t t = (coord[0] ^ coord[axis]) & p;
+          coord[0] ^= t;
+          coord[axis] ^= t;
+        }
+      }
+    }
+    // gray encode
+    for (int axis = 1; axis < D; axis++) {
+      coord[axis] ^= coord[axis - 1];
+    }
+    uint32_t t = 0;
+    for (uint32_t q = (uint32_t)1 << (bits - 1); q > 1; q >>= 1) {
+      if (coord[D - 1] & q) {
+        t ^= q - 1;
+      }
+    }
+    for (int axis = 0; axis < D; axis++) {
+      coord[axis] ^= t;
+    }
+    // the index is the transpose interleaved with axis 0 as the highest bit of each group
+    uint64_t index = 0;
+    for (int bit = bits - 1; bit >= 0; bit--) {
+      for (int axis = 0; axis < D; axis++) {
+        index = (index << 1) | ((coord[axis] >> bit) & 1);
+      }
+    }
+    return index;
+  }
+  /**
+   * @brief Sort patches along a space filling curve through their lower corners
+   *
+   * The corners are placed on a grid over the bounding box of the patches on all ranks of the
+   * communicator, so the order is consistent across the levels of a multigrid hierarchy: a parent
+   * patch has the same index as the child in its lower orthant, and is placed near its children.
+   * Patches with the same index keep their relative order.
+   *
+   * This has to be called on all ranks of the communicator.
+   *
+   * @param pinfos the patches
+   * @param ordering the ordering, nothing is done for PatchOrdering::Given
+   * @param comm the communicator
+   */
+  static void sortPatches(std::vector<PatchInfo<D>>& pinfos,
+                          PatchOrdering ordering,
+                          const Communicator& comm)
+  {
+    if (ordering == PatchOrdering::Given) {
+      return;
+    }
+    // bounding box, the lower bounds are negated so that one reduction finds both
+    std::array<double, 2 * D> bounds;
+    bounds.fill(-std::numeric_limits<double>::max());
+    for (const PatchInfo<D>& pinfo : pinfos) {
+      for (int axis = 0; axis < D; axis++) {
+        double upper = pinfo.starts[axis] + pinfo.ns[axis] * pinfo.spacings[axis];
+        bounds[axis] = std::max(bounds[axis], -pinfo.starts[axis]);
+        bounds[D + axis] = std::max(bounds[D + axis], upper);
+      }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, bounds.data(), 2 * D, MPI_DOUBLE, MPI_MAX, comm.getMPIComm());
+
+    const double grid_size = std::ldexp(1.0, bits);
+    std::vector<std::pair<uint64_t, size_t>> indexes_and_positions;
+    indexes_and_positions.reserve(pinfos.size());
+    for (size_t i = 0; i < pinfos.size(); i++) {
+      std::array<uint32_t, D> coord;
+      for (int axis = 0; axis < D; axis++) {
+        double lower = -bounds[axis];
+        double length = bounds[D + axis] - lower;
+        double x = (pinfos[i].starts[axis] - lower) / length * grid_size;
+        coord[axis] = (uint32_t)std::min(std::max(x, 0.0), grid_size - 1);
+      }
+      uint64_t index = ordering == PatchOrdering::Morton ? getMortonIndex(coord)
+                                                         : getHilbertIndex(coord);
+      indexes_and_positions.emplace_back(index, i);
+    }
+    // pairs with the same index are ordered by position
+    std::sort(indexes_and_positions.begin(), indexes_and_positions.end());
+
+    std::vector<PatchInfo<D>> sorted_pinfos;
+    sorted_pinfos.reserve(pinfos.size());
+    for (const auto& index_and_position : indexes_and_positions) {
+      sorted_pinfos.push_back(std::move(pinfos[index_and_position.second]));
+    }
+    pinfos.swap(sorted_pinfos);
+  }
+};
+extern template class SpaceFillingCurve<2>;
+extern template class SpaceFillingCurve<3>;
+} // namespace ThunderEgg
+#endif
@@ -0,0 +1,732 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef THUNDEREGG_SPARSEMATRIX_H
+#define THUNDEREGG_SPARSEMATRIX_H
+/**
+ * @file
+ *
+ * @brief SparseMatrix class
+ */
+
+#include <ThunderEgg/Domain.h>
+#include <ThunderEgg/Operator.h>
+#include <ThunderEgg/RuntimeError.h>
+#include <ThunderEgg/Vector.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace ThunderEgg {
+/**
+ * @brief A distributed block compressed sparse row matrix that applies directly to Vectors
+ *
+ * The rows and columns are numbered the same way as PETSc::MatWrapper numbers them: the local
+ * rows of each rank are contiguous, in order of rank, and each rank's rows go patch by patch,
+ * component by component, with the first axis varying fastest. A matrix assembled for a PETSc Mat
+ * can be assembled for a SparseMatrix by inserting the same values.
+ *
+ * The rows are grouped into blocks of block_size rows and the nonzeros are stored as dense
+ * block_size by block_size blocks (block_size 1 is plain CSR). The blocks are stored column-major
+ * so that the product of a block with a vector is a sequence of axpys that the compiler
+ * vectorizes.
+ *
+ * Values are added with addBlock() or addValues() and then assemble() is called once, which splits
+ * each row into the columns owned by this rank and the columns owned by other ranks, and builds
+ * the halo exchange plan for the off-rank columns. apply() reads from and writes to the storage of
+ * the Vectors directly, the only copies are the off-rank values in the halo exchange.
+ *
+ * @tparam D the number of Cartesian dimensions of the Vectors
+ */
+template<int D>
+class SparseMatrix : public Operator<D>
+{
+private:
+  /**
+   * @brief The assembled matrix and the halo exchange plan
+   */
+  struct Data
+  {
+    /**
+     * @brief the storage offset of the first row of each local block row
+     */
+    std::vector<int> row_offsets;
+    /**
+     * @brief the start of each block row in diag_cols, has one more element than the number of
+     * block rows
+     */
+    std::vector<int> diag_row_ptr;
+    /**
+     * @brief the storage offset of the first column of each local block
+     */
+    std::vector<int> diag_cols;
+    /**
+     * @brief the column-major values of each local block
+     */
+    std::vector<double> diag_values;
+    /**
+     * @brief the start of each block row in offd_cols, has one more element than the number of
+     * block rows
+     */
+    std::vector<int> offd_row_ptr;
+    /**
+     * @brief the offset into the halo buffer of the first column of each off-rank block
+     */
+    std::vector<int> offd_cols;
+    /**
+     * @brief the column-major values of each off-rank block
+     */
+    std::vector<double> offd_values;
+    /**
+     * @brief the ranks that values are sent to
+     */
+    std::vector<int> send_ranks;
+    /**
+     * @brief for each send rank, the storage offsets of the blocks of values that are sent
+     */
+    std::vector<std::vector<int>> send_offsets;
+    /**
+     * @brief the ranks that values are received from
+     */
+    std::vector<int> recv_ranks;
+    /**
+     * @brief the start of each recv rank's values in the halo buffer, has one more element than
+     * the number of recv ranks
+     */
+    std::vector<int> recv_starts;
+  };
+  /**
+   * @brief The buffers used in apply, these are reused between applies
+   */
+  struct Workspace
+  {
+    std::vector<double> halo;
+    std::vector<std::vector<double>> send_buffers;
+    std::vector<MPI_Request> send_requests;
+    std::vector<MPI_Request> recv_requests;
+  };
+  /**
+   * @brief the communicator
+   */
+  Communicator comm;
+  /**
+   * @brief the number of cells in each direction of a patch
+   */
+  std::array<int, D> ns;
+  /**
+   * @brief the number of components
+   */
+  int num_components;
+  /**
+   * @brief the number of local patches
+   */
+  int num_local_patches;
+  /**
+   * @brief the number of ghost cells of the Vectors
+   */
+  int num_ghost_cells;
+  /**
+   * @brief the number of rows in a block
+   */
+  int block_size;
+  /**
+   * @brief the strides of the Vector storage, the last one is the stride between components
+   */
+  std::array<int, D + 1> strides;
+  /**
+   * @brief the stride between patches in the Vector storage
+   */
+  int patch_stride;
+  /**
+   * @brief the number of rows on a patch
+   */
+  int patch_num_rows;
+  /**
+   * @brief the global index of the first local row
+   */
+  int first_row = 0;
+  /**
+   * @brief the number of local rows
+   */
+  int num_local_rows;
+  /**
+   * @brief the number of global rows
+   */
+  int num_global_rows = 0;
+  /**
+   * @brief the local block row of each block added before assembly
+   */
+  std::vector<int> pending_rows;
+  /**
+   * @brief the global block column of each block added before assembly
+   */
+  std::vector<int> pending_cols;
+  /**
+   * @brief the column-major values of the blocks added before assembly, blocks with the same row
+   * and column are summed in assemble()
+   */
+  std::vector<double> pending_values;
+  /**
+   * @brief the assembled matrix, null before assembly
+   */
+  std::shared_ptr<const Data> data;
+  /**
+   * @brief the buffers for apply
+   */
+  std::shared_ptr<Workspace> workspace = std::make_shared<Workspace>();
+
+  /**
+   * @brief Get the offset in the Vector storage of a local row
+   *
+   * @param local_row the local row
+   * @return int the offset from the first non-ghost cell of the first patch
+   */
+  int getStorageOffset(int local_row) const
+  {
+    int patch = local_row / patch_num_rows;
+    int index = local_row % patch_num_rows;
+    int num_cells = patch_num_rows / num_components;
+    int offset = patch * patch_stride + (index / num_cells) * strides[D];
+    index = index % num_cells;
+    for (int i = 0; i < D; i++) {
+      offset += (index % ns[i]) * strides[i];
+      index /= ns[i];
+    }
+    return offset;
+  }
+  /**
+   * @brief Get the values of a pending block to add to
+   *
+   * Blocks are appended, unless the block is the same as the last one that was added to.
+   *
+   * @param block_row the global block row
+   * @param block_col the global block column
+   * @return double* the column-major values
+   */
+  double* getPendingBlock(int block_row, int block_col)
+  {
+    if (data != nullptr) {
+      throw RuntimeError("SparseMatrix values can not be added after assembly");
+    }
+    int local_block_row = block_row - first_row / block_size;
+    if (local_block_row < 0 || local_block_row >= num_local_rows / block_size) {
+      throw RuntimeError("SparseMatrix row is not on this rank");
+    }
+    if (block_col < 0 || block_col >= num_global_rows / block_size) {
+      throw RuntimeError("SparseMatrix column is out of range");
+    }
+    size_t block_values_size = (size_t)block_size * block_size;
+    if (pending_rows.empty() || pending_rows.back() != local_block_row ||
+        pending_cols.back() != block_col) {
+      pending_rows.push_back(local_block_row);
+      pending_cols.push_back(block_col);
+      pending_values.resize(pending_values.size() + block_values_size, 0.0);
+    }
+    return pending_values.data() + pending_values.size() - block_values_size;
+  }
+  /**
+   * @brief Get a pointer to the first non-ghost cell of the first patch of a vector, and check
+   * that the vector has the layout that this matrix was created for
+   *
+   * @param vec the vector
+   * @return T* the pointer, null if there are no local patches
+   */
+  template<typename T, class VecType>
+  static T* getStoragePtr(const SparseMatrix<D>& A, VecType& vec)
+  {
+    if (vec.getNumLocalPatches() != A.num_local_patches ||
+        vec.getNumComponents() != A.num_components ||
+        vec.getNumGhostCells() != A.num_ghost_cells ||
+        vec.getNumLocalCells() * A.num_components != A.num_local_rows) {
+      throw RuntimeError("Vector does not match the layout of the SparseMatrix");
+    }
+    if (A.num_local_patches == 0) {
+      return nullptr;
+    }
+    std::array<int, D + 1> zero;
+    zero.fill(0);
+    T* ptr = &vec.getPatchView(0)[zero];
+    for (int i = 1; i < A.num_local_patches; i++) {
+      if (&vec.getPatchView(i)[zero] != ptr + i * A.patch_stride) {
+        throw RuntimeError("SparseMatrix requires Vectors with evenly spaced patches");
+      }
+    }
+    return ptr;
+  }
+  /**
+   * @brief y += A x for a column-major block
+   *
+   * Each column is an axpy, which the compiler vectorizes along the rows
+   *
+   * @param bs the block size
+   * @param block the values of the block
+   * @param x the input values
+   * @param y the output values
+   */
+  static inline void multiplyAddBlock(int bs,
+                                      const double* __restrict block,
+                                      const double* __restrict x,
+                                      double* __restrict y)
+  {
+    for (int c = 0; c < bs; c++) {
+      double x_c = x[c];
+      const double* col = block + c * bs;
+      for (int r = 0; r < bs; r++) {
+        y[r] += col[r] * x_c;
+      }
+    }
+  }
+  /**
+   * @brief y += A x for each block row
+   *
+   * @param row_ptr the start of each block row in cols
+   * @param cols the offset of each block's column in x
+   * @param values the values of the blocks
+   * @param x the input values
+   * @param y the output values
+   */
+  void multiplyAdd(const std::vector<int>& row_ptr,
+                   const std::vector<int>& cols,
+                   const std::vector<double>& values,
+                   const double* x,
+                   double* y) const
+  {
+    const std::vector<int>& row_offsets = data->row_offsets;
+    int num_block_rows = (int)row_offsets.size();
+    int bs = block_size;
+    if (bs == 1) {
+      for (int i = 0; i < num_block_rows; i++) {
+        double sum = 0;
+        for (int k = row_ptr[i]; k < row_ptr[i + 1]; k++) {
+          sum += values[k] * x[cols[k]];
+        }
+        y[row_offsets[i]] += sum;
+      }
+    } else {
+      for (int i = 0; i < num_block_rows; i++) {
+        double* y_block = y + row_offsets[i];
+        for (int k = row_ptr[i]; k < row_ptr[i + 1]; k++) {
+          multiplyAddBlock(bs, values.data() + (size_t)k * bs * bs, x + cols[k], y_block);
+        }
+      }
+    }
+  }
+
+public:
+  /**
+   * @brief Construct a new SparseMatrix object
+   *
+   * This is collective on the communicator.
+   *
+   * @param comm the communicator
+   * @param ns the number of cells in each direction of a patch
+   * @param num_components the number of components
+   * @param num_local_patches the number of local patches
+   * @param num_ghost_cells the number of ghost cells of the Vectors that the matrix will be
+   * applied to
+   * @param block_size the number of rows in a block. The rows of a block have to be contiguous in
+   * the Vector storage, so it has to divide ns[0] unless there are no ghost cells, and it has to
+   * divide the number of rows on a patch.
+   */
+  SparseMatrix(const Communicator& comm,
+               const std::array<int, D>& ns,
+               int num_components,
+               int num_local_patches,
+               int num_ghost_cells,
+               int block_size = 1)
+    : comm(comm)
+    , ns(ns)
+    , num_components(num_components)
+    , num_local_patches(num_local_patches)
+    , num_ghost_cells(num_ghost_cells)
+    , block_size(block_size)
+  {
+    int size = 1;
+    int num_cells = 1;
+    for (int i = 0; i < D; i++) {
+      strides[i] = size;
+      size *= ns[i] + 2 * num_ghost_cells;
+      num_cells *= ns[i];
+    }
+    strides[D] = size;
+    patch_stride = size * num_components;
+    patch_num_rows = num_cells * num_components;
+    num_local_rows = patch_num_rows * num_local_patches;
+
+    if (block_size < 1 || patch_num_rows % block_size != 0 ||
+        (num_ghost_cells > 0 && ns[0] % block_size != 0)) {
+      throw RuntimeError("SparseMatrix block size has to divide the rows of a patch");
+    }
+
+    MPI_Exscan(&num_local_rows, &first_row, 1, MPI_INT, MPI_SUM, comm.getMPIComm());
+    if (comm.getRank() == 0) {
+      first_row = 0;
+    }
+    MPI_Allreduce(&num_local_rows, &num_global_rows, 1, MPI_INT, MPI_SUM, comm.getMPIComm());
+  }
+  /**
+   * @brief Construct a new SparseMatrix object for the Vectors of a Domain
+   *
+   * This is collective on the communicator of the domain.
+   *
+   * @param domain the domain
+   * @param num_components the number of components
+   * @param block_size the number of rows in a block
+   */
+  SparseMatrix(const Domain<D>& domain, int num_components, int block_size = 1)
+    : SparseMatrix(domain.getCommunicator(),
+                   domain.getNs(),
+                   num_components,
+                   domain.getNumLocalPatches(),
+                   domain.getNumGhostCells(),
+                   block_size)
+  {}
+  /**
+   * @brief Clone this matrix
+   *
+   * The assembled values are shared with the clone
+   *
+   * @return SparseMatrix<D>* a newly allocated copy
+   */
+  SparseMatrix<D>* clone() const override
+  {
+    SparseMatrix<D>* copy = new SparseMatrix<D>(*this);
+    copy->workspace = std::make_shared<Workspace>();
+    return copy;
+  }
+  /**
+   * @brief Add a block of values
+   *
+   * @param block_row the global block row, has to be on this rank
+   * @param block_col the global block column
+   * @param values the block_size by block_size values, in row-major order
+   */
+  void addBlock(int block_row, int block_col, const double* values)
+  {
+    double* block = getPendingBlock(block_row, block_col);
+    int bs = block_size;
+    for (int r = 0; r < bs; r++) {
+      for (int c = 0; c < bs; c++) {
+        block[r + c * bs] += values[r * bs + c];
+      }
+    }
+  }
+  /**
+   * @brief Add values to a row
+   *
+   * @param row the global row, has to be on this rank
+   * @param num_cols the number of columns
+   * @param cols the global columns
+   * @param values the values for each column
+   */
+  void addValues(int row, int num_cols, const int* cols, const double* values)
+  {
+    int bs = block_size;
+    if (row < 0) {
+      throw RuntimeError("SparseMatrix row is not on this rank");
+    }
+    for (int k = 0; k < num_cols; k++) {
+      if (cols[k] < 0) {
+        throw RuntimeError("SparseMatrix column is out of range");
+      }
+      double* block = getPendingBlock(row / bs, cols[k] / bs);
+      block[row % bs + (cols[k] % bs) * bs] += values[k];
+    }
+  }
+  /**
+   * @brief Assemble the matrix, after this values can no longer be added
+   *
+   * This is collective on the communicator.
+   */
+  void assemble()
+  {
+    if (data != nullptr) {
+      throw RuntimeError("SparseMatrix has already been assembled");
+    }
+    int bs = block_size;
+    int size = comm.getSize();
+    int first_block_row = first_row / bs;
+    int num_local_block_rows = num_local_rows / bs;
+
+    std::vector<int> rank_block_starts(size + 1);
+    MPI_Allgather(&first_block_row,
+                  1,
+                  MPI_INT,
+                  rank_block_starts.data(),
+                  1,
+                  MPI_INT,
+                  comm.getMPIComm());
+    rank_block_starts[size] = num_global_rows / bs;
+
+    auto new_data = std::make_shared<Data>();
+
+    new_data->row_offsets.resize(num_local_block_rows);
+    for (int i = 0; i < num_local_block_rows; i++) {
+      new_data->row_offsets[i] = getStorageOffset(i * bs);
+    }
+
+    // the off-rank block columns, in sorted order so that the halo is grouped by rank
+    std::vector<int> halo_cols;
+    for (int block_col : pending_cols) {
+      if (block_col < first_block_row || block_col >= first_block_row + num_local_block_rows) {
+        halo_cols.push_back(block_col);
+      }
+    }
+    std::sort(halo_cols.begin(), halo_cols.end());
+    halo_cols.erase(std::unique(halo_cols.begin(), halo_cols.end()), halo_cols.end());
+
+    std::vector<std::vector<int>> requested_cols;
+    int rank = -1;
+    for (size_t index = 0; index < halo_cols.size(); index++) {
+      // the last rank that starts at or before the column, this skips ranks without rows
+      int owner = (int)(std::upper_bound(rank_block_starts.begin(),
+                                         rank_block_starts.end(),
+                                         halo_cols[index]) -
+                        rank_block_starts.begin()) -
+                  1;
+      if (owner != rank) {
+        rank = owner;
+        new_data->recv_ranks.push_back(rank);
+        new_data->recv_starts.push_back((int)index * bs);
+        requested_cols.emplace_back();
+      }
+      requested_cols.back().push_back(halo_cols[index]);
+    }
+    new_data->recv_starts.push_back((int)halo_cols.size() * bs);
+
+    // bucket the pending blocks by row
+    std::vector<int> order(pending_rows.size());
+    std::vector<int> row_ends(num_local_block_rows + 1, 0);
+    for (int row : pending_rows) {
+      row_ends[row + 1]++;
+    }
+    for (int i = 0; i < num_local_block_rows; i++) {
+      row_ends[i + 1] += row_ends[i];
+    }
+    for (size_t k = 0; k < pending_rows.size(); k++) {
+      order[row_ends[pending_rows[k]]++] = (int)k;
+    }
+
+    // fill in the rows, summing blocks with the same column
+    size_t block_values_size = (size_t)bs * bs;
+    new_data->diag_row_ptr.reserve(num_local_block_rows + 1);
+    new_data->offd_row_ptr.reserve(num_local_block_rows + 1);
+    new_data->diag_row_ptr.push_back(0);
+    new_data->offd_row_ptr.push_back(0);
+    int row_start = 0;
+    for (int i = 0; i < num_local_block_rows; i++) {
+      int row_end = row_ends[i];
+      std::sort(order.begin() + row_start, order.begin() + row_end, [&](int a, int b) {
+        return pending_cols[a] < pending_cols[b];
+      });
+      int prev_col = -1;
+      std::vector<double>* prev_values = nullptr;
+      for (int k = row_start; k < row_end; k++) {
+        int block_col = pending_cols[order[k]];
+        const double* values = pending_values.data() + order[k] * block_values_size;
+        if (block_col == prev_col) {
+          double* sum = prev_values->data() + prev_values->size() - block_values_size;
+          for (size_t v = 0; v < block_values_size; v++) {
+            sum[v] += values[v];
+          }
+          continue;
+        }
+        if (block_col >= first_block_row && block_col < first_block_row + num_local_block_rows) {
+          new_data->diag_cols.push_back(getStorageOffset((block_col - first_block_row) * bs));
+          prev_values = &new_data->diag_values;
+        } else {
+          int index = (int)(std::lower_bound(halo_cols.begin(), halo_cols.end(), block_col) -
+                            halo_cols.begin());
+          new_data->offd_cols.push_back(index * bs);
+          prev_values = &new_data->offd_values;
+        }
+        prev_values->insert(prev_values->end(), values, values + block_values_size);
+        prev_col = block_col;
+      }
+      new_data->diag_row_ptr.push_back((int)new_data->diag_cols.size());
+      new_data->offd_row_ptr.push_back((int)new_data->offd_cols.size());
+      row_start = row_end;
+    }
+
+    // tell the owners which columns are needed
+    std::vector<int> recv_counts(size, 0);
+    for (size_t i = 0; i < new_data->recv_ranks.size(); i++) {
+      recv_counts[new_data->recv_ranks[i]] = (int)requested_cols[i].size();
+    }
+    std::vector<int> send_counts(size, 0);
+    MPI_Alltoall(
+      recv_counts.data(), 1, MPI_INT, send_counts.data(), 1, MPI_INT, comm.getMPIComm());
+
+    for (int r = 0; r < size; r++) {
+      if (send_counts[r] > 0) {
+        new_data->send_ranks.push_back(r);
+        new_data->send_offsets.emplace_back(send_counts[r]);
+      }
+    }
+    std::vector<MPI_Request> requests;
+    requests.reserve(new_data->send_ranks.size() + new_data->recv_ranks.size());
+    for (size_t i = 0; i < new_data->send_ranks.size(); i++) {
+      requests.emplace_back();
+      MPI_Irecv(new_data->send_offsets[i].data(),
+                (int)new_data->send_offsets[i].size(),
+                MPI_INT,
+                new_data->send_ranks[i],
+                0,
+                comm.getMPIComm(),
+                &requests.back());
+    }
+    for (size_t i = 0; i < new_data->recv_ranks.size(); i++) {
+      requests.emplace_back();
+      MPI_Isend(requested_cols[i].data(),
+                (int)requested_cols[i].size(),
+                MPI_INT,
+                new_data->recv_ranks[i],
+                0,
+                comm.getMPIComm(),
+                &requests.back());
+    }
+    MPI_Waitall((int)requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+
+    for (std::vector<int>& offsets : new_data->send_offsets) {
+      for (int& offset : offsets) {
+        offset = getStorageOffset((offset - first_block_row) * bs);
+      }
+    }
+
+    pending_rows = std::vector<int>();
+    pending_cols = std::vector<int>();
+    pending_values = std::vector<double>();
+    data = new_data;
+  }
+  /**
+   * @brief Check if the matrix has been assembled
+   */
+  bool isAssembled() const { return data != nullptr; }
+  /**
+   * @brief Get the communicator
+   */
+  const Communicator& getCommunicator() const { return comm; }
+  /**
+   * @brief Get the number of rows in a block
+   */
+  int getBlockSize() const { return block_size; }
+  /**
+   * @brief Get the number of local rows
+   */
+  int getNumLocalRows() const { return num_local_rows; }
+  /**
+   * @brief Get the number of global rows
+   */
+  int getNumGlobalRows() const { return num_global_rows; }
+  /**
+   * @brief Get the global index of the first local row
+   */
+  int getFirstRow() const { return first_row; }
+  /**
+   * @brief Get the number of local stored values, this counts every value of each nonzero block
+   *
+   * The matrix has to be assembled
+   */
+  size_t getNumLocalNonzeros() const
+  {
+    if (data == nullptr) {
+      throw RuntimeError("SparseMatrix has not been assembled");
+    }
+    return data->diag_values.size() + data->offd_values.size();
+  }
+  /**
+   * @brief Get the number of off-rank values received in each apply
+   *
+   * The matrix has to be assembled
+   */
+  int getNumHaloValues() const
+  {
+    if (data == nullptr) {
+      throw RuntimeError("SparseMatrix has not been assembled");
+    }
+    return data->recv_starts.back();
+  }
+  /**
+   * @brief Apply the matrix
+   *
+   * This is collective on the ranks that share columns, the off-rank values are exchanged while the
+   * local blocks are applied.
+   *
+   * @param x the input vector
+   * @param b the output vector
+   */
+  void apply(const Vector<D>& x, Vector<D>& b) const override
+  {
+    if (data == nullptr) {
+      throw RuntimeError("SparseMatrix has not been assembled");
+    }
+    const double* x_ptr = getStoragePtr<const double>(*this, x);
+    double* b_ptr = getStoragePtr<double>(*this, b);
+    int bs = block_size;
+
+    Workspace& ws = *workspace;
+    ws.halo.resize(data->recv_starts.back());
+    ws.send_buffers.resize(data->send_ranks.size());
+    ws.send_requests.resize(data->send_ranks.size());
+    ws.recv_requests.resize(data->recv_ranks.size());
+
+    for (size_t i = 0; i < data->recv_ranks.size(); i++) {
+      MPI_Irecv(ws.halo.data() + data->recv_starts[i],
+                data->recv_starts[i + 1] - data->recv_starts[i],
+                MPI_DOUBLE,
+                data->recv_ranks[i],
+                0,
+                comm.getMPIComm(),
+                &ws.recv_requests[i]);
+    }
+    for (size_t i = 0; i < data->send_ranks.size(); i++) {
+      const std::vector<int>& offsets = data->send_offsets[i];
+      std::vector<double>& buffer = ws.send_buffers[i];
+      buffer.resize(offsets.size() * bs);
+      double* buffer_ptr = buffer.data();
+      for (int offset : offsets) {
+        buffer_ptr = std::copy(x_ptr + offset, x_ptr + offset + bs, buffer_ptr);
+      }
+      MPI_Isend(buffer.data(),
+                (int)buffer.size(),
+                MPI_DOUBLE,
+                data->send_ranks[i],
+                0,
+                comm.getMPIComm(),
+                &ws.send_requests[i]);
+    }
+
+    for (int offset : data->row_offsets) {
+      std::fill(b_ptr + offset, b_ptr + offset + bs, 0.0);
+    }
+    multiplyAdd(data->diag_row_ptr, data->diag_cols, data->diag_values, x_ptr, b_ptr);
+
+    if (!data->recv_ranks.empty()) {
+      MPI_Waitall((int)ws.recv_requests.size(), ws.recv_requests.data(), MPI_STATUSES_IGNORE);
+      multiplyAdd(data->offd_row_ptr, data->offd_cols, data->offd_values, ws.halo.data(), b_ptr);
+    }
+    MPI_Waitall((int)ws.send_requests.size(), ws.send_requests.data(), MPI_STATUSES_IGNORE);
+  }
+};
+extern template class SparseMatrix<1>;
+extern template class SparseMatrix<2>;
+extern template class SparseMatrix<3>;
+} // namespace ThunderEgg
+#endif
@@ -92,6 +92,12 @@ public:
     max = std::max(max, info);
     num_calls++;
   }
+  /**
+   * @brief Get the sum of all informations
+   *
+   * @return long int the sum
+   */
+  long int getSum() const { return sum; }
   void to_json(nlohmann::json& j) override
   {
     j["name"] = name;
@@ -332,6 +338,55 @@ public:
     }
     info_ptr->addInfo(info);
   }
+  /**
+   * @brief Add the times of the outermost patch timings of a domain that are nested in this timing
+   *
+   * @param patch_domain_id the id of the domain
+   * @param times map from patch id to time to add to
+   */
+  void addPatchTimes(int patch_domain_id, std::map<int, double>& times) const
+  {
+    for (const Timing& timing : timings) {
+      if (timing.domain_id == patch_domain_id &&
+          timing.patch_id != std::numeric_limits<int>::max()) {
+        times[timing.patch_id] += timing.sum;
+      } else {
+        timing.addPatchTimes(patch_domain_id, times);
+      }
+    }
+  }
+  /**
+   * @brief Add the sums of an integer information of this timing and the timings nested in it
+   *
+   * The information is added to the innermost patch timing of the domain that contains it.
+   *
+   * @param patch_domain_id the id of the domain
+   * @param info_name the name of the information
+   * @param curr_patch_id the id of the patch of the enclosing timings, the max value of int if
+   * there is none
+   * @param sums map from patch id to sum to add to
+   */
+  void addPatchIntInfoSums(int patch_domain_id,
+                           const std::string& info_name,
+                           int curr_patch_id,
+                           std::map<int, long int>& sums) const
+  {
+    if (domain_id == patch_domain_id && patch_id != std::numeric_limits<int>::max()) {
+      curr_patch_id = patch_id;
+    }
+    if (curr_patch_id != std::numeric_limits<int>::max()) {
+      auto info_map_iter = info_map.find(info_name);
+      if (info_map_iter != info_map.end()) {
+        const IntInfo* info_ptr = dynamic_cast<const IntInfo*>(info_map_iter->second);
+        if (info_ptr != nullptr) {
+          sums[curr_patch_id] += info_ptr->getSum();
+        }
+      }
+    }
+    for (const Timing& timing : timings) {
+      timing.addPatchIntInfoSums(patch_domain_id, info_name, curr_patch_id, sums);
+    }
+  }
   friend void to_json(nlohmann::json& j, const Timing& timing)
   {
     if (timing.name != "") {
@@ -437,6 +492,20 @@ Timer::addDoubleInfo(const std::string& name, double info)
   Timing& curr_timing = stack.back();
   curr_timing.addDoubleInfo(name, info);
 }
+std::map<int, double>
+Timer::getPatchTimes(int domain_id) const
+{
+  std::map<int, double> times;
+  root->addPatchTimes(domain_id, times);
+  return times;
+}
+std::map<int, long int>
+Timer::getPatchIntInfoSums(int domain_id, const std::string& name) const
+{
+  std::map<int, long int> sums;
+  root->addPatchIntInfoSums(domain_id, name, std::numeric_limits<int>::max(), sums);
+  return sums;
+}
 static void
 PrintMergedTimings(const Communicator& comm,
                    size_t max_name_size,
@@ -174,6 +174,29 @@ public:
    * information to existing int information
    */
   void addDoubleInfo(const std::string& name, double info);
+  /**
+   * @brief Get the time spent in each patch of a Domain on this rank
+   *
+   * The time of a patch is the sum of the outermost timings of that patch, so timings of a patch
+   * that are nested in another timing of the same patch are not counted twice. Only stopped
+   * timings are counted.
+   *
+   * @param domain_id the id of the Domain
+   * @return std::map<int, double> map from patch id to the time in seconds
+   */
+  std::map<int, double> getPatchTimes(int domain_id) const;
+  /**
+   * @brief Get the sum of an integer information for each patch of a Domain on this rank
+   *
+   * Information added to a patch timing, or to a timing nested in a patch timing, is counted for
+   * that patch. For example the "Iterations" information of Iterative::PatchSolver gives the total
+   * number of iterations used for each patch.
+   *
+   * @param domain_id the id of the Domain
+   * @param name the name of the information
+   * @return std::map<int, long int> map from patch id to the sum of the information
+   */
+  std::map<int, long int> getPatchIntInfoSums(int domain_id, const std::string& name) const;
   /**
    * @brief ostream operator for Timer, this is collective for all ranks, will only output on rank
    * 0
@@ -0,0 +1,341 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2019-2021 Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef THUNDEREGG_VARPOISSON_DIRECTPATCHSOLVER_H
+#define THUNDEREGG_VARPOISSON_DIRECTPATCHSOLVER_H
+/**
+ * @file
+ *
+ * @brief DirectPatchSolver class
+ */
+#include <ThunderEgg/PatchScratch.h>
+#include <ThunderEgg/PatchSolver.h>
+#include <ThunderEgg/RuntimeError.h>
+#include <ThunderEgg/VarPoisson/StarPatchOperator.h>
+#include <memory>
+#include <vector>
+
+extern "C" void
+dpbtrf_(char&, int&, int&, double*, int&, int&);
+extern "C" void
+dpbtrs_(char&, int&, int&, int&, double*, int&, double*, int&, int&);
+extern "C" void
+dgbtrf_(int&, int&, int&, int&, double*, int&, int*, int&);
+extern "C" void
+dgbtrs_(char&, int&, int&, int&, int&, double*, int&, int*, double*, int&, int&);
+
+namespace ThunderEgg::VarPoisson {
+/**
+ * @brief Solves each patch exactly with a banded factorization of the patch operator
+ *
+ * With the cells of a patch numbered with the first axis the fastest, the operator on a patch is
+ * banded with a bandwidth of the number of cells in a slab normal to the last axis. The negated
+ * operator is symmetric positive definite for positive coefficients, and is factored with LAPACK's
+ * banded Cholesky factorization. If that fails (the coefficients are not positive), a banded LU
+ * factorization is used for the patch instead.
+ *
+ * The factorizations are computed once on construction and are shared with clones. If the
+ * coefficients of the operator are changed with StarPatchOperator::setCoefficients, refactor() has
+ * to be called. The memory used by the factorizations is O(n^(2D-1)) per patch, see
+ * getFactorizationMemoryUsage(), so this is best suited for 2d patches and small 3d patches.
+ *
+ * @tparam D the number of Cartesian dimensions
+ */
+template<int D>
+class DirectPatchSolver : public PatchSolver<D>
+{
+private:
+  /**
+   * @brief The factorization of the operator on a patch
+   */
+  struct PatchFactorization
+  {
+    /**
+     * @brief true if band is a Cholesky factorization, false if it is an LU factorization
+     */
+    bool cholesky = true;
+    /**
+     * @brief The factorization in LAPACK's banded storage
+     */
+    std::vector<double> band;
+    /**
+     * @brief The pivots of an LU factorization
+     */
+    std::vector<int> pivots;
+  };
+  /**
+   * @brief The operator, shares coefficients with the operator that was passed to the constructor
+   */
+  std::shared_ptr<const StarPatchOperator<D>> op;
+  /**
+   * @brief The number of cells in a patch
+   */
+  int patch_size = 1;
+  /**
+   * @brief The bandwidth of the patch operator
+   */
+  int bandwidth = 1;
+  /**
+   * @brief The factorization of each local patch, shared with clones
+   */
+  std::shared_ptr<std::vector<PatchFactorization>> factorizations;
+
+  /**
+   * @brief Call a function for each non-zero of the negated operator on a patch
+   *
+   * The operator is the one applied by
+   * StarPatchOperator::applySinglePatchWithInternalBoundaryConditions, where every ghost value is the
+   * negative of the value next to it.
+   *
+   * @param pinfo the patch
+   * @param add called with (row, column, value) for each entry, entries on the diagonal are
+   * called several times and are to be summed
+   */
+  template<typename AddFunction>
+  void forEachEntry(const PatchInfo<D>& pinfo, AddFunction add) const
+  {
+    PatchView<const double, D> c = op->getCoefficients().getPatchView(pinfo.local_index);
+    const std::array<int, D>& ns = this->getDomain().getNs();
+    std::array<int, D> strides;
+    int stride = 1;
+    for (size_t axis = 0; axis < D; axis++) {
+      strides[axis] = stride;
+      stride *= ns[axis];
+    }
+    Loop::OverInteriorIndexes<D + 1>(c, [&](const std::array<int, D + 1>& coord) {
+      int row = 0;
+      for (size_t axis = 0; axis < D; axis++) {
+        row += coord[axis] * strides[axis];
+      }
+      double c_mid = c[coord];
+      for (size_t axis = 0; axis < D; axis++) {
+        double h2 = pinfo.spacings[axis] * pinfo.spacings[axis];
+        std::array<int, D + 1> lower_coord = coord;
+        lower_coord[axis]--;
+        std::array<int, D + 1> upper_coord = coord;
+        upper_coord[axis]++;
+        double lower = (c[lower_coord] + c_mid) / (2 * h2);
+        double upper = (c[upper_coord] + c_mid) / (2 * h2);
+        if (coord[axis] == 0) {
+          add(row, row, 2 * lower);
+        } else {
+          add(row, row, lower);
+          add(row, row - strides[axis], -lower);
+        }
+        if (coord[axis] == ns[axis] - 1) {
+          add(row, row, 2 * upper);
+        } else {
+          add(row, row, upper);
+          add(row, row + strides[axis], -upper);
+        }
+      }
+    });
+  }
+  /**
+   * @brief Factor the operator on a patch
+   *
+   * @param pinfo the patch
+   * @return PatchFactorization the factorization
+   */
+  PatchFactorization factor(const PatchInfo<D>& pinfo) const
+  {
+    PatchFactorization factorization;
+    int n = patch_size;
+    int kd = bandwidth;
+    int info;
+
+    // upper triangle in symmetric band storage
+    int ldab = kd + 1;
+    factorization.band.assign(ldab * n, 0.0);
+    forEachEntry(pinfo, [&](int i, int j, double value) {
+      if (i <= j) {
+        factorization.band[(kd + i - j) + j * ldab] += value;
+      }
+    });
+    char uplo = 'U';
+    dpbtrf_(uplo, n, kd, factorization.band.data(), ldab, info);
+    if (info < 0) {
+      throw RuntimeError("dpbtrf failed with info " + std::to_string(info));
+    }
+    if (info == 0) {
+      return factorization;
+    }
+
+    // not positive definite, use LU in general band storage, with room for the fill in
+    factorization.cholesky = false;
+    ldab = 3 * kd + 1;
+    factorization.band.assign(ldab * n, 0.0);
+    factorization.pivots.resize(n);
+    forEachEntry(pinfo, [&](int i, int j, double value) {
+      factorization.band[(2 * kd + i - j) + j * ldab] += value;
+    });
+    dgbtrf_(n, n, kd, kd, factorization.band.data(), ldab, factorization.pivots.data(), info);
+    if (info != 0) {
+      throw RuntimeError("DirectPatchSolver could not factor the operator on patch " +
+                         std::to_string(pinfo.id) + ", dgbtrf failed with info " +
+                         std::to_string(info));
+    }
+    return factorization;
+  }
+
+public:
+  /**
+   * @brief Construct a new DirectPatchSolver object, this factors the operator on each local patch
+   *
+   * @param op the operator, the solver will use the same coefficients as this operator and any of
+   * its clones
+   */
+  explicit DirectPatchSolver(const StarPatchOperator<D>& op)
+    : PatchSolver<D>(op.getDomain(), op.getGhostFiller())
+    , op(op.clone())
+    , factorizations(std::make_shared<std::vector<PatchFactorization>>())
+  {
+    const std::array<int, D>& ns = this->getDomain().getNs();
+    for (size_t axis = 0; axis < D; axis++) {
+      patch_size *= ns[axis];
+    }
+    bandwidth = patch_size / ns[D - 1];
+    refactor();
+  }
+  /**
+   * @brief Clone this patch solver
+   *
+   * @return DirectPatchSolver<D>* a newly allocated copy of this patch solver, the factorizations
+   * are shared
+   */
+  DirectPatchSolver<D>* clone() const override { return new DirectPatchSolver<D>(*this); }
+  /**
+   * @brief Factor the operator on every local patch with the current coefficients
+   *
+   * This has to be called after the coefficients of the operator are changed, and updates the
+   * factorizations of all clones. If the Domain has a Timer, this is timed as "DirectPatchSolver
+   * Factorization", along with the memory used by the factorizations.
+   */
+  void refactor()
+  {
+    const Domain<D>& domain = this->getDomain();
+    if (domain.hasTimer()) {
+      domain.getTimer()->startDomainTiming(domain.getId(), "DirectPatchSolver Factorization");
+    }
+
+    const std::vector<PatchInfo<D>>& pinfos = domain.getPatchInfoVector();
+    factorizations->resize(pinfos.size());
+    for (const PatchInfo<D>& pinfo : pinfos) {
+      (*factorizations)[pinfo.local_index] = factor(pinfo);
+    }
+
+    if (domain.hasTimer()) {
+      domain.getTimer()->addDoubleInfo("Factorization Memory (MB)",
+                                       getFactorizationMemoryUsage() / 1e6);
+      domain.getTimer()->stopDomainTiming(domain.getId(), "DirectPatchSolver Factorization");
+    }
+  }
+  /**
+   * @brief Get the memory used by the factorizations on this rank
+   *
+   * @return size_t the number of bytes
+   */
+  size_t getFactorizationMemoryUsage() const
+  {
+    size_t bytes = 0;
+    for (const PatchFactorization& factorization : *factorizations) {
+      bytes += factorization.band.size() * sizeof(double);
+      bytes += factorization.pivots.size() * sizeof(int);
+    }
+    return bytes;
+  }
+  /**
+   * @brief Get the number of local patches that use an LU factorization, because the operator on
+   * the patch was not negative definite
+   *
+   * @return int the number of patches
+   */
+  int getNumLUFactorizations() const
+  {
+    int num_lu = 0;
+    for (const PatchFactorization& factorization : *factorizations) {
+      num_lu += !factorization.cholesky;
+    }
+    return num_lu;
+  }
+  /**
+   * @brief Check if solveSinglePatch can be called from multiple threads at the same time
+   *
+   * @return true, the patches are solved in scratch buffers that are allocated once per thread
+   */
+  bool isThreadSafe() const override { return true; }
+  void solveSinglePatch(const PatchInfo<D>& pinfo,
+                        const PatchView<const double, D>& f_view,
+                        const PatchView<double, D>& u_view) const override
+  {
+    const PatchFactorization& factorization = factorizations->at(pinfo.local_index);
+
+    double* x = PatchScratch::GetBuffer(patch_size);
+    PatchView<double, D> x_view = PatchScratch::GetView<D>(x, this->getDomain().getNs());
+    Loop::OverInteriorIndexes<D + 1>(
+      x_view, [&](const std::array<int, D + 1>& coord) { x_view[coord] = f_view[coord]; });
+    op->modifyRHSForInternalBoundaryConditions(pinfo, u_view, x_view);
+    // the factorization is of the negated operator
+    for (int i = 0; i < patch_size; i++) {
+      x[i] = -x[i];
+    }
+
+    int n = patch_size;
+    int kd = bandwidth;
+    int nrhs = 1;
+    int info;
+    if (factorization.cholesky) {
+      char uplo = 'U';
+      int ldab = kd + 1;
+      dpbtrs_(uplo, n, kd, nrhs, const_cast<double*>(factorization.band.data()), ldab, x, n, info);
+      if (info != 0) {
+        throw RuntimeError("DirectPatchSolver could not solve on patch " +
+                           std::to_string(pinfo.id) + ", dpbtrs failed with info " +
+                           std::to_string(info));
+      }
+    } else {
+      char trans = 'N';
+      int ldab = 3 * kd + 1;
+      dgbtrs_(trans,
+              n,
+              kd,
+              kd,
+              nrhs,
+              const_cast<double*>(factorization.band.data()),
+              ldab,
+              const_cast<int*>(factorization.pivots.data()),
+              x,
+              n,
+              info);
+      if (info != 0) {
+        throw RuntimeError("DirectPatchSolver could not solve on patch " +
+                           std::to_string(pinfo.id) + ", dgbtrs failed with info " +
+                           std::to_string(info));
+      }
+    }
+
+    Loop::OverInteriorIndexes<D + 1>(
+      u_view, [&](const std::array<int, D + 1>& coord) { u_view[coord] = x_view[coord]; });
+  }
+};
+extern template class DirectPatchSolver<2>;
+extern template class DirectPatchSolver<3>;
+} // namespace ThunderEgg::VarPoisson
+#endif
@@ -0,0 +1,240 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2019-2021 Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#ifndef THUNDEREGG_VARPOISSON_GMGHIERARCHY_H
+#define THUNDEREGG_VARPOISSON_GMGHIERARCHY_H
+/**
+ * @file
+ *
+ * @brief GMGHierarchy class
+ */
+
+#include <ThunderEgg/BiLinearGhostFiller.h>
+#include <ThunderEgg/DomainGenerator.h>
+#include <ThunderEgg/DomainTools.h>
+#include <ThunderEgg/GMG/CycleBuilder.h>
+#include <ThunderEgg/GMG/DirectCoarseSolver.h>
+#include <ThunderEgg/GMG/DirectInterpolator.h>
+#include <ThunderEgg/GMG/LinearRestrictor.h>
+#include <ThunderEgg/Iterative/PatchSolver.h>
+#include <ThunderEgg/RuntimeError.h>
+#include <ThunderEgg/TriLinearGhostFiller.h>
+#include <ThunderEgg/VarPoisson/StarPatchOperator.h>
+
+namespace ThunderEgg::VarPoisson {
+/**
+ * @brief Builds a multigrid cycle for the variable coefficient Poisson equation.
+ *
+ * All of the Domain objects are taken from a DomainGenerator, and the coefficients are restricted
+ * from the finest level to each coarser level with a LinearRestrictor. Each level gets a
+ * StarPatchOperator, Iterative::PatchSolver smoother, LinearRestrictor and DirectInterpolator,
+ * and the coarsest level is solved with a GMG::DirectCoarseSolver.
+ *
+ * The coefficients can later be replaced with updateCoefficients(). This only restricts the new
+ * coefficients and refactors the coarsest level, the Domain objects, ghost fillers and
+ * inter-level communication patterns are kept, and the cycle returned by getCycle() uses the new
+ * coefficients.
+ *
+ * @tparam D the number of Cartesian dimensions
+ */
+template<int D>
+class GMGHierarchy
+{
+private:
+  /**
+   * @brief The Domain of each level, finest first
+   */
+  std::vector<Domain<D>> domains;
+  /**
+   * @brief The operator of each level, the clones in the cycle share their coefficients
+   */
+  std::vector<StarPatchOperator<D>> operators;
+  /**
+   * @brief Restrictors for the coefficients, these extrapolate the physical boundary ghosts
+   */
+  std::vector<GMG::LinearRestrictor<D>> coeff_restrictors;
+  /**
+   * @brief The coarse solver, the clone in the cycle shares its factorization
+   */
+  std::shared_ptr<GMG::DirectCoarseSolver<D>> coarse_solver;
+  /**
+   * @brief The cycle
+   */
+  std::shared_ptr<GMG::Cycle<D>> cycle;
+
+  /**
+   * @brief Get a new ghost filler for a level
+   */
+  static std::shared_ptr<GhostFiller<D>> getGhostFiller(const Domain<D>& domain)
+  {
+    if constexpr (D == 2) {
+      return std::make_shared<BiLinearGhostFiller>(domain, GhostFillingType::Faces);
+    } else {
+      return std::make_shared<TriLinearGhostFiller>(domain, GhostFillingType::Faces);
+    }
+  }
+
+  /**
+   * @brief Build all the levels and the cycle
+   *
+   * @param fine_coeffs the coefficients on the finest level
+   * @param opts the cycle options
+   * @param patch_solver the solver used for the Iterative::PatchSolver smoothers
+   */
+  void build(const Vector<D>& fine_coeffs,
+             const GMG::CycleOpts& opts,
+             const Iterative::Solver<D>& patch_solver)
+  {
+    if (domains.size() < 2) {
+      throw RuntimeError("GMGHierarchy needs at least two levels, the DomainGenerator only had " +
+                         std::to_string(domains.size()));
+    }
+    coeff_restrictors.reserve(domains.size() - 1);
+    for (size_t i = 0; i + 1 < domains.size(); i++) {
+      coeff_restrictors.emplace_back(domains[i], domains[i + 1], true);
+    }
+
+    operators.reserve(domains.size());
+    operators.emplace_back(fine_coeffs, domains[0], *getGhostFiller(domains[0]));
+    for (size_t i = 1; i < domains.size(); i++) {
+      Vector<D> coeffs = coeff_restrictors[i - 1].restrict(operators[i - 1].getCoefficients());
+      operators.emplace_back(coeffs, domains[i], *getGhostFiller(domains[i]));
+    }
+
+    GMG::CycleBuilder<D> builder(opts);
+    for (size_t i = 0; i < domains.size(); i++) {
+      if (i == 0) {
+        Iterative::PatchSolver<D> smoother(patch_solver, operators[0]);
+        GMG::LinearRestrictor<D> restrictor(domains[0], domains[1]);
+        builder.addFinestLevel(operators[0], smoother, restrictor);
+      } else if (i + 1 < domains.size()) {
+        Iterative::PatchSolver<D> smoother(patch_solver, operators[i]);
+        GMG::LinearRestrictor<D> restrictor(domains[i], domains[i + 1]);
+        GMG::DirectInterpolator<D> interpolator(domains[i], domains[i - 1]);
+        builder.addIntermediateLevel(operators[i], smoother, restrictor, interpolator);
+      } else {
+        coarse_solver = std::make_shared<GMG::DirectCoarseSolver<D>>(domains[i], operators[i]);
+        GMG::DirectInterpolator<D> interpolator(domains[i], domains[i - 1]);
+        builder.addCoarsestLevel(operators[i], *coarse_solver, interpolator);
+      }
+    }
+    cycle = builder.getCycle();
+  }
+
+public:
+  /**
+   * @brief Construct a new GMGHierarchy
+   *
+   * This is collective over the communicator of the finest Domain.
+   *
+   * @param generator the generator for the Domain of each level, this has to have at least two
+   * levels
+   * @param coeff_func the coefficient, it is also evaluated on the ghost cells of the finest level
+   * @param opts the cycle options
+   * @param patch_solver the solver used for the Iterative::PatchSolver smoothers
+   */
+  GMGHierarchy(DomainGenerator<D>& generator,
+               std::function<double(const std::array<double, D>&)> coeff_func,
+               const GMG::CycleOpts& opts,
+               const Iterative::Solver<D>& patch_solver)
+  {
+    domains.push_back(generator.getFinestDomain());
+    while (generator.hasCoarserDomain()) {
+      domains.push_back(generator.getCoarserDomain());
+    }
+    Vector<D> fine_coeffs(domains[0], 1);
+    DomainTools::SetValuesWithGhost<D>(domains[0], fine_coeffs, coeff_func);
+    build(fine_coeffs, opts, patch_solver);
+  }
+  /**
+   * @brief Construct a new GMGHierarchy from already generated Domain objects
+   *
+   * This is collective over the communicator of the finest Domain.
+   *
+   * @param domains the Domain of each level, finest first, there have to be at least two
+   * @param fine_coeffs the coefficients on the finest Domain, ghost values on the physical
+   * boundary have to be set
+   * @param opts the cycle options
+   * @param patch_solver the solver used for the Iterative::PatchSolver smoothers
+   */
+  GMGHierarchy(const std::vector<Domain<D>>& domains,
+               const Vector<D>& fine_coeffs,
+               const GMG::CycleOpts& opts,
+               const Iterative::Solver<D>& patch_solver)
+    : domains(domains)
+  {
+    build(fine_coeffs, opts, patch_solver);
+  }
+  /**
+   * @brief Replace the coefficients on every level
+   *
+   * The new coefficients are restricted to the coarser levels and the coarsest level is
+   * refactored. The Domain objects and communication patterns are reused. This is collective over
+   * the communicator of the finest Domain.
+   *
+   * @param fine_coeffs the coefficients on the finest Domain, ghost values on the physical
+   * boundary have to be set
+   */
+  void updateCoefficients(const Vector<D>& fine_coeffs)
+  {
+    operators[0].setCoefficients(fine_coeffs);
+    for (size_t i = 1; i < operators.size(); i++) {
+      operators[i].setCoefficients(
+        coeff_restrictors[i - 1].restrict(operators[i - 1].getCoefficients()));
+    }
+    coarse_solver->refactor(operators.back());
+  }
+  /**
+   * @brief Replace the coefficients on every level
+   *
+   * @param coeff_func the coefficient, it is also evaluated on the ghost cells of the finest level
+   */
+  void updateCoefficients(std::function<double(const std::array<double, D>&)> coeff_func)
+  {
+    Vector<D> fine_coeffs(domains[0], 1);
+    DomainTools::SetValuesWithGhost<D>(domains[0], fine_coeffs, coeff_func);
+    updateCoefficients(fine_coeffs);
+  }
+  /**
+   * @brief Get the cycle
+   *
+   * @return std::shared_ptr<GMG::Cycle<D>> the cycle
+   */
+  std::shared_ptr<GMG::Cycle<D>> getCycle() const { return cycle; }
+  /**
+   * @brief Get the number of levels
+   */
+  int getNumLevels() const { return domains.size(); }
+  /**
+   * @brief Get the Domain of a level
+   *
+   * @param level the level, 0 is the finest
+   */
+  const Domain<D>& getDomain(int level) const { return domains.at(level); }
+  /**
+   * @brief Get the operator of a level
+   *
+   * @param level the level, 0 is the finest
+   */
+  const StarPatchOperator<D>& getOperator(int level) const { return operators.at(level); }
+};
+extern template class GMGHierarchy<2>;
+extern template class GMGHierarchy<3>;
+} // namespace ThunderEgg::VarPoisson
+#endif
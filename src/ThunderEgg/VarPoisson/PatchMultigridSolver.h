@@ -0,0 +1,534 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2019-2021 Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef THUNDEREGG_VARPOISSON_PATCHMULTIGRIDSOLVER_H
+#define THUNDEREGG_VARPOISSON_PATCHMULTIGRIDSOLVER_H
+/**
+ * @file
+ *
+ * @brief PatchMultigridSolver class
+ */
+#include <ThunderEgg/PatchArray.h>
+#include <ThunderEgg/PatchSolver.h>
+#include <ThunderEgg/RuntimeError.h>
+#include <ThunderEgg/VarPoisson/StarPatchOperator.h>
+#include <cmath>
+#include <vector>
+
+namespace ThunderEgg::VarPoisson {
+/**
+ * @brief Solves each patch with geometric multigrid V-cycles that coarsen within the patch
+ *
+ * The patch is coarsened by factors of two (ns/2, ns/4, ...) as long as the number of cells on
+ * each axis is even and the coarser patch has at least two cells on each axis. The ghost values
+ * of the patch are used as boundary data by modifying the rhs, in the same way as the other patch
+ * solvers, so each level solves a problem with homogeneous boundary conditions.
+ *
+ * - Smoothing is red-black Gauss-Seidel.
+ * - The residual is restricted by averaging, and corrections are interpolated linearly.
+ * - Coefficients are averaged onto the coarser levels for every patch solve, so changes to the
+ *   coefficients of the operator are picked up without any setup.
+ * - The coarsest level is smoothed several times in place of a direct solve.
+ *
+ * The workspace arrays for the levels are allocated once per thread. This only supports vectors
+ * with a single component.
+ *
+ * @tparam D the number of Cartesian dimensions
+ */
+template<int D>
+class PatchMultigridSolver : public PatchSolver<D>
+{
+private:
+  /**
+   * @brief A level of the patch-local hierarchy
+   */
+  struct Level
+  {
+    /**
+     * @brief The number of cells along each axis
+     */
+    std::array<int, D> ns;
+    /**
+     * @brief The cell spacings, set for each patch solve
+     */
+    std::array<double, D> spacings;
+    /**
+     * @brief The solution (or correction on coarser levels)
+     */
+    PatchArray<D> u;
+    /**
+     * @brief The rhs
+     */
+    PatchArray<D> f;
+    /**
+     * @brief The residual
+     */
+    PatchArray<D> r;
+    /**
+     * @brief The coefficients, with the first layer of ghost values
+     */
+    PatchArray<D> c;
+  };
+  /**
+   * @brief The levels, finest first
+   */
+  struct Workspace
+  {
+    std::array<int, D> ns = {};
+    std::vector<Level> levels;
+  };
+  /**
+   * @brief The operator, shares coefficients with the operator that was passed to the constructor
+   */
+  std::shared_ptr<const StarPatchOperator<D>> op;
+  /**
+   * @brief The relative residual tolerance of a patch solve
+   */
+  double tolerance;
+  /**
+   * @brief The maximum number of V-cycles for a patch solve
+   */
+  int max_cycles;
+  /**
+   * @brief The number of sweeps before and after the coarse grid correction
+   */
+  int num_sweeps = 2;
+
+  /**
+   * @brief Get the workspace for the calling thread
+   *
+   * @param ns the number of cells along each axis of the patch
+   * @return Workspace& the workspace
+   */
+  static Workspace& getWorkspace(const std::array<int, D>& ns)
+  {
+    static thread_local Workspace workspace;
+    if (workspace.ns != ns) {
+      workspace.ns = ns;
+      workspace.levels.clear();
+      std::array<int, D> level_ns = ns;
+      while (true) {
+        Level& level = workspace.levels.emplace_back();
+        level.ns = level_ns;
+        level.u = PatchArray<D>(level_ns, 1, 1);
+        level.f = PatchArray<D>(level_ns, 1, 1);
+        level.r = PatchArray<D>(level_ns, 1, 1);
+        level.c = PatchArray<D>(level_ns, 1, 1);
+        bool coarsen = true;
+        for (size_t axis = 0; axis < D; axis++) {
+          coarsen = coarsen && level_ns[axis] % 2 == 0 && level_ns[axis] >= 4;
+        }
+        if (!coarsen) {
+          break;
+        }
+        for (size_t axis = 0; axis < D; axis++) {
+          level_ns[axis] /= 2;
+        }
+      }
+    }
+    return workspace;
+  }
+  /**
+   * @brief Get the start of the first layer of ghost cells
+   */
+  static std::array<int, D + 1> getGhostStart()
+  {
+    std::array<int, D + 1> start;
+    start.fill(-1);
+    start[D] = 0;
+    return start;
+  }
+  /**
+   * @brief Get the end of the first layer of ghost cells
+   */
+  static std::array<int, D + 1> getGhostEnd(const std::array<int, D>& ns)
+  {
+    std::array<int, D + 1> end;
+    for (size_t axis = 0; axis < D; axis++) {
+      end[axis] = ns[axis];
+    }
+    end[D] = 0;
+    return end;
+  }
+  /**
+   * @brief Set the ghost values so that the value on the faces of the patch is zero
+   *
+   * @param u the patch
+   */
+  static void setGhosts(const PatchView<double, D>& u)
+  {
+    for (Side<D> s : Side<D>::getValues()) {
+      View<double, D> ghost = u.getGhostSliceOn(s, { 0 });
+      View<double, D> inner = u.getSliceOn(s, { 0 });
+      Loop::OverInteriorIndexes<D>(
+        inner, [&](const std::array<int, D>& coord) { ghost[coord] = -inner[coord]; });
+    }
+  }
+  /**
+   * @brief Call a function with the coordinate of the first cell of each row along the first axis
+   *
+   * @param ns the number of cells along each axis
+   * @param f the function
+   */
+  template<typename Function>
+  static void forEachRow(const std::array<int, D>& ns, Function f)
+  {
+    std::array<int, D + 1> start = {};
+    std::array<int, D + 1> end = {};
+    for (size_t axis = 1; axis < D; axis++) {
+      end[axis] = ns[axis] - 1;
+    }
+    Loop::Nested<D + 1>(start, end, f);
+  }
+  /**
+   * @brief Apply the operator on a level, with zero boundary values
+   *
+   * All of the arrays of a level have the same layout, so the stencil is applied with the strides
+   * of the solution.
+   *
+   * @param level the level
+   * @param u the values to apply the operator to, the ghost values are set
+   * @param out the result
+   */
+  static void apply(const Level& level, const PatchView<double, D>& u, const PatchView<double, D>& out)
+  {
+    setGhosts(u);
+    const PatchView<double, D>& c = const_cast<PatchArray<D>&>(level.c).getView();
+    const std::array<int, D + 1>& strides = u.getStrides();
+    std::array<double, D> h2;
+    for (size_t axis = 0; axis < D; axis++) {
+      h2[axis] = 2 * level.spacings[axis] * level.spacings[axis];
+    }
+    forEachRow(level.ns, [&](const std::array<int, D + 1>& row) {
+      const double* u_row = &u[row];
+      const double* c_row = &c[row];
+      double* out_row = &out[row];
+      for (int i = 0; i < level.ns[0]; i++) {
+        double sum = 0;
+        for (size_t axis = 0; axis < D; axis++) {
+          int stride = strides[axis];
+          sum += ((c_row[i + stride] + c_row[i]) * (u_row[i + stride] - u_row[i]) -
+                  (c_row[i - stride] + c_row[i]) * (u_row[i] - u_row[i - stride])) /
+                 h2[axis];
+        }
+        out_row[i] = sum;
+      }
+    });
+  }
+  /**
+   * @brief Compute the residual of a level
+   *
+   * @param level the level
+   * @return double the two norm of the residual
+   */
+  static double residual(Level& level)
+  {
+    const PatchView<double, D>& r = level.r.getView();
+    const PatchView<double, D>& f = level.f.getView();
+    apply(level, level.u.getView(), r);
+    double sum = 0;
+    Loop::OverInteriorIndexes<D + 1>(r, [&](const std::array<int, D + 1>& coord) {
+      r[coord] = f[coord] - r[coord];
+      sum += r[coord] * r[coord];
+    });
+    return sqrt(sum);
+  }
+  /**
+   * @brief Red-black Gauss-Seidel sweeps on a level
+   *
+   * @param level the level
+   * @param sweeps the number of sweeps
+   */
+  static void relax(Level& level, int sweeps)
+  {
+    const PatchView<double, D>& u = level.u.getView();
+    const PatchView<double, D>& f = level.f.getView();
+    const PatchView<double, D>& c = level.c.getView();
+    const std::array<int, D + 1>& strides = u.getStrides();
+    std::array<double, D> h2;
+    for (size_t axis = 0; axis < D; axis++) {
+      h2[axis] = 2 * level.spacings[axis] * level.spacings[axis];
+    }
+    for (int sweep = 0; sweep < sweeps; sweep++) {
+      for (int color = 0; color < 2; color++) {
+        forEachRow(level.ns, [&](const std::array<int, D + 1>& row) {
+          double* u_row = &u[row];
+          const double* f_row = &f[row];
+          const double* c_row = &c[row];
+          int parity = 0;
+          for (size_t axis = 1; axis < D; axis++) {
+            parity += row[axis];
+          }
+          for (int i = (color + parity) % 2; i < level.ns[0]; i += 2) {
+            double diag = 0;
+            double sum = 0;
+            for (size_t axis = 0; axis < D; axis++) {
+              int stride = strides[axis];
+              int coord = (axis == 0) ? i : row[axis];
+              double lower_weight = (c_row[i - stride] + c_row[i]) / h2[axis];
+              double upper_weight = (c_row[i + stride] + c_row[i]) / h2[axis];
+              // the ghost value is the negative of the value, this adds to the diagonal
+              if (coord == 0) {
+                diag -= 2 * lower_weight;
+              } else {
+                diag -= lower_weight;
+                sum += lower_weight * u_row[i - stride];
+              }
+              if (coord == level.ns[axis] - 1) {
+                diag -= 2 * upper_weight;
+              } else {
+                diag -= upper_weight;
+                sum += upper_weight * u_row[i + stride];
+              }
+            }
+            u_row[i] = (f_row[i] - sum) / diag;
+          }
+        });
+      }
+    }
+  }
+  /**
+   * @brief Call a function with each of the 2^D fine cells of a coarse cell
+   */
+  template<typename Function>
+  static void forEachChild(const std::array<int, D + 1>& coarse_coord, Function f)
+  {
+    for (int child = 0; child < (1 << D); child++) {
+      std::array<int, D + 1> fine_coord = coarse_coord;
+      for (size_t axis = 0; axis < D; axis++) {
+        fine_coord[axis] = 2 * coarse_coord[axis] + ((child >> axis) & 1);
+      }
+      f(fine_coord);
+    }
+  }
+  /**
+   * @brief Average the coefficients onto the coarser level, including the first layer of ghost
+   * values
+   *
+   * @param fine the finer level
+   * @param coarse the coarser level
+   */
+  static void restrictCoefficients(Level& fine, Level& coarse)
+  {
+    const PatchView<double, D>& fine_c = fine.c.getView();
+    const PatchView<double, D>& coarse_c = coarse.c.getView();
+    Loop::Nested<D + 1>(
+      getGhostStart(), getGhostEnd(coarse.ns), [&](const std::array<int, D + 1>& coord) {
+        double sum = 0;
+        int count = 0;
+        forEachChild(coord, [&](std::array<int, D + 1> fine_coord) {
+          // ghost cells of the coarse level only average the first layer of fine ghost cells
+          for (size_t axis = 0; axis < D; axis++) {
+            if (coord[axis] == -1) {
+              fine_coord[axis] = -1;
+            } else if (coord[axis] == coarse.ns[axis]) {
+              fine_coord[axis] = fine.ns[axis];
+            }
+          }
+          sum += fine_c[fine_coord];
+          count++;
+        });
+        coarse_c[coord] = sum / count;
+      });
+  }
+  /**
+   * @brief Restrict the residual of a level to the rhs of the coarser level, and zero the coarser
+   * solution
+   *
+   * @param fine the finer level
+   * @param coarse the coarser level
+   */
+  static void restrictResidual(Level& fine, Level& coarse)
+  {
+    const PatchView<double, D>& fine_r = fine.r.getView();
+    const PatchView<double, D>& coarse_f = coarse.f.getView();
+    const PatchView<double, D>& coarse_u = coarse.u.getView();
+    Loop::OverInteriorIndexes<D + 1>(coarse_f, [&](const std::array<int, D + 1>& coord) {
+      double sum = 0;
+      forEachChild(coord, [&](const std::array<int, D + 1>& fine_coord) { sum += fine_r[fine_coord]; });
+      coarse_f[coord] = sum / (1 << D);
+      coarse_u[coord] = 0;
+    });
+  }
+  /**
+   * @brief Add the linear interpolation of the coarser solution to the finer solution
+   *
+   * @param coarse the coarser level
+   * @param fine the finer level
+   */
+  static void interpolate(Level& coarse, Level& fine)
+  {
+    const PatchView<double, D>& coarse_u = coarse.u.getView();
+    const PatchView<double, D>& fine_u = fine.u.getView();
+    setGhosts(coarse_u);
+    Loop::OverInteriorIndexes<D + 1>(fine_u, [&](const std::array<int, D + 1>& coord) {
+      double sum = 0;
+      for (int corner = 0; corner < (1 << D); corner++) {
+        std::array<int, D + 1> coarse_coord = coord;
+        double weight = 1;
+        for (size_t axis = 0; axis < D; axis++) {
+          int parent = coord[axis] / 2;
+          if ((corner >> axis) & 1) {
+            // the neighbor of the parent that is closest to the fine cell
+            coarse_coord[axis] = (coord[axis] % 2 == 0) ? parent - 1 : parent + 1;
+            weight *= 0.25;
+          } else {
+            coarse_coord[axis] = parent;
+            weight *= 0.75;
+          }
+        }
+        sum += weight * coarse_u[coarse_coord];
+      }
+      fine_u[coord] += sum;
+    });
+  }
+  /**
+   * @brief Do a V-cycle starting at a level
+   *
+   * @param levels the levels
+   * @param index the index of the level
+   */
+  void vcycle(std::vector<Level>& levels, size_t index) const
+  {
+    Level& level = levels[index];
+    if (index + 1 == levels.size()) {
+      int max_n = 0;
+      for (size_t axis = 0; axis < D; axis++) {
+        max_n = std::max(max_n, level.ns[axis]);
+      }
+      relax(level, 4 * max_n);
+      return;
+    }
+    Level& coarse = levels[index + 1];
+    relax(level, num_sweeps);
+    residual(level);
+    restrictResidual(level, coarse);
+    vcycle(levels, index + 1);
+    interpolate(coarse, level);
+    relax(level, num_sweeps);
+  }
+
+public:
+  /**
+   * @brief Construct a new PatchMultigridSolver object
+   *
+   * @param op the operator, the solver will use the same coefficients as this operator and any of
+   * its clones
+   * @param tolerance the relative residual tolerance for each patch solve
+   * @param max_cycles the maximum number of V-cycles for each patch solve
+   */
+  explicit PatchMultigridSolver(const StarPatchOperator<D>& op,
+                                double tolerance = 1e-10,
+                                int max_cycles = 50)
+    : PatchSolver<D>(op.getDomain(), op.getGhostFiller())
+    , op(op.clone())
+    , tolerance(tolerance)
+    , max_cycles(max_cycles)
+  {}
+  /**
+   * @brief Clone this patch solver
+   *
+   * @return PatchMultigridSolver<D>* a newly allocated copy of this patch solver
+   */
+  PatchMultigridSolver<D>* clone() const override { return new PatchMultigridSolver<D>(*this); }
+  /**
+   * @brief Set the number of Gauss-Seidel sweeps before and after the coarse grid correction
+   *
+   * @param num_sweeps the number of sweeps
+   */
+  void setNumSweeps(int num_sweeps) { this->num_sweeps = num_sweeps; }
+  /**
+   * @brief Get the number of Gauss-Seidel sweeps before and after the coarse grid correction
+   *
+   * @return int the number of sweeps
+   */
+  int getNumSweeps() const { return num_sweeps; }
+  /**
+   * @brief Get the number of levels that a patch is coarsened to, including the patch itself
+   *
+   * @return int the number of levels
+   */
+  int getNumLevels() const { return getWorkspace(this->getDomain().getNs()).levels.size(); }
+  /**
+   * @brief Check if solveSinglePatch can be called from multiple threads at the same time
+   *
+   * @return true, the patches are solved in scratch buffers that are allocated once per thread
+   */
+  bool isThreadSafe() const override { return true; }
+  void solveSinglePatch(const PatchInfo<D>& pinfo,
+                        const PatchView<const double, D>& f_view,
+                        const PatchView<double, D>& u_view) const override
+  {
+    if (f_view.getEnd()[D] != 0) {
+      throw RuntimeError("PatchMultigridSolver only supports vectors with a single component");
+    }
+    std::vector<Level>& levels = getWorkspace(this->getDomain().getNs()).levels;
+
+    // coefficients
+    PatchView<const double, D> coeffs = op->getCoefficients().getPatchView(pinfo.local_index);
+    const PatchView<double, D>& c = levels[0].c.getView();
+    Loop::Nested<D + 1>(getGhostStart(),
+                        getGhostEnd(levels[0].ns),
+                        [&](const std::array<int, D + 1>& coord) { c[coord] = coeffs[coord]; });
+    levels[0].spacings = pinfo.spacings;
+    for (size_t i = 1; i < levels.size(); i++) {
+      for (size_t axis = 0; axis < D; axis++) {
+        levels[i].spacings[axis] = 2 * levels[i - 1].spacings[axis];
+      }
+      restrictCoefficients(levels[i - 1], levels[i]);
+    }
+
+    // rhs and initial guess
+    Level& finest = levels[0];
+    const PatchView<double, D>& f = finest.f.getView();
+    const PatchView<double, D>& u = finest.u.getView();
+    double f_norm = 0;
+    Loop::OverInteriorIndexes<D + 1>(f, [&](const std::array<int, D + 1>& coord) {
+      f[coord] = f_view[coord];
+      u[coord] = u_view[coord];
+    });
+    op->modifyRHSForInternalBoundaryConditions(pinfo, u_view, f);
+    Loop::OverInteriorIndexes<D + 1>(
+      f, [&](const std::array<int, D + 1>& coord) { f_norm += f[coord] * f[coord]; });
+    f_norm = sqrt(f_norm);
+
+    int cycles = 0;
+    if (f_norm > 0) {
+      while (cycles < max_cycles && residual(finest) > tolerance * f_norm) {
+        vcycle(levels, 0);
+        cycles++;
+      }
+    } else {
+      // the rhs is zero, so the solution is zero
+      Loop::OverInteriorIndexes<D + 1>(
+        u, [&](const std::array<int, D + 1>& coord) { u[coord] = 0; });
+    }
+
+    Loop::OverInteriorIndexes<D + 1>(
+      u, [&](const std::array<int, D + 1>& coord) { u_view[coord] = u[coord]; });
+    if (this->getDomain().hasTimer()) {
+      this->getDomain().getTimer()->addIntInfo("Cycles", cycles);
+    }
+  }
+};
+extern template class PatchMultigridSolver<2>;
+extern template class PatchMultigridSolver<3>;
+} // namespace ThunderEgg::VarPoisson
+#endif
@@ -38,7 +38,8 @@ namespace VarPoisson {
 /**
  * @brief Implements a variable coefficient Laplacian f=Div[h*Grad[u]]
  *
- * h is a cell-centered coefficient
+ * h is a cell-centered coefficient. Clones of the operator share the coefficients, so
+ * setCoefficients() updates every clone (for example the ones held by a GMG::Cycle).
  *
  * @tparam D the number of Cartesian dimensions
  */
@@ -46,7 +47,10 @@ template<int D>
 class StarPatchOperator : public PatchOperator<D>
 {
 protected:
-  Vector<D> coeffs;
+  /**
+   * @brief The coefficients, shared with clones
+   */
+  std::shared_ptr<Vector<D>> coeffs;
 
   constexpr int addValue(int axis) const { return (axis == 0) ? 0 : 1; }
 
@@ -62,12 +66,12 @@ public:
                     const Domain<D>& domain,
                     const GhostFiller<D>& ghost_filler)
     : PatchOperator<D>(domain, ghost_filler)
-    , coeffs(coeffs)
+    , coeffs(std::make_shared<Vector<D>>(coeffs))
   {
     if (domain.getNumGhostCells() < 1) {
       throw RuntimeError("StarPatchOperator needs at least one set of ghost cells");
     }
-    ghost_filler.fillGhost(this->coeffs);
+    ghost_filler.fillGhost(*this->coeffs);
   }
   /**
    * @brief Get a clone of this operator
@@ -75,6 +79,31 @@ public:
    * @return StarPatchOperator<D>* a newly allocated copy of this operator
    */
   StarPatchOperator<D>* clone() const override { return new StarPatchOperator<D>(*this); }
+  /**
+   * @brief Replace the coefficients of this operator, and of all of its clones
+   *
+   * The values (including ghost values on the physical boundary) are copied, and the ghost
+   * values between patches are filled. The vector has to be on the same Domain as the current
+   * coefficients.
+   *
+   * @param new_coeffs the new cell centered coefficients
+   */
+  void setCoefficients(const Vector<D>& new_coeffs)
+  {
+    if (new_coeffs.getNumLocalPatches() != coeffs->getNumLocalPatches()) {
+      throw RuntimeError("StarPatchOperator::setCoefficients was given a vector with " +
+                         std::to_string(new_coeffs.getNumLocalPatches()) +
+                         " patches, expected " + std::to_string(coeffs->getNumLocalPatches()));
+    }
+    coeffs->copyWithGhost(new_coeffs);
+    this->getGhostFiller().fillGhost(*coeffs);
+  }
+  /**
+   * @brief Get the coefficients, with ghost values filled
+   *
+   * @return const Vector<D>& the coefficients
+   */
+  const Vector<D>& getCoefficients() const { return *coeffs; }
   void applySinglePatch(const PatchInfo<D>& pinfo,
                         const PatchView<const double, D>& u_view,
                         const PatchView<double, D>& f_view,
@@ -85,7 +114,7 @@ public:
     }
     enforceBoundaryConditions(pinfo, u_view);
 
-    PatchView<const double, D> c = coeffs.getPatchView(pinfo.local_index);
+    PatchView<const double, D> c = coeffs->getPatchView(pinfo.local_index);
     std::array<double, D> h2 = pinfo.spacings;
     for (size_t i = 0; i < D; i++) {
       h2[i] *= h2[i];
@@ -169,7 +198,7 @@ public:
                                               const PatchView<const double, D>& u_view,
                                               const PatchView<double, D>& f_view) const override
   {
-    PatchView<const double, D> c = coeffs.getPatchView(pinfo.local_index);
+    PatchView<const double, D> c = coeffs->getPatchView(pinfo.local_index);
     for (Side<D> s : Side<D>::getValues()) {
       if (pinfo.hasNbr(s)) {
         double h2 = pow(pinfo.spacings[s.getAxisIndex()], 2);
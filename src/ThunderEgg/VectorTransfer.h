@@ -0,0 +1,594 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#ifndef THUNDEREGG_VECTORTRANSFER_H
+#define THUNDEREGG_VECTORTRANSFER_H
+/**
+ * @file
+ *
+ * @brief VectorTransfer class
+ */
+#include <ThunderEgg/Domain.h>
+#include <ThunderEgg/Loops.h>
+#include <ThunderEgg/RuntimeError.h>
+#include <ThunderEgg/Vector.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <vector>
+
+namespace ThunderEgg {
+/**
+ * @brief Transfers vectors from an old Domain to a new Domain, after the patches have been refined,
+ * coarsened, or moved to different ranks.
+ *
+ * The patches of the two domains are matched by their location, so the two domains have to be
+ * refinements of the same forest of quadtrees or octrees, as is the case for domains generated from
+ * a p4est before and after it is adapted or repartitioned. A new patch gets its values from
+ *
+ * 	- the old patch in the same location, which are copied,
+ * 	- the coarser old patch that contains it, which are injected, like GMG::DirectInterpolator,
+ * 	- or the finer old patches that it contains, which are averaged, like GMG::LinearRestrictor.
+ *
+ * Old patches are sent point-to-point to the ranks that own the new patches that need them, and are
+ * received into a ghost vector, as is done in GMG::InterLevelComm. All components of a vector are
+ * transferred in one pass. New patches that do not overlap any old patch are set to zero.
+ *
+ * Both domains have to be on the same communicator and have the same number of cells in each
+ * patch.
+ *
+ * @tparam D the number of Cartesian dimensions
+ */
+template<int D>
+class VectorTransfer
+{
+private:
+  /**
+   * @brief An old patch that overlaps a new patch
+   */
+  struct Overlap
+  {
+    /**
+     * @brief the local index of the new patch
+     */
+    int new_local_index;
+    /**
+     * @brief the local index of the old patch in either the old vector or the ghost vector
+     */
+    int old_index;
+    /**
+     * @brief the offset of the finer patch in the coarser patch along each axis, in lengths of the
+     * finer patch
+     */
+    std::array<int, D> offsets;
+    /**
+     * @brief the length of the old patch divided by the length of the new patch along each axis,
+     * 1 if the old patch is not longer
+     */
+    std::array<int, D> old_ratios;
+    /**
+     * @brief the length of the new patch divided by the length of the old patch along each axis,
+     * 1 if the new patch is not longer
+     */
+    std::array<int, D> new_ratios;
+  };
+  /**
+   * @brief The number of values in a record of a patch: whether the patch is new, the rank, the
+   * local index, the corner on the patch grid, and the lengths on the patch grid
+   */
+  static constexpr int patch_record_size = 3 + 2 * D;
+  /**
+   * @brief A record of a patch
+   */
+  using PatchRecord = std::array<int64_t, patch_record_size>;
+  /**
+   * @brief The number of values in a record of a match: the new patch rank, the new patch local
+   * index, the old patch rank, the old patch local index, and the corners and lengths of the old
+   * and new patches
+   */
+  static constexpr int match_record_size = 4 + 4 * D;
+  /**
+   * @brief A record of a matched old and new patch
+   */
+  using MatchRecord = std::array<int64_t, match_record_size>;
+  /**
+   * @brief The communicator
+   */
+  Communicator comm;
+  /**
+   * @brief The old domain
+   */
+  Domain<D> old_domain;
+  /**
+   * @brief The new domain
+   */
+  Domain<D> new_domain;
+  /**
+   * @brief Dimensions of a patch
+   */
+  std::array<int, D> ns;
+  /**
+   * @brief Number of old patches that are received from other ranks
+   */
+  int num_ghost_patches = 0;
+  /**
+   * @brief Overlaps where the old patch is local
+   */
+  std::vector<Overlap> local_overlaps;
+  /**
+   * @brief Overlaps where the old patch is in the ghost vector
+   */
+  std::vector<Overlap> ghost_overlaps;
+  /**
+   * @brief A vector of pairs where the first value is the rank, and the second vector is the
+   * local indexes of old patches in the order that the other processor is expecting them.
+   */
+  std::vector<std::pair<int, std::vector<int>>> rank_and_local_indexes_for_vector;
+  /**
+   * @brief A vector of pairs where the first value is the rank, and the second vector is the
+   * local indexes in the ghost vector in the order that the other processor is sending them.
+   */
+  std::vector<std::pair<int, std::vector<int>>> rank_and_local_indexes_for_ghost_vector;
+
+  /**
+   * @brief Send records to other ranks
+   *
+   * @tparam Record the record type
+   * @param comm the communicator
+   * @param outgoing the records to send to each rank
+   * @return std::vector<Record> the records that were received from all ranks
+   */
+  template<class Record>
+  static std::vector<Record> Exchange(const Communicator& comm,
+                                      const std::vector<std::vector<Record>>& outgoing)
+  {
+    int size = comm.getSize();
+    std::vector<int> send_counts(size);
+    for (int r = 0; r < size; r++) {
+      send_counts[r] = (int)(outgoing[r].size() * sizeof(Record));
+    }
+    std::vector<int> recv_counts(size);
+    MPI_Alltoall(
+      send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, comm.getMPIComm());
+
+    std::vector<int> recv_offsets(size + 1, 0);
+    for (int r = 0; r < size; r++) {
+      recv_offsets[r + 1] = recv_offsets[r] + recv_counts[r];
+    }
+    std::vector<Record> incoming(recv_offsets[size] / sizeof(Record));
+
+    std::vector<MPI_Request> requests;
+    for (int r = 0; r < size; r++) {
+      if (recv_counts[r] > 0) {
+        requests.emplace_back();
+        MPI_Irecv((char*)incoming.data() + recv_offsets[r],
+                  recv_counts[r],
+                  MPI_BYTE,
+                  r,
+                  0,
+                  comm.getMPIComm(),
+                  &requests.back());
+      }
+    }
+    for (int r = 0; r < size; r++) {
+      if (send_counts[r] > 0) {
+        requests.emplace_back();
+        MPI_Isend(outgoing[r].data(),
+                  send_counts[r],
+                  MPI_BYTE,
+                  r,
+                  0,
+                  comm.getMPIComm(),
+                  &requests.back());
+      }
+    }
+    MPI_Waitall((int)requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+    return incoming;
+  }
+  /**
+   * @brief Group (rank, local index) pairs by rank
+   *
+   * @param pairs the pairs, these will be sorted and have duplicates removed
+   * @return std::vector<std::pair<int, std::vector<int>>> the ranks and their local indexes, in
+   * increasing order
+   */
+  static std::vector<std::pair<int, std::vector<int>>>
+  groupByRank(std::vector<std::array<int, 2>>& pairs)
+  {
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    std::vector<std::pair<int, std::vector<int>>> ranks_and_local_indexes;
+    for (const std::array<int, 2>& pair : pairs) {
+      if (ranks_and_local_indexes.empty() || ranks_and_local_indexes.back().first != pair[0]) {
+        ranks_and_local_indexes.emplace_back(pair[0], std::vector<int>());
+      }
+      ranks_and_local_indexes.back().second.push_back(pair[1]);
+    }
+    return ranks_and_local_indexes;
+  }
+  /**
+   * @brief Match the old and new patches
+   *
+   * Each patch is sent to a directory rank, which is chosen by the cell of the coarsest patch grid
+   * that contains the patch, so that overlapping patches are sent to the same rank. The directory
+   * ranks find the overlapping patches and send the matches to the ranks of the patches.
+   *
+   * @return std::vector<MatchRecord> the matches that involve a patch on this rank
+   */
+  std::vector<MatchRecord> matchPatches() const
+  {
+    int size = comm.getSize();
+
+    // lower corner, and the shortest and longest patch lengths of both domains, the lower corner
+    // and shortest lengths are negated so that one reduction finds all of them
+    std::array<double, 3 * D> bounds;
+    bounds.fill(std::numeric_limits<double>::lowest());
+    for (const Domain<D>* domain : { &old_domain, &new_domain }) {
+      for (const PatchInfo<D>& pinfo : domain->getPatchInfoVector()) {
+        for (int axis = 0; axis < D; axis++) {
+          double length = pinfo.ns[axis] * pinfo.spacings[axis];
+          bounds[axis] = std::max(bounds[axis], -pinfo.starts[axis]);
+          bounds[D + axis] = std::max(bounds[D + axis], -length);
+          bounds[2 * D + axis] = std::max(bounds[2 * D + axis], length);
+        }
+      }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, bounds.data(), 3 * D, MPI_DOUBLE, MPI_MAX, comm.getMPIComm());
+    if (bounds[2 * D] < 0) {
+      // there are no patches
+      return std::vector<MatchRecord>();
+    }
+
+    // records of the patches, on a grid where the shortest patches have a length of 1
+    std::array<int64_t, D> max_lengths;
+    for (int axis = 0; axis < D; axis++) {
+      max_lengths[axis] = std::llround(bounds[2 * D + axis] / -bounds[D + axis]);
+    }
+    std::vector<std::vector<PatchRecord>> outgoing_patches(size);
+    for (const Domain<D>* domain : { &old_domain, &new_domain }) {
+      for (const PatchInfo<D>& pinfo : domain->getPatchInfoVector()) {
+        PatchRecord record;
+        record[0] = domain == &new_domain;
+        record[1] = pinfo.rank;
+        record[2] = pinfo.local_index;
+        uint64_t hash = 0;
+        for (int axis = 0; axis < D; axis++) {
+          double shortest_length = -bounds[D + axis];
+          double length = pinfo.ns[axis] * pinfo.spacings[axis];
+          record[3 + axis] = std::llround((pinfo.starts[axis] + bounds[axis]) / shortest_length);
+          record[3 + D + axis] = std::llround(length / shortest_length);
+          hash = hash * 1000003 + (uint64_t)(record[3 + axis] / max_lengths[axis]);
+        }
+        outgoing_patches[hash % size].push_back(record);
+      }
+    }
+    std::vector<PatchRecord> patches = Exchange(comm, outgoing_patches);
+
+    // find the matches
+    using Key = std::array<int64_t, 2 * D>;
+    std::map<Key, const PatchRecord*> old_patches;
+    std::map<Key, const PatchRecord*> new_patches;
+    for (const PatchRecord& record : patches) {
+      Key key;
+      std::copy(record.begin() + 3, record.end(), key.begin());
+      (record[0] ? new_patches : old_patches).emplace(key, &record);
+    }
+    std::vector<std::vector<MatchRecord>> outgoing_matches(size);
+    auto add_match = [&](const PatchRecord& old_record, const PatchRecord& new_record) {
+      MatchRecord match;
+      match[0] = new_record[1];
+      match[1] = new_record[2];
+      match[2] = old_record[1];
+      match[3] = old_record[2];
+      std::copy(old_record.begin() + 3, old_record.end(), match.begin() + 4);
+      std::copy(new_record.begin() + 3, new_record.end(), match.begin() + 4 + 2 * D);
+      outgoing_matches[new_record[1]].push_back(match);
+      if (old_record[1] != new_record[1]) {
+        outgoing_matches[old_record[1]].push_back(match);
+      }
+    };
+    // replace a key with the key of its parent on the patch grid, false if the parent is longer
+    // than the longest patch along any axis
+    auto to_parent = [&](Key& key) {
+      bool within = true;
+      for (int axis = 0; axis < D; axis++) {
+        key[D + axis] *= 2;
+        key[axis] -= key[axis] % key[D + axis];
+        within = within && key[D + axis] <= max_lengths[axis];
+      }
+      return within;
+    };
+    // each new patch is matched with the old patch that is the same as it or contains it
+    for (const auto& [key, new_record] : new_patches) {
+      Key ancestor_key = key;
+      do {
+        auto iter = old_patches.find(ancestor_key);
+        if (iter != old_patches.end()) {
+          add_match(*iter->second, *new_record);
+          break;
+        }
+      } while (to_parent(ancestor_key));
+    }
+    // each old patch is matched with the new patch that contains it
+    for (const auto& [key, old_record] : old_patches) {
+      Key ancestor_key = key;
+      while (to_parent(ancestor_key)) {
+        auto iter = new_patches.find(ancestor_key);
+        if (iter != new_patches.end()) {
+          add_match(*old_record, *iter->second);
+          break;
+        }
+      }
+    }
+    return Exchange(comm, outgoing_matches);
+  }
+
+public:
+  /**
+   * @brief Construct a new VectorTransfer object
+   *
+   * This is collective over the communicator of the domains.
+   *
+   * @param old_domain the domain that vectors are transferred from
+   * @param new_domain the domain that vectors are transferred to
+   * @exception RuntimeError if the patches of the domains do not have the same number of cells
+   */
+  VectorTransfer(const Domain<D>& old_domain, const Domain<D>& new_domain)
+    : comm(new_domain.getCommunicator())
+    , old_domain(old_domain)
+    , new_domain(new_domain)
+    , ns(new_domain.getNs())
+  {
+    if (old_domain.getNs() != new_domain.getNs()) {
+      throw RuntimeError("VectorTransfer requires the patches of both domains to have the same "
+                         "number of cells");
+    }
+    int rank = comm.getRank();
+
+    std::vector<MatchRecord> matches = matchPatches();
+
+    // old patches to send, and old patches to receive into the ghost vector
+    std::vector<std::array<int, 2>> ranks_and_local_indexes;
+    std::vector<std::array<int, 2>> ranks_and_ghost_local_indexes;
+    for (const MatchRecord& match : matches) {
+      if (match[0] != rank) {
+        ranks_and_local_indexes.push_back({ (int)match[0], (int)match[3] });
+      } else if (match[2] != rank) {
+        ranks_and_ghost_local_indexes.push_back({ (int)match[2], (int)match[3] });
+      }
+    }
+    rank_and_local_indexes_for_vector = groupByRank(ranks_and_local_indexes);
+    // ranks_and_ghost_local_indexes is sorted, so the position of a pair is its local index in the
+    // ghost vector
+    rank_and_local_indexes_for_ghost_vector = groupByRank(ranks_and_ghost_local_indexes);
+    num_ghost_patches = (int)ranks_and_ghost_local_indexes.size();
+    for (auto& rank_indexes_pair : rank_and_local_indexes_for_ghost_vector) {
+      for (int& local_index : rank_indexes_pair.second) {
+        std::array<int, 2> pair = { rank_indexes_pair.first, local_index };
+        local_index = (int)(std::lower_bound(ranks_and_ghost_local_indexes.begin(),
+                                             ranks_and_ghost_local_indexes.end(),
+                                             pair) -
+                            ranks_and_ghost_local_indexes.begin());
+      }
+    }
+
+    for (const MatchRecord& match : matches) {
+      if (match[0] != rank) {
+        continue;
+      }
+      Overlap overlap;
+      overlap.new_local_index = (int)match[1];
+      for (int axis = 0; axis < D; axis++) {
+        int64_t old_corner = match[4 + axis];
+        int64_t old_length = match[4 + D + axis];
+        int64_t new_corner = match[4 + 2 * D + axis];
+        int64_t new_length = match[4 + 3 * D + axis];
+        if (old_length >= new_length) {
+          overlap.offsets[axis] = (int)((new_corner - old_corner) / new_length);
+          overlap.old_ratios[axis] = (int)(old_length / new_length);
+          overlap.new_ratios[axis] = 1;
+        } else {
+          overlap.offsets[axis] = (int)((old_corner - new_corner) / old_length);
+          overlap.old_ratios[axis] = 1;
+          overlap.new_ratios[axis] = (int)(new_length / old_length);
+        }
+      }
+      if (match[2] == rank) {
+        overlap.old_index = (int)match[3];
+        local_overlaps.push_back(overlap);
+      } else {
+        std::array<int, 2> pair = { (int)match[2], (int)match[3] };
+        overlap.old_index = (int)(std::lower_bound(ranks_and_ghost_local_indexes.begin(),
+                                                   ranks_and_ghost_local_indexes.end(),
+                                                   pair) -
+                                  ranks_and_ghost_local_indexes.begin());
+        ghost_overlaps.push_back(overlap);
+      }
+    }
+  }
+  /**
+   * @brief Get the old domain
+   *
+   * @return const Domain<D>& the old domain
+   */
+  const Domain<D>& getOldDomain() const { return old_domain; }
+  /**
+   * @brief Get the new domain
+   *
+   * @return const Domain<D>& the new domain
+   */
+  const Domain<D>& getNewDomain() const { return new_domain; }
+  /**
+   * @brief Get the number of old patches that are received from other ranks
+   *
+   * @return int the number of patches
+   */
+  int getNumGhostPatches() const { return num_ghost_patches; }
+  /**
+   * @brief Transfer the values of a vector on the old domain to a vector on the new domain
+   *
+   * The ghost cells of the new vector are not set. This is collective over the communicator of the
+   * domains.
+   *
+   * @param old_vector the vector on the old domain
+   * @param new_vector the vector on the new domain
+   * @exception RuntimeError if the vectors do not match their domains, or do not have the same
+   * number of components
+   */
+  void transfer(const Vector<D>& old_vector, Vector<D>& new_vector) const
+  {
+    if (old_vector.getNumLocalPatches() != old_domain.getNumLocalPatches()) {
+      throw RuntimeError("VectorTransfer old vector does not have the patches of the old domain");
+    }
+    if (new_vector.getNumLocalPatches() != new_domain.getNumLocalPatches()) {
+      throw RuntimeError("VectorTransfer new vector does not have the patches of the new domain");
+    }
+    if (old_vector.getNumComponents() != new_vector.getNumComponents()) {
+      throw RuntimeError("VectorTransfer vectors have different numbers of components");
+    }
+    int num_components = new_vector.getNumComponents();
+    int patch_size = num_components;
+    for (int axis = 0; axis < D; axis++) {
+      patch_size *= ns[axis];
+    }
+
+    Vector<D> ghost_vector(comm, ns, num_components, num_ghost_patches, 0);
+
+    // post receives
+    std::vector<std::vector<double>> recv_buffers;
+    std::vector<MPI_Request> recv_requests;
+    recv_buffers.reserve(rank_and_local_indexes_for_ghost_vector.size());
+    recv_requests.reserve(rank_and_local_indexes_for_ghost_vector.size());
+    for (const auto& rank_indexes_pair : rank_and_local_indexes_for_ghost_vector) {
+      recv_buffers.emplace_back(patch_size * rank_indexes_pair.second.size());
+      recv_requests.emplace_back();
+      MPI_Irecv(recv_buffers.back().data(),
+                (int)recv_buffers.back().size(),
+                MPI_DOUBLE,
+                rank_indexes_pair.first,
+                0,
+                comm.getMPIComm(),
+                &recv_requests.back());
+    }
+    // post sends
+    std::vector<std::vector<double>> send_buffers;
+    std::vector<MPI_Request> send_requests;
+    send_buffers.reserve(rank_and_local_indexes_for_vector.size());
+    send_requests.reserve(rank_and_local_indexes_for_vector.size());
+    for (const auto& rank_indexes_pair : rank_and_local_indexes_for_vector) {
+      send_buffers.emplace_back(patch_size * rank_indexes_pair.second.size());
+      int buffer_idx = 0;
+      for (int local_index : rank_indexes_pair.second) {
+        PatchView<const double, D> view = old_vector.getPatchView(local_index);
+        Loop::OverInteriorIndexes<D + 1>(view, [&](const std::array<int, D + 1>& coord) {
+          send_buffers.back()[buffer_idx] = view[coord];
+          buffer_idx++;
+        });
+      }
+      send_requests.emplace_back();
+      MPI_Isend(send_buffers.back().data(),
+                (int)send_buffers.back().size(),
+                MPI_DOUBLE,
+                rank_indexes_pair.first,
+                0,
+                comm.getMPIComm(),
+                &send_requests.back());
+    }
+
+    // local patches are transferred while the ghost patches are being communicated
+    new_vector.set(0);
+    for (const Overlap& overlap : local_overlaps) {
+      addOverlap(overlap,
+                 old_vector.getPatchView(overlap.old_index),
+                 new_vector.getPatchView(overlap.new_local_index));
+    }
+
+    for (size_t i = 0; i < recv_requests.size(); i++) {
+      int finished_idx;
+      MPI_Waitany(
+        (int)recv_requests.size(), recv_requests.data(), &finished_idx, MPI_STATUS_IGNORE);
+      const std::vector<double>& buffer = recv_buffers[finished_idx];
+      int buffer_idx = 0;
+      for (int local_index : rank_and_local_indexes_for_ghost_vector[finished_idx].second) {
+        PatchView<double, D> view = ghost_vector.getPatchView(local_index);
+        Loop::OverInteriorIndexes<D + 1>(view, [&](const std::array<int, D + 1>& coord) {
+          view[coord] = buffer[buffer_idx];
+          buffer_idx++;
+        });
+      }
+    }
+    for (const Overlap& overlap : ghost_overlaps) {
+      addOverlap(overlap,
+                 ghost_vector.getPatchView(overlap.old_index),
+                 new_vector.getPatchView(overlap.new_local_index));
+    }
+
+    MPI_Waitall((int)send_requests.size(), send_requests.data(), MPI_STATUSES_IGNORE);
+  }
+
+private:
+  /**
+   * @brief Add the values of an old patch to the new patch that it overlaps
+   *
+   * Each cell of the finer patch along an axis is mapped to the cell of the other patch that
+   * contains it. The values of the cells of a finer old patch are averaged.
+   *
+   * @param overlap the overlap
+   * @param old_view the view of the old patch
+   * @param new_view the view of the new patch
+   */
+  void addOverlap(const Overlap& overlap,
+                  const PatchView<const double, D>& old_view,
+                  const PatchView<double, D>& new_view) const
+  {
+    std::array<std::vector<int>, D> old_indexes;
+    std::array<std::vector<int>, D> new_indexes;
+    double weight = 1;
+    for (int axis = 0; axis < D; axis++) {
+      old_indexes[axis].resize(ns[axis]);
+      new_indexes[axis].resize(ns[axis]);
+      for (int i = 0; i < ns[axis]; i++) {
+        int finer_index = overlap.offsets[axis] * ns[axis] + i;
+        old_indexes[axis][i] = overlap.old_ratios[axis] > 1 ? finer_index / overlap.old_ratios[axis]
+                                                            : i;
+        new_indexes[axis][i] = overlap.new_ratios[axis] > 1 ? finer_index / overlap.new_ratios[axis]
+                                                            : i;
+      }
+      weight /= overlap.new_ratios[axis];
+    }
+    Loop::OverInteriorIndexes<D + 1>(new_view, [&](const std::array<int, D + 1>& coord) {
+      std::array<int, D + 1> old_coord;
+      std::array<int, D + 1> new_coord;
+      for (int axis = 0; axis < D; axis++) {
+        old_coord[axis] = old_indexes[axis][coord[axis]];
+        new_coord[axis] = new_indexes[axis][coord[axis]];
+      }
+      old_coord[D] = coord[D];
+      new_coord[D] = coord[D];
+      new_view[new_coord] += weight * old_view[old_coord];
+    });
+  }
+};
+extern template class VectorTransfer<2>;
+extern template class VectorTransfer<3>;
+} // namespace ThunderEgg
+#endif
@@ -0,0 +1,73 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#include "utils/UniformDomainGenerator.h"
+#include <ThunderEgg/AgglomeratingDomainGenerator.h>
+
+#include <doctest.h>
+
+using namespace std;
+using namespace ThunderEgg;
+
+TEST_CASE("AgglomeratingDomainGenerator throws with min_patches_per_rank less than 1")
+{
+  auto generator = make_shared<UniformDomainGenerator>(4, array<int, 2>{ 2, 2 }, 1);
+  CHECK_THROWS_AS(AgglomeratingDomainGenerator<2>(generator, 0), RuntimeError);
+}
+TEST_CASE("AgglomeratingDomainGenerator getCoarserDomain throws before getFinestDomain")
+{
+  auto generator = make_shared<UniformDomainGenerator>(4, array<int, 2>{ 2, 2 }, 1);
+  AgglomeratingDomainGenerator<2> agglomerating_generator(generator, 4);
+  CHECK_FALSE(agglomerating_generator.hasCoarserDomain());
+  CHECK_THROWS_AS(agglomerating_generator.getCoarserDomain(), RuntimeError);
+}
+TEST_CASE("AgglomeratingDomainGenerator returns the same hierarchy on one rank")
+{
+  for (int min_patches_per_rank : { 1, 4, 100 }) {
+    auto generator = make_shared<UniformDomainGenerator>(8, array<int, 2>{ 2, 2 }, 1);
+    UniformDomainGenerator reference_generator(8, { 2, 2 }, 1);
+    AgglomeratingDomainGenerator<2> agglomerating_generator(generator, min_patches_per_rank);
+    CHECK_EQ(agglomerating_generator.getMinPatchesPerRank(), min_patches_per_rank);
+
+    vector<Domain<2>> domains;
+    vector<Domain<2>> reference_domains;
+    domains.push_back(agglomerating_generator.getFinestDomain());
+    reference_domains.push_back(reference_generator.getFinestDomain());
+    while (reference_generator.hasCoarserDomain()) {
+      REQUIRE(agglomerating_generator.hasCoarserDomain());
+      domains.push_back(agglomerating_generator.getCoarserDomain());
+      reference_domains.push_back(reference_generator.getCoarserDomain());
+    }
+    CHECK_FALSE(agglomerating_generator.hasCoarserDomain());
+
+    REQUIRE_EQ(domains.size(), 4);
+    for (size_t i = 0; i < domains.size(); i++) {
+      CHECK_EQ(domains[i].getId(), reference_domains[i].getId());
+      CHECK_EQ(domains[i].getNumLocalPatches(), reference_domains[i].getNumLocalPatches());
+      for (int j = 0; j < domains[i].getNumLocalPatches(); j++) {
+        const PatchInfo<2>& pinfo = domains[i].getPatchInfoVector()[j];
+        const PatchInfo<2>& reference_pinfo = reference_domains[i].getPatchInfoVector()[j];
+        CHECK_EQ(pinfo.id, reference_pinfo.id);
+        CHECK_EQ(pinfo.parent_rank, reference_pinfo.parent_rank);
+        CHECK_EQ(pinfo.child_ranks, reference_pinfo.child_ranks);
+        CHECK_EQ(pinfo.getNbrRanks(), reference_pinfo.getNbrRanks());
+      }
+    }
+  }
+}
@@ -0,0 +1,239 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#include "utils/UniformDomainGenerator.h"
+#include <ThunderEgg/AgglomeratingDomainGenerator.h>
+#include <ThunderEgg/BiLinearGhostFiller.h>
+#include <ThunderEgg/DomainTools.h>
+#include <ThunderEgg/GMG/CycleBuilder.h>
+#include <ThunderEgg/GMG/DirectInterpolator.h>
+#include <ThunderEgg/GMG/LinearRestrictor.h>
+#include <ThunderEgg/Iterative/BiCGStab.h>
+#include <ThunderEgg/Iterative/PatchSolver.h>
+#include <ThunderEgg/Poisson/StarPatchOperator.h>
+
+#include <doctest.h>
+
+using namespace std;
+using namespace ThunderEgg;
+
+namespace {
+vector<Domain<2>>
+GetDomains(DomainGenerator<2>& generator)
+{
+  vector<Domain<2>> domains;
+  domains.push_back(generator.getFinestDomain());
+  while (generator.hasCoarserDomain()) {
+    domains.push_back(generator.getCoarserDomain());
+  }
+  return domains;
+}
+map<int, int>
+GetOwners(const Domain<2>& domain)
+{
+  int size;
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  vector<int> ids;
+  for (const PatchInfo<2>& pinfo : domain.getPatchInfoVector()) {
+    ids.push_back(pinfo.id);
+  }
+  int num_ids = ids.size();
+  vector<int> counts(size);
+  MPI_Allgather(&num_ids, 1, MPI_INT, counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+  vector<int> offsets(size, 0);
+  for (int r = 1; r < size; r++) {
+    offsets[r] = offsets[r - 1] + counts[r - 1];
+  }
+  vector<int> all_ids(offsets.back() + counts.back());
+  MPI_Allgatherv(ids.data(),
+                 num_ids,
+                 MPI_INT,
+                 all_ids.data(),
+                 counts.data(),
+                 offsets.data(),
+                 MPI_INT,
+                 MPI_COMM_WORLD);
+  map<int, int> owners;
+  for (int r = 0; r < size; r++) {
+    for (int i = offsets[r]; i < offsets[r] + counts[r]; i++) {
+      owners[all_ids[i]] = r;
+    }
+  }
+  return owners;
+}
+} // namespace
+
+TEST_CASE("AgglomeratingDomainGenerator spreads coarse levels over fewer ranks")
+{
+  auto generator = make_shared<UniformDomainGenerator>(8, array<int, 2>{ 2, 2 }, 1);
+  AgglomeratingDomainGenerator<2> agglomerating_generator(generator, 6);
+  vector<Domain<2>> domains = GetDomains(agglomerating_generator);
+
+  UniformDomainGenerator reference_generator(8, { 2, 2 }, 1);
+  Domain<2> reference_finest = reference_generator.getFinestDomain();
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  REQUIRE_EQ(domains.size(), 4);
+
+  // 64 patches, left as is
+  CHECK_EQ(domains[0].getNumLocalPatches(), reference_finest.getNumLocalPatches());
+  CHECK_EQ(domains[0].getCommunicator().getSize(), 3);
+
+  // 16 patches, moved to 2 ranks
+  CHECK_EQ(domains[1].getNumLocalPatches(), rank < 2 ? 8 : 0);
+  CHECK_EQ(domains[1].getCommunicator().getSize(), rank < 2 ? 2 : 1);
+  CHECK_EQ(domains[1].getNumGlobalPatches(), rank < 2 ? 16 : 0);
+
+  // 4 patches, moved to 1 rank
+  CHECK_EQ(domains[2].getNumLocalPatches(), rank == 0 ? 4 : 0);
+  CHECK_EQ(domains[2].getCommunicator().getSize(), 1);
+
+  CHECK_EQ(domains[3].getNumLocalPatches(), rank == 0 ? 1 : 0);
+  CHECK_EQ(domains[3].getCommunicator().getSize(), 1);
+
+  for (size_t i = 0; i < domains.size(); i++) {
+    CHECK_EQ(domains[i].getId(), i);
+  }
+}
+TEST_CASE("AgglomeratingDomainGenerator keeps rank information consistent")
+{
+  for (int min_patches_per_rank : { 1, 2, 6, 100 }) {
+    auto generator = make_shared<UniformDomainGenerator>(8, array<int, 2>{ 2, 2 }, 1);
+    AgglomeratingDomainGenerator<2> agglomerating_generator(generator, min_patches_per_rank);
+    vector<Domain<2>> domains = GetDomains(agglomerating_generator);
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    vector<map<int, int>> owners;
+    for (const Domain<2>& domain : domains) {
+      owners.push_back(GetOwners(domain));
+    }
+
+    for (size_t level = 0; level < domains.size(); level++) {
+      INFO("level: " << level << " min_patches_per_rank: " << min_patches_per_rank);
+      int num_patches = 0;
+      for (const PatchInfo<2>& pinfo : domains[level].getPatchInfoVector()) {
+        num_patches++;
+        CHECK_EQ(pinfo.rank, rank);
+        auto nbr_ids = pinfo.getNbrIds();
+        auto nbr_ranks = pinfo.getNbrRanks();
+        for (size_t i = 0; i < nbr_ids.size(); i++) {
+          CHECK_EQ(nbr_ranks[i], owners[level].at(nbr_ids[i]));
+        }
+        if (level + 1 < domains.size()) {
+          CHECK_EQ(pinfo.parent_rank, owners[level + 1].at(pinfo.parent_id));
+        }
+        if (level > 0) {
+          for (int orth = 0; orth < 4; orth++) {
+            CHECK_EQ(pinfo.child_ranks[orth], owners[level - 1].at(pinfo.child_ids[orth]));
+          }
+        }
+      }
+      int global_num_patches;
+      MPI_Allreduce(&num_patches, &global_num_patches, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+      CHECK_EQ(global_num_patches, (int)owners[level].size());
+    }
+  }
+}
+TEST_CASE("AgglomeratingDomainGenerator restriction and interpolation match the original hierarchy")
+{
+  auto generator = make_shared<UniformDomainGenerator>(8, array<int, 2>{ 4, 4 }, 1);
+  AgglomeratingDomainGenerator<2> agglomerating_generator(generator, 6);
+  vector<Domain<2>> domains = GetDomains(agglomerating_generator);
+
+  UniformDomainGenerator reference_generator(8, { 4, 4 }, 1);
+  vector<Domain<2>> reference_domains = GetDomains(reference_generator);
+
+  auto round_trip = [](const vector<Domain<2>>& domains) {
+    Vector<2> fine(domains[0], 1);
+    DomainTools::SetValuesWithGhost<2>(domains[0], fine, [](const std::array<double, 2>& coord) {
+      return sin(M_PI * coord[0]) * cos(3 * coord[1]) + coord[0];
+    });
+    vector<Vector<2>> restricted = { fine };
+    for (size_t i = 1; i < domains.size(); i++) {
+      GMG::LinearRestrictor<2> restrictor(domains[i - 1], domains[i]);
+      restricted.push_back(restrictor.restrict(restricted.back()));
+    }
+    for (size_t i = domains.size() - 1; i > 0; i--) {
+      GMG::DirectInterpolator<2> interpolator(domains[i], domains[i - 1]);
+      interpolator.interpolate(restricted[i], restricted[i - 1]);
+    }
+    return restricted[0];
+  };
+
+  Vector<2> result = round_trip(domains);
+  Vector<2> reference_result = round_trip(reference_domains);
+
+  Vector<2> diff = result.getZeroClone();
+  diff.addScaled(1.0, result, -1.0, reference_result);
+  CHECK_GT(reference_result.twoNorm(), 0);
+  CHECK_LT(diff.twoNorm(), 1e-12 * reference_result.twoNorm());
+}
+TEST_CASE("AgglomeratingDomainGenerator V-cycle matches the original hierarchy")
+{
+  auto build_cycle = [](const vector<Domain<2>>& domains) {
+    GMG::CycleOpts opts;
+    GMG::CycleBuilder<2> builder(opts);
+    Iterative::BiCGStab<2> bcgs;
+    bcgs.setTolerance(1e-12);
+    for (size_t i = 0; i < domains.size(); i++) {
+      BiLinearGhostFiller ghost_filler(domains[i], GhostFillingType::Faces);
+      Poisson::StarPatchOperator<2> op(domains[i], ghost_filler);
+      if (i == 0) {
+        Iterative::PatchSolver<2> smoother(bcgs, op);
+        GMG::LinearRestrictor<2> restrictor(domains[0], domains[1]);
+        builder.addFinestLevel(op, smoother, restrictor);
+      } else if (i + 1 < domains.size()) {
+        Iterative::PatchSolver<2> smoother(bcgs, op);
+        GMG::LinearRestrictor<2> restrictor(domains[i], domains[i + 1]);
+        GMG::DirectInterpolator<2> interpolator(domains[i], domains[i - 1]);
+        builder.addIntermediateLevel(op, smoother, restrictor, interpolator);
+      } else {
+        GMG::DirectInterpolator<2> interpolator(domains[i], domains[i - 1]);
+        builder.addCoarsestLevel(op, domains[i], interpolator);
+      }
+    }
+    return builder.getCycle();
+  };
+
+  auto generator = make_shared<UniformDomainGenerator>(8, array<int, 2>{ 4, 4 }, 1);
+  AgglomeratingDomainGenerator<2> agglomerating_generator(generator, 6);
+  vector<Domain<2>> domains = GetDomains(agglomerating_generator);
+
+  UniformDomainGenerator reference_generator(8, { 4, 4 }, 1);
+  vector<Domain<2>> reference_domains = GetDomains(reference_generator);
+
+  Vector<2> f(domains[0], 1);
+  DomainTools::SetValues<2>(domains[0], f, [](const std::array<double, 2>& coord) {
+    return sin(M_PI * coord[0]) * sin(2 * M_PI * coord[1]);
+  });
+
+  Vector<2> u(domains[0], 1);
+  build_cycle(domains)->apply(f, u);
+  Vector<2> reference_u(reference_domains[0], 1);
+  build_cycle(reference_domains)->apply(f, reference_u);
+
+  Vector<2> diff = u.getZeroClone();
+  diff.addScaled(1.0, u, -1.0, reference_u);
+  CHECK_GT(reference_u.twoNorm(), 0);
+  CHECK_LT(diff.twoNorm(), 1e-8 * reference_u.twoNorm());
+}
@@ -380,3 +380,50 @@ TEST_CASE("Domain<3> global indexes in neighbor info are consistent")
     }
   }
 }
+TEST_CASE("Domain copies share PatchInfo vector and NbrTable")
+{
+  DomainReader<2> domain_reader("mesh_inputs/2d_uniform_2x2_refined_nw_mpi1.json", { 4, 4 }, 1);
+  Domain<2> domain = domain_reader.getFinerDomain();
+  Domain<2> copy = domain;
+
+  CHECK_EQ(&copy.getPatchInfoVector(), &domain.getPatchInfoVector());
+  CHECK_EQ(&copy.getNbrTable(), &domain.getNbrTable());
+  CHECK_EQ(copy.getNumLocalPatches(), domain.getNumLocalPatches());
+}
+TEST_CASE("Domain orders patches along space filling curves")
+{
+  for (auto ordering : { PatchOrdering::Morton, PatchOrdering::Hilbert }) {
+    DomainReader<2> domain_reader("mesh_inputs/2d_uniform_8x8_refined_cross_mpi1.json", { 4, 4 }, 1);
+    Domain<2> given = domain_reader.getFinerDomain();
+    const vector<PatchInfo<2>>& given_pinfos = given.getPatchInfoVector();
+    Domain<2> domain(given.getCommunicator(),
+                     given.getId(),
+                     given.getNs(),
+                     given.getNumGhostCells(),
+                     given_pinfos.begin(),
+                     given_pinfos.end(),
+                     ordering);
+
+    const vector<PatchInfo<2>>& pinfos = domain.getPatchInfoVector();
+    REQUIRE_EQ(pinfos.size(), given_pinfos.size());
+    map<int, int> id_to_local_index;
+    for (size_t i = 0; i < pinfos.size(); i++) {
+      CHECK_EQ(pinfos[i].local_index, i);
+      CHECK_EQ(pinfos[i].global_index, i);
+      id_to_local_index[pinfos[i].id] = pinfos[i].local_index;
+    }
+    CHECK_EQ(id_to_local_index.size(), given_pinfos.size());
+
+    // neighbors have the new local indexes
+    const NbrTable<2>& table = domain.getNbrTable();
+    for (const PatchInfo<2>& pinfo : pinfos) {
+      for (Side<2> s : Side<2>::getValues()) {
+        for (int i = 0; i < table.getNumNbrs(pinfo.local_index, s); i++) {
+          int nbr_id = table.getIds(pinfo.local_index, s)[i];
+          CHECK_EQ(table.getLocalIndexes(pinfo.local_index, s)[i], id_to_local_index[nbr_id]);
+          CHECK_EQ(table.getGlobalIndexes(pinfo.local_index, s)[i], id_to_local_index[nbr_id]);
+        }
+      }
+    }
+  }
+}
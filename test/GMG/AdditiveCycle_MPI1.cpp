@@ -0,0 +1,157 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2020-2021 Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#include "../utils/UniformDomainGenerator.h"
+#include <ThunderEgg/BiLinearGhostFiller.h>
+#include <ThunderEgg/DomainTools.h>
+#include <ThunderEgg/GMG/CycleBuilder.h>
+#include <ThunderEgg/GMG/DirectInterpolator.h>
+#include <ThunderEgg/GMG/LinearRestrictor.h>
+#include <ThunderEgg/Iterative/BiCGStab.h>
+#include <ThunderEgg/Iterative/CG.h>
+#include <ThunderEgg/Iterative/PCG.h>
+#include <ThunderEgg/Iterative/PatchSolver.h>
+#include <ThunderEgg/VarPoisson/StarPatchOperator.h>
+
+#include <doctest.h>
+
+using namespace std;
+using namespace ThunderEgg;
+
+namespace {
+/**
+ * @brief Build a cycle for the variable coefficient problem with a smooth coefficient
+ */
+std::shared_ptr<GMG::Cycle<2>>
+BuildCycle(const vector<Domain<2>>& domains, const GMG::CycleOpts& opts)
+{
+  GMG::CycleBuilder<2> builder(opts);
+  Iterative::BiCGStab<2> bcgs;
+  bcgs.setTolerance(1e-12);
+  for (size_t i = 0; i < domains.size(); i++) {
+    Vector<2> coeffs(domains[i], 1);
+    DomainTools::SetValuesWithGhost<2>(
+      domains[i], coeffs, [](const std::array<double, 2>& coord) { return 1 + coord[0] * coord[1]; });
+    BiLinearGhostFiller ghost_filler(domains[i], GhostFillingType::Faces);
+    VarPoisson::StarPatchOperator<2> op(coeffs, domains[i], ghost_filler);
+    if (i == 0) {
+      Iterative::PatchSolver<2> smoother(bcgs, op);
+      GMG::LinearRestrictor<2> restrictor(domains[0], domains[1]);
+      builder.addFinestLevel(op, smoother, restrictor);
+    } else if (i + 1 < domains.size()) {
+      Iterative::PatchSolver<2> smoother(bcgs, op);
+      GMG::LinearRestrictor<2> restrictor(domains[i], domains[i + 1]);
+      GMG::DirectInterpolator<2> interpolator(domains[i], domains[i - 1]);
+      builder.addIntermediateLevel(op, smoother, restrictor, interpolator);
+    } else {
+      GMG::DirectInterpolator<2> interpolator(domains[i], domains[i - 1]);
+      builder.addCoarsestLevel(op, domains[i], interpolator);
+    }
+  }
+  return builder.getCycle();
+}
+vector<Domain<2>>
+GetDomains()
+{
+  UniformDomainGenerator generator(8, { 8, 8 }, 1);
+  vector<Domain<2>> domains;
+  domains.push_back(generator.getFinestDomain());
+  while (generator.hasCoarserDomain()) {
+    domains.push_back(generator.getCoarserDomain());
+  }
+  return domains;
+}
+/**
+ * @brief Solve with CG, or with PCG if there is a preconditioner, return the number of iterations
+ */
+int
+CGIterations(const vector<Domain<2>>& domains, const Operator<2>* preconditioner)
+{
+  Vector<2> coeffs(domains[0], 1);
+  DomainTools::SetValuesWithGhost<2>(
+    domains[0], coeffs, [](const std::array<double, 2>& coord) { return 1 + coord[0] * coord[1]; });
+  BiLinearGhostFiller ghost_filler(domains[0], GhostFillingType::Faces);
+  VarPoisson::StarPatchOperator<2> op(coeffs, domains[0], ghost_filler);
+
+  Vector<2> f(domains[0], 1);
+  DomainTools::SetValues<2>(domains[0], f, [](const std::array<double, 2>& coord) {
+    return sin(M_PI * coord[0]) * sin(2 * M_PI * coord[1]) + 1;
+  });
+  Vector<2> u = f.getZeroClone();
+
+  if (preconditioner == nullptr) {
+    Iterative::CG<2> cg;
+    cg.setTolerance(1e-8);
+    cg.setMaxIterations(500);
+    return cg.solve(op, u, f);
+  } else {
+    Iterative::PCG<2> pcg;
+    pcg.setTolerance(1e-8);
+    pcg.setMaxIterations(500);
+    return pcg.solve(op, u, f, preconditioner);
+  }
+}
+} // namespace
+
+TEST_CASE("CycleBuilder builds AdditiveCycle for cycle_type A")
+{
+  vector<Domain<2>> domains = GetDomains();
+  GMG::CycleOpts opts;
+  opts.cycle_type = "A";
+  auto cycle = BuildCycle(domains, opts);
+  CHECK_NE(dynamic_pointer_cast<GMG::AdditiveCycle<2>>(cycle), nullptr);
+}
+TEST_CASE("AdditiveCycle is symmetric")
+{
+  vector<Domain<2>> domains = GetDomains();
+  GMG::CycleOpts opts;
+  opts.cycle_type = "A";
+  auto cycle = BuildCycle(domains, opts);
+
+  Vector<2> x(domains[0], 1);
+  Vector<2> y(domains[0], 1);
+  DomainTools::SetValues<2>(domains[0], x, [](const std::array<double, 2>& coord) {
+    return sin(3 * M_PI * coord[0]) * coord[1];
+  });
+  DomainTools::SetValues<2>(domains[0], y, [](const std::array<double, 2>& coord) {
+    return coord[0] * coord[0] + cos(M_PI * coord[1]);
+  });
+  Vector<2> Bx = x.getZeroClone();
+  Vector<2> By = y.getZeroClone();
+  cycle->apply(x, Bx);
+  cycle->apply(y, By);
+
+  double yBx = y.dot(Bx);
+  double xBy = x.dot(By);
+  CHECK_LT(x.dot(Bx), 0);
+  CHECK_EQ(yBx, doctest::Approx(xBy).epsilon(1e-6));
+}
+TEST_CASE("AdditiveCycle preconditioned CG converges faster than CG")
+{
+  vector<Domain<2>> domains = GetDomains();
+  GMG::CycleOpts opts;
+  opts.cycle_type = "A";
+  auto cycle = BuildCycle(domains, opts);
+
+  int cg_iterations = CGIterations(domains, nullptr);
+  int pcg_iterations = CGIterations(domains, cycle.get());
+  INFO("CG: " << cg_iterations << " CG with AdditiveCycle: " << pcg_iterations);
+  CHECK_LT(pcg_iterations, 60);
+  CHECK_LT(2 * pcg_iterations, cg_iterations);
+}
@@ -0,0 +1,218 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2020-2021 Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include "../utils/DomainReader.h"
+#include <ThunderEgg/BiLinearGhostFiller.h>
+#include <ThunderEgg/DomainTools.h>
+#include <ThunderEgg/GMG/CycleBuilder.h>
+#include <ThunderEgg/GMG/DirectCoarseSolver.h>
+#include <ThunderEgg/GMG/DirectInterpolator.h>
+#include <ThunderEgg/GMG/LinearRestrictor.h>
+#include <ThunderEgg/Poisson/StarPatchOperator.h>
+
+#include <doctest.h>
+
+using namespace std;
+using namespace ThunderEgg;
+
+#define MESHES "mesh_inputs/2d_uniform_2x2_mpi1.json", "mesh_inputs/2d_uniform_2x2_refined_nw_mpi1.json"
+
+TEST_CASE("GMG::DirectCoarseSolver solves the coarse problem exactly")
+{
+  for (auto mesh_file : { MESHES }) {
+    for (auto nx : { 4, 5 }) {
+      for (auto ny : { 4, 5 }) {
+        int num_ghost = 1;
+        DomainReader<2> domain_reader(mesh_file, { nx, ny }, num_ghost);
+        Domain<2> domain = domain_reader.getFinerDomain();
+
+        auto gfun = [](const std::array<double, 2>& coord) {
+          double x = coord[0];
+          double y = coord[1];
+          return sin(M_PI * y) * cos(2 * M_PI * x) + x;
+        };
+
+        Vector<2> u_expected(domain, 1);
+        DomainTools::SetValues<2>(domain, u_expected, gfun);
+
+        BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+        Poisson::StarPatchOperator<2> op(domain, gf);
+
+        Vector<2> f(domain, 1);
+        op.apply(u_expected, f);
+
+        GMG::DirectCoarseSolver<2> solver(domain, op);
+        CHECK_EQ(solver.getNumUnknowns(), domain.getNumGlobalCells());
+        CHECK_UNARY(solver.participates());
+
+        Vector<2> u(domain, 1);
+        solver.smooth(f, u);
+
+        Vector<2> error(domain, 1);
+        error.addScaled(1.0, u, -1.0, u_expected);
+        CHECK_LT(error.twoNorm(), 1e-9);
+      }
+    }
+  }
+}
+TEST_CASE("GMG::DirectCoarseSolver solves singular Neumann problem")
+{
+  for (auto mesh_file : { MESHES }) {
+    for (auto nx : { 4, 6 }) {
+      for (auto ny : { 4, 6 }) {
+        int num_ghost = 1;
+        DomainReader<2> domain_reader(mesh_file, { nx, ny }, num_ghost);
+        Domain<2> domain = domain_reader.getFinerDomain();
+
+        auto gfun = [](const std::array<double, 2>& coord) {
+          double x = coord[0];
+          double y = coord[1];
+          return cos(M_PI * y) * cos(2 * M_PI * x) + 3;
+        };
+
+        Vector<2> u_expected(domain, 1);
+        DomainTools::SetValues<2>(domain, u_expected, gfun);
+
+        BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+        Poisson::StarPatchOperator<2> op(domain, gf, true);
+
+        Vector<2> f(domain, 1);
+        op.apply(u_expected, f);
+
+        GMG::DirectCoarseSolver<2> solver(domain, op);
+
+        Vector<2> u(domain, 1);
+        solver.smooth(f, u);
+
+        Vector<2> ones(domain, 1);
+        ones.set(1);
+        double num_cells = domain.getNumGlobalCells();
+        CHECK_EQ(u.dot(ones) / num_cells, doctest::Approx(0));
+
+        // the solution is only defined up to a constant
+        Vector<2> error(domain, 1);
+        error.addScaled(1.0, u, -1.0, u_expected);
+        error.shift(-error.dot(ones) / num_cells);
+        CHECK_LT(error.twoNorm(), 1e-9);
+
+        Vector<2> residual(domain, 1);
+        op.apply(u, residual);
+        residual.addScaled(-1.0, f);
+        CHECK_LT(residual.twoNorm(), 1e-9);
+      }
+    }
+  }
+}
+TEST_CASE("GMG::DirectCoarseSolver ignores initial guess")
+{
+  DomainReader<2> domain_reader("mesh_inputs/2d_uniform_2x2_mpi1.json", { 4, 4 }, 1);
+  Domain<2> domain = domain_reader.getFinerDomain();
+
+  BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+  Poisson::StarPatchOperator<2> op(domain, gf);
+  GMG::DirectCoarseSolver<2> solver(domain, op);
+
+  Vector<2> f(domain, 1);
+  f.set(1);
+  Vector<2> u1(domain, 1);
+  Vector<2> u2(domain, 1);
+  u2.set(42);
+  solver.smooth(f, u1);
+  solver.smooth(f, u2);
+
+  Vector<2> diff(domain, 1);
+  diff.addScaled(1.0, u1, -1.0, u2);
+  CHECK_EQ(diff.twoNorm(), doctest::Approx(0));
+}
+TEST_CASE("GMG::DirectCoarseSolver clone shares factorization")
+{
+  DomainReader<2> domain_reader("mesh_inputs/2d_uniform_2x2_mpi1.json", { 4, 4 }, 1);
+  Domain<2> domain = domain_reader.getFinerDomain();
+
+  BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+  Poisson::StarPatchOperator<2> op(domain, gf);
+  GMG::DirectCoarseSolver<2> solver(domain, op);
+  std::unique_ptr<GMG::DirectCoarseSolver<2>> clone(solver.clone());
+
+  Vector<2> f(domain, 1);
+  f.set(1);
+  Vector<2> u1(domain, 1);
+  Vector<2> u2(domain, 1);
+  solver.smooth(f, u1);
+  clone->smooth(f, u2);
+
+  Vector<2> diff(domain, 1);
+  diff.addScaled(1.0, u1, -1.0, u2);
+  CHECK_EQ(diff.twoNorm(), doctest::Approx(0));
+}
+TEST_CASE("GMG::DirectCoarseSolver throws above the unknown limit")
+{
+  DomainReader<2> domain_reader("mesh_inputs/2d_uniform_2x2_mpi1.json", { 4, 4 }, 1);
+  Domain<2> domain = domain_reader.getFinerDomain();
+
+  BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+  Poisson::StarPatchOperator<2> op(domain, gf);
+
+  int n = domain.getNumGlobalCells();
+  CHECK_THROWS_AS(GMG::DirectCoarseSolver<2>(domain, op, 1, n - 1), RuntimeError);
+  CHECK_THROWS_AS(GMG::DirectCoarseSolver<2>(domain, op, 2, 2 * n - 1), RuntimeError);
+  GMG::DirectCoarseSolver<2> solver(domain, op, 1, n);
+  CHECK_EQ(solver.getNumUnknowns(), n);
+}
+TEST_CASE("CycleBuilder addCoarsestLevel with direct coarse solve")
+{
+  class NoOpSmoother : public GMG::Smoother<2>
+  {
+  public:
+    NoOpSmoother* clone() const override { return new NoOpSmoother(*this); }
+    void smooth(const Vector<2>&, Vector<2>&) const override {}
+  };
+
+  DomainReader<2> domain_reader("mesh_inputs/2d_uniform_2x2_refined_nw_mpi1.json", { 4, 4 }, 1);
+  Domain<2> d_fine = domain_reader.getFinerDomain();
+  Domain<2> d_coarse = domain_reader.getCoarserDomain();
+
+  BiLinearGhostFiller fine_gf(d_fine, GhostFillingType::Faces);
+  Poisson::StarPatchOperator<2> fine_op(d_fine, fine_gf);
+  BiLinearGhostFiller coarse_gf(d_coarse, GhostFillingType::Faces);
+  Poisson::StarPatchOperator<2> coarse_op(d_coarse, coarse_gf);
+
+  NoOpSmoother smoother;
+  GMG::LinearRestrictor<2> restrictor(d_fine, d_coarse);
+  GMG::DirectInterpolator<2> interpolator(d_coarse, d_fine);
+
+  GMG::CycleOpts opts;
+  GMG::CycleBuilder<2> builder(opts);
+  CHECK_THROWS_AS(builder.addCoarsestLevel(coarse_op, d_coarse, interpolator), RuntimeError);
+  builder.addFinestLevel(fine_op, smoother, restrictor);
+  builder.addCoarsestLevel(coarse_op, d_coarse, interpolator);
+  CHECK_THROWS_AS(builder.addCoarsestLevel(coarse_op, d_coarse, interpolator), RuntimeError);
+
+  auto cycle = builder.getCycle();
+  const GMG::Level<2>& coarsest_level = cycle->getFinestLevel().getCoarser();
+  CHECK_UNARY(coarsest_level.coarsest());
+  CHECK_NE(dynamic_cast<const GMG::DirectCoarseSolver<2>*>(&coarsest_level.getSmoother()), nullptr);
+
+  Vector<2> f(d_fine, 1);
+  f.set(1);
+  Vector<2> u(d_fine, 1);
+  cycle->apply(f, u);
+  CHECK_GT(u.twoNorm(), 0);
+}
@@ -0,0 +1,92 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2020-2021 Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include "../utils/DomainReader.h"
+#include <ThunderEgg/BiLinearGhostFiller.h>
+#include <ThunderEgg/DomainTools.h>
+#include <ThunderEgg/GMG/DirectCoarseSolver.h>
+#include <ThunderEgg/Poisson/StarPatchOperator.h>
+
+#include <doctest.h>
+
+using namespace std;
+using namespace ThunderEgg;
+
+#define MESHES "mesh_inputs/2d_uniform_2x2_nw_on_1_mpi2.json", "mesh_inputs/2d_uniform_4x4_sw_on_1_mpi2.json"
+
+TEST_CASE("GMG::DirectCoarseSolver solves the coarse problem exactly")
+{
+  for (auto mesh_file : { MESHES }) {
+    for (auto nx : { 4, 5 }) {
+      for (auto ny : { 4, 5 }) {
+        int num_ghost = 1;
+        DomainReader<2> domain_reader(mesh_file, { nx, ny }, num_ghost);
+        Domain<2> domain = domain_reader.getFinerDomain();
+
+        auto gfun = [](const std::array<double, 2>& coord) {
+          double x = coord[0];
+          double y = coord[1];
+          return sin(M_PI * y) * cos(2 * M_PI * x) + x;
+        };
+
+        Vector<2> u_expected(domain, 1);
+        DomainTools::SetValues<2>(domain, u_expected, gfun);
+
+        BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+        Poisson::StarPatchOperator<2> op(domain, gf);
+
+        Vector<2> f(domain, 1);
+        op.apply(u_expected, f);
+
+        GMG::DirectCoarseSolver<2> solver(domain, op);
+        CHECK_EQ(solver.getNumUnknowns(), domain.getNumGlobalCells());
+
+        Vector<2> u(domain, 1);
+        solver.smooth(f, u);
+
+        Vector<2> error(domain, 1);
+        error.addScaled(1.0, u, -1.0, u_expected);
+        CHECK_LT(error.twoNorm(), 1e-9);
+      }
+    }
+  }
+}
+TEST_CASE("GMG::DirectCoarseSolver ranks without patches do not participate")
+{
+  DomainReader<2> domain_reader("mesh_inputs/2d_uniform_2x2_nw_on_1_mpi2.json", { 4, 4 }, 1);
+  Domain<2> domain = domain_reader.getCoarserDomain();
+
+  BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+  Poisson::StarPatchOperator<2> op(domain, gf);
+  GMG::DirectCoarseSolver<2> solver(domain, op);
+
+  CHECK_EQ(solver.participates(), domain.getNumLocalPatches() > 0);
+  CHECK_EQ(solver.getNumUnknowns(), domain.getNumGlobalCells());
+
+  Vector<2> f(domain, 1);
+  f.set(1);
+  Vector<2> u(domain, 1);
+  solver.smooth(f, u);
+
+  Vector<2> au(domain, 1);
+  op.apply(u, au);
+  au.addScaled(-1, f);
+  CHECK_LT(au.twoNorm(), 1e-9);
+}
@@ -0,0 +1,173 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2020-2021 Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#include "../utils/UniformDomainGenerator.h"
+#include <ThunderEgg/BiLinearGhostFiller.h>
+#include <ThunderEgg/DomainTools.h>
+#include <ThunderEgg/GMG/CycleBuilder.h>
+#include <ThunderEgg/GMG/DirectInterpolator.h>
+#include <ThunderEgg/GMG/LinearRestrictor.h>
+#include <ThunderEgg/Iterative/BiCGStab.h>
+#include <ThunderEgg/Iterative/PatchSolver.h>
+#include <ThunderEgg/VarPoisson/StarPatchOperator.h>
+
+#include <doctest.h>
+
+using namespace std;
+using namespace ThunderEgg;
+
+namespace {
+/**
+ * @brief Coefficient with a jump of 1000 in the north-east quarter of the domain
+ */
+double
+JumpCoeff(const std::array<double, 2>& coord)
+{
+  return (coord[0] > 0.5 && coord[1] > 0.5) ? 1000 : 1;
+}
+/**
+ * @brief Build a cycle for the variable coefficient problem on a uniform hierarchy
+ */
+std::shared_ptr<GMG::Cycle<2>>
+BuildCycle(const vector<Domain<2>>& domains, const GMG::CycleOpts& opts)
+{
+  GMG::CycleBuilder<2> builder(opts);
+  Iterative::BiCGStab<2> bcgs;
+  bcgs.setTolerance(1e-12);
+  for (size_t i = 0; i < domains.size(); i++) {
+    Vector<2> coeffs(domains[i], 1);
+    DomainTools::SetValuesWithGhost<2>(domains[i], coeffs, JumpCoeff);
+    BiLinearGhostFiller ghost_filler(domains[i], GhostFillingType::Faces);
+    VarPoisson::StarPatchOperator<2> op(coeffs, domains[i], ghost_filler);
+    if (i == 0) {
+      Iterative::PatchSolver<2> smoother(bcgs, op);
+      GMG::LinearRestrictor<2> restrictor(domains[0], domains[1]);
+      builder.addFinestLevel(op, smoother, restrictor);
+    } else if (i + 1 < domains.size()) {
+      Iterative::PatchSolver<2> smoother(bcgs, op);
+      GMG::LinearRestrictor<2> restrictor(domains[i], domains[i + 1]);
+      GMG::DirectInterpolator<2> interpolator(domains[i], domains[i - 1]);
+      builder.addIntermediateLevel(op, smoother, restrictor, interpolator);
+    } else {
+      GMG::DirectInterpolator<2> interpolator(domains[i], domains[i - 1]);
+      builder.addCoarsestLevel(op, domains[i], interpolator);
+    }
+  }
+  return builder.getCycle();
+}
+/**
+ * @brief Run the cycle as a stationary iteration, return the number of cycles needed to reduce
+ * the residual by 1e-8
+ */
+int
+CyclesToConverge(const vector<Domain<2>>& domains, const GMG::CycleOpts& opts)
+{
+  auto cycle = BuildCycle(domains, opts);
+
+  Vector<2> coeffs(domains[0], 1);
+  DomainTools::SetValuesWithGhost<2>(domains[0], coeffs, JumpCoeff);
+  BiLinearGhostFiller ghost_filler(domains[0], GhostFillingType::Faces);
+  VarPoisson::StarPatchOperator<2> op(coeffs, domains[0], ghost_filler);
+
+  Vector<2> f(domains[0], 1);
+  DomainTools::SetValues<2>(domains[0], f, [](const std::array<double, 2>& coord) {
+    return sin(M_PI * coord[0]) * sin(2 * M_PI * coord[1]) + 1;
+  });
+  Vector<2> u = f.getZeroClone();
+  Vector<2> r = f;
+  Vector<2> e = f.getZeroClone();
+  double f_norm = f.twoNorm();
+  for (int i = 1; i <= 50; i++) {
+    cycle->apply(r, e);
+    u.add(e);
+    op.apply(u, r);
+    r.scaleThenAdd(-1, f);
+    if (r.twoNorm() < 1e-8 * f_norm) {
+      return i;
+    }
+  }
+  return 51;
+}
+vector<Domain<2>>
+GetDomains()
+{
+  UniformDomainGenerator generator(8, { 8, 8 }, 1);
+  vector<Domain<2>> domains;
+  domains.push_back(generator.getFinestDomain());
+  while (generator.hasCoarserDomain()) {
+    domains.push_back(generator.getCoarserDomain());
+  }
+  return domains;
+}
+} // namespace
+
+TEST_CASE("CycleBuilder builds KCycle for cycle_type K")
+{
+  vector<Domain<2>> domains = GetDomains();
+  GMG::CycleOpts opts;
+  opts.cycle_type = "K";
+  auto cycle = BuildCycle(domains, opts);
+  CHECK_NE(dynamic_pointer_cast<GMG::KCycle<2>>(cycle), nullptr);
+}
+TEST_CASE("KCycle throws with unsupported number of Krylov iterations")
+{
+  GMG::Level<2> level;
+  for (int iterations : { 0, 3 }) {
+    GMG::CycleOpts opts;
+    opts.kcycle_iterations = iterations;
+    CHECK_THROWS_AS(GMG::KCycle<2>(level, opts), RuntimeError);
+  }
+}
+TEST_CASE("KCycle clone")
+{
+  vector<Domain<2>> domains = GetDomains();
+  GMG::CycleOpts opts;
+  opts.cycle_type = "K";
+  auto cycle = BuildCycle(domains, opts);
+  unique_ptr<Operator<2>> clone(cycle->clone());
+
+  Vector<2> f(domains[0], 1);
+  f.set(1);
+  Vector<2> u = f.getZeroClone();
+  Vector<2> u_clone = f.getZeroClone();
+  cycle->apply(f, u);
+  clone->apply(f, u_clone);
+
+  Vector<2> diff = u.getZeroClone();
+  diff.addScaled(1.0, u, -1.0, u_clone);
+  CHECK_GT(u.twoNorm(), 0);
+  CHECK_EQ(diff.twoNorm(), 0);
+}
+TEST_CASE("KCycle converges faster than VCycle on a jump coefficient problem")
+{
+  vector<Domain<2>> domains = GetDomains();
+
+  GMG::CycleOpts opts;
+  opts.cycle_type = "V";
+  int v_cycles = CyclesToConverge(domains, opts);
+
+  for (int iterations : { 1, 2 }) {
+    opts.cycle_type = "K";
+    opts.kcycle_iterations = iterations;
+    int k_cycles = CyclesToConverge(domains, opts);
+    INFO("V: " << v_cycles << " K(" << iterations << "): " << k_cycles);
+    CHECK_LE(k_cycles, 50);
+    CHECK_LE(k_cycles, v_cycles);
+  }
+}
@@ -70,3 +70,53 @@ TEST_CASE("Linear Test LinearRestrictor")
     }
   }
 }
+TEST_CASE("LinearRestrictor restrictStart and restrictFinish match restrict")
+{
+  for (auto nx : { 2, 10 }) {
+    for (auto ny : { 2, 10 }) {
+      int num_ghost = 1;
+      DomainReader<2> domain_reader(mesh_file, { nx, ny }, num_ghost);
+      Domain<2> d_fine = domain_reader.getFinerDomain();
+      Domain<2> d_coarse = domain_reader.getCoarserDomain();
+
+      Vector<2> fine_vec(d_fine, 1);
+
+      auto f = [&](const std::array<double, 2> coord) -> double {
+        double x = coord[0];
+        double y = coord[1];
+        return sin(M_PI * x) * cos(2 * M_PI * y);
+      };
+
+      DomainTools::SetValuesWithGhost<2>(d_fine, fine_vec, f);
+
+      GMG::LinearRestrictor<2> restrictor(d_fine, d_coarse, true);
+
+      Vector<2> expected = restrictor.restrict(fine_vec);
+
+      restrictor.restrictStart(fine_vec);
+      Vector<2> coarse_vec = restrictor.restrictFinish(fine_vec);
+
+      for (auto pinfo : d_coarse.getPatchInfoVector()) {
+        ComponentView<double, 2> vec_ld = coarse_vec.getComponentView(0, pinfo.local_index);
+        ComponentView<double, 2> expected_ld = expected.getComponentView(0, pinfo.local_index);
+        Loop::Nested<2>(vec_ld.getGhostStart(), vec_ld.getGhostEnd(), [&](const array<int, 2>& coord) { REQUIRE_EQ(vec_ld[coord], expected_ld[coord]); });
+      }
+    }
+  }
+}
+TEST_CASE("LinearRestrictor throws if a restriction is started twice")
+{
+  int num_ghost = 1;
+  DomainReader<2> domain_reader(mesh_file, { 4, 4 }, num_ghost);
+  Domain<2> d_fine = domain_reader.getFinerDomain();
+  Domain<2> d_coarse = domain_reader.getCoarserDomain();
+
+  Vector<2> fine_vec(d_fine, 1);
+
+  GMG::LinearRestrictor<2> restrictor(d_fine, d_coarse, true);
+
+  CHECK_THROWS_AS(restrictor.restrictFinish(fine_vec), RuntimeError);
+  restrictor.restrictStart(fine_vec);
+  CHECK_THROWS_AS(restrictor.restrictStart(fine_vec), RuntimeError);
+  restrictor.restrictFinish(fine_vec);
+}
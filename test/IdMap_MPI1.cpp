@@ -0,0 +1,91 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#include <ThunderEgg/IdMap.h>
+
+#include <doctest.h>
+
+#include <limits>
+#include <map>
+
+using namespace std;
+using namespace ThunderEgg;
+
+TEST_CASE("IdMap empty")
+{
+  IdMap map;
+  CHECK_EQ(map.size(), 0);
+  CHECK_EQ(map.find(0), nullptr);
+  CHECK_FALSE(map.contains(0));
+  CHECK_THROWS_AS(map.at(0), RuntimeError);
+}
+TEST_CASE("IdMap set and find")
+{
+  for (size_t expected_size : { 0, 1, 10, 1000 }) {
+    INFO("EXPECTED SIZE: " << expected_size);
+    IdMap map(expected_size);
+    map.set(5, 50);
+    map.set(-3, 30);
+    map.set(7, 70);
+
+    CHECK_EQ(map.size(), 3);
+    REQUIRE_NE(map.find(5), nullptr);
+    CHECK_EQ(*map.find(5), 50);
+    CHECK_EQ(map.at(-3), 30);
+    CHECK_EQ(map.at(7), 70);
+    CHECK_EQ(map.find(6), nullptr);
+    CHECK_THROWS_AS(map.at(6), RuntimeError);
+  }
+}
+TEST_CASE("IdMap set replaces value")
+{
+  IdMap map;
+  map.set(1, 10);
+  map.set(1, 20);
+  CHECK_EQ(map.size(), 1);
+  CHECK_EQ(map.at(1), 20);
+}
+TEST_CASE("IdMap grows past expected size")
+{
+  IdMap map(2);
+  for (int id = 0; id < 10000; id++) {
+    map.set(id * 17, id);
+  }
+  CHECK_EQ(map.size(), 10000);
+  for (int id = 0; id < 10000; id++) {
+    CHECK_EQ(map.at(id * 17), id);
+    CHECK_FALSE(map.contains(id * 17 + 1));
+  }
+}
+TEST_CASE("IdMap from std::map")
+{
+  map<int, int> std_map;
+  std_map[2] = 30;
+  std_map[100] = 4;
+  IdMap map(std_map);
+  CHECK_EQ(map.size(), 2);
+  CHECK_EQ(map.at(2), 30);
+  CHECK_EQ(map.at(100), 4);
+}
+TEST_CASE("IdMap reserved id")
+{
+  IdMap map;
+  CHECK_THROWS_AS(map.set(numeric_limits<int>::min(), 0), RuntimeError);
+  CHECK_EQ(map.find(numeric_limits<int>::min()), nullptr);
+}
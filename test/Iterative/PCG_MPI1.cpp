@@ -0,0 +1,159 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include "../utils/DomainReader.h"
+#include <ThunderEgg/BiLinearGhostFiller.h>
+#include <ThunderEgg/Iterative/CG.h>
+#include <ThunderEgg/Iterative/PCG.h>
+#include <ThunderEgg/Poisson/StarPatchOperator.h>
+
+#include <doctest.h>
+
+using namespace std;
+using namespace ThunderEgg;
+using namespace ThunderEgg::Iterative;
+
+namespace {
+/**
+ * @brief Preconditioner that scales the vector
+ */
+class ScalingOperator : public Operator<2>
+{
+private:
+  double scale;
+
+public:
+  explicit ScalingOperator(double scale)
+    : scale(scale)
+  {}
+  ScalingOperator* clone() const override { return new ScalingOperator(*this); }
+  void apply(const Vector<2>& x, Vector<2>& b) const override
+  {
+    b.copy(x);
+    b.scale(scale);
+  }
+};
+auto ffun = [](const std::array<double, 2>& coord) {
+  double x = coord[0];
+  double y = coord[1];
+  return -5 * M_PI * M_PI * sin(M_PI * y) * cos(2 * M_PI * x);
+};
+auto gfun = [](const std::array<double, 2>& coord) {
+  double x = coord[0];
+  double y = coord[1];
+  return sin(M_PI * y) * cos(2 * M_PI * x);
+};
+} // namespace
+
+TEST_CASE("PCG clone")
+{
+  PCG<2> solver;
+  solver.setMaxIterations(3);
+  solver.setTolerance(1.2);
+  Communicator comm(MPI_COMM_WORLD);
+  auto timer = make_shared<Timer>(comm);
+  solver.setTimer(timer);
+
+  unique_ptr<PCG<2>> clone(solver.clone());
+  CHECK_EQ(solver.getTimer(), clone->getTimer());
+  CHECK_EQ(solver.getMaxIterations(), clone->getMaxIterations());
+  CHECK_EQ(solver.getTolerance(), clone->getTolerance());
+}
+TEST_CASE("PCG solves poisson problem within given tolerance")
+{
+  for (double tolerance : { 1e-9, 1e-7, 1e-5 }) {
+    string mesh_file = "mesh_inputs/2d_uniform_2x2_mpi1.json";
+    DomainReader<2> domain_reader(mesh_file, { 32, 32 }, 1);
+    Domain<2> domain = domain_reader.getCoarserDomain();
+
+    Vector<2> f_vec(domain, 1);
+    DomainTools::SetValues<2>(domain, f_vec, ffun);
+    Vector<2> residual(domain, 1);
+
+    Vector<2> g_vec(domain, 1);
+
+    BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+
+    Poisson::StarPatchOperator<2> p_operator(domain, gf);
+    p_operator.addDrichletBCToRHS(f_vec, gfun);
+
+    ScalingOperator preconditioner(-0.5);
+
+    PCG<2> solver;
+    solver.setMaxIterations(1000);
+    solver.setTolerance(tolerance);
+    solver.solve(p_operator, g_vec, f_vec, &preconditioner);
+
+    p_operator.apply(g_vec, residual);
+    residual.addScaled(-1, f_vec);
+    CHECK_LE(residual.twoNorm() / f_vec.twoNorm(), tolerance);
+  }
+}
+TEST_CASE("PCG with a scaling preconditioner takes the same iterations as CG")
+{
+  string mesh_file = "mesh_inputs/2d_uniform_2x2_mpi1.json";
+  DomainReader<2> domain_reader(mesh_file, { 16, 16 }, 1);
+  Domain<2> domain = domain_reader.getCoarserDomain();
+
+  Vector<2> f_vec(domain, 1);
+  DomainTools::SetValues<2>(domain, f_vec, ffun);
+
+  BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+
+  Poisson::StarPatchOperator<2> p_operator(domain, gf);
+  p_operator.addDrichletBCToRHS(f_vec, gfun);
+
+  CG<2> cg;
+  cg.setTolerance(1e-9);
+  Vector<2> cg_solution(domain, 1);
+  int cg_iterations = cg.solve(p_operator, cg_solution, f_vec);
+
+  ScalingOperator preconditioner(3);
+  PCG<2> pcg;
+  pcg.setTolerance(1e-9);
+  Vector<2> pcg_solution(domain, 1);
+  int pcg_iterations = pcg.solve(p_operator, pcg_solution, f_vec, &preconditioner);
+
+  CHECK_EQ(pcg_iterations, cg_iterations);
+
+  Vector<2> diff(domain, 1);
+  diff.addScaled(1.0, pcg_solution, -1.0, cg_solution);
+  CHECK_LE(diff.twoNorm(), 1e-6 * cg_solution.twoNorm());
+}
+TEST_CASE("PCG handles zero rhs vector")
+{
+  string mesh_file = "mesh_inputs/2d_uniform_2x2_mpi1.json";
+  DomainReader<2> domain_reader(mesh_file, { 32, 32 }, 1);
+  Domain<2> domain = domain_reader.getCoarserDomain();
+
+  Vector<2> f_vec(domain, 1);
+
+  Vector<2> g_vec(domain, 1);
+  g_vec.set(1);
+
+  BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+
+  Poisson::StarPatchOperator<2> p_operator(domain, gf);
+
+  PCG<2> solver;
+  solver.solve(p_operator, g_vec, f_vec);
+
+  CHECK_EQ(g_vec.infNorm(), 0);
+}
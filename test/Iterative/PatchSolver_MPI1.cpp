@@ -19,7 +19,14 @@
  ***************************************************************************/
 #include "../utils/DomainReader.h"
 #include "PatchSolver_MOCKS.h"
+#include <ThunderEgg/BiLinearGhostFiller.h>
+#include <ThunderEgg/DomainTools.h>
+#include <ThunderEgg/Iterative/BiCGStab.h>
+#include <ThunderEgg/Iterative/CG.h>
 #include <ThunderEgg/Iterative/PatchSolver.h>
+#include <ThunderEgg/Poisson/StarPatchOperator.h>
+#include <ThunderEgg/Timer.h>
+#include <ThunderEgg/tpl/json.hpp>
 
 #include <list>
 #include <sstream>
@@ -33,6 +40,29 @@ constexpr auto single_mesh_file = "mesh_inputs/2d_uniform_2x2_mpi1.json";
 constexpr auto refined_mesh_file = "mesh_inputs/2d_uniform_2x2_refined_nw_mpi1.json";
 constexpr auto cross_mesh_file = "mesh_inputs/2d_uniform_8x8_refined_cross_mpi1.json";
 
+namespace {
+/**
+ * @brief Add up the sum and take the max of all "Iterations" infos in a timer json
+ */
+void
+SumIterations(const tpl::nlohmann::json& j, double& sum, double& max)
+{
+  if (j.is_array()) {
+    for (const tpl::nlohmann::json& child : j) {
+      SumIterations(child, sum, max);
+    }
+  } else if (j.is_object()) {
+    if (j.contains("name") && j["name"] == "Iterations" && j.contains("sum")) {
+      sum += j["sum"].get<double>();
+      max = std::max(max, j["max"].get<double>());
+    }
+    for (const auto& item : j.items()) {
+      SumIterations(item.value(), sum, max);
+    }
+  }
+}
+} // namespace
+
 TEST_CASE("Iterative::PatchSolver passes vectors of a single patch length")
 {
   for (auto mesh_file : { single_mesh_file, refined_mesh_file, cross_mesh_file }) {
@@ -159,3 +189,242 @@ TEST_CASE("Iterative::PatchSolver does not propagate BreakdownError")
     }
   }
 }
+TEST_CASE("Iterative::PatchSolver patch-local CG and BiCGStab match solves with single patch vectors")
+{
+  for (auto mesh_file : { single_mesh_file, refined_mesh_file, cross_mesh_file }) {
+    for (string method : { "CG", "BiCGStab" }) {
+      DomainReader<2> domain_reader(mesh_file, { 6, 5 }, 1);
+      Domain<2> domain = domain_reader.getFinerDomain();
+
+      BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+      Poisson::StarPatchOperator<2> op(domain, gf);
+
+      unique_ptr<Iterative::Solver<2>> local_solver;
+      unique_ptr<Iterative::Solver<2>> vector_solver;
+      // a solver with a timer is not solved patch-locally, so that its iterations are timed
+      auto timer = make_shared<Timer>(Communicator(MPI_COMM_WORLD));
+      if (method == "CG") {
+        Iterative::CG<2> cg;
+        cg.setTolerance(1e-12);
+        local_solver.reset(cg.clone());
+        cg.setTimer(timer);
+        vector_solver.reset(cg.clone());
+      } else {
+        Iterative::BiCGStab<2> bcgs;
+        bcgs.setTolerance(1e-12);
+        local_solver.reset(bcgs.clone());
+        bcgs.setTimer(timer);
+        vector_solver.reset(bcgs.clone());
+      }
+
+      Vector<2> f(domain, 1);
+      DomainTools::SetValues<2>(domain, f, [](const std::array<double, 2>& coord) {
+        return sin(3 * coord[0]) + coord[1] * coord[1];
+      });
+      Vector<2> u(domain, 1);
+      DomainTools::SetValuesWithGhost<2>(
+        domain, u, [](const std::array<double, 2>& coord) { return coord[0] * coord[1]; });
+      Vector<2> u_expected = u;
+
+      Iterative::PatchSolver<2> local_patch_solver(*local_solver, op);
+      Iterative::PatchSolver<2> vector_patch_solver(*vector_solver, op);
+      local_patch_solver.smooth(f, u);
+      vector_patch_solver.smooth(f, u_expected);
+
+      Vector<2> diff(domain, 1);
+      diff.addScaled(1.0, u, -1.0, u_expected);
+      CHECK_GT(u_expected.twoNorm(), 0);
+      CHECK_LE(diff.twoNorm(), 1e-9 * u_expected.twoNorm());
+    }
+  }
+}
+TEST_CASE("Iterative::PatchSolver adaptive tolerance does less inner work")
+{
+  for (string method : { "CG", "BiCGStab" }) {
+    DomainReader<2> domain_reader(cross_mesh_file, { 16, 16 }, 1);
+    Domain<2> domain = domain_reader.getFinerDomain();
+
+    BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+    Poisson::StarPatchOperator<2> op(domain, gf);
+
+    unique_ptr<Iterative::Solver<2>> solver;
+    if (method == "CG") {
+      Iterative::CG<2> cg;
+      cg.setTolerance(1e-12);
+      solver.reset(cg.clone());
+    } else {
+      Iterative::BiCGStab<2> bcgs;
+      bcgs.setTolerance(1e-12);
+      solver.reset(bcgs.clone());
+    }
+
+    Vector<2> f(domain, 1);
+    DomainTools::SetValues<2>(domain, f, [](const std::array<double, 2>& coord) {
+      return sin(3 * coord[0]) + coord[1] * coord[1];
+    });
+
+    double fixed_sum = 0;
+    double fixed_max = 0;
+    double adaptive_sum = 0;
+    double adaptive_max = 0;
+    for (bool adaptive : { false, true }) {
+      Domain<2> timed_domain = domain;
+      auto timer = make_shared<Timer>(Communicator(MPI_COMM_WORLD));
+      timed_domain.setTimer(timer);
+      BiLinearGhostFiller timed_gf(timed_domain, GhostFillingType::Faces);
+      Poisson::StarPatchOperator<2> timed_op(timed_domain, timed_gf);
+      Iterative::PatchSolver<2> patch_solver(*solver, timed_op);
+      if (adaptive) {
+        patch_solver.setAdaptiveTolerance(0.1, 4);
+        CHECK_UNARY(patch_solver.hasAdaptiveTolerance());
+        CHECK_EQ(patch_solver.getResidualReduction(), 0.1);
+        CHECK_EQ(patch_solver.getMaxPatchIterations(), 4);
+      }
+
+      Vector<2> u(timed_domain, 1);
+      for (int sweep = 0; sweep < 3; sweep++) {
+        patch_solver.smooth(f, u);
+      }
+      tpl::nlohmann::json j = *timer;
+      if (adaptive) {
+        SumIterations(j, adaptive_sum, adaptive_max);
+      } else {
+        SumIterations(j, fixed_sum, fixed_max);
+      }
+    }
+    CHECK_GT(fixed_sum, 0);
+    CHECK_LT(adaptive_sum, fixed_sum / 2);
+    CHECK_LE(adaptive_max, 4);
+  }
+}
+TEST_CASE("Iterative::PatchSolver adaptive tolerance reduces the residual of the initial guess")
+{
+  for (string method : { "CG", "BiCGStab" }) {
+    // the coarser domain is a single patch, so the patch residual is the residual of the domain
+    DomainReader<2> domain_reader(single_mesh_file, { 16, 16 }, 1);
+    Domain<2> domain = domain_reader.getCoarserDomain();
+    REQUIRE_EQ(domain.getNumGlobalPatches(), 1);
+
+    BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+    Poisson::StarPatchOperator<2> op(domain, gf);
+
+    unique_ptr<Iterative::Solver<2>> solver;
+    if (method == "CG") {
+      solver.reset(new Iterative::CG<2>());
+    } else {
+      solver.reset(new Iterative::BiCGStab<2>());
+    }
+    Iterative::PatchSolver<2> patch_solver(*solver, op);
+    patch_solver.setAdaptiveTolerance(0.1, 1000);
+
+    Vector<2> f(domain, 1);
+    DomainTools::SetValues<2>(domain, f, [](const std::array<double, 2>& coord) {
+      return sin(3 * coord[0]) + coord[1] * coord[1];
+    });
+    Vector<2> u(domain, 1);
+    DomainTools::SetValuesWithGhost<2>(
+      domain, u, [](const std::array<double, 2>& coord) { return coord[0] * coord[1]; });
+
+    Vector<2> r(domain, 1);
+    op.apply(u, r);
+    r.scaleThenAdd(-1, f);
+    double initial_residual = r.twoNorm();
+
+    patch_solver.smooth(f, u);
+
+    op.apply(u, r);
+    r.scaleThenAdd(-1, f);
+    CHECK_LE(r.twoNorm(), 0.1 * initial_residual);
+    // the patch is not solved to the tolerance of the solver
+    CHECK_GT(r.twoNorm(), 1e-6 * initial_residual);
+  }
+}
+TEST_CASE("Iterative::PatchSolver adaptive tolerance requires a patch-local solver")
+{
+  DomainReader<2> domain_reader(single_mesh_file, { 4, 4 }, 1);
+  Domain<2> domain = domain_reader.getFinerDomain();
+
+  BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+  Poisson::StarPatchOperator<2> op(domain, gf);
+
+  Iterative::CG<2> cg;
+  cg.setTimer(make_shared<Timer>(Communicator(MPI_COMM_WORLD)));
+  Iterative::PatchSolver<2> patch_solver(cg, op);
+  CHECK_THROWS_AS(patch_solver.setAdaptiveTolerance(0.1, 4), RuntimeError);
+  CHECK_UNARY_FALSE(patch_solver.hasAdaptiveTolerance());
+}
+TEST_CASE("Iterative::PatchSolver patch-local solve of zero rhs zeroes the initial guess")
+{
+  for (string method : { "CG", "BiCGStab" }) {
+    // a single patch, so there are no neighbor values in the modified rhs
+    DomainReader<2> domain_reader(single_mesh_file, { 6, 5 }, 1);
+    Domain<2> domain = domain_reader.getCoarserDomain();
+    REQUIRE_EQ(domain.getNumGlobalPatches(), 1);
+
+    BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+    Poisson::StarPatchOperator<2> op(domain, gf);
+
+    unique_ptr<Iterative::Solver<2>> solver;
+    if (method == "CG") {
+      solver.reset(new Iterative::CG<2>());
+    } else {
+      solver.reset(new Iterative::BiCGStab<2>());
+    }
+    Iterative::PatchSolver<2> patch_solver(*solver, op);
+
+    Vector<2> f(domain, 1);
+    Vector<2> u(domain, 1);
+    u.set(1);
+
+    patch_solver.smooth(f, u);
+
+    CHECK_EQ(u.infNorm(), 0);
+  }
+}
+TEST_CASE("Iterative::PatchSolver subclasses of CG use the generic path")
+{
+  class CountingCG : public Iterative::CG<2>
+  {
+  public:
+    shared_ptr<int> num_solves = make_shared<int>(0);
+    CountingCG* clone() const override { return new CountingCG(*this); }
+    int solve(const Operator<2>& A,
+              Vector<2>& x,
+              const Vector<2>& b,
+              const Operator<2>* Mr = nullptr,
+              bool output = false,
+              std::ostream& os = std::cout) const override
+    {
+      (*num_solves)++;
+      return Iterative::CG<2>::solve(A, x, b, Mr, output, os);
+    }
+  };
+
+  DomainReader<2> domain_reader(single_mesh_file, { 4, 4 }, 1);
+  Domain<2> domain = domain_reader.getFinerDomain();
+
+  BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+  Poisson::StarPatchOperator<2> op(domain, gf);
+
+  CountingCG cg;
+  Iterative::PatchSolver<2> patch_solver(cg, op);
+
+  Vector<2> f(domain, 1);
+  f.set(1);
+  Vector<2> u(domain, 1);
+  patch_solver.smooth(f, u);
+
+  CHECK_EQ(*cg.num_solves, domain.getNumLocalPatches());
+}
+TEST_CASE("Iterative::PatchSolver is only thread safe with the patch-local methods")
+{
+  DomainReader<2> domain_reader(single_mesh_file, { 6, 6 }, 1);
+  Domain<2> domain = domain_reader.getFinerDomain();
+  BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+  Poisson::StarPatchOperator<2> op(domain, gf);
+
+  Iterative::CG<2> cg;
+  CHECK_UNARY(Iterative::PatchSolver<2>(cg, op).isThreadSafe());
+  cg.setTimer(make_shared<Timer>(Communicator(MPI_COMM_WORLD)));
+  CHECK_UNARY_FALSE(Iterative::PatchSolver<2>(cg, op).isThreadSafe());
+}
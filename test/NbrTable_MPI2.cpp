@@ -0,0 +1,123 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#include <ThunderEgg/Domain.h>
+
+#include "utils/DomainReader.h"
+
+#include <doctest.h>
+
+using namespace std;
+using namespace ThunderEgg;
+
+namespace {
+template<int D, int M>
+void
+checkFaces(const NbrTable<D>& table, const PatchInfo<D>& pinfo)
+{
+  for (Face<D, M> f : Face<D, M>::getValues()) {
+    CHECK_EQ(table.hasNbr(pinfo.local_index, f), pinfo.hasNbr(f));
+    if (!pinfo.hasNbr(f)) {
+      CHECK_EQ(table.getNumNbrs(pinfo.local_index, f), 0);
+      continue;
+    }
+    NbrType type = pinfo.getNbrType(f);
+    CHECK_EQ(table.getNbrType(pinfo.local_index, f), type);
+    const int* ids = table.getIds(pinfo.local_index, f);
+    const int* ranks = table.getRanks(pinfo.local_index, f);
+    const int* local_indexes = table.getLocalIndexes(pinfo.local_index, f);
+    const int* global_indexes = table.getGlobalIndexes(pinfo.local_index, f);
+    if (type == NbrType::Normal) {
+      const NormalNbrInfo<M>& info = pinfo.getNormalNbrInfo(f);
+      REQUIRE_EQ(table.getNumNbrs(pinfo.local_index, f), 1);
+      CHECK_EQ(ids[0], info.id);
+      CHECK_EQ(ranks[0], info.rank);
+      CHECK_EQ(local_indexes[0], info.local_index);
+      CHECK_EQ(global_indexes[0], info.global_index);
+    } else if (type == NbrType::Coarse) {
+      const CoarseNbrInfo<M>& info = pinfo.getCoarseNbrInfo(f);
+      REQUIRE_EQ(table.getNumNbrs(pinfo.local_index, f), 1);
+      CHECK_EQ(ids[0], info.id);
+      CHECK_EQ(ranks[0], info.rank);
+      CHECK_EQ(local_indexes[0], info.local_index);
+      CHECK_EQ(global_indexes[0], info.global_index);
+      CHECK_EQ(table.getOrthOnCoarse(pinfo.local_index, f), info.orth_on_coarse);
+    } else {
+      const FineNbrInfo<M>& info = pinfo.getFineNbrInfo(f);
+      REQUIRE_EQ(table.getNumNbrs(pinfo.local_index, f), (int)Orthant<M>::num_orthants);
+      for (size_t i = 0; i < Orthant<M>::num_orthants; i++) {
+        CHECK_EQ(ids[i], info.ids[i]);
+        CHECK_EQ(ranks[i], info.ranks[i]);
+        CHECK_EQ(local_indexes[i], info.local_indexes[i]);
+        CHECK_EQ(global_indexes[i], info.global_indexes[i]);
+      }
+    }
+  }
+}
+template<int D>
+void
+checkTable(const Domain<D>& domain)
+{
+  const NbrTable<D>& table = domain.getNbrTable();
+  CHECK_EQ(table.getNumPatches(), domain.getNumLocalPatches());
+  for (const PatchInfo<D>& pinfo : domain.getPatchInfoVector()) {
+    checkFaces<D, D - 1>(table, pinfo);
+    checkFaces<D, D - 2>(table, pinfo);
+    if constexpr (D == 3) {
+      checkFaces<D, 0>(table, pinfo);
+    }
+  }
+}
+} // namespace
+TEST_CASE("NbrTable<2> matches PatchInfo")
+{
+  for (auto mesh_file : { "mesh_inputs/2d_uniform_4x4_mid_on_1_mpi2.json",
+                          "mesh_inputs/2d_uniform_8x8_refined_cross_on_1_mpi2.json",
+                          "mesh_inputs/2d_refined_complicated_mpi2.json" }) {
+    INFO("MESH: " << mesh_file);
+    DomainReader<2> domain_reader(mesh_file, { 4, 4 }, 1);
+    checkTable(domain_reader.getFinerDomain());
+    checkTable(domain_reader.getCoarserDomain());
+  }
+}
+TEST_CASE("NbrTable<3> matches PatchInfo")
+{
+  DomainReader<3> domain_reader("mesh_inputs/3d_refined_bnw_2x2x2_mpi2.json", { 4, 4, 4 }, 1);
+  checkTable(domain_reader.getFinerDomain());
+  checkTable(domain_reader.getCoarserDomain());
+}
+TEST_CASE("NbrTable local indexes of off rank neighbors are -1")
+{
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  DomainReader<2> domain_reader("mesh_inputs/2d_refined_complicated_mpi2.json", { 4, 4 }, 1);
+  Domain<2> domain = domain_reader.getFinerDomain();
+  const NbrTable<2>& table = domain.getNbrTable();
+  for (int i = 0; i < table.getNumPatches(); i++) {
+    for (Side<2> s : Side<2>::getValues()) {
+      for (int n = 0; n < table.getNumNbrs(i, s); n++) {
+        if (table.getRanks(i, s)[n] == rank) {
+          CHECK_GE(table.getLocalIndexes(i, s)[n], 0);
+        } else {
+          CHECK_EQ(table.getLocalIndexes(i, s)[n], -1);
+        }
+      }
+    }
+  }
+}
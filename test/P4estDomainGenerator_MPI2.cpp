@@ -3115,3 +3115,73 @@ TEST_CASE("P4estDomainGenerator 4x4 Refined SW")
     }
   }
 }
+TEST_CASE("P4estDomainGenerator 4x4 Repartition by patch costs")
+{
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  p4est_connectivity_t* conn = p4est_connectivity_new_unitsquare();
+
+  p4est_t* p4est = p4est_new_ext(MPI_COMM_WORLD, conn, 0, 0, 0, 0, nullptr, nullptr);
+
+  p4est_refine(
+    p4est, false, [](p4est_t* p4est, p4est_topidx_t witch_tree, p4est_quadrant_t* quadrant) -> int { return 1; }, nullptr);
+  p4est_refine(
+    p4est, false, [](p4est_t* p4est, p4est_topidx_t witch_tree, p4est_quadrant_t* quadrant) -> int { return 1; }, nullptr);
+
+  p4est_partition(p4est, true, nullptr);
+
+  P4estDomainGenerator::BlockMapFunc bmf = [&](int block_no, double unit_x, double unit_y, double& x, double& y) {
+    x = unit_x;
+    y = unit_y;
+  };
+
+  map<int, double> patch_costs;
+  {
+    P4estDomainGenerator dg(p4est, { 10, 10 }, 1, bmf);
+    Domain<2> domain = dg.getFinestDomain();
+    for (const PatchInfo<2>& pinfo : domain.getPatchInfoVector()) {
+      patch_costs[pinfo.id] = pinfo.id < 4 ? 3 : 1;
+    }
+  }
+
+  p4est_gloidx_t num_moved = P4estDomainGenerator::Repartition(p4est, patch_costs);
+
+  CHECK_GT(num_moved, 0);
+  if (rank == 0) {
+    CHECK_LT(p4est->local_num_quadrants, 8);
+  } else {
+    CHECK_GT(p4est->local_num_quadrants, 8);
+  }
+
+  {
+    P4estDomainGenerator dg(p4est, { 10, 10 }, 1, bmf);
+
+    Domain<2> domain_2 = dg.getFinestDomain();
+    Domain<2> domain_1 = dg.getCoarserDomain();
+    Domain<2> domain_0 = dg.getCoarserDomain();
+
+    CHECK_EQ(domain_2.getNumLocalPatches(), p4est->local_num_quadrants);
+    CHECK_EQ(domain_2.getNumGlobalPatches(), 16);
+    CHECK_EQ(domain_1.getNumGlobalPatches(), 4);
+    CHECK_EQ(domain_0.getNumGlobalPatches(), 1);
+  }
+
+  p4est_destroy(p4est);
+  p4est_connectivity_destroy(conn);
+}
+TEST_CASE("P4estDomainGenerator Repartition throws with patch on other rank")
+{
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  p4est_connectivity_t* conn = p4est_connectivity_new_unitsquare();
+
+  p4est_t* p4est = p4est_new_ext(MPI_COMM_WORLD, conn, 0, 1, 0, 0, nullptr, nullptr);
+
+  map<int, double> patch_costs;
+  patch_costs[rank == 0 ? 3 : 0] = 1;
+
+  CHECK_THROWS_AS(P4estDomainGenerator::Repartition(p4est, patch_costs), RuntimeError);
+
+  p4est_destroy(p4est);
+  p4est_connectivity_destroy(conn);
+}
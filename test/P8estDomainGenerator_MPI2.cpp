@@ -811,3 +811,46 @@ TEST_CASE("P8estDomainGenerator 2x2x2rbsw child/parent ids and ranks")
   PatchVector domain_1_pvector(domain_1, 1);
   PatchVector domain_0_pvector(domain_0, 0);
 }
+TEST_CASE("P8estDomainGenerator 4x4x4 Repartition by patch costs")
+{
+  FourTreeBSW tree;
+
+  map<int, double> patch_costs;
+  {
+    P8estDomainGenerator dg(tree.p8est, { 10, 10, 10 }, 1, Ident);
+    Domain<3> domain = dg.getFinestDomain();
+    for (const PatchInfo<3>& pinfo : domain.getPatchInfoVector()) {
+      patch_costs[pinfo.id] = pinfo.id < 8 ? 7 : 1;
+    }
+  }
+
+  p4est_gloidx_t num_moved = P8estDomainGenerator::Repartition(tree.p8est, patch_costs);
+
+  CHECK_GT(num_moved, 0);
+  if (tree.rank == 0) {
+    CHECK_LT(tree.p8est->local_num_quadrants, 32);
+  } else {
+    CHECK_GT(tree.p8est->local_num_quadrants, 32);
+  }
+
+  P8estDomainGenerator dg(tree.p8est, { 10, 10, 10 }, 1, Ident);
+
+  Domain<3> domain_2 = dg.getFinestDomain();
+  Domain<3> domain_1 = dg.getCoarserDomain();
+  Domain<3> domain_0 = dg.getCoarserDomain();
+
+  CHECK_EQ(domain_2.getNumLocalPatches(), tree.p8est->local_num_quadrants);
+  CHECK_EQ(domain_2.getNumGlobalPatches(), 64);
+  CHECK_EQ(domain_1.getNumGlobalPatches(), 8);
+  CHECK_EQ(domain_0.getNumGlobalPatches(), 1);
+  CheckParentAndChildIdsAndRanks(domain_0, 0, domain_1, 1);
+}
+TEST_CASE("P8estDomainGenerator Repartition throws with patch on other rank")
+{
+  FourTreeBSW tree;
+
+  map<int, double> patch_costs;
+  patch_costs[tree.rank == 0 ? 63 : 0] = 1;
+
+  CHECK_THROWS_AS(P8estDomainGenerator::Repartition(tree.p8est, patch_costs), RuntimeError);
+}
@@ -897,3 +897,15 @@ TEST_CASE("PatchInfo copy assignment")
     }
   }
 }
+TEST_CASE("PatchInfo typed NbrInfo accessors check the NbrType in debug builds")
+{
+  PatchInfo<3> pinfo;
+  pinfo.setNbrInfo(Side<3>::west(), new NormalNbrInfo<2>(2));
+
+  CHECK_EQ(pinfo.getNormalNbrInfo(Side<3>::west()).id, 2);
+  if (ENABLE_DEBUG) {
+    CHECK_THROWS_AS(pinfo.getCoarseNbrInfo(Side<3>::west()), RuntimeError);
+    CHECK_THROWS_AS(pinfo.getFineNbrInfo(Side<3>::west()), RuntimeError);
+    CHECK_THROWS_AS(pinfo.getNormalNbrInfo(Side<3>::east()), RuntimeError);
+  }
+}
@@ -24,6 +24,7 @@
 #include <ThunderEgg/GMG/LinearRestrictor.h>
 #include <ThunderEgg/Poisson/DFTPatchSolver.h>
 #include <ThunderEgg/Poisson/StarPatchOperator.h>
+#include <ThunderEgg/TriLinearGhostFiller.h>
 
 #include <doctest.h>
 
@@ -197,3 +198,33 @@ TEST_CASE("Test Poisson::DFTPatchSolver gets 2nd order convergence with neumann
     }
   }
 }
+TEST_CASE("Test Poisson::DFTPatchSolver inverts the 3d operator on a single patch")
+{
+  for (bool all_neumann : { false, true }) {
+    DomainReader<3> domain_reader("mesh_inputs/3d_uniform_2x2x2_mpi1.json", { 6, 8, 4 }, 1);
+    Domain<3> d_coarse = domain_reader.getCoarserDomain();
+    const PatchInfo<3>& pinfo = d_coarse.getPatchInfoVector()[0];
+
+    Vector<3> u_vec(d_coarse, 1);
+    DomainTools::SetValues<3>(d_coarse, u_vec, [](const std::array<double, 3>& coord) {
+      return sin(3 * coord[0]) * cos(coord[1]) + coord[2] * coord[2];
+    });
+
+    TriLinearGhostFiller gf(d_coarse, GhostFillingType::Faces);
+    Poisson::StarPatchOperator<3> p_operator(d_coarse, gf, all_neumann);
+    Poisson::DFTPatchSolver<3> p_solver(p_operator, all_neumann ? bitset<6>(0x3F) : bitset<6>());
+
+    Vector<3> f_vec(d_coarse, 1);
+    p_operator.applySinglePatch(pinfo, u_vec.getPatchView(0), f_vec.getPatchView(0));
+    Vector<3> g_vec(d_coarse, 1);
+    p_solver.solveSinglePatch(pinfo, f_vec.getPatchView(0), g_vec.getPatchView(0));
+
+    // the pure neumann solution is only defined up to a constant
+    PatchView<double, 3> g_view = g_vec.getPatchView(0);
+    PatchView<const double, 3> u_view = u_vec.getPatchView(0);
+    double shift = all_neumann ? u_view[u_view.getStart()] - g_view[g_view.getStart()] : 0;
+    Loop::OverInteriorIndexes<4>(g_view, [&](const std::array<int, 4>& coord) {
+      CHECK_EQ(g_view[coord] + shift, doctest::Approx(u_view[coord]));
+    });
+  }
+}
@@ -24,8 +24,12 @@
 #include <ThunderEgg/GMG/LinearRestrictor.h>
 #include <ThunderEgg/Poisson/FFTWPatchSolver.h>
 #include <ThunderEgg/Poisson/StarPatchOperator.h>
+#include <ThunderEgg/Timer.h>
 
 #include <doctest.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
 
 using namespace std;
 using namespace ThunderEgg;
@@ -197,3 +201,169 @@ TEST_CASE("Test Poisson::FFTWPatchSolver gets 2nd order convergence with neumann
     }
   }
 }
+TEST_CASE("Test Poisson::FFTWPatchSolver batched smooth matches solveSinglePatch")
+{
+  for (auto mesh_file : { MESHES }) {
+    for (bitset<4> neumann : { bitset<4>(0), bitset<4>(0xF) }) {
+      DomainReader<2> domain_reader(mesh_file, { 10, 13 }, 1);
+      Domain<2> d_fine = domain_reader.getFinerDomain();
+
+      auto ffun = [](const std::array<double, 2>& coord) {
+        double x = coord[0];
+        double y = coord[1];
+        return sin(3 * x) + y * y;
+      };
+      auto gfun = [](const std::array<double, 2>& coord) {
+        double x = coord[0];
+        double y = coord[1];
+        return x * y;
+      };
+
+      Vector<2> f_vec(d_fine, 1);
+      DomainTools::SetValues<2>(d_fine, f_vec, ffun);
+      Vector<2> g_vec(d_fine, 1);
+      DomainTools::SetValuesWithGhost<2>(d_fine, g_vec, gfun);
+      Vector<2> g_vec_single = g_vec;
+
+      BiLinearGhostFiller gf(d_fine, GhostFillingType::Faces);
+      Poisson::StarPatchOperator<2> p_operator(d_fine, gf, neumann.all());
+      Poisson::FFTWPatchSolver<2> p_solver(p_operator, neumann);
+
+      p_solver.smooth(f_vec, g_vec);
+
+      gf.fillGhost(g_vec_single);
+      for (const PatchInfo<2>& pinfo : d_fine.getPatchInfoVector()) {
+        p_solver.solveSinglePatch(pinfo,
+                                  f_vec.getPatchView(pinfo.local_index),
+                                  g_vec_single.getPatchView(pinfo.local_index));
+      }
+
+      Vector<2> diff(d_fine, 1);
+      diff.addScaled(1.0, g_vec, -1.0, g_vec_single);
+      CHECK_GT(g_vec.twoNorm(), 0);
+      CHECK_LE(diff.twoNorm(), 1e-12 * g_vec.twoNorm());
+    }
+  }
+}
+TEST_CASE("Test Poisson::FFTWPatchSolver clone gives the same result")
+{
+  DomainReader<2> domain_reader(mesh_file, { 10, 10 }, 1);
+  Domain<2> d_fine = domain_reader.getFinerDomain();
+
+  Vector<2> f_vec(d_fine, 1);
+  DomainTools::SetValues<2>(d_fine, f_vec, [](const std::array<double, 2>& coord) {
+    return sin(M_PI * coord[0]) * coord[1];
+  });
+
+  BiLinearGhostFiller gf(d_fine, GhostFillingType::Faces);
+  Poisson::StarPatchOperator<2> p_operator(d_fine, gf);
+  unique_ptr<Poisson::FFTWPatchSolver<2>> p_solver(
+    new Poisson::FFTWPatchSolver<2>(p_operator, bitset<4>()));
+  unique_ptr<Poisson::FFTWPatchSolver<2>> clone(p_solver->clone());
+  p_solver.reset();
+
+  Vector<2> g_vec(d_fine, 1);
+  clone->apply(f_vec, g_vec);
+
+  Poisson::FFTWPatchSolver<2> expected_solver(p_operator, bitset<4>());
+  Vector<2> g_vec_expected(d_fine, 1);
+  expected_solver.apply(f_vec, g_vec_expected);
+
+  Vector<2> diff(d_fine, 1);
+  diff.addScaled(1.0, g_vec, -1.0, g_vec_expected);
+  CHECK_GT(g_vec.twoNorm(), 0);
+  CHECK_EQ(diff.twoNorm(), 0);
+}
+TEST_CASE("Test Poisson::FFTWPatchSolver planning options give the same result")
+{
+  DomainReader<2> domain_reader(mesh_file, { 10, 10 }, 1);
+  Domain<2> d_fine = domain_reader.getFinerDomain();
+
+  Vector<2> f_vec(d_fine, 1);
+  DomainTools::SetValues<2>(d_fine, f_vec, [](const std::array<double, 2>& coord) {
+    return sin(M_PI * coord[0]) * coord[1];
+  });
+
+  BiLinearGhostFiller gf(d_fine, GhostFillingType::Faces);
+  Poisson::StarPatchOperator<2> p_operator(d_fine, gf);
+
+  Poisson::FFTWPatchSolver<2> expected_solver(p_operator, bitset<4>());
+  Vector<2> g_vec_expected(d_fine, 1);
+  expected_solver.apply(f_vec, g_vec_expected);
+
+  for (Poisson::FFTWPlanningRigor rigor : { Poisson::FFTWPlanningRigor::Estimate,
+                                            Poisson::FFTWPlanningRigor::Measure,
+                                            Poisson::FFTWPlanningRigor::Patient }) {
+    for (bool share_wisdom : { false, true }) {
+      Poisson::FFTWPatchSolverOpts opts;
+      opts.planning_rigor = rigor;
+      opts.share_wisdom = share_wisdom;
+      Poisson::FFTWPatchSolver<2> p_solver(p_operator, bitset<4>(), opts);
+
+      Vector<2> g_vec(d_fine, 1);
+      p_solver.apply(f_vec, g_vec);
+
+      Vector<2> diff(d_fine, 1);
+      diff.addScaled(1.0, g_vec, -1.0, g_vec_expected);
+      CHECK_GT(g_vec.twoNorm(), 0);
+      CHECK_LE(diff.twoNorm(), 1e-12 * g_vec_expected.twoNorm());
+    }
+  }
+}
+TEST_CASE("Test Poisson::FFTWPatchSolver writes wisdom file")
+{
+  DomainReader<2> domain_reader(mesh_file, { 10, 10 }, 1);
+  Domain<2> d_fine = domain_reader.getFinerDomain();
+
+  BiLinearGhostFiller gf(d_fine, GhostFillingType::Faces);
+  Poisson::StarPatchOperator<2> p_operator(d_fine, gf);
+
+  string wisdom_file = "fftw_patch_solver_test.wisdom";
+  remove(wisdom_file.c_str());
+  fftw_forget_wisdom();
+
+  Poisson::FFTWPatchSolverOpts opts;
+  opts.wisdom_file = wisdom_file;
+  Poisson::FFTWPatchSolver<2> p_solver(p_operator, bitset<4>(), opts);
+  CHECK_GT(p_solver.getNumFreshPlans(), 0);
+
+  ifstream file(wisdom_file);
+  CHECK(file.good());
+  file.close();
+
+  // a second solver reads the wisdom that was just written, and does not have to plan anything
+  fftw_forget_wisdom();
+  Poisson::FFTWPatchSolver<2> p_solver2(p_operator, bitset<4>(), opts);
+  CHECK_EQ(p_solver2.getNumFreshPlans(), 0);
+
+  remove(wisdom_file.c_str());
+}
+TEST_CASE("Test Poisson::FFTWPatchSolver does not count estimated plans as fresh plans")
+{
+  DomainReader<2> domain_reader(mesh_file, { 10, 10 }, 1);
+  Domain<2> d_fine = domain_reader.getFinerDomain();
+
+  BiLinearGhostFiller gf(d_fine, GhostFillingType::Faces);
+  Poisson::StarPatchOperator<2> p_operator(d_fine, gf);
+
+  fftw_forget_wisdom();
+  Poisson::FFTWPatchSolverOpts opts;
+  opts.planning_rigor = Poisson::FFTWPlanningRigor::Estimate;
+  Poisson::FFTWPatchSolver<2> p_solver(p_operator, bitset<4>(), opts);
+  CHECK_EQ(p_solver.getNumFreshPlans(), 0);
+}
+TEST_CASE("Test Poisson::FFTWPatchSolver records setup time")
+{
+  DomainReader<2> domain_reader(mesh_file, { 10, 10 }, 1);
+  Domain<2> d_fine = domain_reader.getFinerDomain();
+  auto timer = make_shared<Timer>(Communicator(MPI_COMM_WORLD));
+  d_fine.setTimer(timer);
+
+  BiLinearGhostFiller gf(d_fine, GhostFillingType::Faces);
+  Poisson::StarPatchOperator<2> p_operator(d_fine, gf);
+  Poisson::FFTWPatchSolver<2> p_solver(p_operator, bitset<4>());
+
+  stringstream ss;
+  ss << *timer;
+  CHECK_NE(ss.str().find("FFTWPatchSolver Setup"), string::npos);
+}
@@ -0,0 +1,106 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2020-2021 Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include "../utils/DomainReader.h"
+#include <ThunderEgg/BiLinearGhostFiller.h>
+#include <ThunderEgg/DomainTools.h>
+#include <ThunderEgg/Poisson/FFTWPatchSolver.h>
+#include <ThunderEgg/Poisson/StarPatchOperator.h>
+
+#include <doctest.h>
+#include <cstdio>
+
+using namespace std;
+using namespace ThunderEgg;
+
+const string mesh_file = "mesh_inputs/2d_uniform_4x4_mid_on_1_mpi2.json";
+
+TEST_CASE("Test Poisson::FFTWPatchSolver with shared wisdom gives same result")
+{
+  for (auto nx : { 10, 13 }) {
+    for (auto ny : { 10, 13 }) {
+      DomainReader<2> domain_reader(mesh_file, { nx, ny }, 1);
+      Domain<2> d_fine = domain_reader.getFinerDomain();
+
+      Vector<2> f_vec(d_fine, 1);
+      DomainTools::SetValues<2>(d_fine, f_vec, [](const std::array<double, 2>& coord) {
+        return sin(M_PI * coord[1]) * cos(2 * M_PI * coord[0]);
+      });
+
+      BiLinearGhostFiller gf(d_fine, GhostFillingType::Faces);
+      Poisson::StarPatchOperator<2> p_operator(d_fine, gf);
+
+      Poisson::FFTWPatchSolver<2> expected_solver(p_operator, bitset<4>("0101"));
+      Vector<2> g_vec_expected(d_fine, 1);
+      expected_solver.apply(f_vec, g_vec_expected);
+
+      Poisson::FFTWPatchSolverOpts opts;
+      opts.share_wisdom = true;
+      Poisson::FFTWPatchSolver<2> p_solver(p_operator, bitset<4>("0101"), opts);
+      Vector<2> g_vec(d_fine, 1);
+      p_solver.apply(f_vec, g_vec);
+
+      Vector<2> diff(d_fine, 1);
+      diff.addScaled(1.0, g_vec, -1.0, g_vec_expected);
+      CHECK_GT(g_vec.twoNorm(), 0);
+      CHECK_LE(diff.twoNorm(), 1e-12 * g_vec_expected.twoNorm());
+    }
+  }
+}
+TEST_CASE("Test Poisson::FFTWPatchSolver wisdom file holds the batched plans of every rank")
+{
+  DomainReader<2> domain_reader(mesh_file, { 10, 10 }, 1);
+  Domain<2> d_fine = domain_reader.getFinerDomain();
+
+  BiLinearGhostFiller gf(d_fine, GhostFillingType::Faces);
+  Poisson::StarPatchOperator<2> p_operator(d_fine, gf);
+
+  string wisdom_file = "fftw_patch_solver_test_mpi2.wisdom";
+  if (d_fine.getCommunicator().getRank() == 0) {
+    remove(wisdom_file.c_str());
+  }
+  fftw_forget_wisdom();
+
+  Poisson::FFTWPatchSolverOpts opts;
+  opts.wisdom_file = wisdom_file;
+  Poisson::FFTWPatchSolver<2> p_solver(p_operator, bitset<4>("0101"), opts);
+
+  // a second solver reads the wisdom that was just written, and does not have to plan anything
+  fftw_forget_wisdom();
+  Poisson::FFTWPatchSolver<2> p_solver2(p_operator, bitset<4>("0101"), opts);
+  CHECK_EQ(p_solver2.getNumFreshPlans(), 0);
+
+  MPI_Barrier(d_fine.getCommunicator().getMPIComm());
+  if (d_fine.getCommunicator().getRank() == 0) {
+    remove(wisdom_file.c_str());
+  }
+}
+TEST_CASE("Test Poisson::FFTWPatchSolver throws on every rank if wisdom file cannot be written")
+{
+  DomainReader<2> domain_reader(mesh_file, { 10, 10 }, 1);
+  Domain<2> d_fine = domain_reader.getFinerDomain();
+
+  BiLinearGhostFiller gf(d_fine, GhostFillingType::Faces);
+  Poisson::StarPatchOperator<2> p_operator(d_fine, gf);
+
+  Poisson::FFTWPatchSolverOpts opts;
+  opts.wisdom_file = "directory_that_does_not_exist/fftw_patch_solver_test.wisdom";
+  CHECK_THROWS_AS(Poisson::FFTWPatchSolver<2>(p_operator, bitset<4>(), opts), RuntimeError);
+}
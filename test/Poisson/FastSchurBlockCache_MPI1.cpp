@@ -0,0 +1,86 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include <ThunderEgg/Poisson/FastSchurBlockCache.h>
+
+#include <doctest.h>
+
+using namespace std;
+using namespace ThunderEgg;
+
+TEST_CASE("Poisson::FastSchurBlockCache starts empty")
+{
+  Poisson::FastSchurBlockCache<2> cache;
+  CHECK_EQ(cache.getNumBlocks(), 0);
+  CHECK_EQ(cache.getNumBytes(), 0);
+  CHECK_EQ(cache.find({ "gf", 4, 0, Side<2>::west(), Schur::IfaceType<2>::Normal() }), nullptr);
+}
+TEST_CASE("Poisson::FastSchurBlockCache finds inserted blocks")
+{
+  Poisson::FastSchurBlockCache<2> cache;
+  auto normal = make_shared<vector<double>>(16, 1.0);
+  auto fine = make_shared<vector<double>>(16, 2.0);
+  Poisson::FastSchurBlockCache<2>::Key normal_key = {
+    "gf", 4, 0, Side<2>::west(), Schur::IfaceType<2>::Normal()
+  };
+  Poisson::FastSchurBlockCache<2>::Key fine_key = {
+    "gf", 4, 0, Side<2>::west(), Schur::IfaceType<2>::CoarseToFine(Orthant<1>::upper())
+  };
+  cache.insert(normal_key, normal);
+  cache.insert(fine_key, fine);
+
+  CHECK_EQ(cache.getNumBlocks(), 2);
+  CHECK_EQ(cache.getNumBytes(), 32 * sizeof(double));
+  CHECK_EQ(cache.find(normal_key), normal);
+  CHECK_EQ(cache.find(fine_key), fine);
+}
+TEST_CASE("Poisson::FastSchurBlockCache keys differ by every component")
+{
+  Poisson::FastSchurBlockCache<3> cache;
+  Poisson::FastSchurBlockCache<3>::Key key = {
+    "gf", 4, 0, Side<3>::west(), Schur::IfaceType<3>::Normal()
+  };
+  cache.insert(key, make_shared<vector<double>>(256));
+
+  CHECK_NE(cache.find(key), nullptr);
+  CHECK_EQ(cache.find({ "other", 4, 0, Side<3>::west(), Schur::IfaceType<3>::Normal() }), nullptr);
+  CHECK_EQ(cache.find({ "gf", 8, 0, Side<3>::west(), Schur::IfaceType<3>::Normal() }), nullptr);
+  CHECK_EQ(cache.find({ "gf", 4, 1, Side<3>::west(), Schur::IfaceType<3>::Normal() }), nullptr);
+  CHECK_EQ(cache.find({ "gf", 4, 0, Side<3>::east(), Schur::IfaceType<3>::Normal() }), nullptr);
+  CHECK_EQ(cache.find({ "gf", 4, 0, Side<3>::west(), Schur::IfaceType<3>::CoarseToCoarse() }),
+           nullptr);
+}
+TEST_CASE("Poisson::FastSchurBlockCache insert replaces and clear empties")
+{
+  Poisson::FastSchurBlockCache<2> cache;
+  Poisson::FastSchurBlockCache<2>::Key key = {
+    "gf", 2, 0, Side<2>::west(), Schur::IfaceType<2>::Normal()
+  };
+  auto first = make_shared<vector<double>>(4, 1.0);
+  auto second = make_shared<vector<double>>(4, 2.0);
+  cache.insert(key, first);
+  cache.insert(key, second);
+  CHECK_EQ(cache.getNumBlocks(), 1);
+  CHECK_EQ(cache.find(key), second);
+
+  cache.clear();
+  CHECK_EQ(cache.getNumBlocks(), 0);
+  CHECK_EQ(cache.find(key), nullptr);
+}
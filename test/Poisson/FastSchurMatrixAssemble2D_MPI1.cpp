@@ -280,3 +280,198 @@ TEST_CASE("Poisson::FastSchurMatrixAssemble2D gives equivalent operator to "
     MatDestroy(&A);
   }
 }
+TEST_CASE("Poisson::FastSchurMatrixAssemble2D is exactly preallocated")
+{
+  for (auto mesh_file : { MESHES }) {
+    int n = 8;
+    int num_ghost = 1;
+    bitset<4> neumann;
+    DomainReader<2> domain_reader(mesh_file, { n, n }, num_ghost);
+    Domain<2> d_fine = domain_reader.getFinerDomain();
+    Schur::InterfaceDomain<2> iface_domain(d_fine);
+
+    BiLinearGhostFiller gf(d_fine, GhostFillingType::Faces);
+    Poisson::StarPatchOperator<2> p_operator(d_fine, gf);
+    Poisson::FFTWPatchSolver<2> p_solver(p_operator, neumann);
+
+    Mat A = Poisson::FastSchurMatrixAssemble2D(iface_domain, p_solver);
+
+    PetscInt block_size;
+    MatGetBlockSize(A, &block_size);
+    CHECK_EQ(block_size, n);
+
+    MatInfo info;
+    MatGetInfo(A, MAT_LOCAL, &info);
+    CHECK_EQ(info.mallocs, 0);
+    CHECK_EQ(info.nz_unneeded, 0);
+    CHECK_GT(info.nz_used, 0);
+
+    MatDestroy(&A);
+  }
+}
+TEST_CASE("Poisson::FastSchurMatrixAssemble2D gives the same operator for MATAIJ and MATBAIJ")
+{
+  for (auto mesh_file : { MESHES }) {
+    int n = 8;
+    int num_ghost = 1;
+    bitset<4> neumann;
+    DomainReader<2> domain_reader(mesh_file, { n, n }, num_ghost);
+    Domain<2> d_fine = domain_reader.getFinerDomain();
+    Schur::InterfaceDomain<2> iface_domain(d_fine);
+
+    Vector<1> g_vec = iface_domain.getNewVector();
+    int index = 0;
+    for (auto iface_info : iface_domain.getInterfaces()) {
+      View<double, 1> view = g_vec.getComponentView(0, iface_info->local_index);
+      for (int i = 0; i < n; i++) {
+        double x = (index + 0.5) / g_vec.getNumLocalCells();
+        view(i) = sin(M_PI * x);
+        index++;
+      }
+    }
+
+    BiQuadraticGhostFiller gf(d_fine, GhostFillingType::Faces);
+    Poisson::StarPatchOperator<2> p_operator(d_fine, gf);
+    Poisson::FFTWPatchSolver<2> p_solver(p_operator, neumann);
+
+    Mat A_aij = Poisson::FastSchurMatrixAssemble2D(iface_domain, p_solver, MATAIJ);
+    Mat A_baij = Poisson::FastSchurMatrixAssemble2D(iface_domain, p_solver, MATBAIJ);
+
+    Vector<1> f_aij = iface_domain.getNewVector();
+    PETSc::MatWrapper<1>(A_aij).apply(g_vec, f_aij);
+    Vector<1> f_baij = iface_domain.getNewVector();
+    PETSc::MatWrapper<1>(A_baij).apply(g_vec, f_baij);
+
+    REQUIRE_GT(f_aij.infNorm(), 0);
+    for (auto iface : iface_domain.getInterfaces()) {
+      ComponentView<double, 1> f_aij_ld = f_aij.getComponentView(0, iface->local_index);
+      ComponentView<double, 1> f_baij_ld = f_baij.getComponentView(0, iface->local_index);
+      Loop::Nested<1>(f_aij_ld.getStart(), f_aij_ld.getEnd(), [&](const array<int, 1>& coord) { CHECK_EQ(f_baij_ld[coord], doctest::Approx(f_aij_ld[coord])); });
+    }
+    MatDestroy(&A_aij);
+    MatDestroy(&A_baij);
+  }
+}
+TEST_CASE("Poisson::FastSchurMatrixFree2D gives the same operator as FastSchurMatrixAssemble2D")
+{
+  for (auto mesh_file : { MESHES }) {
+    int n = 8;
+    int num_ghost = 1;
+    bitset<4> neumann;
+    DomainReader<2> domain_reader(mesh_file, { n, n }, num_ghost);
+    Domain<2> d_fine = domain_reader.getFinerDomain();
+    Schur::InterfaceDomain<2> iface_domain(d_fine);
+
+    Vector<1> g_vec = iface_domain.getNewVector();
+    int index = 0;
+    for (auto iface_info : iface_domain.getInterfaces()) {
+      View<double, 1> view = g_vec.getComponentView(0, iface_info->local_index);
+      for (int i = 0; i < n; i++) {
+        double x = (index + 0.5) / g_vec.getNumLocalCells();
+        view(i) = sin(M_PI * x);
+        index++;
+      }
+    }
+
+    BiQuadraticGhostFiller gf(d_fine, GhostFillingType::Faces);
+    Poisson::StarPatchOperator<2> p_operator(d_fine, gf);
+    Poisson::FFTWPatchSolver<2> p_solver(p_operator, neumann);
+
+    Poisson::FastSchurBlockCache<2> cache;
+    Mat A = Poisson::FastSchurMatrixAssemble2D(iface_domain, p_solver, cache);
+    Mat A_free = Poisson::FastSchurMatrixFree2D(iface_domain, p_solver, cache);
+
+    Vector<1> f_vec = iface_domain.getNewVector();
+    PETSc::MatWrapper<1>(A).apply(g_vec, f_vec);
+    Vector<1> f_free_vec = iface_domain.getNewVector();
+    PETSc::MatWrapper<1>(A_free).apply(g_vec, f_free_vec);
+
+    REQUIRE_GT(f_vec.infNorm(), 0);
+    for (auto iface : iface_domain.getInterfaces()) {
+      ComponentView<double, 1> f_ld = f_vec.getComponentView(0, iface->local_index);
+      ComponentView<double, 1> f_free_ld = f_free_vec.getComponentView(0, iface->local_index);
+      Loop::Nested<1>(f_ld.getStart(), f_ld.getEnd(), [&](const array<int, 1>& coord) {
+        CHECK_EQ(f_free_ld[coord], doctest::Approx(f_ld[coord]));
+      });
+    }
+    MatDestroy(&A);
+    MatDestroy(&A_free);
+  }
+}
+TEST_CASE("Poisson::FastSchurMatrixAssemble2D reuses the blocks in the cache")
+{
+  for (auto mesh_file : { MESHES }) {
+    int n = 8;
+    int num_ghost = 1;
+    bitset<4> neumann;
+    DomainReader<2> domain_reader(mesh_file, { n, n }, num_ghost);
+    Domain<2> d_fine = domain_reader.getFinerDomain();
+    Schur::InterfaceDomain<2> iface_domain(d_fine);
+
+    BiQuadraticGhostFiller gf(d_fine, GhostFillingType::Faces);
+    Poisson::StarPatchOperator<2> p_operator(d_fine, gf);
+    Poisson::FFTWPatchSolver<2> p_solver(p_operator, neumann);
+
+    Poisson::FastSchurBlockCache<2> cache;
+    Mat A = Poisson::FastSchurMatrixAssemble2D(iface_domain, p_solver, cache);
+    size_t num_blocks = cache.getNumBlocks();
+    CHECK_GT(num_blocks, 0);
+
+    Mat A_again = Poisson::FastSchurMatrixAssemble2D(iface_domain, p_solver, cache);
+    CHECK_EQ(cache.getNumBlocks(), num_blocks);
+
+    PetscBool equal;
+    MatEqual(A, A_again, &equal);
+    CHECK(equal);
+
+    MatDestroy(&A);
+    MatDestroy(&A_again);
+  }
+}
+TEST_CASE("Poisson::FastSchurSparseMatrixAssemble2D gives the same operator as "
+          "FastSchurMatrixAssemble2D")
+{
+  for (auto mesh_file : { MESHES }) {
+    int n = 8;
+    int num_ghost = 1;
+    bitset<4> neumann;
+    DomainReader<2> domain_reader(mesh_file, { n, n }, num_ghost);
+    Domain<2> d_fine = domain_reader.getFinerDomain();
+    Schur::InterfaceDomain<2> iface_domain(d_fine);
+
+    Vector<1> g_vec = iface_domain.getNewVector();
+    int index = 0;
+    for (auto iface_info : iface_domain.getInterfaces()) {
+      View<double, 1> view = g_vec.getComponentView(0, iface_info->local_index);
+      for (int i = 0; i < n; i++) {
+        double x = (index + 0.5) / g_vec.getNumLocalCells();
+        view(i) = sin(M_PI * x);
+        index++;
+      }
+    }
+
+    BiQuadraticGhostFiller gf(d_fine, GhostFillingType::Faces);
+    Poisson::StarPatchOperator<2> p_operator(d_fine, gf);
+    Poisson::FFTWPatchSolver<2> p_solver(p_operator, neumann);
+
+    Poisson::FastSchurBlockCache<2> cache;
+    Mat A = Poisson::FastSchurMatrixAssemble2D(iface_domain, p_solver, cache);
+    SparseMatrix<1> A_sparse =
+      Poisson::FastSchurSparseMatrixAssemble2D(iface_domain, p_solver, cache);
+
+    Vector<1> f_vec = iface_domain.getNewVector();
+    PETSc::MatWrapper<1>(A).apply(g_vec, f_vec);
+    Vector<1> f_sparse_vec = iface_domain.getNewVector();
+    A_sparse.apply(g_vec, f_sparse_vec);
+
+    REQUIRE_GT(f_vec.infNorm(), 0);
+    for (auto iface : iface_domain.getInterfaces()) {
+      ComponentView<double, 1> f_ld = f_vec.getComponentView(0, iface->local_index);
+      ComponentView<double, 1> f_sparse_ld = f_sparse_vec.getComponentView(0, iface->local_index);
+      Loop::Nested<1>(f_ld.getStart(), f_ld.getEnd(), [&](const array<int, 1>& coord) {
+        CHECK_EQ(f_sparse_ld[coord], doctest::Approx(f_ld[coord]));
+      });
+    }
+    MatDestroy(&A);
+  }
+}
@@ -195,3 +195,131 @@ TEST_CASE("Poisson::FastSchurMatrixAssemble3D gives equivalent operator to "
     MatDestroy(&A);
   }
 }
+TEST_CASE("Poisson::FastSchurMatrixAssemble3D is exactly preallocated")
+{
+  for (auto mesh_file : { MESHES }) {
+    int n = 4;
+    int num_ghost = 1;
+    bitset<6> neumann;
+    DomainReader<3> domain_reader(mesh_file, { n, n, n }, num_ghost);
+    Domain<3> d_fine = domain_reader.getFinerDomain();
+    Schur::InterfaceDomain<3> iface_domain(d_fine);
+
+    TriLinearGhostFiller gf(d_fine, GhostFillingType::Faces);
+    Poisson::StarPatchOperator<3> p_operator(d_fine, gf);
+    Poisson::FFTWPatchSolver<3> p_solver(p_operator, neumann);
+
+    Mat A = Poisson::FastSchurMatrixAssemble3D(iface_domain, p_solver);
+
+    PetscInt block_size;
+    MatGetBlockSize(A, &block_size);
+    CHECK_EQ(block_size, n * n);
+
+    MatInfo info;
+    MatGetInfo(A, MAT_LOCAL, &info);
+    CHECK_EQ(info.mallocs, 0);
+    CHECK_EQ(info.nz_unneeded, 0);
+    CHECK_GT(info.nz_used, 0);
+
+    MatDestroy(&A);
+  }
+}
+TEST_CASE("Poisson::FastSchurMatrixFree3D gives the same operator as FastSchurMatrixAssemble3D")
+{
+  for (auto mesh_file : { MESHES }) {
+    int n = 4;
+    int num_ghost = 1;
+    bitset<6> neumann;
+    DomainReader<3> domain_reader(mesh_file, { n, n, n }, num_ghost);
+    Domain<3> d_fine = domain_reader.getFinerDomain();
+    Schur::InterfaceDomain<3> iface_domain(d_fine);
+
+    Vector<2> g_vec = iface_domain.getNewVector();
+    int index = 0;
+    for (auto iface_info : iface_domain.getInterfaces()) {
+      View<double, 2> view = g_vec.getComponentView(0, iface_info->local_index);
+      for (int yi = 0; yi < n; yi++) {
+        for (int xi = 0; xi < n; xi++) {
+          double x = (index + 0.5) / g_vec.getNumLocalCells();
+          view(xi, yi) = sin(M_PI * x);
+          index++;
+        }
+      }
+    }
+
+    TriLinearGhostFiller gf(d_fine, GhostFillingType::Faces);
+    Poisson::StarPatchOperator<3> p_operator(d_fine, gf);
+    Poisson::FFTWPatchSolver<3> p_solver(p_operator, neumann);
+
+    Poisson::FastSchurBlockCache<3> cache;
+    Mat A = Poisson::FastSchurMatrixAssemble3D(iface_domain, p_solver, cache);
+    size_t num_blocks = cache.getNumBlocks();
+    Mat A_free = Poisson::FastSchurMatrixFree3D(iface_domain, p_solver, cache);
+    CHECK_EQ(cache.getNumBlocks(), num_blocks);
+
+    Vector<2> f_vec = iface_domain.getNewVector();
+    PETSc::MatWrapper<2>(A).apply(g_vec, f_vec);
+    Vector<2> f_free_vec = iface_domain.getNewVector();
+    PETSc::MatWrapper<2>(A_free).apply(g_vec, f_free_vec);
+
+    REQUIRE_GT(f_vec.infNorm(), 0);
+    for (auto iface : iface_domain.getInterfaces()) {
+      ComponentView<double, 2> f_ld = f_vec.getComponentView(0, iface->local_index);
+      ComponentView<double, 2> f_free_ld = f_free_vec.getComponentView(0, iface->local_index);
+      Loop::Nested<2>(f_ld.getStart(), f_ld.getEnd(), [&](const array<int, 2>& coord) {
+        CHECK_EQ(f_free_ld[coord], doctest::Approx(f_ld[coord]));
+      });
+    }
+    MatDestroy(&A);
+    MatDestroy(&A_free);
+  }
+}
+TEST_CASE("Poisson::FastSchurSparseMatrixAssemble3D gives the same operator as "
+          "FastSchurMatrixAssemble3D")
+{
+  for (auto mesh_file : { MESHES }) {
+    int n = 4;
+    int num_ghost = 1;
+    bitset<6> neumann;
+    DomainReader<3> domain_reader(mesh_file, { n, n, n }, num_ghost);
+    Domain<3> d_fine = domain_reader.getFinerDomain();
+    Schur::InterfaceDomain<3> iface_domain(d_fine);
+
+    Vector<2> g_vec = iface_domain.getNewVector();
+    int index = 0;
+    for (auto iface_info : iface_domain.getInterfaces()) {
+      View<double, 2> view = g_vec.getComponentView(0, iface_info->local_index);
+      for (int yi = 0; yi < n; yi++) {
+        for (int xi = 0; xi < n; xi++) {
+          double x = (index + 0.5) / g_vec.getNumLocalCells();
+          view(xi, yi) = sin(M_PI * x);
+          index++;
+        }
+      }
+    }
+
+    TriLinearGhostFiller gf(d_fine, GhostFillingType::Faces);
+    Poisson::StarPatchOperator<3> p_operator(d_fine, gf);
+    Poisson::FFTWPatchSolver<3> p_solver(p_operator, neumann);
+
+    Poisson::FastSchurBlockCache<3> cache;
+    Mat A = Poisson::FastSchurMatrixAssemble3D(iface_domain, p_solver, cache);
+    SparseMatrix<2> A_sparse =
+      Poisson::FastSchurSparseMatrixAssemble3D(iface_domain, p_solver, cache);
+
+    Vector<2> f_vec = iface_domain.getNewVector();
+    PETSc::MatWrapper<2>(A).apply(g_vec, f_vec);
+    Vector<2> f_sparse_vec = iface_domain.getNewVector();
+    A_sparse.apply(g_vec, f_sparse_vec);
+
+    REQUIRE_GT(f_vec.infNorm(), 0);
+    for (auto iface : iface_domain.getInterfaces()) {
+      ComponentView<double, 2> f_ld = f_vec.getComponentView(0, iface->local_index);
+      ComponentView<double, 2> f_sparse_ld = f_sparse_vec.getComponentView(0, iface->local_index);
+      Loop::Nested<2>(f_ld.getStart(), f_ld.getEnd(), [&](const array<int, 2>& coord) {
+        CHECK_EQ(f_sparse_ld[coord], doctest::Approx(f_ld[coord]));
+      });
+    }
+    MatDestroy(&A);
+  }
+}
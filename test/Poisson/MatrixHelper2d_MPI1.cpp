@@ -22,18 +22,22 @@
 #include <ThunderEgg/BiQuadraticGhostFiller.h>
 #include <ThunderEgg/DomainTools.h>
 #include <ThunderEgg/GMG/LinearRestrictor.h>
-#include <ThunderEgg/PETSc/MatWrapper.h>
 #include <ThunderEgg/Poisson/MatrixHelper2d.h>
 #include <ThunderEgg/Poisson/StarPatchOperator.h>
 
 #include <doctest.h>
 
+#ifdef THUNDEREGG_PETSC_ENABLED
+#include <ThunderEgg/PETSc/MatWrapper.h>
+#endif
+
 using namespace std;
 using namespace ThunderEgg;
 
 #define MESHES "mesh_inputs/2d_uniform_2x2_mpi1.json", "mesh_inputs/2d_uniform_8x8_refined_cross_mpi1.json"
 const string mesh_file = "mesh_inputs/2d_uniform_4x4_mpi1.json";
 
+#ifdef THUNDEREGG_PETSC_ENABLED
 TEST_CASE("Poisson::MatrixHelper2d gives equivalent operator to Poisson::StarPatchOperator")
 {
   for (auto mesh_file : { MESHES }) {
@@ -116,3 +120,103 @@ TEST_CASE("Poisson::MatrixHelper2d gives equivalent operator to Poisson::StarPat
     MatDestroy(&A);
   }
 }
+TEST_CASE("Poisson::MatrixHelper2d is exactly preallocated")
+{
+  for (auto mesh_file : { MESHES }) {
+    int n = 8;
+    int num_ghost = 1;
+    bitset<4> neumann;
+    DomainReader<2> domain_reader(mesh_file, { n, n }, num_ghost);
+    Domain<2> d_fine = domain_reader.getFinerDomain();
+
+    Poisson::MatrixHelper2d mh(d_fine, neumann);
+    Mat A = mh.formCRSMatrix();
+
+    MatInfo info;
+    MatGetInfo(A, MAT_LOCAL, &info);
+    CHECK_EQ(info.mallocs, 0);
+    CHECK_EQ(info.nz_unneeded, 0);
+    CHECK_GT(info.nz_used, 0);
+
+    MatDestroy(&A);
+  }
+}
+#endif
+TEST_CASE("Poisson::MatrixHelper2d formSparseMatrix gives equivalent operator to Poisson::StarPatchOperator")
+{
+  for (auto mesh_file : { MESHES }) {
+    int n = 32;
+    int num_ghost = 1;
+    bitset<4> neumann;
+    DomainReader<2> domain_reader(mesh_file, { n, n }, num_ghost);
+    Domain<2> d_fine = domain_reader.getFinerDomain();
+
+    auto gfun = [](const std::array<double, 2>& coord) {
+      double x = coord[0];
+      double y = coord[1];
+      return sinl(M_PI * y) * cosl(2 * M_PI * x);
+    };
+
+    Vector<2> f_vec(d_fine, 1);
+    Vector<2> f_vec_expected(d_fine, 1);
+
+    Vector<2> g_vec(d_fine, 1);
+    DomainTools::SetValues<2>(d_fine, g_vec, gfun);
+
+    BiQuadraticGhostFiller gf(d_fine, GhostFillingType::Faces);
+    Poisson::StarPatchOperator<2> p_operator(d_fine, gf);
+    p_operator.apply(g_vec, f_vec_expected);
+
+    // generate matrix with matrix_helper
+    Poisson::MatrixHelper2d mh(d_fine, neumann);
+    SparseMatrix<2> A = mh.formSparseMatrix();
+    A.apply(g_vec, f_vec);
+
+    REQUIRE_GT(f_vec.infNorm(), 0);
+
+    for (auto pinfo : d_fine.getPatchInfoVector()) {
+      ComponentView<double, 2> f_vec_ld = f_vec.getComponentView(0, pinfo.local_index);
+      ComponentView<double, 2> f_vec_expected_ld = f_vec_expected.getComponentView(0, pinfo.local_index);
+      Loop::Nested<2>(f_vec_ld.getStart(), f_vec_ld.getEnd(), [&](const array<int, 2>& coord) { CHECK_EQ(f_vec_ld[coord], doctest::Approx(f_vec_expected_ld[coord])); });
+    }
+  }
+}
+TEST_CASE("Poisson::MatrixHelper2d formSparseMatrix gives equivalent operator to Poisson::StarPatchOperator with Neumann BC")
+{
+  for (auto mesh_file : { MESHES }) {
+    int n = 32;
+    int num_ghost = 1;
+    bitset<4> neumann = 0xF;
+    DomainReader<2> domain_reader(mesh_file, { n, n }, num_ghost);
+    Domain<2> d_fine = domain_reader.getFinerDomain();
+
+    auto gfun = [](const std::array<double, 2>& coord) {
+      double x = coord[0];
+      double y = coord[1];
+      return sinl(M_PI * y) * cosl(2 * M_PI * x);
+    };
+
+    Vector<2> f_vec(d_fine, 1);
+    Vector<2> f_vec_expected(d_fine, 1);
+
+    Vector<2> g_vec(d_fine, 1);
+    DomainTools::SetValues<2>(d_fine, g_vec, gfun);
+
+    BiQuadraticGhostFiller gf(d_fine, GhostFillingType::Faces);
+    Poisson::StarPatchOperator<2> p_operator(d_fine, gf, true);
+    p_operator.apply(g_vec, f_vec_expected);
+
+    // generate matrix with matrix_helper
+    Poisson::MatrixHelper2d mh(d_fine, neumann);
+    SparseMatrix<2> A = mh.formSparseMatrix();
+    A.apply(g_vec, f_vec);
+
+    REQUIRE_GT(f_vec.infNorm(), 0);
+
+    for (auto pinfo : d_fine.getPatchInfoVector()) {
+      ComponentView<double, 2> f_vec_ld = f_vec.getComponentView(0, pinfo.local_index);
+      ComponentView<double, 2> f_vec_expected_ld = f_vec_expected.getComponentView(0, pinfo.local_index);
+      Loop::Nested<2>(f_vec_ld.getStart(), f_vec_ld.getEnd(), [&](const array<int, 2>& coord) { CHECK_EQ(f_vec_ld[coord], doctest::Approx(f_vec_expected_ld[coord])); });
+    }
+  }
+}
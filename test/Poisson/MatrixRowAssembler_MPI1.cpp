@@ -0,0 +1,103 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include "../utils/DomainReader.h"
+#include <ThunderEgg/Poisson/MatrixRowAssembler.h>
+
+#include <doctest.h>
+
+using namespace std;
+using namespace ThunderEgg;
+
+TEST_CASE("Poisson::MatrixRowAssembler sorts columns and sums duplicates")
+{
+  Poisson::MatrixRowAssembler rows(10, 3);
+  rows.beginRows(10, 3);
+  int cols_a[3] = { 12, 4, 12 };
+  double values_a[3] = { 1, 2, 3 };
+  rows.add(11, 3, cols_a, values_a);
+  int cols_b[2] = { 10, 30 };
+  double values_b[2] = { 4, 5 };
+  rows.add(10, 2, cols_b, values_b);
+  int col_c = 4;
+  double value_c = 6;
+  rows.add(11, 1, &col_c, &value_c);
+  rows.endRows();
+
+  CHECK_EQ(rows.getNumFinishedRows(), 3);
+  CHECK_EQ(rows.getRowPtr(), vector<int>({ 0, 2, 4, 4 }));
+  CHECK_EQ(rows.getCols(), vector<int>({ 10, 30, 4, 12 }));
+  CHECK_EQ(rows.getValues(), vector<double>({ 4, 5, 8, 4 }));
+
+  vector<int> diag_nnz;
+  vector<int> offd_nnz;
+  rows.getNumNonzeros(diag_nnz, offd_nnz);
+  CHECK_EQ(diag_nnz, vector<int>({ 1, 1, 0 }));
+  CHECK_EQ(offd_nnz, vector<int>({ 1, 1, 0 }));
+}
+TEST_CASE("Poisson::MatrixRowAssembler leaves skipped rows empty")
+{
+  Poisson::MatrixRowAssembler rows(0, 6);
+  int col = 0;
+  double value = 1;
+  rows.beginRows(2, 2);
+  rows.add(3, 1, &col, &value);
+  rows.endRows();
+  rows.beginRows(5, 1);
+  rows.add(5, 1, &col, &value);
+  rows.endRows();
+  rows.finish();
+
+  CHECK_EQ(rows.getNumFinishedRows(), 6);
+  CHECK_EQ(rows.getRowPtr(), vector<int>({ 0, 0, 0, 0, 1, 1, 2 }));
+}
+TEST_CASE("Poisson::MatrixRowAssembler throws for rows outside of the batch")
+{
+  Poisson::MatrixRowAssembler rows(0, 8);
+  int col = 0;
+  double value = 1;
+  CHECK_THROWS_AS(rows.add(0, 1, &col, &value), RuntimeError);
+  CHECK_THROWS_AS(rows.endRows(), RuntimeError);
+  CHECK_THROWS_AS(rows.beginRows(6, 4), RuntimeError);
+
+  rows.beginRows(2, 2);
+  CHECK_THROWS_AS(rows.beginRows(4, 2), RuntimeError);
+  CHECK_THROWS_AS(rows.add(1, 1, &col, &value), RuntimeError);
+  CHECK_THROWS_AS(rows.add(4, 1, &col, &value), RuntimeError);
+  CHECK_THROWS_AS(rows.finish(), RuntimeError);
+  rows.endRows();
+
+  CHECK_THROWS_AS(rows.beginRows(0, 2), RuntimeError);
+}
+TEST_CASE("Poisson::MatrixRowAssembler uses the rows of a Domain")
+{
+  DomainReader<2> domain_reader("mesh_inputs/2d_uniform_8x8_refined_cross_mpi1.json", { 4, 4 }, 1);
+  Domain<2> domain = domain_reader.getFinerDomain();
+
+  Poisson::MatrixRowAssembler rows(domain);
+  CHECK_EQ(rows.getFirstRow(), 0);
+  CHECK_EQ(rows.getNumRows(), domain.getNumLocalCells());
+
+  auto pinfos = Poisson::MatrixRowAssembler::getPatchesInRowOrder(domain);
+  REQUIRE_EQ(pinfos.size(), domain.getNumLocalPatches());
+  for (size_t i = 0; i < pinfos.size(); i++) {
+    CHECK_EQ(pinfos[i]->global_index, i);
+  }
+}
@@ -0,0 +1,156 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2020-2021 Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include "../utils/DomainReader.h"
+#include <ThunderEgg/BiLinearGhostFiller.h>
+#include <ThunderEgg/DomainTools.h>
+#include <ThunderEgg/Poisson/DFTPatchSolver.h>
+#include <ThunderEgg/Poisson/StarPatchOperator.h>
+#include <ThunderEgg/Poisson/TridiagPatchSolver.h>
+#include <ThunderEgg/TriLinearGhostFiller.h>
+
+#include <doctest.h>
+
+using namespace std;
+using namespace ThunderEgg;
+
+#define MESHES "mesh_inputs/2d_uniform_2x2_mpi1.json", "mesh_inputs/2d_uniform_8x8_refined_cross_mpi1.json"
+
+TEST_CASE("Test Poisson::TridiagPatchSolver matches DFTPatchSolver")
+{
+  for (auto mesh_file : { MESHES }) {
+    for (bitset<4> neumann : { 0b0000, 0b1111, 0b0101, 0b1010, 0b0001, 0b1000 }) {
+      for (auto nx : { 10, 13 }) {
+        for (auto ny : { 10, 13 }) {
+          DomainReader<2> domain_reader(mesh_file, { nx, ny }, 1);
+          Domain<2> d_fine = domain_reader.getFinerDomain();
+
+          Vector<2> f_vec(d_fine, 1);
+          DomainTools::SetValues<2>(d_fine, f_vec, [](const std::array<double, 2>& coord) {
+            return sin(3 * coord[0]) + coord[1] * coord[1];
+          });
+          Vector<2> g_vec(d_fine, 1);
+          DomainTools::SetValuesWithGhost<2>(
+            d_fine, g_vec, [](const std::array<double, 2>& coord) { return coord[0] * coord[1]; });
+          Vector<2> g_vec_expected = g_vec;
+
+          BiLinearGhostFiller gf(d_fine, GhostFillingType::Faces);
+          Poisson::StarPatchOperator<2> p_operator(d_fine, gf, neumann.all());
+          Poisson::TridiagPatchSolver<2> p_solver(p_operator, neumann);
+          Poisson::DFTPatchSolver<2> expected_solver(p_operator, neumann);
+
+          p_solver.smooth(f_vec, g_vec);
+          expected_solver.smooth(f_vec, g_vec_expected);
+
+          Vector<2> diff(d_fine, 1);
+          diff.addScaled(1.0, g_vec, -1.0, g_vec_expected);
+          CHECK_GT(g_vec_expected.twoNorm(), 0);
+          CHECK_LE(diff.twoNorm(), 1e-10 * g_vec_expected.twoNorm());
+        }
+      }
+    }
+  }
+}
+TEST_CASE("Test Poisson::TridiagPatchSolver matches DFTPatchSolver in 3d")
+{
+  for (bitset<6> neumann : { 0b000000, 0b111111, 0b010101, 0b100001 }) {
+    DomainReader<3> domain_reader("mesh_inputs/3d_mid_refine_4x4x4_mpi1.json", { 6, 4, 8 }, 1);
+    Domain<3> d_fine = domain_reader.getFinerDomain();
+
+    Vector<3> f_vec(d_fine, 1);
+    DomainTools::SetValues<3>(d_fine, f_vec, [](const std::array<double, 3>& coord) {
+      return sin(3 * coord[0]) * cos(coord[1]) + coord[2] * coord[2];
+    });
+    Vector<3> g_vec(d_fine, 1);
+    DomainTools::SetValuesWithGhost<3>(d_fine, g_vec, [](const std::array<double, 3>& coord) {
+      return coord[0] * coord[1] - coord[2];
+    });
+    Vector<3> g_vec_expected = g_vec;
+
+    TriLinearGhostFiller gf(d_fine, GhostFillingType::Faces);
+    Poisson::StarPatchOperator<3> p_operator(d_fine, gf, neumann.all());
+    Poisson::TridiagPatchSolver<3> p_solver(p_operator, neumann);
+    Poisson::DFTPatchSolver<3> expected_solver(p_operator, neumann);
+
+    p_solver.smooth(f_vec, g_vec);
+    expected_solver.smooth(f_vec, g_vec_expected);
+
+    Vector<3> diff(d_fine, 1);
+    diff.addScaled(1.0, g_vec, -1.0, g_vec_expected);
+    CHECK_GT(g_vec_expected.twoNorm(), 0);
+    CHECK_LE(diff.twoNorm(), 1e-10 * g_vec_expected.twoNorm());
+  }
+}
+TEST_CASE("Test Poisson::TridiagPatchSolver inverts the operator on a single patch")
+{
+  for (bool all_neumann : { false, true }) {
+    DomainReader<3> domain_reader("mesh_inputs/3d_uniform_2x2x2_mpi1.json", { 6, 8, 4 }, 1);
+    Domain<3> d_coarse = domain_reader.getCoarserDomain();
+    const PatchInfo<3>& pinfo = d_coarse.getPatchInfoVector()[0];
+
+    Vector<3> u_vec(d_coarse, 1);
+    DomainTools::SetValues<3>(d_coarse, u_vec, [](const std::array<double, 3>& coord) {
+      return sin(3 * coord[0]) * cos(coord[1]) + coord[2] * coord[2];
+    });
+
+    TriLinearGhostFiller gf(d_coarse, GhostFillingType::Faces);
+    Poisson::StarPatchOperator<3> p_operator(d_coarse, gf, all_neumann);
+    Poisson::TridiagPatchSolver<3> p_solver(p_operator,
+                                            all_neumann ? bitset<6>(0x3F) : bitset<6>());
+
+    Vector<3> f_vec(d_coarse, 1);
+    p_operator.applySinglePatch(pinfo, u_vec.getPatchView(0), f_vec.getPatchView(0));
+    Vector<3> g_vec(d_coarse, 1);
+    p_solver.solveSinglePatch(pinfo, f_vec.getPatchView(0), g_vec.getPatchView(0));
+
+    // the pure neumann solution is only defined up to a constant
+    PatchView<double, 3> g_view = g_vec.getPatchView(0);
+    PatchView<const double, 3> u_view = u_vec.getPatchView(0);
+    double shift = all_neumann ? u_view[u_view.getStart()] - g_view[g_view.getStart()] : 0;
+    Loop::OverInteriorIndexes<4>(g_view, [&](const std::array<int, 4>& coord) {
+      CHECK_EQ(g_view[coord] + shift, doctest::Approx(u_view[coord]));
+    });
+  }
+}
+TEST_CASE("Test Poisson::TridiagPatchSolver clone gives the same result")
+{
+  DomainReader<2> domain_reader("mesh_inputs/2d_uniform_2x2_mpi1.json", { 10, 10 }, 1);
+  Domain<2> d_fine = domain_reader.getFinerDomain();
+
+  Vector<2> f_vec(d_fine, 1);
+  DomainTools::SetValues<2>(d_fine, f_vec, [](const std::array<double, 2>& coord) {
+    return sin(M_PI * coord[0]) * coord[1];
+  });
+
+  BiLinearGhostFiller gf(d_fine, GhostFillingType::Faces);
+  Poisson::StarPatchOperator<2> p_operator(d_fine, gf);
+  Poisson::TridiagPatchSolver<2> p_solver(p_operator, bitset<4>());
+  unique_ptr<Poisson::TridiagPatchSolver<2>> clone(p_solver.clone());
+
+  Vector<2> g_vec(d_fine, 1);
+  clone->apply(f_vec, g_vec);
+  Vector<2> g_vec_expected(d_fine, 1);
+  p_solver.apply(f_vec, g_vec_expected);
+
+  Vector<2> diff(d_fine, 1);
+  diff.addScaled(1.0, g_vec, -1.0, g_vec_expected);
+  CHECK_GT(g_vec.twoNorm(), 0);
+  CHECK_EQ(diff.twoNorm(), 0);
+}
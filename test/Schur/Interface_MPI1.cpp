@@ -158,7 +158,8 @@ TEST_CASE("Schur::Interface enumerateIfacesFromPiinfoVector")
 
   map<int, map<int, std::shared_ptr<Schur::Interface<2>>>> ifaces;
   vector<std::shared_ptr<Schur::PatchIfaceInfo<2>>> off_proc_piinfos;
-  Schur::Interface<2>::EnumerateIfacesFromPiinfoVector(piinfos, ifaces, off_proc_piinfos);
+  Schur::Interface<2>::EnumerateIfacesFromPiinfoVector(
+    domain.getCommunicator(), piinfos, ifaces, off_proc_piinfos);
   CHECK_EQ(ifaces.size(), 1);
   CHECK_EQ(ifaces[0].size(), 7);
   CHECK_EQ(off_proc_piinfos.size(), 0);
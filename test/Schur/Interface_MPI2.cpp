@@ -39,7 +39,8 @@ TEST_CASE("Schur::Interface enumerateIfacesFromPiinfoVector refined interface on
 
   map<int, map<int, std::shared_ptr<Schur::Interface<2>>>> ifaces;
   vector<std::shared_ptr<Schur::PatchIfaceInfo<2>>> off_proc_piinfos;
-  Schur::Interface<2>::EnumerateIfacesFromPiinfoVector(piinfos, ifaces, off_proc_piinfos);
+  Schur::Interface<2>::EnumerateIfacesFromPiinfoVector(
+    domain.getCommunicator(), piinfos, ifaces, off_proc_piinfos);
 
   CHECK_EQ(ifaces.size(), 2);
 
@@ -304,7 +305,8 @@ TEST_CASE("Schur::Interface enumerateIfacesFromPiinfoVector normal interface on
 
   map<int, map<int, std::shared_ptr<Schur::Interface<2>>>> ifaces;
   vector<std::shared_ptr<Schur::PatchIfaceInfo<2>>> off_proc_piinfos;
-  Schur::Interface<2>::EnumerateIfacesFromPiinfoVector(piinfos, ifaces, off_proc_piinfos);
+  Schur::Interface<2>::EnumerateIfacesFromPiinfoVector(
+    domain.getCommunicator(), piinfos, ifaces, off_proc_piinfos);
 
   int rank;
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
@@ -368,7 +370,8 @@ TEST_CASE("Schur::Interface enumerateIfacesFromPiinfoVector complicated mesh")
 
   map<int, map<int, std::shared_ptr<Schur::Interface<2>>>> ifaces;
   vector<std::shared_ptr<Schur::PatchIfaceInfo<2>>> off_proc_piinfos;
-  Schur::Interface<2>::EnumerateIfacesFromPiinfoVector(piinfos, ifaces, off_proc_piinfos);
+  Schur::Interface<2>::EnumerateIfacesFromPiinfoVector(
+    domain.getCommunicator(), piinfos, ifaces, off_proc_piinfos);
 
   int rank;
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
@@ -403,3 +406,34 @@ TEST_CASE("Schur::Interface enumerateIfacesFromPiinfoVector complicated mesh")
     CHECK_EQ(off_proc_patch_ids.count(10), 1);
   }
 }
+TEST_CASE("Schur::Interface enumerateIfacesFromPiinfoVector back to back calls give the same interfaces")
+{
+  DomainReader<2> domain_reader("mesh_inputs/2d_refined_complicated_mpi2.json", { 10, 10 }, 0);
+  auto domain = domain_reader.getFinerDomain();
+  vector<shared_ptr<const Schur::PatchIfaceInfo<2>>> piinfos;
+  for (auto& patch : domain.getPatchInfoVector()) {
+    piinfos.push_back(make_shared<Schur::PatchIfaceInfo<2>>(patch));
+  }
+
+  map<int, map<int, std::shared_ptr<Schur::Interface<2>>>> ifaces_a;
+  vector<std::shared_ptr<Schur::PatchIfaceInfo<2>>> off_proc_piinfos_a;
+  Schur::Interface<2>::EnumerateIfacesFromPiinfoVector(
+    domain.getCommunicator(), piinfos, ifaces_a, off_proc_piinfos_a);
+  map<int, map<int, std::shared_ptr<Schur::Interface<2>>>> ifaces_b;
+  vector<std::shared_ptr<Schur::PatchIfaceInfo<2>>> off_proc_piinfos_b;
+  Schur::Interface<2>::EnumerateIfacesFromPiinfoVector(
+    domain.getCommunicator(), piinfos, ifaces_b, off_proc_piinfos_b);
+
+  REQUIRE_EQ(ifaces_a.size(), ifaces_b.size());
+  for (auto& pair : ifaces_a) {
+    auto& id_iface_map_b = ifaces_b.at(pair.first);
+    REQUIRE_EQ(pair.second.size(), id_iface_map_b.size());
+    for (auto& id_iface : pair.second) {
+      CHECK_EQ(id_iface.second->patches.size(), id_iface_map_b.at(id_iface.first)->patches.size());
+    }
+  }
+  REQUIRE_EQ(off_proc_piinfos_a.size(), off_proc_piinfos_b.size());
+  for (size_t i = 0; i < off_proc_piinfos_a.size(); i++) {
+    CHECK_EQ(off_proc_piinfos_a[i]->pinfo.id, off_proc_piinfos_b[i]->pinfo.id);
+  }
+}
@@ -305,3 +305,30 @@ TEST_CASE("Schur::PatchIfaceScatter<2> scatter with local vector already filled"
     }
   }
 }
+TEST_CASE("Schur::PatchIfaceScatter<2> scatterStart throws exception when a scatter is in progress")
+{
+  for (auto mesh_file : { MESHES }) {
+    for (auto n : { 5, 10 }) {
+
+      DomainReader<2> domain_reader(mesh_file, { n, n }, 0);
+      auto domain = domain_reader.getFinerDomain();
+      Schur::InterfaceDomain<2> iface_domain(domain);
+
+      Schur::PatchIfaceScatter<2> scatter(iface_domain);
+
+      Vector<1> global_vector = iface_domain.getNewVector();
+      auto local_vector = scatter.getNewLocalPatchIfaceVector();
+
+      auto state = scatter.scatterStart(global_vector, *local_vector);
+      CHECK_THROWS_AS(scatter.scatterStart(global_vector, *local_vector), RuntimeError);
+
+      // a copy has its own buffers
+      Schur::PatchIfaceScatter<2> copy(scatter);
+      auto copy_local_vector = copy.getNewLocalPatchIfaceVector();
+      auto copy_state = copy.scatterStart(global_vector, *copy_local_vector);
+      copy.scatterFinish(copy_state, global_vector, *copy_local_vector);
+
+      scatter.scatterFinish(state, global_vector, *local_vector);
+    }
+  }
+}
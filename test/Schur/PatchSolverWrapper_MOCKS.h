@@ -20,7 +20,9 @@
 
 #include <ThunderEgg/GhostFiller.h>
 #include <ThunderEgg/PatchSolver.h>
+#include <mutex>
 #include <set>
+#include <thread>
 
 #include <doctest.h>
 
@@ -107,5 +109,47 @@ public:
   }
   bool wasCalled() { return *was_called; }
 };
+template<int D>
+class ThrowingPatchSolver : public PatchSolver<D>
+{
+public:
+  ThrowingPatchSolver(const Domain<D>& domain_in, const GhostFiller<D>& ghost_filler_in)
+    : PatchSolver<D>(domain_in, ghost_filler_in)
+  {
+  }
+  ThrowingPatchSolver<D>* clone() const override { return new ThrowingPatchSolver<D>(*this); }
+  void solveSinglePatch(const PatchInfo<D>& pinfo, const PatchView<const double, D>& f_view, const PatchView<double, D>& u_view) const override
+  {
+    throw RuntimeError("patch " + std::to_string(pinfo.id) + " failed");
+  }
+  bool isThreadSafe() const override { return true; }
+};
+template<int D>
+class ThreadRecordingPatchSolver : public PatchSolver<D>
+{
+private:
+  bool thread_safe;
+  std::shared_ptr<std::mutex> mutex = std::make_shared<std::mutex>();
+  std::shared_ptr<std::set<std::thread::id>> thread_ids = std::make_shared<std::set<std::thread::id>>();
+
+public:
+  ThreadRecordingPatchSolver(const Domain<D>& domain_in, const GhostFiller<D>& ghost_filler_in, bool thread_safe)
+    : PatchSolver<D>(domain_in, ghost_filler_in)
+    , thread_safe(thread_safe)
+  {
+  }
+  ThreadRecordingPatchSolver<D>* clone() const override { return new ThreadRecordingPatchSolver<D>(*this); }
+  void solveSinglePatch(const PatchInfo<D>& pinfo, const PatchView<const double, D>& f_view, const PatchView<double, D>& u_view) const override
+  {
+    std::lock_guard<std::mutex> lock(*mutex);
+    thread_ids->insert(std::this_thread::get_id());
+  }
+  bool isThreadSafe() const override { return thread_safe; }
+  size_t getNumThreadsUsed() const { return thread_ids->size(); }
+  bool onlyCalledFromThisThread() const
+  {
+    return thread_ids->size() == 1 && thread_ids->count(std::this_thread::get_id()) == 1;
+  }
+};
 } // namespace
 } // namespace ThunderEgg
\ No newline at end of file
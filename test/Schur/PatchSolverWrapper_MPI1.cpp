@@ -20,6 +20,11 @@
 
 #include "../utils/DomainReader.h"
 #include "PatchSolverWrapper_MOCKS.h"
+#include <ThunderEgg/BiLinearGhostFiller.h>
+#include <ThunderEgg/DomainTools.h>
+#include <ThunderEgg/Iterative/CG.h>
+#include <ThunderEgg/Iterative/PatchSolver.h>
+#include <ThunderEgg/Poisson/StarPatchOperator.h>
 #include <ThunderEgg/Schur/PatchSolverWrapper.h>
 
 #include <limits>
@@ -208,3 +213,83 @@ TEST_CASE("Schur::PatchSolverWrapper<2> getSchurRHSFromDomainRHS gives expected
     }
   }
 }
+TEST_CASE("Schur::PatchSolverWrapper<2> apply with threads matches apply with one thread")
+{
+  for (auto mesh_file : { MESHES, "mesh_inputs/2d_uniform_4x4_mpi1.json" }) {
+    for (int num_threads : { 2, 4 }) {
+      DomainReader<2> domain_reader(mesh_file, { 6, 6 }, 1);
+      auto domain = domain_reader.getFinerDomain();
+      Schur::InterfaceDomain<2> iface_domain(domain);
+      BiLinearGhostFiller ghost_filler(domain, GhostFillingType::Faces);
+      Poisson::StarPatchOperator<2> op(domain, ghost_filler);
+      Iterative::CG<2> cg;
+      cg.setTolerance(1e-12);
+      Iterative::PatchSolver<2> solver(cg, op);
+
+      Vector<1> x = iface_domain.getNewVector();
+      for (int i = 0; i < x.getNumLocalPatches(); i++) {
+        auto local_data = x.getComponentView(0, i);
+        Loop::Nested<1>(local_data.getStart(), local_data.getEnd(), [&](const std::array<int, 1>& coord) { local_data[coord] = sin(i + coord[0]); });
+      }
+      Vector<2> domain_b(domain, 1);
+      DomainTools::SetValues<2>(domain, domain_b, [](const std::array<double, 2>& coord) { return coord[0] + coord[1]; });
+
+      Schur::PatchSolverWrapper<2> serial(iface_domain, solver);
+      Schur::PatchSolverWrapper<2> threaded(iface_domain, solver);
+      threaded.setNumThreads(num_threads);
+      CHECK_EQ(threaded.getNumThreads(), num_threads);
+
+      Vector<1> b_expected = iface_domain.getNewVector();
+      Vector<1> b = iface_domain.getNewVector();
+      serial.apply(x, b_expected);
+      // apply twice to check that the workspaces are reset
+      threaded.apply(x, b);
+      threaded.apply(x, b);
+      Vector<1> diff = iface_domain.getNewVector();
+      diff.addScaled(1.0, b, -1.0, b_expected);
+      CHECK_GT(b_expected.twoNorm(), 0);
+      CHECK_LE(diff.twoNorm(), 1e-12 * b_expected.twoNorm());
+
+      serial.getSchurRHSFromDomainRHS(domain_b, b_expected);
+      threaded.getSchurRHSFromDomainRHS(domain_b, b);
+      diff.addScaled(1.0, b, -1.0, b_expected);
+      CHECK_GT(b_expected.twoNorm(), 0);
+      CHECK_LE(diff.twoNorm(), 1e-12 * b_expected.twoNorm());
+    }
+  }
+}
+TEST_CASE("Schur::PatchSolverWrapper<2> apply with threads propagates exceptions")
+{
+  for (auto mesh_file : { MESHES }) {
+    DomainReader<2> domain_reader(mesh_file, { 6, 6 }, 1);
+    auto domain = domain_reader.getFinerDomain();
+    Schur::InterfaceDomain<2> iface_domain(domain);
+    MockGhostFiller<2> ghost_filler;
+    ThrowingPatchSolver<2> solver(domain, ghost_filler);
+
+    Vector<1> x = iface_domain.getNewVector();
+    Vector<1> b = iface_domain.getNewVector();
+
+    Schur::PatchSolverWrapper<2> psw(iface_domain, solver);
+    CHECK_THROWS_AS(psw.setNumThreads(0), RuntimeError);
+    psw.setNumThreads(3);
+    CHECK_THROWS_AS(psw.apply(x, b), RuntimeError);
+  }
+}
+TEST_CASE("Schur::PatchSolverWrapper<2> solves on one thread if the PatchSolver is not thread safe")
+{
+  DomainReader<2> domain_reader("mesh_inputs/2d_uniform_4x4_mpi1.json", { 6, 6 }, 1);
+  auto domain = domain_reader.getFinerDomain();
+  Schur::InterfaceDomain<2> iface_domain(domain);
+  MockGhostFiller<2> ghost_filler;
+  ThreadRecordingPatchSolver<2> solver(domain, ghost_filler, false);
+
+  Vector<1> x = iface_domain.getNewVector();
+  Vector<1> b = iface_domain.getNewVector();
+
+  Schur::PatchSolverWrapper<2> psw(iface_domain, solver);
+  psw.setNumThreads(4);
+  psw.apply(x, b);
+  // the wrapper holds a clone, which shares the recorded thread ids
+  CHECK_UNARY(solver.onlyCalledFromThisThread());
+}
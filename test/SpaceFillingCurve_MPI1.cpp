@@ -0,0 +1,157 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#include <ThunderEgg/SpaceFillingCurve.h>
+
+#include "utils/DomainReader.h"
+
+#include <doctest.h>
+
+#include <cstdlib>
+
+using namespace std;
+using namespace ThunderEgg;
+
+namespace {
+/**
+ * @brief get the points of a grid with 2^level points along each axis, sorted by index
+ */
+template<int D, class IndexFunction>
+vector<array<uint32_t, D>>
+GetSortedPoints(int level, IndexFunction index_function)
+{
+  vector<pair<uint64_t, array<uint32_t, D>>> indexes_and_points;
+  uint32_t n = 1u << level;
+  size_t num_points = 1;
+  for (int axis = 0; axis < D; axis++) {
+    num_points *= n;
+  }
+  for (size_t i = 0; i < num_points; i++) {
+    array<uint32_t, D> point;
+    size_t rest = i;
+    for (int axis = 0; axis < D; axis++) {
+      point[axis] = rest % n;
+      rest /= n;
+    }
+    indexes_and_points.emplace_back(index_function(point), point);
+  }
+  sort(indexes_and_points.begin(), indexes_and_points.end());
+  vector<array<uint32_t, D>> points;
+  for (size_t i = 0; i < indexes_and_points.size(); i++) {
+    // the curves fill the grid at the origin before leaving it
+    CHECK_EQ(indexes_and_points[i].first, i);
+    points.push_back(indexes_and_points[i].second);
+  }
+  return points;
+}
+} // namespace
+TEST_CASE("SpaceFillingCurve<2> getMortonIndex")
+{
+  CHECK_EQ(SpaceFillingCurve<2>::getMortonIndex({ 0, 0 }), 0);
+  CHECK_EQ(SpaceFillingCurve<2>::getMortonIndex({ 1, 0 }), 1);
+  CHECK_EQ(SpaceFillingCurve<2>::getMortonIndex({ 0, 1 }), 2);
+  CHECK_EQ(SpaceFillingCurve<2>::getMortonIndex({ 1, 1 }), 3);
+  CHECK_EQ(SpaceFillingCurve<2>::getMortonIndex({ 2, 0 }), 4);
+  CHECK_EQ(SpaceFillingCurve<2>::getMortonIndex({ 3, 3 }), 15);
+}
+TEST_CASE("SpaceFillingCurve<3> getMortonIndex")
+{
+  CHECK_EQ(SpaceFillingCurve<3>::getMortonIndex({ 1, 0, 0 }), 1);
+  CHECK_EQ(SpaceFillingCurve<3>::getMortonIndex({ 0, 1, 0 }), 2);
+  CHECK_EQ(SpaceFillingCurve<3>::getMortonIndex({ 0, 0, 1 }), 4);
+  CHECK_EQ(SpaceFillingCurve<3>::getMortonIndex({ 2, 0, 0 }), 8);
+}
+TEST_CASE("SpaceFillingCurve<2> getHilbertIndex visits neighboring points")
+{
+  vector<array<uint32_t, 2>> points =
+    GetSortedPoints<2>(4, [](auto point) { return SpaceFillingCurve<2>::getHilbertIndex(point); });
+  for (size_t i = 1; i < points.size(); i++) {
+    int distance = 0;
+    for (int axis = 0; axis < 2; axis++) {
+      distance += abs((int)points[i][axis] - (int)points[i - 1][axis]);
+    }
+    CHECK_EQ(distance, 1);
+  }
+}
+TEST_CASE("SpaceFillingCurve<3> getHilbertIndex visits neighboring points")
+{
+  vector<array<uint32_t, 3>> points =
+    GetSortedPoints<3>(3, [](auto point) { return SpaceFillingCurve<3>::getHilbertIndex(point); });
+  for (size_t i = 1; i < points.size(); i++) {
+    int distance = 0;
+    for (int axis = 0; axis < 3; axis++) {
+      distance += abs((int)points[i][axis] - (int)points[i - 1][axis]);
+    }
+    CHECK_EQ(distance, 1);
+  }
+}
+TEST_CASE("SpaceFillingCurve<2> getMortonIndex fills quadrants in order")
+{
+  vector<array<uint32_t, 2>> points =
+    GetSortedPoints<2>(3, [](auto point) { return SpaceFillingCurve<2>::getMortonIndex(point); });
+  for (size_t i = 0; i < points.size(); i++) {
+    // each quarter of the curve is a quadrant of the grid
+    uint32_t quadrant = (points[i][0] / 4) + 2 * (points[i][1] / 4);
+    CHECK_EQ(quadrant, i / 16);
+  }
+}
+TEST_CASE("SpaceFillingCurve<2> sortPatches")
+{
+  for (auto ordering : { PatchOrdering::Given, PatchOrdering::Morton, PatchOrdering::Hilbert }) {
+    DomainReader<2> domain_reader("mesh_inputs/2d_uniform_8x8_refined_cross_mpi1.json", { 4, 4 }, 0);
+    Domain<2> domain = domain_reader.getFinerDomain();
+    vector<PatchInfo<2>> pinfos = domain.getPatchInfoVector();
+
+    SpaceFillingCurve<2>::sortPatches(pinfos, ordering, domain.getCommunicator());
+
+    REQUIRE_EQ(pinfos.size(), domain.getPatchInfoVector().size());
+    if (ordering == PatchOrdering::Given) {
+      for (size_t i = 0; i < pinfos.size(); i++) {
+        CHECK_EQ(pinfos[i].id, domain.getPatchInfoVector()[i].id);
+      }
+    } else {
+      // every patch is still there
+      vector<int> ids;
+      for (const PatchInfo<2>& pinfo : pinfos) {
+        ids.push_back(pinfo.id);
+      }
+      sort(ids.begin(), ids.end());
+      CHECK(unique(ids.begin(), ids.end()) == ids.end());
+      CHECK_EQ(ids.size(), domain.getPatchInfoVector().size());
+    }
+  }
+}
+TEST_CASE("SpaceFillingCurve<2> sortPatches Morton is quadtree order")
+{
+  DomainReader<2> domain_reader("mesh_inputs/2d_uniform_2x2_refined_nw_mpi1.json", { 4, 4 }, 0);
+  Domain<2> domain = domain_reader.getFinerDomain();
+  vector<PatchInfo<2>> pinfos = domain.getPatchInfoVector();
+
+  SpaceFillingCurve<2>::sortPatches(pinfos, PatchOrdering::Morton, domain.getCommunicator());
+
+  // lower corners in z order, the refined north west quadrant is in the third position
+  vector<array<double, 2>> expected_starts = { { 0.0, 0.0 },   { 0.5, 0.0 },   { 0.0, 0.5 },
+                                               { 0.25, 0.5 },  { 0.0, 0.75 },  { 0.25, 0.75 },
+                                               { 0.5, 0.5 } };
+  REQUIRE_EQ(pinfos.size(), expected_starts.size());
+  for (size_t i = 0; i < pinfos.size(); i++) {
+    CHECK_EQ(pinfos[i].starts[0], doctest::Approx(expected_starts[i][0]));
+    CHECK_EQ(pinfos[i].starts[1], doctest::Approx(expected_starts[i][1]));
+  }
+}
@@ -0,0 +1,263 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include <ThunderEgg/SparseMatrix.h>
+
+#include <doctest.h>
+#include <functional>
+
+using namespace std;
+using namespace ThunderEgg;
+
+namespace {
+/**
+ * @brief Set the values of a vector in the order of the rows of a SparseMatrix
+ */
+template<int D>
+void
+SetInRowOrder(Vector<D>& vec, int first_row, const function<double(int)>& f)
+{
+  int row = first_row;
+  for (int i = 0; i < vec.getNumLocalPatches(); i++) {
+    for (int c = 0; c < vec.getNumComponents(); c++) {
+      ComponentView<double, D> view = vec.getComponentView(c, i);
+      Loop::Nested<D>(view.getStart(), view.getEnd(), [&](const array<int, D>& coord) {
+        view[coord] = f(row);
+        row++;
+      });
+    }
+  }
+}
+/**
+ * @brief Check the values of a vector in the order of the rows of a SparseMatrix
+ */
+template<int D>
+void
+CheckInRowOrder(const Vector<D>& vec, int first_row, const function<double(int)>& f)
+{
+  int row = first_row;
+  for (int i = 0; i < vec.getNumLocalPatches(); i++) {
+    for (int c = 0; c < vec.getNumComponents(); c++) {
+      ComponentView<const double, D> view = vec.getComponentView(c, i);
+      Loop::Nested<D>(view.getStart(), view.getEnd(), [&](const array<int, D>& coord) {
+        CHECK_EQ(view[coord], doctest::Approx(f(row)));
+        row++;
+      });
+    }
+  }
+}
+double
+Coeff(int i, int j)
+{
+  return 1.0 + 0.25 * i - 0.5 * j;
+}
+double
+XValue(int j)
+{
+  return sin(0.3 * j + 0.1);
+}
+} // namespace
+TEST_CASE("SparseMatrix<2> gives the same result as the dense matrix")
+{
+  Communicator comm(MPI_COMM_WORLD);
+  array<int, 2> ns = { 4, 6 };
+  int num_local_patches = 3;
+  for (int num_components : { 1, 2 }) {
+    for (int num_ghost_cells : { 0, 1 }) {
+      for (int block_size : { 1, 2, 4 }) {
+        INFO("num_components: " << num_components);
+        INFO("num_ghost_cells: " << num_ghost_cells);
+        INFO("block_size: " << block_size);
+        SparseMatrix<2> A(comm, ns, num_components, num_local_patches, num_ghost_cells, block_size);
+        int n = A.getNumGlobalRows();
+        CHECK_EQ(n, 4 * 6 * num_components * num_local_patches);
+        CHECK_EQ(A.getNumLocalRows(), n);
+        CHECK_EQ(A.getFirstRow(), 0);
+
+        // a banded matrix with an extra coupling to the far end
+        auto inBand = [&](int i, int j) { return abs(i - j) <= 2 || j == n - 1 - i; };
+        for (int i = 0; i < n; i++) {
+          for (int j = 0; j < n; j++) {
+            if (inBand(i, j)) {
+              double value = Coeff(i, j);
+              A.addValues(i, 1, &j, &value);
+            }
+          }
+        }
+        A.assemble();
+        CHECK(A.isAssembled());
+        CHECK_EQ(A.getNumHaloValues(), 0);
+
+        Vector<2> x(comm, ns, num_components, num_local_patches, num_ghost_cells);
+        Vector<2> b(comm, ns, num_components, num_local_patches, num_ghost_cells);
+        SetInRowOrder<2>(x, 0, XValue);
+        b.set(100);
+
+        A.apply(x, b);
+
+        CheckInRowOrder<2>(b, 0, [&](int i) {
+          double sum = 0;
+          for (int j = 0; j < n; j++) {
+            if (inBand(i, j)) {
+              sum += Coeff(i, j) * XValue(j);
+            }
+          }
+          return sum;
+        });
+      }
+    }
+  }
+}
+TEST_CASE("SparseMatrix<1> addBlock gives the same result as addValues")
+{
+  Communicator comm(MPI_COMM_WORLD);
+  int bs = 5;
+  int num_local_patches = 4;
+  SparseMatrix<1> A_blocks(comm, { bs }, 1, num_local_patches, 0, bs);
+  SparseMatrix<1> A_values(comm, { bs }, 1, num_local_patches, 0, bs);
+
+  vector<double> block(bs * bs);
+  for (int bi = 0; bi < num_local_patches; bi++) {
+    for (int bj : { bi, (bi + 1) % num_local_patches }) {
+      for (int r = 0; r < bs; r++) {
+        for (int c = 0; c < bs; c++) {
+          block[r * bs + c] = Coeff(bi * bs + r, bj * bs + c);
+        }
+      }
+      A_blocks.addBlock(bi, bj, block.data());
+      // add it twice to check that values are summed
+      A_blocks.addBlock(bi, bj, block.data());
+      for (int r = 0; r < bs; r++) {
+        int row = bi * bs + r;
+        for (int c = 0; c < bs; c++) {
+          int col = bj * bs + c;
+          double value = 2 * Coeff(row, col);
+          A_values.addValues(row, 1, &col, &value);
+        }
+      }
+    }
+  }
+  A_blocks.assemble();
+  A_values.assemble();
+  CHECK_EQ(A_blocks.getNumLocalNonzeros(), 2 * num_local_patches * bs * bs);
+  CHECK_EQ(A_values.getNumLocalNonzeros(), 2 * num_local_patches * bs * bs);
+
+  Vector<1> x(comm, { bs }, 1, num_local_patches, 0);
+  SetInRowOrder<1>(x, 0, XValue);
+  Vector<1> b_blocks(comm, { bs }, 1, num_local_patches, 0);
+  Vector<1> b_values(comm, { bs }, 1, num_local_patches, 0);
+  A_blocks.apply(x, b_blocks);
+  A_values.apply(x, b_values);
+
+  CheckInRowOrder<1>(b_blocks, 0, [&](int i) {
+    int bi = i / bs;
+    double sum = 0;
+    for (int bj : { bi, (bi + 1) % num_local_patches }) {
+      for (int j = bj * bs; j < bj * bs + bs; j++) {
+        sum += 2 * Coeff(i, j) * XValue(j);
+      }
+    }
+    return sum;
+  });
+  for (int i = 0; i < num_local_patches; i++) {
+    ComponentView<const double, 1> blocks_view = b_blocks.getComponentView(0, i);
+    ComponentView<const double, 1> values_view = b_values.getComponentView(0, i);
+    for (int xi = 0; xi < bs; xi++) {
+      CHECK_EQ(values_view(xi), doctest::Approx(blocks_view(xi)));
+    }
+  }
+}
+TEST_CASE("SparseMatrix<3> clone gives the same result")
+{
+  Communicator comm(MPI_COMM_WORLD);
+  array<int, 3> ns = { 2, 3, 2 };
+  SparseMatrix<3> A(comm, ns, 1, 2, 1);
+  int n = A.getNumGlobalRows();
+  for (int i = 0; i < n; i++) {
+    int cols[2] = { i, (i + 3) % n };
+    double values[2] = { Coeff(i, cols[0]), Coeff(i, cols[1]) };
+    A.addValues(i, 2, cols, values);
+  }
+  A.assemble();
+  unique_ptr<SparseMatrix<3>> A_clone(A.clone());
+
+  Vector<3> x(comm, ns, 1, 2, 1);
+  SetInRowOrder<3>(x, 0, XValue);
+  Vector<3> b(comm, ns, 1, 2, 1);
+  Vector<3> b_clone(comm, ns, 1, 2, 1);
+  A.apply(x, b);
+  A_clone->apply(x, b_clone);
+  CheckInRowOrder<3>(b_clone, 0, [&](int i) {
+    return Coeff(i, i) * XValue(i) + Coeff(i, (i + 3) % n) * XValue((i + 3) % n);
+  });
+  CheckInRowOrder<3>(b, 0, [&](int i) {
+    return Coeff(i, i) * XValue(i) + Coeff(i, (i + 3) % n) * XValue((i + 3) % n);
+  });
+}
+TEST_CASE("SparseMatrix throws with block size that does not fit the patches")
+{
+  Communicator comm(MPI_COMM_WORLD);
+  CHECK_THROWS_AS(SparseMatrix<2>(comm, { 4, 4 }, 1, 1, 0, 3), RuntimeError);
+  CHECK_THROWS_AS(SparseMatrix<2>(comm, { 4, 4 }, 1, 1, 1, 8), RuntimeError);
+  CHECK_THROWS_AS(SparseMatrix<2>(comm, { 4, 4 }, 1, 1, 0, 0), RuntimeError);
+  CHECK_NOTHROW(SparseMatrix<2>(comm, { 4, 4 }, 1, 1, 0, 8));
+}
+TEST_CASE("SparseMatrix throws with rows or columns out of range")
+{
+  Communicator comm(MPI_COMM_WORLD);
+  SparseMatrix<2> A(comm, { 4, 4 }, 1, 1, 0);
+  double value = 1;
+  int col = 0;
+  CHECK_THROWS_AS(A.addValues(16, 1, &col, &value), RuntimeError);
+  CHECK_THROWS_AS(A.addValues(-1, 1, &col, &value), RuntimeError);
+  col = 16;
+  CHECK_THROWS_AS(A.addValues(0, 1, &col, &value), RuntimeError);
+  col = -1;
+  CHECK_THROWS_AS(A.addValues(0, 1, &col, &value), RuntimeError);
+}
+TEST_CASE("SparseMatrix throws when used in the wrong order")
+{
+  Communicator comm(MPI_COMM_WORLD);
+  SparseMatrix<2> A(comm, { 4, 4 }, 1, 1, 0);
+  Vector<2> x(comm, { 4, 4 }, 1, 1, 0);
+  Vector<2> b(comm, { 4, 4 }, 1, 1, 0);
+  CHECK_THROWS_AS(A.apply(x, b), RuntimeError);
+  CHECK_THROWS_AS(A.getNumLocalNonzeros(), RuntimeError);
+  A.assemble();
+  double value = 1;
+  int col = 0;
+  CHECK_THROWS_AS(A.addValues(0, 1, &col, &value), RuntimeError);
+  CHECK_THROWS_AS(A.assemble(), RuntimeError);
+}
+TEST_CASE("SparseMatrix throws with vectors of a different layout")
+{
+  Communicator comm(MPI_COMM_WORLD);
+  SparseMatrix<2> A(comm, { 4, 4 }, 1, 2, 1);
+  A.assemble();
+  Vector<2> x(comm, { 4, 4 }, 1, 2, 1);
+  Vector<2> b(comm, { 4, 4 }, 1, 2, 1);
+  CHECK_NOTHROW(A.apply(x, b));
+  Vector<2> no_ghost(comm, { 4, 4 }, 1, 2, 0);
+  CHECK_THROWS_AS(A.apply(no_ghost, b), RuntimeError);
+  Vector<2> two_components(comm, { 4, 4 }, 2, 2, 1);
+  CHECK_THROWS_AS(A.apply(x, two_components), RuntimeError);
+  Vector<2> one_patch(comm, { 4, 4 }, 1, 1, 1);
+  CHECK_THROWS_AS(A.apply(one_patch, b), RuntimeError);
+}
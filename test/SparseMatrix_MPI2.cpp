@@ -0,0 +1,133 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include <ThunderEgg/SparseMatrix.h>
+
+#include <doctest.h>
+#include <set>
+
+using namespace std;
+using namespace ThunderEgg;
+
+namespace {
+double
+Coeff(int i, int j)
+{
+  return 1.0 + 0.25 * i - 0.5 * j;
+}
+double
+XValue(int j)
+{
+  return sin(0.3 * j + 0.1);
+}
+} // namespace
+TEST_CASE("SparseMatrix<2> exchanges off-rank values")
+{
+  Communicator comm(MPI_COMM_WORLD);
+  array<int, 2> ns = { 4, 4 };
+  for (int num_ghost_cells : { 0, 1 }) {
+    for (int block_size : { 1, 4 }) {
+      INFO("num_ghost_cells: " << num_ghost_cells);
+      INFO("block_size: " << block_size);
+      // the ranks have a different number of patches
+      int num_local_patches = comm.getRank() + 1;
+      SparseMatrix<2> A(comm, ns, 1, num_local_patches, num_ghost_cells, block_size);
+      int n = A.getNumGlobalRows();
+      CHECK_EQ(n, 16 * 3);
+      int first_row = A.getFirstRow();
+      CHECK_EQ(first_row, comm.getRank() * 16);
+
+      // each row couples to its neighbors and the mirrored row, which is usually on the other rank
+      auto cols = [&](int i) {
+        set<int> cols = { i, n - 1 - i };
+        if (i > 0) {
+          cols.insert(i - 1);
+        }
+        if (i < n - 1) {
+          cols.insert(i + 1);
+        }
+        return cols;
+      };
+      for (int i = first_row; i < first_row + A.getNumLocalRows(); i++) {
+        for (int j : cols(i)) {
+          double value = Coeff(i, j);
+          A.addValues(i, 1, &j, &value);
+        }
+      }
+      A.assemble();
+      CHECK_GT(A.getNumHaloValues(), 0);
+
+      Vector<2> x(comm, ns, 1, num_local_patches, num_ghost_cells);
+      Vector<2> b(comm, ns, 1, num_local_patches, num_ghost_cells);
+      int row = first_row;
+      for (int p = 0; p < num_local_patches; p++) {
+        ComponentView<double, 2> view = x.getComponentView(0, p);
+        Loop::Nested<2>(view.getStart(), view.getEnd(), [&](const array<int, 2>& coord) {
+          view[coord] = XValue(row);
+          row++;
+        });
+      }
+
+      A.apply(x, b);
+
+      row = first_row;
+      for (int p = 0; p < num_local_patches; p++) {
+        ComponentView<const double, 2> view = b.getComponentView(0, p);
+        Loop::Nested<2>(view.getStart(), view.getEnd(), [&](const array<int, 2>& coord) {
+          double expected = 0;
+          for (int j : cols(row)) {
+            expected += Coeff(row, j) * XValue(j);
+          }
+          CHECK_EQ(view[coord], doctest::Approx(expected));
+          row++;
+        });
+      }
+    }
+  }
+}
+TEST_CASE("SparseMatrix<2> with a rank that has no rows")
+{
+  Communicator comm(MPI_COMM_WORLD);
+  array<int, 2> ns = { 2, 2 };
+  int num_local_patches = comm.getRank() == 0 ? 0 : 2;
+  SparseMatrix<2> A(comm, ns, 1, num_local_patches, 0);
+  int n = A.getNumGlobalRows();
+  CHECK_EQ(n, 8);
+  for (int i = A.getFirstRow(); i < A.getFirstRow() + A.getNumLocalRows(); i++) {
+    int j = n - 1 - i;
+    double value = Coeff(i, j);
+    A.addValues(i, 1, &j, &value);
+  }
+  A.assemble();
+
+  Vector<2> x(comm, ns, 1, num_local_patches, 0);
+  Vector<2> b(comm, ns, 1, num_local_patches, 0);
+  x.set(1);
+  A.apply(x, b);
+  for (int p = 0; p < num_local_patches; p++) {
+    ComponentView<const double, 2> view = b.getComponentView(0, p);
+    for (int yi = 0; yi < 2; yi++) {
+      for (int xi = 0; xi < 2; xi++) {
+        int i = p * 4 + xi + 2 * yi;
+        CHECK_EQ(view(xi, yi), doctest::Approx(Coeff(i, n - 1 - i)));
+      }
+    }
+  }
+}
@@ -862,3 +862,83 @@ TEST_CASE("Timer saveToFile throws with nonexistant directory")
 
   CHECK_THROWS_AS(timer.saveToFile("surely/this/directory/does/not/exist/timer.json"), RuntimeError);
 }
+TEST_CASE("Timer getPatchTimes is empty without patch timings")
+{
+  Communicator comm(MPI_COMM_WORLD);
+  Timer timer(comm);
+  timer.addDomain(0, GetDomain(comm));
+  timer.startDomainTiming(0, "A");
+  timer.stopDomainTiming(0, "A");
+
+  CHECK_UNARY(timer.getPatchTimes(0).empty());
+}
+TEST_CASE("Timer getPatchTimes sums outermost patch timings of domain")
+{
+  Communicator comm(MPI_COMM_WORLD);
+  Timer timer(comm);
+  timer.addDomain(0, GetDomain(comm));
+  timer.addDomain(1, GetDomain(comm));
+  timer.startDomainTiming(0, "Smooth");
+  for (int i = 0; i < 2; i++) {
+    timer.startPatchTiming(0, 0, "A");
+    timer.startPatchTiming(0, 0, "B");
+    timer.stopPatchTiming(0, 0, "B");
+    timer.stopPatchTiming(0, 0, "A");
+    timer.startPatchTiming(1, 0, "A");
+    timer.stopPatchTiming(1, 0, "A");
+  }
+  timer.startPatchTiming(2, 1, "A");
+  timer.stopPatchTiming(2, 1, "A");
+  timer.stopDomainTiming(0, "Smooth");
+
+  map<int, double> times = timer.getPatchTimes(0);
+
+  const nlohmann::json j = timer;
+  map<int, double> expected_times;
+  for (const nlohmann::json& timing : j["timings"][0]["timings"]) {
+    if (timing["domain_id"] == 0) {
+      expected_times[timing["patch_id"].get<int>()] = timing["sum"].get<double>();
+    }
+  }
+
+  REQUIRE_EQ(times.size(), 2);
+  REQUIRE_EQ(expected_times.size(), 2);
+  CHECK_EQ(times[0], expected_times[0]);
+  CHECK_EQ(times[1], expected_times[1]);
+
+  map<int, double> times_1 = timer.getPatchTimes(1);
+  REQUIRE_EQ(times_1.size(), 1);
+  CHECK_GE(times_1[2], 0);
+}
+TEST_CASE("Timer getPatchIntInfoSums sums info in patch timings of domain")
+{
+  Communicator comm(MPI_COMM_WORLD);
+  Timer timer(comm);
+  timer.addDomain(0, GetDomain(comm));
+  timer.addDomain(1, GetDomain(comm));
+  timer.startDomainTiming(0, "Smooth");
+  timer.addIntInfo("Iterations", 100);
+  for (int i = 0; i < 2; i++) {
+    timer.startPatchTiming(0, 0, "A");
+    timer.addIntInfo("Iterations", 3);
+    timer.addIntInfo("Other", 7);
+    timer.stopPatchTiming(0, 0, "A");
+  }
+  timer.startPatchTiming(1, 0, "A");
+  timer.start("B");
+  timer.addIntInfo("Iterations", 5);
+  timer.stop("B");
+  timer.addDoubleInfo("Iterations", 1.5);
+  timer.stopPatchTiming(1, 0, "A");
+  timer.startPatchTiming(2, 1, "A");
+  timer.addIntInfo("Iterations", 11);
+  timer.stopPatchTiming(2, 1, "A");
+  timer.stopDomainTiming(0, "Smooth");
+
+  map<int, long int> sums = timer.getPatchIntInfoSums(0, "Iterations");
+
+  REQUIRE_EQ(sums.size(), 2);
+  CHECK_EQ(sums[0], 6);
+  CHECK_EQ(sums[1], 5);
+  CHECK_UNARY(timer.getPatchIntInfoSums(0, "Missing").empty());
+}
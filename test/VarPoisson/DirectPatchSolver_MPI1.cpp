@@ -0,0 +1,163 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2020-2021 Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#include "../utils/DomainReader.h"
+#include <ThunderEgg/BiLinearGhostFiller.h>
+#include <ThunderEgg/DomainTools.h>
+#include <ThunderEgg/Iterative/BiCGStab.h>
+#include <ThunderEgg/Iterative/PatchSolver.h>
+#include <ThunderEgg/Timer.h>
+#include <ThunderEgg/TriLinearGhostFiller.h>
+#include <ThunderEgg/VarPoisson/DirectPatchSolver.h>
+
+#include <doctest.h>
+#include <sstream>
+
+using namespace std;
+using namespace ThunderEgg;
+
+#define MESHES "mesh_inputs/2d_uniform_2x2_mpi1.json", "mesh_inputs/2d_uniform_8x8_refined_cross_mpi1.json"
+
+namespace {
+/**
+ * @brief Check that a smooth with the direct solver matches a smooth with a tightly converged
+ * iterative patch solver
+ */
+template<int D>
+void
+CheckMatchesIterative(const Domain<D>& domain,
+                      const VarPoisson::StarPatchOperator<D>& op,
+                      const VarPoisson::DirectPatchSolver<D>& solver)
+{
+  Vector<D> f(domain, 1);
+  DomainTools::SetValues<D>(domain, f, [](const std::array<double, D>& coord) {
+    return sin(3 * coord[0]) + coord[1] * coord[1];
+  });
+  Vector<D> u(domain, 1);
+  DomainTools::SetValuesWithGhost<D>(
+    domain, u, [](const std::array<double, D>& coord) { return coord[0] * coord[1]; });
+  Vector<D> u_expected = u;
+
+  Iterative::BiCGStab<D> bcgs;
+  bcgs.setTolerance(1e-13);
+  bcgs.setMaxIterations(10000);
+  Iterative::PatchSolver<D> expected_solver(bcgs, op);
+
+  solver.smooth(f, u);
+  expected_solver.smooth(f, u_expected);
+
+  Vector<D> diff(domain, 1);
+  diff.addScaled(1.0, u, -1.0, u_expected);
+  CHECK_GT(u_expected.twoNorm(), 0);
+  CHECK_LE(diff.twoNorm(), 1e-9 * u_expected.twoNorm());
+}
+} // namespace
+
+TEST_CASE("VarPoisson::DirectPatchSolver matches Iterative::PatchSolver")
+{
+  for (auto mesh_file : { MESHES }) {
+    for (auto nx : { 6, 7 }) {
+      for (auto ny : { 6, 9 }) {
+        DomainReader<2> domain_reader(mesh_file, { nx, ny }, 1);
+        Domain<2> domain = domain_reader.getFinerDomain();
+        Vector<2> coeffs(domain, 1);
+        DomainTools::SetValuesWithGhost<2>(domain, coeffs, [](const std::array<double, 2>& coord) {
+          return 1 + coord[0] * coord[1] + ((coord[0] > 0.5) ? 10 : 0);
+        });
+        BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+        VarPoisson::StarPatchOperator<2> op(coeffs, domain, gf);
+        VarPoisson::DirectPatchSolver<2> solver(op);
+
+        CHECK_EQ(solver.getNumLUFactorizations(), 0);
+        CheckMatchesIterative(domain, op, solver);
+      }
+    }
+  }
+}
+TEST_CASE("VarPoisson::DirectPatchSolver matches Iterative::PatchSolver in 3d")
+{
+  DomainReader<3> domain_reader("mesh_inputs/3d_mid_refine_4x4x4_mpi1.json", { 4, 6, 2 }, 1);
+  Domain<3> domain = domain_reader.getFinerDomain();
+  Vector<3> coeffs(domain, 1);
+  DomainTools::SetValuesWithGhost<3>(domain, coeffs, [](const std::array<double, 3>& coord) {
+    return 1 + coord[0] + coord[1] * coord[2];
+  });
+  TriLinearGhostFiller gf(domain, GhostFillingType::Faces);
+  VarPoisson::StarPatchOperator<3> op(coeffs, domain, gf);
+  VarPoisson::DirectPatchSolver<3> solver(op);
+
+  CheckMatchesIterative(domain, op, solver);
+}
+TEST_CASE("VarPoisson::DirectPatchSolver uses LU when the coefficients are negative")
+{
+  DomainReader<2> domain_reader("mesh_inputs/2d_uniform_2x2_mpi1.json", { 6, 6 }, 1);
+  Domain<2> domain = domain_reader.getFinerDomain();
+  Vector<2> coeffs(domain, 1);
+  DomainTools::SetValuesWithGhost<2>(
+    domain, coeffs, [](const std::array<double, 2>& coord) { return -1 - coord[0]; });
+  BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+  VarPoisson::StarPatchOperator<2> op(coeffs, domain, gf);
+  VarPoisson::DirectPatchSolver<2> solver(op);
+
+  CHECK_EQ(solver.getNumLUFactorizations(), domain.getNumLocalPatches());
+  CheckMatchesIterative(domain, op, solver);
+}
+TEST_CASE("VarPoisson::DirectPatchSolver refactor after the coefficients change")
+{
+  DomainReader<2> domain_reader("mesh_inputs/2d_uniform_8x8_refined_cross_mpi1.json", { 6, 6 }, 1);
+  Domain<2> domain = domain_reader.getFinerDomain();
+  Vector<2> coeffs(domain, 1);
+  DomainTools::SetValuesWithGhost<2>(
+    domain, coeffs, [](const std::array<double, 2>& coord) { return 1 + coord[0]; });
+  BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+  VarPoisson::StarPatchOperator<2> op(coeffs, domain, gf);
+  VarPoisson::DirectPatchSolver<2> solver(op);
+  unique_ptr<VarPoisson::DirectPatchSolver<2>> clone(solver.clone());
+
+  DomainTools::SetValuesWithGhost<2>(
+    domain, coeffs, [](const std::array<double, 2>& coord) { return 2 + sin(5 * coord[1]); });
+  op.setCoefficients(coeffs);
+  solver.refactor();
+
+  // the clone shares the factorizations
+  CheckMatchesIterative(domain, op, *clone);
+}
+TEST_CASE("VarPoisson::DirectPatchSolver reports the memory of the factorizations")
+{
+  DomainReader<2> domain_reader("mesh_inputs/2d_uniform_2x2_mpi1.json", { 6, 8 }, 1);
+  Domain<2> domain = domain_reader.getFinerDomain();
+  auto timer = make_shared<Timer>(Communicator(MPI_COMM_WORLD));
+  domain.setTimer(timer);
+  Vector<2> coeffs(domain, 1);
+  DomainTools::SetValuesWithGhost<2>(domain, coeffs, [](const std::array<double, 2>&) {
+    return 1.0;
+  });
+  BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+  VarPoisson::StarPatchOperator<2> op(coeffs, domain, gf);
+  VarPoisson::DirectPatchSolver<2> solver(op);
+
+  // 6 x 8 cells, bandwidth of 6
+  CHECK_EQ(solver.getFactorizationMemoryUsage(),
+           domain.getNumLocalPatches() * (6 + 1) * 48 * sizeof(double));
+
+  stringstream ss;
+  ss << *timer;
+  CHECK_NE(ss.str().find("DirectPatchSolver Factorization"), string::npos);
+  CHECK_NE(ss.str().find("Factorization Memory (MB)"), string::npos);
+}
@@ -0,0 +1,145 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2020-2021 Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#include "../utils/UniformDomainGenerator.h"
+#include <ThunderEgg/Iterative/BiCGStab.h>
+#include <ThunderEgg/VarPoisson/GMGHierarchy.h>
+
+#include <doctest.h>
+
+using namespace std;
+using namespace ThunderEgg;
+
+namespace {
+double
+SmoothCoeff(const std::array<double, 2>& coord)
+{
+  return 1 + coord[0] * coord[1];
+}
+double
+JumpCoeff(const std::array<double, 2>& coord)
+{
+  return (coord[0] > 0.5 && coord[1] > 0.5) ? 100 : 1;
+}
+Iterative::BiCGStab<2>
+GetPatchSolver()
+{
+  Iterative::BiCGStab<2> bcgs;
+  bcgs.setTolerance(1e-12);
+  return bcgs;
+}
+/**
+ * @brief Run the cycle as a stationary iteration, return the number of cycles needed to reduce
+ * the residual by 1e-8
+ */
+int
+CyclesToConverge(const VarPoisson::GMGHierarchy<2>& hierarchy)
+{
+  const Operator<2>& op = hierarchy.getOperator(0);
+  auto cycle = hierarchy.getCycle();
+
+  Vector<2> f(hierarchy.getDomain(0), 1);
+  DomainTools::SetValues<2>(hierarchy.getDomain(0), f, [](const std::array<double, 2>& coord) {
+    return sin(M_PI * coord[0]) * sin(2 * M_PI * coord[1]) + 1;
+  });
+  Vector<2> u = f.getZeroClone();
+  Vector<2> r = f;
+  Vector<2> e = f.getZeroClone();
+  double f_norm = f.twoNorm();
+  for (int i = 1; i <= 50; i++) {
+    cycle->apply(r, e);
+    u.add(e);
+    op.apply(u, r);
+    r.scaleThenAdd(-1, f);
+    if (r.twoNorm() < 1e-8 * f_norm) {
+      return i;
+    }
+  }
+  return 51;
+}
+} // namespace
+
+TEST_CASE("GMGHierarchy takes every level from the generator")
+{
+  UniformDomainGenerator generator(8, { 4, 4 }, 1);
+  VarPoisson::GMGHierarchy<2> hierarchy(generator, SmoothCoeff, GMG::CycleOpts(), GetPatchSolver());
+
+  REQUIRE_EQ(hierarchy.getNumLevels(), 4);
+  CHECK_EQ(hierarchy.getDomain(0).getNumGlobalPatches(), 64);
+  CHECK_EQ(hierarchy.getDomain(1).getNumGlobalPatches(), 16);
+  CHECK_EQ(hierarchy.getDomain(2).getNumGlobalPatches(), 4);
+  CHECK_EQ(hierarchy.getDomain(3).getNumGlobalPatches(), 1);
+  CHECK_NE(hierarchy.getCycle(), nullptr);
+}
+TEST_CASE("GMGHierarchy restricts constant coefficients to every level")
+{
+  UniformDomainGenerator generator(4, { 4, 4 }, 1);
+  VarPoisson::GMGHierarchy<2> hierarchy(
+    generator, [](const std::array<double, 2>&) { return 3.0; }, GMG::CycleOpts(), GetPatchSolver());
+
+  for (int level = 0; level < hierarchy.getNumLevels(); level++) {
+    const Vector<2>& coeffs = hierarchy.getOperator(level).getCoefficients();
+    for (int i = 0; i < coeffs.getNumLocalPatches(); i++) {
+      ComponentView<const double, 2> view = coeffs.getComponentView(0, i);
+      Loop::Nested<2>(view.getGhostStart(), view.getGhostEnd(), [&](const array<int, 2>& coord) {
+        bool corner = (coord[0] < 0 || coord[0] >= 4) && (coord[1] < 0 || coord[1] >= 4);
+        if (!corner) {
+          CHECK_EQ(view[coord], doctest::Approx(3.0));
+        }
+      });
+    }
+  }
+}
+TEST_CASE("GMGHierarchy cycle converges")
+{
+  UniformDomainGenerator generator(4, { 8, 8 }, 1);
+  VarPoisson::GMGHierarchy<2> hierarchy(generator, JumpCoeff, GMG::CycleOpts(), GetPatchSolver());
+  CHECK_LE(CyclesToConverge(hierarchy), 50);
+}
+TEST_CASE("GMGHierarchy updateCoefficients matches a newly built hierarchy")
+{
+  UniformDomainGenerator generator(4, { 8, 8 }, 1);
+  VarPoisson::GMGHierarchy<2> updated(generator, SmoothCoeff, GMG::CycleOpts(), GetPatchSolver());
+  updated.updateCoefficients(JumpCoeff);
+
+  UniformDomainGenerator new_generator(4, { 8, 8 }, 1);
+  VarPoisson::GMGHierarchy<2> built(new_generator, JumpCoeff, GMG::CycleOpts(), GetPatchSolver());
+
+  Vector<2> f(updated.getDomain(0), 1);
+  DomainTools::SetValues<2>(updated.getDomain(0), f, [](const std::array<double, 2>& coord) {
+    return sin(M_PI * coord[0]) * coord[1];
+  });
+  Vector<2> u_updated = f.getZeroClone();
+  Vector<2> u_built = f.getZeroClone();
+  updated.getCycle()->apply(f, u_updated);
+  built.getCycle()->apply(f, u_built);
+
+  Vector<2> diff = f.getZeroClone();
+  diff.addScaled(1.0, u_updated, -1.0, u_built);
+  CHECK_GT(u_built.twoNorm(), 0);
+  CHECK_LE(diff.twoNorm(), 1e-10 * u_built.twoNorm());
+}
+TEST_CASE("GMGHierarchy updateCoefficients throws for a vector on another Domain")
+{
+  UniformDomainGenerator generator(4, { 4, 4 }, 1);
+  VarPoisson::GMGHierarchy<2> hierarchy(generator, SmoothCoeff, GMG::CycleOpts(), GetPatchSolver());
+
+  Vector<2> coeffs(hierarchy.getDomain(1), 1);
+  CHECK_THROWS_AS(hierarchy.updateCoefficients(coeffs), RuntimeError);
+}
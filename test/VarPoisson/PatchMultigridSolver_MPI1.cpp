@@ -0,0 +1,170 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2020-2021 Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#include "../utils/DomainReader.h"
+#include <ThunderEgg/BiLinearGhostFiller.h>
+#include <ThunderEgg/DomainTools.h>
+#include <ThunderEgg/Iterative/BiCGStab.h>
+#include <ThunderEgg/Iterative/PatchSolver.h>
+#include <ThunderEgg/Timer.h>
+#include <ThunderEgg/TriLinearGhostFiller.h>
+#include <ThunderEgg/VarPoisson/PatchMultigridSolver.h>
+
+#include <doctest.h>
+#include <sstream>
+
+using namespace std;
+using namespace ThunderEgg;
+
+#define MESHES "mesh_inputs/2d_uniform_2x2_mpi1.json", "mesh_inputs/2d_uniform_8x8_refined_cross_mpi1.json"
+
+namespace {
+/**
+ * @brief Check that a smooth with the multigrid solver matches a smooth with a tightly converged
+ * iterative patch solver
+ */
+template<int D>
+void
+CheckMatchesIterative(const Domain<D>& domain,
+                      const VarPoisson::StarPatchOperator<D>& op,
+                      const VarPoisson::PatchMultigridSolver<D>& solver)
+{
+  Vector<D> f(domain, 1);
+  DomainTools::SetValues<D>(domain, f, [](const std::array<double, D>& coord) {
+    return sin(3 * coord[0]) + coord[1] * coord[1];
+  });
+  Vector<D> u(domain, 1);
+  DomainTools::SetValuesWithGhost<D>(
+    domain, u, [](const std::array<double, D>& coord) { return coord[0] * coord[1]; });
+  Vector<D> u_expected = u;
+
+  Iterative::BiCGStab<D> bcgs;
+  bcgs.setTolerance(1e-13);
+  bcgs.setMaxIterations(10000);
+  Iterative::PatchSolver<D> expected_solver(bcgs, op);
+
+  solver.smooth(f, u);
+  expected_solver.smooth(f, u_expected);
+
+  Vector<D> diff(domain, 1);
+  diff.addScaled(1.0, u, -1.0, u_expected);
+  CHECK_GT(u_expected.twoNorm(), 0);
+  CHECK_LE(diff.twoNorm(), 1e-8 * u_expected.twoNorm());
+}
+} // namespace
+
+TEST_CASE("VarPoisson::PatchMultigridSolver matches Iterative::PatchSolver")
+{
+  for (auto mesh_file : { MESHES }) {
+    for (auto ns : { array<int, 2>{ 8, 8 }, array<int, 2>{ 12, 6 }, array<int, 2>{ 7, 9 } }) {
+      DomainReader<2> domain_reader(mesh_file, ns, 1);
+      Domain<2> domain = domain_reader.getFinerDomain();
+      Vector<2> coeffs(domain, 1);
+      DomainTools::SetValuesWithGhost<2>(domain, coeffs, [](const std::array<double, 2>& coord) {
+        return 1 + coord[0] * coord[1] + ((coord[0] > 0.5) ? 10 : 0);
+      });
+      BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+      VarPoisson::StarPatchOperator<2> op(coeffs, domain, gf);
+      VarPoisson::PatchMultigridSolver<2> solver(op, 1e-12);
+
+      CheckMatchesIterative(domain, op, solver);
+    }
+  }
+}
+TEST_CASE("VarPoisson::PatchMultigridSolver matches Iterative::PatchSolver in 3d")
+{
+  DomainReader<3> domain_reader("mesh_inputs/3d_mid_refine_4x4x4_mpi1.json", { 8, 8, 4 }, 1);
+  Domain<3> domain = domain_reader.getFinerDomain();
+  Vector<3> coeffs(domain, 1);
+  DomainTools::SetValuesWithGhost<3>(domain, coeffs, [](const std::array<double, 3>& coord) {
+    return 1 + coord[0] + coord[1] * coord[2];
+  });
+  TriLinearGhostFiller gf(domain, GhostFillingType::Faces);
+  VarPoisson::StarPatchOperator<3> op(coeffs, domain, gf);
+  VarPoisson::PatchMultigridSolver<3> solver(op, 1e-12);
+
+  CHECK_EQ(solver.getNumLevels(), 2);
+  CheckMatchesIterative(domain, op, solver);
+}
+TEST_CASE("VarPoisson::PatchMultigridSolver coarsens while the patch sizes are even")
+{
+  for (auto ns : { array<int, 2>{ 32, 16 }, array<int, 2>{ 12, 6 }, array<int, 2>{ 7, 8 } }) {
+    DomainReader<2> domain_reader("mesh_inputs/2d_uniform_2x2_mpi1.json", ns, 1);
+    Domain<2> domain = domain_reader.getFinerDomain();
+    Vector<2> coeffs(domain, 1);
+    BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+    VarPoisson::StarPatchOperator<2> op(coeffs, domain, gf);
+    VarPoisson::PatchMultigridSolver<2> solver(op);
+
+    if (ns[1] == 16) {
+      CHECK_EQ(solver.getNumLevels(), 4);
+    } else if (ns[1] == 6) {
+      CHECK_EQ(solver.getNumLevels(), 2);
+    } else {
+      CHECK_EQ(solver.getNumLevels(), 1);
+    }
+  }
+}
+TEST_CASE("VarPoisson::PatchMultigridSolver converges in a few cycles")
+{
+  DomainReader<2> domain_reader("mesh_inputs/2d_uniform_2x2_mpi1.json", { 32, 32 }, 1);
+  Domain<2> domain = domain_reader.getFinerDomain();
+  auto timer = make_shared<Timer>(Communicator(MPI_COMM_WORLD));
+  domain.setTimer(timer);
+  Vector<2> coeffs(domain, 1);
+  DomainTools::SetValuesWithGhost<2>(domain, coeffs, [](const std::array<double, 2>& coord) {
+    return 1 + 0.5 * sin(7 * coord[0]) * cos(5 * coord[1]);
+  });
+  BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+  VarPoisson::StarPatchOperator<2> op(coeffs, domain, gf);
+  VarPoisson::PatchMultigridSolver<2> solver(op, 1e-10, 12);
+  unique_ptr<VarPoisson::PatchMultigridSolver<2>> clone(solver.clone());
+
+  // the clone uses the updated coefficients
+  DomainTools::SetValuesWithGhost<2>(domain, coeffs, [](const std::array<double, 2>& coord) {
+    return 2 + 0.5 * sin(7 * coord[0]) * cos(5 * coord[1]);
+  });
+  op.setCoefficients(coeffs);
+
+  CheckMatchesIterative(domain, op, *clone);
+
+  stringstream ss;
+  ss << *timer;
+  CHECK_NE(ss.str().find("Cycles"), string::npos);
+}
+TEST_CASE("VarPoisson::PatchMultigridSolver zeroes the initial guess for a zero rhs")
+{
+  // a single patch, so there are no neighbor values in the modified rhs
+  DomainReader<2> domain_reader("mesh_inputs/2d_uniform_2x2_mpi1.json", { 8, 8 }, 1);
+  Domain<2> domain = domain_reader.getCoarserDomain();
+  REQUIRE_EQ(domain.getNumGlobalPatches(), 1);
+  Vector<2> coeffs(domain, 1);
+  coeffs.setWithGhost(1);
+  BiLinearGhostFiller gf(domain, GhostFillingType::Faces);
+  VarPoisson::StarPatchOperator<2> op(coeffs, domain, gf);
+  VarPoisson::PatchMultigridSolver<2> solver(op);
+
+  Vector<2> f(domain, 1);
+  Vector<2> u(domain, 1);
+  u.set(1);
+
+  solver.smooth(f, u);
+
+  CHECK_EQ(u.infNorm(), 0);
+}
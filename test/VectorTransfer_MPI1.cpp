@@ -0,0 +1,194 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#include "utils/DomainReader.h"
+#include <ThunderEgg/DomainTools.h>
+#include <ThunderEgg/VectorTransfer.h>
+
+#include <doctest.h>
+
+using namespace std;
+using namespace ThunderEgg;
+using namespace doctest;
+
+constexpr auto single_mesh_file = "mesh_inputs/2d_uniform_2x2_mpi1.json";
+constexpr auto refined_mesh_file = "mesh_inputs/2d_uniform_2x2_refined_nw_mpi1.json";
+constexpr auto uniform_mesh_file = "mesh_inputs/2d_uniform_4x4_mpi1.json";
+constexpr auto cross_mesh_file = "mesh_inputs/2d_uniform_8x8_refined_cross_mpi1.json";
+constexpr auto refined_3d_mesh_file = "mesh_inputs/3d_refined_bnw_2x2x2_mpi1.json";
+
+template<int D>
+static void
+CheckVectorsEqual(const Domain<D>& domain, const Vector<D>& vec, const Vector<D>& expected)
+{
+  for (const PatchInfo<D>& pinfo : domain.getPatchInfoVector()) {
+    PatchView<const double, D> vec_view = vec.getPatchView(pinfo.local_index);
+    PatchView<const double, D> expected_view = expected.getPatchView(pinfo.local_index);
+    Loop::OverInteriorIndexes<D + 1>(vec_view, [&](const array<int, D + 1>& coord) {
+      REQUIRE_EQ(vec_view[coord], Approx(expected_view[coord]));
+    });
+  }
+}
+TEST_CASE("VectorTransfer copies vector to same domain")
+{
+  for (auto mesh_file : { single_mesh_file, refined_mesh_file, cross_mesh_file }) {
+    DomainReader<2> domain_reader(mesh_file, { 4, 6 }, 1);
+    Domain<2> domain = domain_reader.getFinerDomain();
+
+    auto f = [](const std::array<double, 2>& coord) { return sin(coord[0]) + cos(coord[1]); };
+    auto g = [](const std::array<double, 2>& coord) { return coord[0] * coord[1]; };
+
+    Vector<2> old_vector(domain, 2);
+    DomainTools::SetValues<2>(domain, old_vector, f, g);
+
+    VectorTransfer<2> transfer(domain, domain);
+    Vector<2> new_vector(domain, 2);
+    transfer.transfer(old_vector, new_vector);
+
+    CHECK_EQ(transfer.getNumGhostPatches(), 0);
+    CheckVectorsEqual(domain, new_vector, old_vector);
+  }
+}
+TEST_CASE("VectorTransfer averages linear function on coarsened patches")
+{
+  for (auto mesh_file : { refined_mesh_file, uniform_mesh_file, cross_mesh_file }) {
+    for (int n : { 2, 6 }) {
+      DomainReader<2> domain_reader(mesh_file, { n, n }, 1);
+      Domain<2> old_domain = domain_reader.getFinerDomain();
+      Domain<2> new_domain = domain_reader.getCoarserDomain();
+
+      auto f = [](const std::array<double, 2>& coord) { return 1 + 0.5 * coord[0] - coord[1]; };
+      auto g = [](const std::array<double, 2>& coord) { return 3 * coord[0] + 2 * coord[1]; };
+
+      Vector<2> old_vector(old_domain, 2);
+      DomainTools::SetValues<2>(old_domain, old_vector, f, g);
+      Vector<2> expected(new_domain, 2);
+      DomainTools::SetValues<2>(new_domain, expected, f, g);
+
+      VectorTransfer<2> transfer(old_domain, new_domain);
+      Vector<2> new_vector(new_domain, 2);
+      new_vector.set(99);
+      transfer.transfer(old_vector, new_vector);
+
+      CheckVectorsEqual(new_domain, new_vector, expected);
+    }
+  }
+}
+TEST_CASE("VectorTransfer refining then coarsening gives the same vector")
+{
+  for (auto mesh_file : { refined_mesh_file, uniform_mesh_file, cross_mesh_file }) {
+    DomainReader<2> domain_reader(mesh_file, { 4, 4 }, 1);
+    Domain<2> coarse_domain = domain_reader.getCoarserDomain();
+    Domain<2> fine_domain = domain_reader.getFinerDomain();
+
+    auto f = [](const std::array<double, 2>& coord) { return sin(coord[0]) + cos(coord[1]); };
+
+    Vector<2> coarse_vector(coarse_domain, 1);
+    DomainTools::SetValues<2>(coarse_domain, coarse_vector, f);
+
+    VectorTransfer<2> refine(coarse_domain, fine_domain);
+    Vector<2> fine_vector(fine_domain, 1);
+    refine.transfer(coarse_vector, fine_vector);
+
+    VectorTransfer<2> coarsen(fine_domain, coarse_domain);
+    Vector<2> result(coarse_domain, 1);
+    coarsen.transfer(fine_vector, result);
+
+    CheckVectorsEqual(coarse_domain, result, coarse_vector);
+  }
+}
+TEST_CASE("VectorTransfer injects values on refined patches")
+{
+  DomainReader<2> domain_reader(refined_mesh_file, { 2, 2 }, 1);
+  Domain<2> coarse_domain = domain_reader.getCoarserDomain();
+  Domain<2> fine_domain = domain_reader.getFinerDomain();
+
+  Vector<2> coarse_vector(coarse_domain, 1);
+  DomainTools::SetValues<2>(
+    coarse_domain, coarse_vector, [](const std::array<double, 2>& coord) { return coord[0]; });
+
+  VectorTransfer<2> transfer(coarse_domain, fine_domain);
+  Vector<2> fine_vector(fine_domain, 1);
+  transfer.transfer(coarse_vector, fine_vector);
+
+  for (const PatchInfo<2>& fine_pinfo : fine_domain.getPatchInfoVector()) {
+    PatchView<const double, 2> fine_view = fine_vector.getPatchView(fine_pinfo.local_index);
+    Loop::OverInteriorIndexes<3>(fine_view, [&](const array<int, 3>& coord) {
+      std::array<double, 2> real_coord;
+      DomainTools::GetRealCoord<2>(fine_pinfo, { coord[0], coord[1] }, real_coord);
+      // the x coordinate of the center of the coarse cell that contains the fine cell
+      for (const PatchInfo<2>& coarse_pinfo : coarse_domain.getPatchInfoVector()) {
+        double lower = coarse_pinfo.starts[0];
+        double upper = lower + coarse_pinfo.ns[0] * coarse_pinfo.spacings[0];
+        double lower_y = coarse_pinfo.starts[1];
+        double upper_y = lower_y + coarse_pinfo.ns[1] * coarse_pinfo.spacings[1];
+        if (lower < real_coord[0] && real_coord[0] < upper && lower_y < real_coord[1] &&
+            real_coord[1] < upper_y) {
+          double h = coarse_pinfo.spacings[0];
+          double expected = lower + (floor((real_coord[0] - lower) / h) + 0.5) * h;
+          CHECK_EQ(fine_view[coord], Approx(expected));
+        }
+      }
+    });
+  }
+}
+TEST_CASE("VectorTransfer averages linear function on coarsened 3d patches")
+{
+  DomainReader<3> domain_reader(refined_3d_mesh_file, { 2, 4, 2 }, 1);
+  Domain<3> old_domain = domain_reader.getFinerDomain();
+  Domain<3> new_domain = domain_reader.getCoarserDomain();
+
+  auto f = [](const std::array<double, 3>& coord) { return coord[0] - 2 * coord[1] + coord[2]; };
+
+  Vector<3> old_vector(old_domain, 1);
+  DomainTools::SetValues<3>(old_domain, old_vector, f);
+  Vector<3> expected(new_domain, 1);
+  DomainTools::SetValues<3>(new_domain, expected, f);
+
+  VectorTransfer<3> transfer(old_domain, new_domain);
+  Vector<3> new_vector(new_domain, 1);
+  transfer.transfer(old_vector, new_vector);
+
+  CheckVectorsEqual(new_domain, new_vector, expected);
+}
+TEST_CASE("VectorTransfer throws with different patch sizes")
+{
+  DomainReader<2> domain_reader_4(refined_mesh_file, { 4, 4 }, 1);
+  DomainReader<2> domain_reader_2(refined_mesh_file, { 2, 2 }, 1);
+
+  CHECK_THROWS_AS(VectorTransfer<2>(domain_reader_4.getFinerDomain(),
+                                    domain_reader_2.getFinerDomain()),
+                  RuntimeError);
+}
+TEST_CASE("VectorTransfer transfer throws with mismatched vectors")
+{
+  DomainReader<2> domain_reader(refined_mesh_file, { 4, 4 }, 1);
+  Domain<2> old_domain = domain_reader.getFinerDomain();
+  Domain<2> new_domain = domain_reader.getCoarserDomain();
+
+  VectorTransfer<2> transfer(old_domain, new_domain);
+
+  Vector<2> old_vector(old_domain, 2);
+  Vector<2> new_vector(new_domain, 1);
+  CHECK_THROWS_AS(transfer.transfer(old_vector, new_vector), RuntimeError);
+
+  Vector<2> new_vector_2(new_domain, 2);
+  CHECK_THROWS_AS(transfer.transfer(new_vector_2, new_vector_2), RuntimeError);
+  CHECK_THROWS_AS(transfer.transfer(old_vector, old_vector), RuntimeError);
+}
@@ -0,0 +1,113 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2021      Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#include "utils/DomainReader.h"
+#include <ThunderEgg/DomainTools.h>
+#include <ThunderEgg/VectorTransfer.h>
+
+#include <doctest.h>
+
+using namespace std;
+using namespace ThunderEgg;
+using namespace doctest;
+
+constexpr auto mid_mesh_file = "mesh_inputs/2d_uniform_4x4_mid_on_1_mpi2.json";
+constexpr auto sw_mesh_file = "mesh_inputs/2d_uniform_4x4_sw_on_1_mpi2.json";
+constexpr auto refined_mesh_file = "mesh_inputs/2d_uniform_2x2_refined_nw_on_1_mpi2.json";
+constexpr auto cross_mesh_file = "mesh_inputs/2d_uniform_8x8_refined_cross_on_1_mpi2.json";
+
+static void
+CheckVectorsEqual(const Domain<2>& domain, const Vector<2>& vec, const Vector<2>& expected)
+{
+  for (const PatchInfo<2>& pinfo : domain.getPatchInfoVector()) {
+    PatchView<const double, 2> vec_view = vec.getPatchView(pinfo.local_index);
+    PatchView<const double, 2> expected_view = expected.getPatchView(pinfo.local_index);
+    Loop::OverInteriorIndexes<3>(vec_view, [&](const array<int, 3>& coord) {
+      REQUIRE_EQ(vec_view[coord], Approx(expected_view[coord]));
+    });
+  }
+}
+TEST_CASE("VectorTransfer migrates patches to different ranks")
+{
+  DomainReader<2> mid_domain_reader(mid_mesh_file, { 4, 6 }, 1);
+  DomainReader<2> sw_domain_reader(sw_mesh_file, { 4, 6 }, 1);
+  Domain<2> old_domain = mid_domain_reader.getFinerDomain();
+  Domain<2> new_domain = sw_domain_reader.getFinerDomain();
+
+  auto f = [](const std::array<double, 2>& coord) { return sin(coord[0]) + cos(coord[1]); };
+  auto g = [](const std::array<double, 2>& coord) { return coord[0] * coord[1]; };
+
+  Vector<2> old_vector(old_domain, 2);
+  DomainTools::SetValues<2>(old_domain, old_vector, f, g);
+  Vector<2> expected(new_domain, 2);
+  DomainTools::SetValues<2>(new_domain, expected, f, g);
+
+  VectorTransfer<2> transfer(old_domain, new_domain);
+  Vector<2> new_vector(new_domain, 2);
+  transfer.transfer(old_vector, new_vector);
+
+  // both ranks receive patches from the other rank
+  CHECK_GT(transfer.getNumGhostPatches(), 0);
+  CheckVectorsEqual(new_domain, new_vector, expected);
+}
+TEST_CASE("VectorTransfer averages linear function on coarsened patches on other ranks")
+{
+  for (auto mesh_file : { refined_mesh_file, mid_mesh_file, cross_mesh_file }) {
+    DomainReader<2> domain_reader(mesh_file, { 4, 4 }, 1);
+    Domain<2> old_domain = domain_reader.getFinerDomain();
+    Domain<2> new_domain = domain_reader.getCoarserDomain();
+
+    auto f = [](const std::array<double, 2>& coord) { return 1 + 0.5 * coord[0] - coord[1]; };
+    auto g = [](const std::array<double, 2>& coord) { return 3 * coord[0] + 2 * coord[1]; };
+
+    Vector<2> old_vector(old_domain, 2);
+    DomainTools::SetValues<2>(old_domain, old_vector, f, g);
+    Vector<2> expected(new_domain, 2);
+    DomainTools::SetValues<2>(new_domain, expected, f, g);
+
+    VectorTransfer<2> transfer(old_domain, new_domain);
+    Vector<2> new_vector(new_domain, 2);
+    transfer.transfer(old_vector, new_vector);
+
+    CheckVectorsEqual(new_domain, new_vector, expected);
+  }
+}
+TEST_CASE("VectorTransfer refining then coarsening on other ranks gives the same vector")
+{
+  for (auto mesh_file : { refined_mesh_file, mid_mesh_file, cross_mesh_file }) {
+    DomainReader<2> domain_reader(mesh_file, { 4, 4 }, 1);
+    Domain<2> coarse_domain = domain_reader.getCoarserDomain();
+    Domain<2> fine_domain = domain_reader.getFinerDomain();
+
+    auto f = [](const std::array<double, 2>& coord) { return sin(coord[0]) + cos(coord[1]); };
+
+    Vector<2> coarse_vector(coarse_domain, 1);
+    DomainTools::SetValues<2>(coarse_domain, coarse_vector, f);
+
+    VectorTransfer<2> refine(coarse_domain, fine_domain);
+    Vector<2> fine_vector(fine_domain, 1);
+    refine.transfer(coarse_vector, fine_vector);
+
+    VectorTransfer<2> coarsen(fine_domain, coarse_domain);
+    Vector<2> result(coarse_domain, 1);
+    coarsen.transfer(fine_vector, result);
+
+    CheckVectorsEqual(coarse_domain, result, coarse_vector);
+  }
+}
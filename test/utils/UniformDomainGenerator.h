@@ -0,0 +1,120 @@
+/***************************************************************************
+ *  ThunderEgg, a library for solvers on adaptively refined block-structured
+ *  Cartesian grids.
+ *
+ *  Copyright (c) 2020-2021 Scott Aiton
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+#ifndef THUNDEREGG_TEST_UTILS_UNIFORMDOMAINGENERATOR_H
+#define THUNDEREGG_TEST_UTILS_UNIFORMDOMAINGENERATOR_H
+#include <ThunderEgg/DomainGenerator.h>
+#include <ThunderEgg/NormalNbrInfo.h>
+/**
+ * @brief Generates a hierarchy of uniform 2d domains on the unit square
+ *
+ * The finest level has num_patches_per_side x num_patches_per_side patches, each coarser level
+ * halves that until a single patch is left. On each level the patches are numbered in row-major
+ * order and are split into contiguous ranges over the ranks of MPI_COMM_WORLD.
+ */
+class UniformDomainGenerator : public ThunderEgg::DomainGenerator<2>
+{
+private:
+  ThunderEgg::Communicator comm;
+  int finest_num_patches_per_side;
+  int curr_num_patches_per_side;
+  std::array<int, 2> ns;
+  int num_ghost_cells;
+  int id = 0;
+
+  int owner(int index, int num_patches) const
+  {
+    return (int)((long long)index * comm.getSize() / num_patches);
+  }
+  ThunderEgg::Domain<2> generate()
+  {
+    int n = curr_num_patches_per_side;
+    std::vector<ThunderEgg::PatchInfo<2>> pinfos;
+    for (int index = 0; index < n * n; index++) {
+      if (owner(index, n * n) != comm.getRank()) {
+        continue;
+      }
+      int i = index % n;
+      int j = index / n;
+      ThunderEgg::PatchInfo<2>& pinfo = pinfos.emplace_back();
+      pinfo.id = index;
+      pinfo.rank = comm.getRank();
+      pinfo.ns = ns;
+      pinfo.num_ghost_cells = num_ghost_cells;
+      pinfo.refine_level = 0;
+      for (int m = n; m > 1; m /= 2) {
+        pinfo.refine_level++;
+      }
+      pinfo.starts = { (double)i / n, (double)j / n };
+      pinfo.spacings = { 1.0 / n / ns[0], 1.0 / n / ns[1] };
+      if (n > 1) {
+        pinfo.parent_id = (j / 2) * (n / 2) + i / 2;
+        pinfo.parent_rank = owner(pinfo.parent_id, n * n / 4);
+        pinfo.orth_on_parent = ThunderEgg::Orthant<2>((unsigned char)(i % 2 + 2 * (j % 2)));
+      }
+      if (n < finest_num_patches_per_side) {
+        for (int orth = 0; orth < 4; orth++) {
+          int child_id = (2 * j + orth / 2) * (2 * n) + 2 * i + orth % 2;
+          pinfo.child_ids[orth] = child_id;
+          pinfo.child_ranks[orth] = owner(child_id, 4 * n * n);
+        }
+      }
+      auto set_nbr = [&](ThunderEgg::Side<2> s, int nbr_id) {
+        auto info = new ThunderEgg::NormalNbrInfo<1>(nbr_id);
+        info->rank = owner(nbr_id, n * n);
+        pinfo.setNbrInfo(s, info);
+      };
+      if (i > 0) {
+        set_nbr(ThunderEgg::Side<2>::west(), index - 1);
+      }
+      if (i < n - 1) {
+        set_nbr(ThunderEgg::Side<2>::east(), index + 1);
+      }
+      if (j > 0) {
+        set_nbr(ThunderEgg::Side<2>::south(), index - n);
+      }
+      if (j < n - 1) {
+        set_nbr(ThunderEgg::Side<2>::north(), index + n);
+      }
+    }
+    curr_num_patches_per_side /= 2;
+    return ThunderEgg::Domain<2>(comm, id++, ns, num_ghost_cells, pinfos.begin(), pinfos.end());
+  }
+
+public:
+  /**
+   * @brief Construct a new UniformDomainGenerator
+   *
+   * @param num_patches_per_side number of patches along each side of the finest level, has to
+   * be a power of two
+   * @param ns the number of cells in each direction
+   * @param num_ghost_cells the number of ghost cells on each side of a patch
+   */
+  UniformDomainGenerator(int num_patches_per_side, std::array<int, 2> ns, int num_ghost_cells)
+    : comm(MPI_COMM_WORLD)
+    , finest_num_patches_per_side(num_patches_per_side)
+    , curr_num_patches_per_side(num_patches_per_side)
+    , ns(ns)
+    , num_ghost_cells(num_ghost_cells)
+  {}
+  ThunderEgg::Domain<2> getFinestDomain() override { return generate(); }
+  bool hasCoarserDomain() override { return curr_num_patches_per_side >= 1; }
+  ThunderEgg::Domain<2> getCoarserDomain() override { return generate(); }
+};
+#endif